@@ -0,0 +1,136 @@
+#pragma once
+
+/**
+ * Minimal Arduino API for host (native) builds.
+ *
+ * Provides String, millis/micros/delay on top of FakeClock, random() and a Serial that
+ * writes to stdout. Only what the project libraries use, not a full core.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <thread>
+
+#include "WString.h"
+#include "FakeClock.h"
+
+inline unsigned long millis() { return (unsigned long)(uint32_t)FakeClock::instance().millis(); }
+inline unsigned long micros() { return (unsigned long)(uint32_t)FakeClock::instance().micros(); }
+
+// Advances a frozen clock, otherwise sleeps for real
+inline void delay(uint32_t ms)
+{
+    if (FakeClock::instance().isFrozen())
+        FakeClock::instance().advanceMillis(ms);
+    else
+        std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+inline void delayMicroseconds(uint32_t us)
+{
+    if (FakeClock::instance().isFrozen())
+        FakeClock::instance().advance(us);
+    else
+        std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+inline void yield() {}
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+inline void randomSeed(unsigned long seed) { srand(seed); }
+inline long random(long max) { return max > 0 ? rand() % max : 0; }
+inline long random(long min, long max) { return max > min ? min + rand() % (max - min) : min; }
+
+/**--------------------------------------------------------------------------------------
+ * Print Class
+ *-------------------------------------------------------------------------------------*/
+
+class Print
+{
+protected:
+    FILE *out;
+
+public:
+    Print(FILE *out) : out(out) {};
+
+    size_t write(uint8_t c) { return fputc(c, out) == EOF ? 0 : 1; }
+    size_t write(const uint8_t *buffer, size_t size) { return fwrite(buffer, 1, size, out); }
+
+    size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)))
+    {
+        va_list args;
+        va_start(args, format);
+        int written = vfprintf(out, format, args);
+        va_end(args);
+        return written < 0 ? 0 : written;
+    }
+
+    size_t print(const char *text) { return fputs(text, out) < 0 ? 0 : strlen(text); }
+    size_t print(const String &text) { return print(text.c_str()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(int value) { return printf("%d", value); }
+    size_t print(unsigned int value) { return printf("%u", value); }
+    size_t print(long value) { return printf("%ld", value); }
+    size_t print(unsigned long value) { return printf("%lu", value); }
+    size_t print(double value, int decimals = 2) { return printf("%.*f", decimals, value); }
+
+    size_t println() { return print("\r\n"); }
+    template <typename T>
+    size_t println(const T &value)
+    {
+        size_t written = print(value);
+        return written + println();
+    }
+
+    void flush() { fflush(out); }
+};
+
+class HardwareSerial : public Print
+{
+public:
+    HardwareSerial() : Print(stdout) {};
+
+    void begin(unsigned long) {}
+    void end() { flush(); }
+    int available() { return 0; }
+    int read() { return -1; }
+    operator bool() { return true; }
+};
+
+inline HardwareSerial Serial;
+
+/**--------------------------------------------------------------------------------------
+ * Client Class
+ *
+ * The connection interface of the Arduino core, host tests implement it with a stand-in
+ * server. Only the calls the network wrappers override.
+ *-------------------------------------------------------------------------------------*/
+
+class IPAddress
+{
+private:
+    uint8_t octets[4];
+
+public:
+    IPAddress(uint8_t a = 0, uint8_t b = 0, uint8_t c = 0, uint8_t d = 0) : octets{a, b, c, d} {};
+
+    uint8_t operator[](int index) const { return octets[index]; }
+};
+
+class Client
+{
+public:
+    virtual ~Client() {}
+
+    virtual int connect(IPAddress ip, uint16_t port) = 0;
+    virtual int connect(const char *host, uint16_t port) = 0;
+    virtual uint8_t connected() = 0;
+    virtual void stop() = 0;
+};
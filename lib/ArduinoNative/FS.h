@@ -0,0 +1,173 @@
+#pragma once
+
+#include <Arduino.h>
+#include <filesystem>
+#include <memory>
+
+/**--------------------------------------------------------------------------------------
+ * File System Shim
+ *
+ * fs::FS and fs::File backed by a directory on the host, so code written against the
+ * ESP32 file system API (LittleFS, SPIFFS, SD) runs unchanged in native builds.
+ *-------------------------------------------------------------------------------------*/
+
+namespace fs
+{
+    class File
+    {
+    private:
+        std::shared_ptr<FILE> file;
+        std::shared_ptr<std::filesystem::directory_iterator> directory;
+        std::string hostPath;
+        String filePath;
+
+    public:
+        File() {}
+        File(FILE *file, const std::string &hostPath, const String &path)
+            : file(file, [](FILE *f) { if (f) fclose(f); }), hostPath(hostPath), filePath(path) {}
+        File(const std::string &hostPath, const String &path)
+            : directory(std::make_shared<std::filesystem::directory_iterator>(hostPath)), hostPath(hostPath), filePath(path) {}
+
+        operator bool() const { return file || directory; }
+        bool isDirectory() const { return (bool)directory; }
+        const char *path() const { return filePath.c_str(); }
+        const char *name() const
+        {
+            const char *slash = strrchr(filePath.c_str(), '/');
+            return slash ? slash + 1 : filePath.c_str();
+        }
+
+        size_t write(uint8_t c) { return file ? fwrite(&c, 1, 1, file.get()) : 0; }
+        size_t write(const uint8_t *buffer, size_t size) { return file ? fwrite(buffer, 1, size, file.get()) : 0; }
+        size_t print(const char *text) { return write((const uint8_t *)text, strlen(text)); }
+        size_t print(const String &text) { return print(text.c_str()); }
+
+        int read() { return file ? fgetc(file.get()) : -1; }
+        size_t read(uint8_t *buffer, size_t size) { return file ? fread(buffer, 1, size, file.get()) : 0; }
+        size_t readBytes(char *buffer, size_t size) { return read((uint8_t *)buffer, size); }
+        int peek()
+        {
+            int c = read();
+            if (c != EOF)
+                ungetc(c, file.get());
+            return c;
+        }
+        int available() { return file ? (int)(size() - position()) : 0; }
+
+        bool seek(uint32_t position) { return file && fseek(file.get(), position, SEEK_SET) == 0; }
+        size_t position() const { return file ? ftell(file.get()) : 0; }
+        size_t size() const
+        {
+            if (!file)
+                return 0;
+            fflush(file.get());
+            std::error_code error;
+            size_t size = std::filesystem::file_size(hostPath, error);
+            return error ? 0 : size;
+        }
+
+        // Modification time in seconds since the epoch
+        time_t getLastWrite() const
+        {
+            std::error_code error;
+            auto time = std::filesystem::last_write_time(hostPath, error);
+            if (error)
+                return 0;
+            auto system = std::chrono::time_point_cast<std::chrono::system_clock::duration>(
+                time - std::filesystem::file_time_type::clock::now() + std::chrono::system_clock::now());
+            return std::chrono::system_clock::to_time_t(system);
+        }
+
+        void flush()
+        {
+            if (file)
+                fflush(file.get());
+        }
+
+        void close()
+        {
+            file.reset();
+            directory.reset();
+        }
+
+        File openNextFile()
+        {
+            if (!directory)
+                return File();
+            std::filesystem::directory_iterator &it = *directory;
+            if (it == std::filesystem::directory_iterator())
+                return File();
+
+            std::filesystem::directory_entry entry = *it;
+            ++it;
+            String path = filePath + (filePath.endsWith("/") ? "" : "/") + entry.path().filename().string();
+            if (entry.is_directory())
+                return File(entry.path().string(), path);
+            FILE *file = fopen(entry.path().string().c_str(), "rb");
+            return file ? File(file, entry.path().string(), path) : File();
+        }
+    };
+
+    class FS
+    {
+    private:
+        std::string root;
+
+        std::string hostPath(const String &path) { return root + path.c_str(); }
+
+    public:
+        // root is the host directory that stands in for the mount point
+        FS(const char *root = "./.native_fs") : root(root) {}
+
+        bool begin(bool = false)
+        {
+            std::error_code error;
+            std::filesystem::create_directories(root, error);
+            return !error;
+        }
+
+        void end() {}
+
+        File open(const String &path, const char *mode = "r")
+        {
+            std::string host = hostPath(path);
+            if (std::filesystem::is_directory(host))
+                return File(host, path);
+
+            // Arduino "a" also allows reading, "w" and "a" create missing files
+            const char *hostMode = strcmp(mode, "w") == 0 ? "wb+" : strcmp(mode, "a") == 0 ? "ab+" : "rb";
+            FILE *file = fopen(host.c_str(), hostMode);
+            return file ? File(file, host, path) : File();
+        }
+
+        bool exists(const String &path) { return std::filesystem::exists(hostPath(path)); }
+
+        bool remove(const String &path)
+        {
+            std::error_code error;
+            return std::filesystem::remove(hostPath(path), error);
+        }
+
+        bool rename(const String &from, const String &to)
+        {
+            std::error_code error;
+            std::filesystem::rename(hostPath(from), hostPath(to), error);
+            return !error;
+        }
+
+        bool mkdir(const String &path)
+        {
+            std::error_code error;
+            return std::filesystem::create_directories(hostPath(path), error) || std::filesystem::is_directory(hostPath(path));
+        }
+
+        bool rmdir(const String &path)
+        {
+            std::error_code error;
+            return std::filesystem::remove(hostPath(path), error);
+        }
+    };
+} // namespace fs
+
+using fs::File;
+using fs::FS;
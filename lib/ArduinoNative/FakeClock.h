@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+
+/**--------------------------------------------------------------------------------------
+ * Fake Clock Class
+ *
+ * Time source behind millis() and micros() on the host. Runs on the steady clock by
+ * default, freeze() switches to manual time that only moves with set() and advance().
+ *-------------------------------------------------------------------------------------*/
+
+class FakeClock
+{
+private:
+    bool frozen = false;
+    uint64_t nowMicros = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+public:
+    static FakeClock &instance()
+    {
+        static FakeClock clock;
+        return clock;
+    }
+
+    uint64_t micros()
+    {
+        if (frozen)
+            return nowMicros;
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    uint64_t millis() { return micros() / 1000; }
+
+    // Stops real time, the clock keeps its current value until set() or advance()
+    void freeze()
+    {
+        nowMicros = micros();
+        frozen = true;
+    }
+
+    // Goes back to real time, continuing from the current value
+    void unfreeze()
+    {
+        start = std::chrono::steady_clock::now() - std::chrono::microseconds(micros());
+        frozen = false;
+    }
+
+    void set(uint64_t micros)
+    {
+        frozen = true;
+        nowMicros = micros;
+    }
+
+    void advance(uint64_t micros)
+    {
+        if (!frozen)
+            freeze();
+        nowMicros += micros;
+    }
+
+    void advanceMillis(uint64_t millis) { advance(millis * 1000); }
+
+    bool isFrozen() { return frozen; }
+};
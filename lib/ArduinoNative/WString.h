@@ -0,0 +1,139 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <string>
+
+/**--------------------------------------------------------------------------------------
+ * String Class
+ *
+ * Host stand-in for the Arduino String, backed by std::string. Only the subset of the
+ * Arduino API used by the project is provided so host builds catch the same misuse.
+ *-------------------------------------------------------------------------------------*/
+
+class String
+{
+private:
+    std::string buffer;
+
+    static std::string format(const char *fmt, double value, unsigned char decimals)
+    {
+        char text[64];
+        snprintf(text, sizeof(text), fmt, decimals, value);
+        return text;
+    }
+
+public:
+    String(const char *text = "") : buffer(text ? text : "") {}
+    String(const char *text, size_t length) : buffer(text, length) {}
+    String(const std::string &text) : buffer(text) {}
+    explicit String(char c) : buffer(1, c) {}
+    explicit String(int value) : buffer(std::to_string(value)) {}
+    explicit String(unsigned int value) : buffer(std::to_string(value)) {}
+    explicit String(long value) : buffer(std::to_string(value)) {}
+    explicit String(unsigned long value) : buffer(std::to_string(value)) {}
+    explicit String(long long value) : buffer(std::to_string(value)) {}
+    explicit String(unsigned long long value) : buffer(std::to_string(value)) {}
+    explicit String(float value, unsigned char decimals = 2) : buffer(format("%.*f", value, decimals)) {}
+    explicit String(double value, unsigned char decimals = 2) : buffer(format("%.*f", value, decimals)) {}
+
+    const char *c_str() const { return buffer.c_str(); }
+    unsigned int length() const { return buffer.length(); }
+    bool isEmpty() const { return buffer.empty(); }
+    bool reserve(unsigned int size)
+    {
+        buffer.reserve(size);
+        return true;
+    }
+    void clear() { buffer.clear(); }
+
+    bool concat(const String &text)
+    {
+        buffer += text.buffer;
+        return true;
+    }
+    bool concat(const char *text)
+    {
+        buffer += text;
+        return true;
+    }
+    bool concat(const char *text, unsigned int length)
+    {
+        buffer.append(text, length);
+        return true;
+    }
+    bool concat(char c)
+    {
+        buffer += c;
+        return true;
+    }
+
+    String &operator+=(const String &text) { return concat(text), *this; }
+    String &operator+=(const char *text) { return concat(text), *this; }
+    String &operator+=(char c) { return concat(c), *this; }
+    template <typename T>
+    String &operator+=(T value) { return concat(String(value)), *this; }
+
+    char operator[](unsigned int index) const { return index < buffer.length() ? buffer[index] : 0; }
+    char charAt(unsigned int index) const { return (*this)[index]; }
+
+    bool equals(const String &other) const { return buffer == other.buffer; }
+    bool operator==(const String &other) const { return buffer == other.buffer; }
+    bool operator==(const char *other) const { return buffer == (other ? other : ""); }
+    bool operator!=(const String &other) const { return buffer != other.buffer; }
+    bool operator!=(const char *other) const { return !(*this == other); }
+    bool operator<(const String &other) const { return buffer < other.buffer; }
+    bool startsWith(const String &prefix) const { return buffer.compare(0, prefix.buffer.length(), prefix.buffer) == 0; }
+    bool endsWith(const String &suffix) const
+    {
+        return buffer.length() >= suffix.buffer.length() &&
+               buffer.compare(buffer.length() - suffix.buffer.length(), suffix.buffer.length(), suffix.buffer) == 0;
+    }
+
+    int indexOf(char c, unsigned int from = 0) const
+    {
+        size_t index = buffer.find(c, from);
+        return index == std::string::npos ? -1 : (int)index;
+    }
+    int indexOf(const String &text, unsigned int from = 0) const
+    {
+        size_t index = buffer.find(text.buffer, from);
+        return index == std::string::npos ? -1 : (int)index;
+    }
+    int lastIndexOf(char c) const
+    {
+        size_t index = buffer.rfind(c);
+        return index == std::string::npos ? -1 : (int)index;
+    }
+
+    String substring(unsigned int from) const { return from < buffer.length() ? String(buffer.substr(from)) : String(); }
+    String substring(unsigned int from, unsigned int to) const
+    {
+        if (from > to)
+            std::swap(from, to);
+        return from < buffer.length() ? String(buffer.substr(from, to - from)) : String();
+    }
+
+    long toInt() const { return strtol(buffer.c_str(), NULL, 10); }
+    float toFloat() const { return strtof(buffer.c_str(), NULL); }
+
+    void trim()
+    {
+        size_t first = buffer.find_first_not_of(" \t\r\n");
+        size_t last = buffer.find_last_not_of(" \t\r\n");
+        buffer = first == std::string::npos ? "" : buffer.substr(first, last - first + 1);
+    }
+
+    friend String operator+(const String &a, const String &b) { return String(a.buffer + b.buffer); }
+    friend String operator+(const String &a, const char *b) { return String(a.buffer + b); }
+    friend String operator+(const char *a, const String &b) { return String(a + b.buffer); }
+};
+
+// Type of a String sum on the ESP32 core, libraries such as ArduinoJson refer to it
+class StringSumHelper : public String
+{
+public:
+    using String::String;
+};
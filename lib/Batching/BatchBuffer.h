@@ -0,0 +1,64 @@
+#pragma once
+
+#include <Arduino.h>
+
+/**--------------------------------------------------------------------------------------
+ * Batch Buffer Class
+ *
+ * Fixed capacity buffer that collects samples until either the batch size or the
+ * latency budget is reached. The owner polls ready() and drains the buffer in one go.
+ *-------------------------------------------------------------------------------------*/
+
+template <typename T, size_t Capacity>
+class BatchBuffer
+{
+protected:
+    T items[Capacity];
+    size_t count = 0;
+    size_t maxBatch = Capacity;
+    uint32_t maxLatency = 0;
+    uint32_t firstMillis = 0;
+
+public:
+    BatchBuffer() {}
+    BatchBuffer(size_t maxBatch, uint32_t maxLatency)
+    {
+        setMaxBatch(maxBatch);
+        setMaxLatency(maxLatency);
+    }
+
+    // Maximum samples per flush, clamped to the buffer capacity
+    void setMaxBatch(size_t maxBatch) { this->maxBatch = (maxBatch == 0 || maxBatch > Capacity) ? Capacity : maxBatch; }
+    // Maximum milliseconds the oldest sample may wait before a flush, 0 waits for a full batch
+    void setMaxLatency(uint32_t maxLatency) { this->maxLatency = maxLatency; }
+
+    size_t getMaxBatch() { return maxBatch; }
+    uint32_t getMaxLatency() { return maxLatency; }
+    size_t size() { return count; }
+    size_t capacity() { return Capacity; }
+    bool isEmpty() { return count == 0; }
+    bool isFull() { return count >= maxBatch; }
+    uint32_t getAge() { return count ? millis() - firstMillis : 0; }
+
+    // Returns false if the buffer is full, flush before adding more
+    bool add(const T &item)
+    {
+        if (count >= maxBatch)
+            return false;
+        if (count == 0)
+            firstMillis = millis();
+        items[count++] = item;
+        return true;
+    }
+
+    // True when the batch is full or the oldest sample exceeded the latency budget
+    bool ready()
+    {
+        if (count == 0)
+            return false;
+        return isFull() || (maxLatency && getAge() >= maxLatency);
+    }
+
+    T &operator[](size_t index) { return items[index]; }
+    void clear() { count = 0; }
+};
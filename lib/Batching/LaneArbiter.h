@@ -0,0 +1,152 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <BenchmarkStats.h>
+
+enum LaneMode : uint8_t
+{
+    LANE_STRICT,  // the lowest lane with work always goes first
+    LANE_WEIGHTED // send slots are shared by weight between lanes with work
+};
+
+/**--------------------------------------------------------------------------------------
+ * Lane Arbiter Class
+ *
+ * Picks which lane gets the next send slot on a shared client, lane 0 being the most
+ * urgent. Each loop the caller offers the lanes that have work with the age of their
+ * oldest item, next() returns the winner. A lane waiting longer than its max wait wins
+ * regardless of mode, which bounds critical latency and keeps bulk lanes from starving
+ * under a steady critical load. Queue wait per lane is kept as a latency histogram.
+ *-------------------------------------------------------------------------------------*/
+
+template <uint8_t Lanes>
+class LaneArbiter
+{
+private:
+    struct Lane
+    {
+        uint8_t weight = 1;
+        int32_t credit = 0;    // smooth weighted round robin
+        uint32_t maxWait = 0;  // 0 for no bound
+        uint32_t offered = 0;  // age of the oldest item, valid when pending
+        bool pending = false;
+        uint32_t served = 0;
+        uint32_t overdue = 0;  // served after maxWait
+        BenchmarkStats wait;
+    };
+
+    Lane lanes[Lanes];
+    LaneMode mode = LANE_STRICT;
+    uint8_t lastOverdue = Lanes - 1;
+
+    // Overdue lanes take turns, so an overdue bulk lane can't lock out an overdue critical one
+    int8_t pickOverdue()
+    {
+        for (uint8_t n = 1; n <= Lanes; n++)
+        {
+            uint8_t i = (lastOverdue + n) % Lanes;
+            Lane &lane = lanes[i];
+            if (lane.pending && lane.maxWait && lane.offered >= lane.maxWait)
+            {
+                lastOverdue = i;
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    int8_t pickWeighted()
+    {
+        int8_t pick = -1;
+        int32_t total = 0;
+        for (uint8_t i = 0; i < Lanes; i++)
+        {
+            Lane &lane = lanes[i];
+            if (!lane.pending)
+                continue;
+            lane.credit += lane.weight;
+            total += lane.weight;
+            if (pick < 0 || lane.credit > lanes[pick].credit)
+                pick = i;
+        }
+        if (pick >= 0)
+            lanes[pick].credit -= total;
+        return pick;
+    }
+
+public:
+    LaneArbiter &setMode(LaneMode mode)
+    {
+        this->mode = mode;
+        return *this;
+    }
+
+    // Share of send slots in weighted mode
+    LaneArbiter &setWeight(uint8_t lane, uint8_t weight)
+    {
+        if (lane < Lanes)
+            lanes[lane].weight = weight ? weight : 1;
+        return *this;
+    }
+
+    // Milliseconds after which a waiting lane is served first, 0 for no bound
+    LaneArbiter &setMaxWait(uint8_t lane, uint32_t maxWait)
+    {
+        if (lane < Lanes)
+            lanes[lane].maxWait = maxWait;
+        return *this;
+    }
+
+    // The lane has work, its oldest item has waited age milliseconds
+    void offer(uint8_t lane, uint32_t age)
+    {
+        if (lane >= Lanes)
+            return;
+        lanes[lane].pending = true;
+        lanes[lane].offered = age;
+    }
+
+    // Lane for the free send slot, -1 if nothing was offered. Clears the offers.
+    int8_t next()
+    {
+        int8_t pick = pickOverdue();
+        if (pick < 0 && mode == LANE_WEIGHTED)
+            pick = pickWeighted();
+        for (uint8_t i = 0; pick < 0 && i < Lanes; i++)
+        {
+            if (lanes[i].pending)
+                pick = i;
+        }
+
+        if (pick >= 0)
+        {
+            Lane &lane = lanes[pick];
+            lane.served++;
+            lane.wait.add(lane.offered);
+            if (lane.maxWait && lane.offered > lane.maxWait)
+                lane.overdue++;
+        }
+        for (uint8_t i = 0; i < Lanes; i++)
+            lanes[i].pending = false;
+        return pick;
+    }
+
+    uint32_t getServed(uint8_t lane) { return lane < Lanes ? lanes[lane].served : 0; }
+    uint32_t getOverdue(uint8_t lane) { return lane < Lanes ? lanes[lane].overdue : 0; }
+    uint32_t getWaitPercentile(uint8_t lane, uint8_t percent) { return lane < Lanes ? lanes[lane].wait.percentile(percent) : 0; }
+
+    // names holds one name per lane
+    template <typename Print>
+    void print(Print &out, const char *const *names)
+    {
+        for (uint8_t i = 0; i < Lanes; i++)
+        {
+            Lane &lane = lanes[i];
+            out.printf("lane %s: served=%lu overdue=%lu wait mean=%lu p50=%lu p95=%lu p99=%lu max=%lu ms\n", names[i],
+                       (unsigned long)lane.served, (unsigned long)lane.overdue, (unsigned long)lane.wait.mean(),
+                       (unsigned long)lane.wait.percentile(50), (unsigned long)lane.wait.percentile(95),
+                       (unsigned long)lane.wait.percentile(99), (unsigned long)(lane.wait.count ? lane.wait.max : 0));
+        }
+    }
+};
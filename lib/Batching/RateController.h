@@ -0,0 +1,195 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Requests tracked at once, setMaxInFlight() is limited to it
+#ifndef RATE_CONTROLLER_MAX_IN_FLIGHT
+#define RATE_CONTROLLER_MAX_IN_FLIGHT 4
+#endif
+
+/**--------------------------------------------------------------------------------------
+ * Rate Controller Class
+ *
+ * Adapts how often uploads are sent to the observed round-trip time, AIMD style like
+ * TCP congestion control. Each fast completion shortens the send interval by a fixed
+ * step, an error, a timeout or a completion slower than the target doubles it. The
+ * batch size follows the interval so a batch holds about one interval of samples.
+ * canSend() applies backpressure while the maximum requests are in flight. Requests
+ * are tracked by id, e.g. the TaskTracer sequence of their uid, and time out one by
+ * one. A result for a request that already timed out is counted as late and ignored,
+ * it neither frees the slot of a newer request nor feeds its round-trip time.
+ *-------------------------------------------------------------------------------------*/
+
+class RateController
+{
+private:
+    struct Request
+    {
+        uint32_t submitMillis;
+        uint16_t id;
+        bool used;
+    };
+
+    uint32_t minInterval = 1000;
+    uint32_t maxInterval = 60000;
+    uint32_t intervalStep = 1000;
+    uint32_t targetLatency = 2000;
+    uint32_t requestTimeout = 30000;
+    uint32_t samplePeriod = 1000;
+    size_t minBatch = 1;
+    size_t maxBatch = 20;
+    uint8_t maxInFlight = 1;
+
+    uint32_t interval = 10000;
+    Request requests[RATE_CONTROLLER_MAX_IN_FLIGHT] = {};
+    uint8_t inFlight = 0;
+    uint32_t increases = 0;
+    uint32_t decreases = 0;
+    uint32_t timeouts = 0;
+    uint32_t late = 0;
+
+    void backOff()
+    {
+        interval = interval > maxInterval / 2 ? maxInterval : interval * 2;
+        decreases++;
+    }
+
+    void release(Request &request)
+    {
+        request.used = false;
+        inFlight--;
+    }
+
+    // A request without a result within the timeout is not coming back, backs off once
+    // however many expired together
+    void expire()
+    {
+        bool expired = false;
+        for (uint8_t i = 0; i < RATE_CONTROLLER_MAX_IN_FLIGHT; i++)
+        {
+            if (requests[i].used && millis() - requests[i].submitMillis >= requestTimeout)
+            {
+                release(requests[i]);
+                timeouts++;
+                expired = true;
+            }
+        }
+        if (expired)
+            backOff();
+    }
+
+public:
+    // Range of the send interval in milliseconds and the step it shrinks by on success
+    RateController &setInterval(uint32_t minInterval, uint32_t maxInterval, uint32_t step)
+    {
+        this->minInterval = minInterval;
+        this->maxInterval = maxInterval < minInterval ? minInterval : maxInterval;
+        intervalStep = step;
+        interval = constrain(interval, this->minInterval, this->maxInterval);
+        return *this;
+    }
+
+    // Completions slower than target milliseconds count as congestion
+    RateController &setTargetLatency(uint32_t target)
+    {
+        targetLatency = target;
+        return *this;
+    }
+
+    RateController &setRequestTimeout(uint32_t timeout)
+    {
+        requestTimeout = timeout;
+        return *this;
+    }
+
+    // Range of the batch size and the sampling period used to derive it from the interval
+    RateController &setBatch(size_t minBatch, size_t maxBatch, uint32_t samplePeriod)
+    {
+        this->minBatch = minBatch ? minBatch : 1;
+        this->maxBatch = maxBatch < this->minBatch ? this->minBatch : maxBatch;
+        this->samplePeriod = samplePeriod ? samplePeriod : 1;
+        return *this;
+    }
+
+    RateController &setMaxInFlight(uint8_t maxInFlight)
+    {
+        this->maxInFlight = constrain(maxInFlight, 1, RATE_CONTROLLER_MAX_IN_FLIGHT);
+        return *this;
+    }
+
+    // Milliseconds the oldest sample may wait before the batch is sent
+    uint32_t getInterval() { return interval; }
+
+    size_t getBatchSize()
+    {
+        size_t batch = (interval + samplePeriod - 1) / samplePeriod;
+        return constrain(batch, minBatch, maxBatch);
+    }
+
+    // False while the maximum requests are in flight, keep batching until one completes
+    bool canSend()
+    {
+        expire();
+        return inFlight < maxInFlight;
+    }
+
+    uint8_t getInFlight() { return inFlight; }
+    uint32_t getIncreases() { return increases; }
+    uint32_t getDecreases() { return decreases; }
+    uint32_t getTimeouts() { return timeouts; }
+    // Results that arrived after their request timed out
+    uint32_t getLate() { return late; }
+
+    // Call after a request is sent, with an id its result can be matched by
+    void onSubmit(uint16_t request)
+    {
+        // Without a free slot canSend() was skipped, the oldest request gives way
+        Request *slot = &requests[0];
+        for (uint8_t i = 0; i < RATE_CONTROLLER_MAX_IN_FLIGHT; i++)
+        {
+            if (!requests[i].used)
+            {
+                slot = &requests[i];
+                break;
+            }
+            if ((int32_t)(requests[i].submitMillis - slot->submitMillis) < 0)
+                slot = &requests[i];
+        }
+        if (slot->used)
+        {
+            release(*slot);
+            timeouts++;
+        }
+
+        slot->used = true;
+        slot->id = request;
+        slot->submitMillis = millis();
+        inFlight++;
+    }
+
+    // Call with the result of each request, the round-trip time is measured from onSubmit()
+    void onComplete(uint16_t request, bool error)
+    {
+        Request *slot = nullptr;
+        for (uint8_t i = 0; i < RATE_CONTROLLER_MAX_IN_FLIGHT && !slot; i++)
+        {
+            if (requests[i].used && requests[i].id == request)
+                slot = &requests[i];
+        }
+        if (!slot)
+        {
+            late++; // timed out already, its slot and interval were dealt with then
+            return;
+        }
+        uint32_t latency = millis() - slot->submitMillis;
+        release(*slot);
+
+        if (error || latency > targetLatency)
+        {
+            backOff();
+            return;
+        }
+        interval = interval > minInterval + intervalStep ? interval - intervalStep : minInterval;
+        increases++;
+    }
+};
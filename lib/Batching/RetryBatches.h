@@ -0,0 +1,190 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Attempts per batch before its items are dropped and counted as failed
+#ifndef RETRY_BATCHES_MAX_ATTEMPTS
+#define RETRY_BATCHES_MAX_ATTEMPTS 5
+#endif
+
+/**--------------------------------------------------------------------------------------
+ * Retry Batches Class
+ *
+ * Keeps the batches a writer sent until their result arrives. A batch that failed, or
+ * got no result within the request timeout, is handed out again ahead of new items
+ * until it runs out of attempts. Each batch gets a range of ids when it is taken from
+ * the buffer, so a retry can rebuild the same keys or document names. Without a free
+ * slot the oldest batch still waiting gives way and its items count as failed. Results
+ * are matched by request id, e.g. the TaskTracer sequence of the uid, oldest first.
+ *-------------------------------------------------------------------------------------*/
+
+template <typename T, size_t Capacity, size_t Slots>
+class RetryBatches
+{
+public:
+    struct Batch
+    {
+        T items[Capacity];
+        size_t count = 0;     // 0 when the slot is free
+        uint32_t firstId = 0; // id of the first item, ids run on in item order
+        uint16_t request = 0;
+        uint32_t sentMillis = 0;
+        uint32_t failedMillis = 0;
+        uint8_t attempts = 0;
+        bool failed = false; // waiting to be sent again
+    };
+
+private:
+    Batch batches[Slots];
+    uint8_t maxAttempts = RETRY_BATCHES_MAX_ATTEMPTS;
+    uint32_t requestTimeout = 30000;
+    uint32_t nextId = 0;
+    uint32_t retries = 0;
+    uint32_t taken = 0;
+    uint32_t delivered = 0;
+    uint32_t failed = 0;
+
+    // Sent again unless the batch ran out of attempts
+    void fail(Batch &batch)
+    {
+        if (batch.attempts < maxAttempts)
+        {
+            batch.failed = true;
+            batch.failedMillis = millis();
+            return;
+        }
+        failed += batch.count;
+        batch.count = 0;
+    }
+
+    // A batch without a result within the request timeout has failed
+    void expire()
+    {
+        for (Batch &batch : batches)
+        {
+            if (batch.count && !batch.failed && millis() - batch.sentMillis >= requestTimeout)
+                fail(batch);
+        }
+    }
+
+    Batch *oldest(bool failedOnly)
+    {
+        Batch *oldest = nullptr;
+        for (Batch &batch : batches)
+        {
+            if (batch.count && (batch.failed || !failedOnly) && (!oldest || batch.firstId < oldest->firstId))
+                oldest = &batch;
+        }
+        return oldest;
+    }
+
+public:
+    // Attempts before a batch is given up, at least 1
+    void setMaxAttempts(uint8_t maxAttempts) { this->maxAttempts = maxAttempts ? maxAttempts : 1; }
+    // Milliseconds after which a batch without a result counts as failed
+    void setRequestTimeout(uint32_t timeout) { requestTimeout = timeout; }
+
+    // Items of failed batches waiting to be sent again
+    size_t pending()
+    {
+        size_t count = 0;
+        for (Batch &batch : batches)
+            count += batch.failed ? batch.count : 0;
+        return count;
+    }
+
+    // Items of batches waiting for their result
+    size_t inFlight()
+    {
+        size_t count = 0;
+        for (Batch &batch : batches)
+            count += batch.failed ? 0 : batch.count;
+        return count;
+    }
+
+    // True once a failed batch waited backoff milliseconds since it failed
+    bool due(uint32_t backoff)
+    {
+        expire();
+        Batch *batch = oldest(true);
+        return batch && millis() - batch->failedMillis >= backoff;
+    }
+
+    // The batch to send next: a failed one, else the buffer's items moved into a slot and
+    // given `ids` consecutive ids. nullptr when there is nothing to send.
+    template <typename Buffer>
+    Batch *next(Buffer &buffer, uint32_t ids)
+    {
+        expire();
+        Batch *batch = oldest(true);
+        if (batch || buffer.isEmpty())
+            return batch;
+        for (Batch &slot : batches)
+        {
+            if (!slot.count)
+                batch = &slot;
+        }
+        if (!batch)
+        {
+            batch = oldest(false);
+            failed += batch->count;
+        }
+        batch->count = buffer.size();
+        for (size_t i = 0; i < batch->count; i++)
+            batch->items[i] = buffer[i];
+        batch->firstId = nextId;
+        batch->attempts = 0;
+        batch->failed = false;
+        nextId += ids;
+        taken += batch->count;
+        buffer.clear();
+        return batch;
+    }
+
+    // Call once the batch from next() is submitted
+    void onSubmit(Batch &batch, uint16_t request)
+    {
+        if (batch.attempts)
+            retries++;
+        batch.request = request;
+        batch.sentMillis = millis();
+        batch.attempts++;
+        batch.failed = false;
+    }
+
+    // Gives up a batch that can't be sent, its items count as failed
+    void discard(Batch &batch)
+    {
+        failed += batch.count;
+        batch.count = 0;
+    }
+
+    // Call with the result of each request, a result for a batch that timed out is ignored
+    void onResult(uint16_t request, bool error)
+    {
+        Batch *match = nullptr;
+        for (Batch &batch : batches)
+        {
+            if (batch.count && !batch.failed && batch.request == request && (!match || batch.firstId < match->firstId))
+                match = &batch;
+        }
+        if (!match)
+            return; // timed out before, the next attempt decides
+        if (error)
+        {
+            fail(*match);
+            return;
+        }
+        delivered += match->count;
+        match->count = 0;
+    }
+
+    // Batches sent again after an error or a request timeout
+    uint32_t getRetries() { return retries; }
+    // Items taken from the buffer so far
+    uint32_t getTaken() { return taken; }
+    // Items of batches that succeeded
+    uint32_t getDelivered() { return delivered; }
+    // Items of batches that ran out of attempts, or gave way to a newer one
+    uint32_t getFailed() { return failed; }
+};
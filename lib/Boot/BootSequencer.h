@@ -0,0 +1,218 @@
+#pragma once
+
+#include <Arduino.h>
+
+enum BootStatus
+{
+    BOOT_PENDING,
+    BOOT_DONE,
+    BOOT_FAILED
+};
+
+enum BootPhaseState : uint8_t
+{
+    BOOT_PHASE_WAITING,
+    BOOT_PHASE_RUNNING,
+    BOOT_PHASE_DONE,
+    BOOT_PHASE_FAILED,
+    BOOT_PHASE_SKIPPED
+};
+
+// start() kicks off a phase, poll() is called until it stops returning BOOT_PENDING
+typedef BootStatus (*BootStep)();
+
+// Dependency mask for a phase id returned by BootSequencer::add()
+#define BOOT_AFTER(id) (1UL << (id))
+
+/**--------------------------------------------------------------------------------------
+ * Boot Sequencer Class
+ *
+ * Runs startup phases as a dependency graph. A phase starts as soon as all the phases
+ * it depends on are done, so independent phases overlap (e.g. NTP sync and Firebase
+ * auth). A failed or timed out phase skips everything that depends on it. Start and
+ * end times of every phase are kept for the startup timeline.
+ *-------------------------------------------------------------------------------------*/
+
+template <uint8_t Capacity>
+class BootSequencer
+{
+private:
+    struct Phase
+    {
+        const char *name;
+        BootStep start;
+        BootStep poll;
+        uint32_t dependsOn;
+        uint32_t timeout;
+        uint32_t startMillis;
+        uint32_t endMillis;
+        BootPhaseState state;
+    };
+
+    Phase phases[Capacity];
+    uint8_t count = 0;
+    uint32_t beginMillis = 0;
+    bool started = false;
+
+    void finish(Phase &phase, BootStatus status)
+    {
+        phase.endMillis = millis();
+        phase.state = status == BOOT_DONE ? BOOT_PHASE_DONE : BOOT_PHASE_FAILED;
+    }
+
+public:
+    // Returns the phase id, use BOOT_AFTER(id) to depend on it. timeout 0 waits forever.
+    uint8_t add(const char *name, BootStep start, BootStep poll = nullptr, uint32_t dependsOn = 0, uint32_t timeout = 0)
+    {
+        if (count >= Capacity || count >= 32)
+            return 0xFF;
+        phases[count] = {name, start, poll, dependsOn, timeout, 0, 0, BOOT_PHASE_WAITING};
+        return count++;
+    }
+
+    // Starts ready phases and polls running ones once, returns true when every phase finished
+    bool loop()
+    {
+        if (!started)
+        {
+            started = true;
+            beginMillis = millis();
+        }
+
+        bool finished = true;
+        for (uint8_t i = 0; i < count; i++)
+        {
+            Phase &phase = phases[i];
+            if (phase.state == BOOT_PHASE_WAITING)
+            {
+                bool ready = true;
+                for (uint8_t d = 0; d < count; d++)
+                {
+                    if (!(phase.dependsOn & BOOT_AFTER(d)))
+                        continue;
+                    if (phases[d].state == BOOT_PHASE_FAILED || phases[d].state == BOOT_PHASE_SKIPPED)
+                    {
+                        phase.state = BOOT_PHASE_SKIPPED;
+                        ready = false;
+                        break;
+                    }
+                    if (phases[d].state != BOOT_PHASE_DONE)
+                        ready = false;
+                }
+                if (phase.state == BOOT_PHASE_SKIPPED)
+                    continue;
+                if (!ready)
+                {
+                    finished = false;
+                    continue;
+                }
+
+                phase.state = BOOT_PHASE_RUNNING;
+                phase.startMillis = millis();
+                BootStatus status = phase.start ? phase.start() : BOOT_PENDING;
+                if (status != BOOT_PENDING || !phase.poll)
+                {
+                    finish(phase, status == BOOT_PENDING ? BOOT_DONE : status);
+                    // Dependents may be able to start in this same pass
+                    i = (uint8_t)-1;
+                    finished = true;
+                    continue;
+                }
+            }
+
+            if (phase.state == BOOT_PHASE_RUNNING)
+            {
+                BootStatus status = phase.poll();
+                if (status == BOOT_PENDING && phase.timeout && millis() - phase.startMillis >= phase.timeout)
+                    status = BOOT_FAILED;
+                if (status == BOOT_PENDING)
+                    finished = false;
+                else
+                    finish(phase, status);
+            }
+        }
+        return finished;
+    }
+
+    // Runs until every phase finished or timeout expired, returns true if all succeeded
+    bool run(uint32_t timeout = 0)
+    {
+        uint32_t startMillis = millis();
+        while (!loop())
+        {
+            if (timeout && millis() - startMillis >= timeout)
+                return false;
+            delay(1);
+        }
+        return succeeded();
+    }
+
+    // Puts a failed phase and the phases skipped because of it back to waiting, so the next
+    // loop() starts them again. Returns false if the phase has not failed.
+    bool retry(uint8_t id)
+    {
+        if (id >= count || phases[id].state != BOOT_PHASE_FAILED)
+            return false;
+        phases[id].state = BOOT_PHASE_WAITING;
+        uint32_t reset = BOOT_AFTER(id);
+        for (bool changed = true; changed;)
+        {
+            changed = false;
+            for (uint8_t i = 0; i < count; i++)
+            {
+                if (phases[i].state == BOOT_PHASE_SKIPPED && (phases[i].dependsOn & reset))
+                {
+                    phases[i].state = BOOT_PHASE_WAITING;
+                    reset |= BOOT_AFTER(i);
+                    changed = true;
+                }
+            }
+        }
+        return true;
+    }
+
+    bool succeeded()
+    {
+        for (uint8_t i = 0; i < count; i++)
+        {
+            if (phases[i].state != BOOT_PHASE_DONE)
+                return false;
+        }
+        return true;
+    }
+
+    BootPhaseState getState(uint8_t id) { return id < count ? phases[id].state : BOOT_PHASE_SKIPPED; }
+    uint32_t getDuration(uint8_t id) { return id < count ? phases[id].endMillis - phases[id].startMillis : 0; }
+
+    // Milliseconds from the first loop() to the last finished phase
+    uint32_t getTotal()
+    {
+        uint32_t end = beginMillis;
+        for (uint8_t i = 0; i < count; i++)
+        {
+            if (phases[i].state == BOOT_PHASE_DONE || phases[i].state == BOOT_PHASE_FAILED)
+                end = (int32_t)(phases[i].endMillis - end) > 0 ? phases[i].endMillis : end;
+        }
+        return end - beginMillis;
+    }
+
+    template <typename Print>
+    void printTimeline(Print &out)
+    {
+        static const char *states[] = {"waiting", "running", "done", "failed", "skipped"};
+        out.printf("Boot timeline (%lu ms):\n", (unsigned long)getTotal());
+        for (uint8_t i = 0; i < count; i++)
+        {
+            Phase &phase = phases[i];
+            if (phase.state == BOOT_PHASE_WAITING || phase.state == BOOT_PHASE_SKIPPED)
+            {
+                out.printf("  %-12s %s\n", phase.name, states[phase.state]);
+                continue;
+            }
+            uint32_t end = phase.state == BOOT_PHASE_RUNNING ? millis() : phase.endMillis;
+            out.printf("  %-12s %6lu -> %6lu ms (%lu ms) %s\n", phase.name,
+                       (unsigned long)(phase.startMillis - beginMillis), (unsigned long)(end - beginMillis),
+                       (unsigned long)(end - phase.startMillis), states[phase.state]);
+        }
+    }
+};
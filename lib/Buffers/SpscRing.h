@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+/**--------------------------------------------------------------------------------------
+ * SPSC Ring Class
+ *
+ * Lock-free ring buffer for exactly one producer and one consumer, e.g. a sampling task
+ * on one core and the upload loop on the other. The producer only writes head and the
+ * consumer only writes tail, acquire/release ordering publishes the items between them.
+ * A full ring drops the new item and counts it instead of blocking the producer.
+ *-------------------------------------------------------------------------------------*/
+
+template <typename T, size_t Capacity>
+class SpscRing
+{
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+private:
+    T items[Capacity];
+    std::atomic<uint32_t> head{0}; // next slot to write, owned by the producer
+    std::atomic<uint32_t> tail{0}; // next slot to read, owned by the consumer
+    std::atomic<uint32_t> pushed{0};
+    std::atomic<uint32_t> dropped{0};
+
+public:
+    // Producer side, returns false and counts a drop when the ring is full
+    bool push(const T &item)
+    {
+        uint32_t currentHead = head.load(std::memory_order_relaxed);
+        if (currentHead - tail.load(std::memory_order_acquire) >= Capacity)
+        {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        items[currentHead & (Capacity - 1)] = item;
+        head.store(currentHead + 1, std::memory_order_release);
+        pushed.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Consumer side, returns false when the ring is empty
+    bool pop(T &item)
+    {
+        uint32_t currentTail = tail.load(std::memory_order_relaxed);
+        if (currentTail == head.load(std::memory_order_acquire))
+            return false;
+        item = items[currentTail & (Capacity - 1)];
+        tail.store(currentTail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side, passes up to maxItems to handler(const T &) and releases them in one store
+    template <typename Handler>
+    size_t drain(Handler handler, size_t maxItems = Capacity)
+    {
+        uint32_t currentTail = tail.load(std::memory_order_relaxed);
+        uint32_t available = head.load(std::memory_order_acquire) - currentTail;
+        size_t count = available < maxItems ? available : maxItems;
+        for (size_t i = 0; i < count; i++)
+            handler(items[(currentTail + i) & (Capacity - 1)]);
+        tail.store(currentTail + count, std::memory_order_release);
+        return count;
+    }
+
+    size_t size() { return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire); }
+    size_t capacity() { return Capacity; }
+    bool isEmpty() { return size() == 0; }
+    uint32_t getPushed() { return pushed.load(std::memory_order_relaxed); }
+    uint32_t getDropped() { return dropped.load(std::memory_order_relaxed); }
+};
@@ -0,0 +1,99 @@
+#include "HeapTracker.h"
+
+#if DEBUG_HEAP
+#include <new>
+#include <stdlib.h>
+
+#if DEBUG_HEAP_WRAP_MALLOC
+// The linker sends every statically linked malloc call here
+extern "C"
+{
+    void *__real_malloc(size_t size);
+    void *__real_calloc(size_t count, size_t size);
+    void *__real_realloc(void *ptr, size_t size);
+    void __real_free(void *ptr);
+
+    void *__wrap_malloc(size_t size)
+    {
+        void *ptr = __real_malloc(size);
+        HeapTracker::instance().allocated(ptr, size);
+        return ptr;
+    }
+
+    void *__wrap_calloc(size_t count, size_t size)
+    {
+        void *ptr = __real_calloc(count, size);
+        HeapTracker::instance().allocated(ptr, count * size);
+        return ptr;
+    }
+
+    void *__wrap_realloc(void *ptr, size_t size)
+    {
+        size_t previous = ptr ? HeapTracker::usableSize(ptr) : 0;
+        void *resized = __real_realloc(ptr, size);
+        if (resized || size == 0)
+        {
+            if (ptr)
+                HeapTracker::instance().freed(previous);
+            if (resized)
+                HeapTracker::instance().allocated(resized, size);
+        }
+        return resized;
+    }
+
+    void __wrap_free(void *ptr)
+    {
+        if (ptr)
+            HeapTracker::instance().freed(HeapTracker::usableSize(ptr));
+        __real_free(ptr);
+    }
+}
+
+// new/delete call the wrapped malloc/free from here, the C++ runtime may be a shared
+// library whose calls the linker can't wrap
+static void *trackedNew(size_t size) { return malloc(size ? size : 1); }
+
+static void trackedDelete(void *ptr) { free(ptr); }
+
+#else
+static void *trackedNew(size_t size)
+{
+    void *ptr = malloc(size ? size : 1);
+    HeapTracker::instance().allocated(ptr, size);
+    return ptr;
+}
+
+static void trackedDelete(void *ptr)
+{
+    if (ptr)
+        HeapTracker::instance().freed(HeapTracker::usableSize(ptr));
+    free(ptr);
+}
+#endif
+
+static void *checkedNew(size_t size)
+{
+    void *ptr = trackedNew(size);
+    if (!ptr)
+    {
+#if __cpp_exceptions
+        throw std::bad_alloc();
+#else
+        abort();
+#endif
+    }
+    return ptr;
+}
+
+void *operator new(size_t size) { return checkedNew(size); }
+void *operator new[](size_t size) { return checkedNew(size); }
+void *operator new(size_t size, const std::nothrow_t &) noexcept { return trackedNew(size); }
+void *operator new[](size_t size, const std::nothrow_t &) noexcept { return trackedNew(size); }
+void operator delete(void *ptr) noexcept { trackedDelete(ptr); }
+void operator delete[](void *ptr) noexcept { trackedDelete(ptr); }
+void operator delete(void *ptr, size_t) noexcept { trackedDelete(ptr); }
+void operator delete[](void *ptr, size_t) noexcept { trackedDelete(ptr); }
+void operator delete(void *ptr, const std::nothrow_t &) noexcept { trackedDelete(ptr); }
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept { trackedDelete(ptr); }
+
+#endif
@@ -0,0 +1,265 @@
+#pragma once
+
+// Toggle allocation accounting. Set it in build_flags (-D DEBUG_HEAP=1) so HeapTracker.cpp
+// sees it too, when 0 nothing is hooked and the macros below are empty.
+#ifndef DEBUG_HEAP
+#define DEBUG_HEAP 0
+#endif
+
+// Count malloc/calloc/realloc/free, which covers String, C libraries and new/delete. Needs
+// -Wl,--wrap=malloc -Wl,--wrap=calloc -Wl,--wrap=realloc -Wl,--wrap=free (GNU ld) and
+// -fno-builtin-malloc and friends, the [heap_debug] flags in platformio.ini. As builtins
+// GCC assumes they touch no program state and moves or drops them across a scope tag
+// from -O1 on. Only calls linked statically are wrapped. Set it to 0 where the linker
+// can't wrap: then only new/delete are hooked and the String and malloc allocations of
+// tagged scopes are not counted.
+#ifndef DEBUG_HEAP_WRAP_MALLOC
+#define DEBUG_HEAP_WRAP_MALLOC 1
+#endif
+
+// Heap report serial port
+#ifndef DEBUG_HEAP_SERIAL
+#define DEBUG_HEAP_SERIAL Serial
+#endif
+
+// Maximum number of scope tags
+#ifndef DEBUG_HEAP_MAX_TAGS
+#define DEBUG_HEAP_MAX_TAGS 16
+#endif
+
+#if DEBUG_HEAP
+#include <Arduino.h>
+#include <atomic>
+
+#if defined(ESP32)
+#include <esp_heap_caps.h>
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#else
+#include <malloc.h>
+#endif
+
+struct HeapTagStats
+{
+    const char *label = nullptr;
+    std::atomic<uint32_t> allocations{0};
+    std::atomic<uint32_t> bytes{0};
+    std::atomic<uint32_t> largest{0};
+};
+
+/**--------------------------------------------------------------------------------------
+ * Heap Tracker Class
+ *
+ * Counts allocations and frees from the hooks in HeapTracker.cpp. Live and peak bytes
+ * are kept for the whole heap, allocation counts and bytes per scope tag so churn can
+ * be traced to the subsystem causing it. Frees can't be attributed, a block may be
+ * released outside the scope that allocated it. Never allocates itself.
+ *-------------------------------------------------------------------------------------*/
+
+class HeapTracker
+{
+private:
+    HeapTagStats tags[DEBUG_HEAP_MAX_TAGS];
+    HeapTagStats untagged;
+    std::atomic<uint8_t> size{0};
+    std::atomic<uint32_t> allocations{0};
+    std::atomic<uint32_t> frees{0};
+    std::atomic<uint32_t> failures{0};
+    std::atomic<int32_t> live{0};
+    std::atomic<int32_t> peak{0};
+    uint32_t minLargestFree = UINT32_MAX;
+
+    static inline thread_local HeapTagStats *current = nullptr;
+
+    static void raise(std::atomic<uint32_t> &value, uint32_t candidate)
+    {
+        uint32_t seen = value.load(std::memory_order_relaxed);
+        while (candidate > seen && !value.compare_exchange_weak(seen, candidate, std::memory_order_relaxed))
+            ;
+    }
+
+public:
+    static HeapTracker &instance()
+    {
+        static HeapTracker tracker;
+        return tracker;
+    }
+
+    // Size of the block behind ptr as the allocator sees it
+    static size_t usableSize(void *ptr)
+    {
+#if defined(ESP32)
+        return heap_caps_get_allocated_size(ptr);
+#elif defined(__APPLE__)
+        return malloc_size(ptr);
+#else
+        return malloc_usable_size(ptr);
+#endif
+    }
+
+    // Free heap and the largest block that can still be allocated, 0 where unknown
+    static uint32_t freeHeap()
+    {
+#if defined(ESP32)
+        return heap_caps_get_free_size(MALLOC_CAP_8BIT);
+#else
+        return 0;
+#endif
+    }
+
+    static uint32_t largestFreeBlock()
+    {
+#if defined(ESP32)
+        return heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+#else
+        return 0;
+#endif
+    }
+
+    void allocated(void *ptr, size_t requested)
+    {
+        if (!ptr)
+        {
+            failures.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        int32_t bytes = usableSize(ptr);
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        int32_t now = live.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        int32_t seen = peak.load(std::memory_order_relaxed);
+        while (now > seen && !peak.compare_exchange_weak(seen, now, std::memory_order_relaxed))
+            ;
+
+        HeapTagStats *tag = current ? current : &untagged;
+        tag->allocations.fetch_add(1, std::memory_order_relaxed);
+        tag->bytes.fetch_add(requested, std::memory_order_relaxed);
+        raise(tag->largest, requested);
+    }
+
+    // bytes is the usable size of the block, read before it is released
+    void freed(size_t bytes)
+    {
+        frees.fetch_add(1, std::memory_order_relaxed);
+        live.fetch_sub(bytes, std::memory_order_relaxed);
+    }
+
+    HeapTagStats *get(const char *label)
+    {
+        uint8_t count = size.load(std::memory_order_acquire);
+        for (uint8_t i = 0; i < count; i++)
+        {
+            if (tags[i].label == label || strcmp(tags[i].label, label) == 0)
+                return &tags[i];
+        }
+        if (count >= DEBUG_HEAP_MAX_TAGS)
+            return &untagged;
+        tags[count].label = label;
+        size.store(count + 1, std::memory_order_release);
+        return &tags[count];
+    }
+
+    // Attributes allocations of the calling task to tag, returns the tag to restore
+    HeapTagStats *enter(HeapTagStats *tag)
+    {
+        HeapTagStats *previous = current;
+        current = tag;
+        return previous;
+    }
+
+    void leave(HeapTagStats *previous) { current = previous; }
+
+    template <typename Print>
+    void print(Print &out)
+    {
+        uint32_t largest = largestFreeBlock();
+        if (largest && largest < minLargestFree)
+            minLargestFree = largest;
+        int32_t liveBytes = live.load(std::memory_order_relaxed);
+
+        out.printf("heap: live=%ld peak=%ld allocs=%lu frees=%lu failed=%lu free=%lu largest=%lu min-largest=%lu\n",
+                   (long)liveBytes, (long)peak.load(std::memory_order_relaxed), (unsigned long)allocations.load(std::memory_order_relaxed),
+                   (unsigned long)frees.load(std::memory_order_relaxed), (unsigned long)failures.load(std::memory_order_relaxed),
+                   (unsigned long)freeHeap(), (unsigned long)largest, (unsigned long)(largest ? minLargestFree : 0));
+
+        uint8_t count = size.load(std::memory_order_acquire);
+        for (uint8_t i = 0; i <= count; i++)
+        {
+            HeapTagStats &tag = i < count ? tags[i] : untagged;
+            uint32_t tagAllocations = tag.allocations.load(std::memory_order_relaxed);
+            if (tagAllocations == 0)
+                continue;
+            out.printf("heap %s: allocs=%lu bytes=%lu largest=%lu\n", i < count ? tag.label : "untagged",
+                       (unsigned long)tagAllocations, (unsigned long)tag.bytes.load(std::memory_order_relaxed),
+                       (unsigned long)tag.largest.load(std::memory_order_relaxed));
+        }
+    }
+
+    // Clears the per-tag counters, live and peak bytes keep running
+    void reset()
+    {
+        uint8_t count = size.load(std::memory_order_acquire);
+        for (uint8_t i = 0; i <= count; i++)
+        {
+            HeapTagStats &tag = i < count ? tags[i] : untagged;
+            tag.allocations.store(0, std::memory_order_relaxed);
+            tag.bytes.store(0, std::memory_order_relaxed);
+            tag.largest.store(0, std::memory_order_relaxed);
+        }
+    }
+};
+
+/**--------------------------------------------------------------------------------------
+ * Heap Scope Class
+ *
+ * Tags the allocations of the calling task until the end of the enclosing block.
+ *-------------------------------------------------------------------------------------*/
+
+class HeapScope
+{
+private:
+    HeapTagStats *previous;
+
+public:
+    HeapScope(HeapTagStats *tag) : previous(HeapTracker::instance().enter(tag)) {}
+    ~HeapScope() { HeapTracker::instance().leave(previous); }
+};
+
+// Attributes allocations until the end of the block to tag, scopes nest
+// tag must be a symbol
+#define HEAP_SCOPE(tag) I_HEAP_SCOPE(CONCAT(_heapTag_, tag), CONCAT(_heapScope_, tag), #tag)
+#define I_HEAP_SCOPE(tagStats, scope, label)                                  \
+    static HeapTagStats *tagStats = HeapTracker::instance().get(label); \
+    HeapScope scope(tagStats);
+
+// Prints the heap summary and every tag
+#define HEAP_PRINT() HeapTracker::instance().print(DEBUG_HEAP_SERIAL);
+
+// Clears the tag counters
+#define HEAP_RESET() HeapTracker::instance().reset();
+
+// Prints and clears the tag counters every n milliseconds, call from loop()
+#define HEAP_PRINT_EVERY(n) I_HEAP_PRINT_EVERY(CONCAT(_heapPrint_, __COUNTER__), n)
+#define I_HEAP_PRINT_EVERY(lastPrint, n)           \
+    {                                              \
+        static uint32_t lastPrint = millis();      \
+        if (millis() - lastPrint >= (uint32_t)(n)) \
+        {                                          \
+            lastPrint = millis();                  \
+            HEAP_PRINT()                           \
+            HEAP_RESET()                           \
+        }                                          \
+    }
+
+#ifndef CONCAT
+#define CONCAT(x, y) I_CONCAT(x, y)
+#define I_CONCAT(x, y) x##y
+#endif
+
+#else
+#define HEAP_SCOPE(tag)
+
+#define HEAP_PRINT()
+#define HEAP_RESET()
+#define HEAP_PRINT_EVERY(n)
+
+#endif
@@ -0,0 +1,239 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <BenchmarkStats.h>
+
+#ifndef TASK_TRACER_MAX_OPERATIONS
+#define TASK_TRACER_MAX_OPERATIONS 8
+#endif
+
+#ifndef TASK_TRACER_MAX_IN_FLIGHT
+#define TASK_TRACER_MAX_IN_FLIGHT 16
+#endif
+
+// Separates the operation name from the sequence number in a traced uid
+#define TASK_TRACER_SEPARATOR '#'
+
+struct TaskStatsSnapshot
+{
+    const char *operation;
+    uint32_t submitted;
+    uint32_t completed;
+    uint32_t errors;
+    uint32_t expired; // dropped without a result, see expire()
+    uint16_t inFlight;
+    uint32_t mean;    // completion latency in milliseconds
+    uint32_t p50;
+    uint32_t p95;
+    uint32_t p99;
+    uint32_t max;
+};
+
+/**--------------------------------------------------------------------------------------
+ * Task Tracer Class
+ *
+ * Measures end-to-end latency of async tasks. submit() stamps the task and returns a
+ * unique uid ("commitTask#12") to pass to the FirebaseClient call, complete() matches
+ * the uid from the AsyncResult callback. Keeps per-operation latency histograms,
+ * in-flight counts and error counts in fixed memory.
+ *-------------------------------------------------------------------------------------*/
+
+class TaskTracer
+{
+private:
+    struct Operation
+    {
+        const char *name;
+        uint32_t submitted;
+        uint32_t completed;
+        uint32_t errors;
+        uint32_t expired;
+        uint16_t inFlight;
+        BenchmarkStats latency;
+    };
+
+    struct Task
+    {
+        uint32_t submitMillis;
+        uint16_t sequence;
+        uint8_t operation;
+        bool used;
+    };
+
+    Operation operations[TASK_TRACER_MAX_OPERATIONS];
+    Task tasks[TASK_TRACER_MAX_IN_FLIGHT] = {};
+    uint8_t operationCount = 0;
+    uint16_t sequence = 0;
+
+    int findOperation(const char *name, size_t length)
+    {
+        for (uint8_t i = 0; i < operationCount; i++)
+        {
+            if (strncmp(operations[i].name, name, length) == 0 && operations[i].name[length] == '\0')
+                return i;
+        }
+        return -1;
+    }
+
+    int addOperation(const char *name)
+    {
+        int index = findOperation(name, strlen(name));
+        if (index >= 0 || operationCount >= TASK_TRACER_MAX_OPERATIONS)
+            return index;
+        Operation &operation = operations[operationCount];
+        operation.name = name;
+        operation.submitted = operation.completed = operation.errors = operation.expired = 0;
+        operation.inFlight = 0;
+        operation.latency.reset();
+        return operationCount++;
+    }
+
+    void drop(Task &task)
+    {
+        task.used = false;
+        operations[task.operation].inFlight--;
+    }
+
+public:
+    // Stamps a new task, returns the uid to submit it with.
+    // operation must outlive the tracer, a string literal is expected.
+    String submit(const char *operation)
+    {
+        int index = addOperation(operation);
+        if (index < 0)
+            return String(operation); // table full, untraced
+
+        // Reuse a free slot, or the oldest one if every slot is in flight
+        Task *slot = &tasks[0];
+        for (uint8_t i = 0; i < TASK_TRACER_MAX_IN_FLIGHT; i++)
+        {
+            if (!tasks[i].used)
+            {
+                slot = &tasks[i];
+                break;
+            }
+            if ((int32_t)(tasks[i].submitMillis - slot->submitMillis) < 0)
+                slot = &tasks[i];
+        }
+        if (slot->used)
+        {
+            operations[slot->operation].expired++;
+            drop(*slot);
+        }
+
+        slot->used = true;
+        slot->operation = index;
+        if (++sequence == 0)
+            sequence = 1; // 0 is left for untraced uids
+        slot->sequence = sequence;
+        slot->submitMillis = millis();
+        operations[index].submitted++;
+        operations[index].inFlight++;
+
+        char uid[48];
+        snprintf(uid, sizeof(uid), "%s%c%u", operation, TASK_TRACER_SEPARATOR, slot->sequence);
+        return String(uid);
+    }
+
+    // Matches a final result (payload or error) to its submitted task, returns false if untraced.
+    // The round-trip time in milliseconds is stored in latency when given.
+    bool complete(const char *uid, bool error, uint32_t *latency = nullptr)
+    {
+        const char *separator = strrchr(uid, TASK_TRACER_SEPARATOR);
+        if (!separator)
+            return false;
+        int index = findOperation(uid, separator - uid);
+        if (index < 0)
+            return false;
+        uint16_t taskSequence = strtoul(separator + 1, NULL, 10);
+
+        for (uint8_t i = 0; i < TASK_TRACER_MAX_IN_FLIGHT; i++)
+        {
+            Task &task = tasks[i];
+            if (!task.used || task.operation != index || task.sequence != taskSequence)
+                continue;
+
+            Operation &operation = operations[index];
+            operation.completed++;
+            if (error)
+                operation.errors++;
+            uint32_t elapsed = millis() - task.submitMillis;
+            operation.latency.add(elapsed);
+            if (latency)
+                *latency = elapsed;
+            drop(task);
+            return true;
+        }
+        return false;
+    }
+
+    // Sequence number of a traced uid, 0 for an untraced one. Unique among the tasks in
+    // flight, so it can identify the request elsewhere, e.g. in a RateController.
+    static uint16_t sequenceOf(const char *uid)
+    {
+        const char *separator = strrchr(uid, TASK_TRACER_SEPARATOR);
+        return separator ? strtoul(separator + 1, NULL, 10) : 0;
+    }
+
+    // Drops tasks that never got a result within timeout milliseconds
+    void expire(uint32_t timeout)
+    {
+        for (uint8_t i = 0; i < TASK_TRACER_MAX_IN_FLIGHT; i++)
+        {
+            if (tasks[i].used && millis() - tasks[i].submitMillis >= timeout)
+            {
+                operations[tasks[i].operation].expired++;
+                drop(tasks[i]);
+            }
+        }
+    }
+
+    uint16_t inFlight()
+    {
+        uint16_t count = 0;
+        for (uint8_t i = 0; i < operationCount; i++)
+            count += operations[i].inFlight;
+        return count;
+    }
+
+    uint8_t size() { return operationCount; }
+
+    bool snapshot(uint8_t index, TaskStatsSnapshot &snapshot)
+    {
+        if (index >= operationCount)
+            return false;
+        Operation &operation = operations[index];
+        snapshot.operation = operation.name;
+        snapshot.submitted = operation.submitted;
+        snapshot.completed = operation.completed;
+        snapshot.errors = operation.errors;
+        snapshot.expired = operation.expired;
+        snapshot.inFlight = operation.inFlight;
+        snapshot.mean = operation.latency.mean();
+        snapshot.p50 = operation.latency.percentile(50);
+        snapshot.p95 = operation.latency.percentile(95);
+        snapshot.p99 = operation.latency.percentile(99);
+        snapshot.max = operation.latency.max;
+        return true;
+    }
+
+    bool snapshot(const char *operation, TaskStatsSnapshot &snapshot)
+    {
+        int index = findOperation(operation, strlen(operation));
+        return index >= 0 && this->snapshot(index, snapshot);
+    }
+
+    template <typename Print>
+    void print(Print &out)
+    {
+        TaskStatsSnapshot s;
+        for (uint8_t i = 0; snapshot(i, s); i++)
+        {
+            out.printf("%s: sent=%lu done=%lu errors=%lu expired=%lu in-flight=%u mean=%lu p50=%lu p95=%lu p99=%lu max=%lu ms\n",
+                       s.operation, (unsigned long)s.submitted, (unsigned long)s.completed, (unsigned long)s.errors,
+                       (unsigned long)s.expired, s.inFlight, (unsigned long)s.mean, (unsigned long)s.p50,
+                       (unsigned long)s.p95, (unsigned long)s.p99, (unsigned long)(s.completed ? s.max : 0));
+        }
+    }
+};
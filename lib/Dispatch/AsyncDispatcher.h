@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdint.h>
+
+/**--------------------------------------------------------------------------------------
+ * Async Dispatcher Class
+ *
+ * Routes async results to per-operation handlers through a fixed table. Operations are
+ * compile-time ids, each gets its own callback<Id>() to pass with its requests, so the
+ * id is known from the function pointer without reading or comparing the uid. The
+ * dispatcher never touches the payload or message strings, handlers read only what
+ * they need. Result is the FirebaseClient AsyncResult, any type with isError() works.
+ *-------------------------------------------------------------------------------------*/
+
+template <typename Result, uint8_t Operations>
+class AsyncDispatcher
+{
+public:
+    typedef void (*Handler)(uint8_t operation, Result &result);
+
+private:
+    struct Route
+    {
+        Handler handler;
+        uint32_t results;
+        uint32_t errors;
+    };
+
+    Route routes[Operations] = {};
+    Handler fallback = nullptr;
+
+    AsyncDispatcher() {}
+
+public:
+    // One table per Result type and operation count
+    static AsyncDispatcher &instance()
+    {
+        static AsyncDispatcher dispatcher;
+        return dispatcher;
+    }
+
+    // Callback for the requests of one operation
+    template <uint8_t Operation>
+    static void callback(Result &result)
+    {
+        static_assert(Operation < Operations, "Operation id out of range");
+        instance().dispatch(Operation, result);
+    }
+
+    AsyncDispatcher &on(uint8_t operation, Handler handler)
+    {
+        if (operation < Operations)
+            routes[operation].handler = handler;
+        return *this;
+    }
+
+    // Handler for operations without their own
+    AsyncDispatcher &otherwise(Handler handler)
+    {
+        fallback = handler;
+        return *this;
+    }
+
+    void dispatch(uint8_t operation, Result &result)
+    {
+        if (operation >= Operations)
+            return;
+        Route &route = routes[operation];
+        route.results++;
+        if (result.isError())
+            route.errors++;
+
+        Handler handler = route.handler ? route.handler : fallback;
+        if (handler)
+            handler(operation, result);
+    }
+
+    uint32_t getResults(uint8_t operation) { return operation < Operations ? routes[operation].results : 0; }
+    uint32_t getErrors(uint8_t operation) { return operation < Operations ? routes[operation].errors : 0; }
+};
@@ -0,0 +1,652 @@
+#pragma once
+
+/**
+ * Mock FirebaseClient for host (native) builds.
+ *
+ * Covers the part of the FirebaseClient API the project writers use: AsyncClientClass,
+ * AsyncResult, FirebaseApp with UserAuth and IDToken, RealtimeDatabase update/set/get
+ * (SSE) and Firestore commits built from Values, Document and Writes. Nothing is sent anywhere. Each async client is a mock
+ * endpoint that answers its requests in order, one at a time like the real client,
+ * after a simulated round trip on the FakeClock. Latency, errors, lost responses and
+ * outages are configurable so tests can drive the upload paths through faults.
+ */
+
+#include <Arduino.h>
+#include <deque>
+
+#define FIREBASE_CLIENT_VERSION "native-mock"
+
+// Codes of the errors the mock endpoint injects
+#define MOCK_ERROR_CONNECTION -1
+#define MOCK_ERROR_SERVICE_UNAVAILABLE 503
+
+class AsyncResult;
+typedef void (*AsyncResultCallback)(AsyncResult &aResult);
+
+class FirebaseError
+{
+private:
+    int errorCode = 0;
+    String errorMessage;
+
+public:
+    FirebaseError() {}
+    FirebaseError(int code, const String &message) : errorCode(code), errorMessage(message) {}
+
+    int code() const { return errorCode; }
+    String message() const { return errorMessage; }
+};
+
+/**--------------------------------------------------------------------------------------
+ * Realtime Database Result Class
+ *
+ * Parsed server-sent event of a stream, filled by the mock from the raw payload.
+ *-------------------------------------------------------------------------------------*/
+
+class RealtimeDatabaseResult
+{
+    friend class AsyncClientClass;
+
+private:
+    bool stream = false;
+    String eventName;
+    String path;
+    String value;
+
+public:
+    bool isStream() const { return stream; }
+    String event() const { return eventName; }
+    String dataPath() const { return path; }
+    String data() const { return value; }
+};
+
+class AsyncResult
+{
+    friend class AsyncClientClass;
+
+private:
+    String taskUid;
+    String text;
+    FirebaseError lastError;
+    RealtimeDatabaseResult database;
+
+public:
+    String uid() const { return taskUid; }
+    bool isError() const { return lastError.code() != 0; }
+    bool available() const { return !text.isEmpty(); }
+    bool isEvent() const { return false; }
+    bool isDebug() const { return false; }
+    const FirebaseError &error() const { return lastError; }
+    FirebaseError appEvent() const { return FirebaseError(); }
+    String debug() const { return String(); }
+    String payload() const { return text; }
+    const char *c_str() const { return text.c_str(); }
+
+    template <typename T>
+    T &to();
+};
+
+template <>
+inline RealtimeDatabaseResult &AsyncResult::to<RealtimeDatabaseResult>() { return database; }
+
+/**--------------------------------------------------------------------------------------
+ * Async Client Class
+ *
+ * One mock connection. Requests queue in submit order, each is answered latency
+ * milliseconds after the previous one finished. Results are delivered from loop(),
+ * which the service loop() calls like the real library does.
+ *-------------------------------------------------------------------------------------*/
+
+class AsyncClientClass
+{
+public:
+    struct Request
+    {
+        String method;
+        String path;
+        String body;
+        String uid;
+        AsyncResultCallback callback;
+        uint32_t submitMillis;
+        uint32_t dueMillis;
+        int error;  // answered with this error code, 0 for success
+        bool lost;  // never answered
+        bool event; // server-sent event of an open stream
+    };
+
+private:
+    std::deque<Request> queue;
+    Request lastRequest = {};
+    uint32_t minLatency = 100;
+    uint32_t maxLatency = 100;
+    uint8_t errorPercent = 0;
+    uint8_t lossPercent = 0;
+    bool online = true;
+    uint32_t busyUntil = 0;
+    uint32_t seed = 1;
+
+    String streamPath;
+    String streamUid;
+    AsyncResultCallback streamCallback = nullptr;
+
+    uint32_t requests = 0;
+    uint32_t errors = 0;
+    uint32_t lost = 0;
+    uint32_t answered = 0;
+    uint32_t bytes = 0;
+    size_t maxQueued = 0;
+
+    // xorshift32 of its own, random() is shared with the code under test
+    uint32_t nextRandom(uint32_t max)
+    {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        return seed % max;
+    }
+
+    uint32_t nextLatency() { return maxLatency > minLatency ? minLatency + nextRandom(maxLatency - minLatency + 1) : minLatency; }
+
+    bool roll(uint8_t percent) { return percent && nextRandom(100) < percent; }
+
+    void deliver(const Request &request)
+    {
+        AsyncResult result;
+        result.taskUid = request.uid;
+        if (request.error)
+        {
+            result.lastError = FirebaseError(request.error, request.error == MOCK_ERROR_CONNECTION ? "connection refused" : "service unavailable");
+        }
+        else if (request.event)
+        {
+            result.text = request.body;
+            parseEvent(request.body, result.database);
+        }
+        else if (request.method == "PATCH" || request.method == "PUT" || request.method == "GET")
+        {
+            result.text = request.body.isEmpty() ? String("null") : request.body; // RTDB echoes the written data
+        }
+        else
+        {
+            result.text = "{\"commitTime\":\"1970-01-01T00:00:00Z\"}";
+        }
+        answered++;
+        if (request.callback)
+            request.callback(result);
+    }
+
+    // "event: put\ndata: {"path":"/a","data":...}" into its parts, data is the raw JSON value
+    static void parseEvent(const String &payload, RealtimeDatabaseResult &result)
+    {
+        result.stream = true;
+        int eventStart = payload.indexOf("event: ");
+        int dataStart = payload.indexOf("data: ");
+        if (eventStart < 0 || dataStart < 0)
+            return;
+        result.eventName = payload.substring(eventStart + 7, payload.indexOf('\n', eventStart));
+        String envelope = payload.substring(dataStart + 6);
+        envelope.trim();
+        int pathStart = envelope.indexOf("\"path\":\"");
+        int valueStart = envelope.indexOf("\"data\":");
+        if (pathStart < 0 || valueStart < 0)
+            return;
+        result.path = envelope.substring(pathStart + 8, envelope.indexOf('"', pathStart + 8));
+        result.value = envelope.substring(valueStart + 7, envelope.length() - 1);
+    }
+
+public:
+    // Seeds the latency, error and loss draws, runs with the same seed answer alike
+    AsyncClientClass &setSeed(uint32_t seed)
+    {
+        this->seed = seed ? seed : 1;
+        return *this;
+    }
+
+    // Round trip of each request, uniformly distributed in milliseconds
+    AsyncClientClass &setLatency(uint32_t minLatency, uint32_t maxLatency)
+    {
+        this->minLatency = minLatency;
+        this->maxLatency = maxLatency < minLatency ? minLatency : maxLatency;
+        return *this;
+    }
+
+    // Percent of the requests answered with a 503 error
+    AsyncClientClass &setErrorRate(uint8_t percent)
+    {
+        errorPercent = percent;
+        return *this;
+    }
+
+    // Percent of the requests that never get a result
+    AsyncClientClass &setLossRate(uint8_t percent)
+    {
+        lossPercent = percent;
+        return *this;
+    }
+
+    // Requests sent while offline fail with a connection error after one round trip
+    AsyncClientClass &setOnline(bool online)
+    {
+        this->online = online;
+        return *this;
+    }
+
+    void setSSEFilters(const String &) {}
+
+    void submit(const char *method, const String &path, const String &body, AsyncResultCallback callback, const String &uid)
+    {
+        Request request = {method, path, body, uid, callback, (uint32_t)millis(), 0, 0, false, false};
+        uint32_t start = (int32_t)(busyUntil - request.submitMillis) > 0 ? busyUntil : request.submitMillis;
+        request.dueMillis = busyUntil = start + nextLatency();
+        if (!online)
+            request.error = MOCK_ERROR_CONNECTION;
+        else if (roll(lossPercent))
+            request.lost = true;
+        else if (roll(errorPercent))
+            request.error = MOCK_ERROR_SERVICE_UNAVAILABLE;
+
+        requests++;
+        bytes += body.length();
+        lastRequest = request;
+        queue.push_back(request);
+        if (queue.size() > maxQueued)
+            maxQueued = queue.size();
+    }
+
+    // Opens a stream, events are queued with pushEvent()
+    void openStream(const String &path, AsyncResultCallback callback, const String &uid)
+    {
+        streamPath = path;
+        streamCallback = callback;
+        streamUid = uid;
+    }
+
+    // Queues a server-sent event for the open stream, data is the JSON value written at path
+    bool pushEvent(const char *event, const char *path, const char *data)
+    {
+        if (!streamCallback)
+            return false;
+        String payload = String("event: ") + event + "\ndata: {\"path\":\"" + path + "\",\"data\":" + data + "}\n";
+        Request request = {"SSE", streamPath, payload, streamUid, streamCallback, (uint32_t)millis(), (uint32_t)millis(), 0, false, true};
+        queue.push_back(request);
+        return true;
+    }
+
+    // Delivers the results that are due, in order
+    void loop()
+    {
+        uint32_t now = millis();
+        while (!queue.empty() && (int32_t)(now - queue.front().dueMillis) >= 0)
+        {
+            Request request = queue.front();
+            queue.pop_front();
+            if (request.lost)
+            {
+                lost++;
+                continue;
+            }
+            if (request.error)
+                errors++;
+            deliver(request);
+        }
+    }
+
+    size_t queued() { return queue.size(); }
+    size_t getMaxQueued() { return maxQueued; }
+    uint32_t getRequests() { return requests; }
+    uint32_t getAnswered() { return answered; }
+    uint32_t getErrors() { return errors; }
+    uint32_t getLost() { return lost; }
+    uint32_t getBytes() { return bytes; }
+    const Request &last() { return lastRequest; }
+};
+
+// Clients a service was used with, its loop() services them
+class MockService
+{
+private:
+    AsyncClientClass *clients[4] = {};
+    uint8_t clientCount = 0;
+
+protected:
+    void track(AsyncClientClass &aClient)
+    {
+        for (uint8_t i = 0; i < clientCount; i++)
+        {
+            if (clients[i] == &aClient)
+                return;
+        }
+        if (clientCount < 4)
+            clients[clientCount++] = &aClient;
+    }
+
+public:
+    void loop()
+    {
+        for (uint8_t i = 0; i < clientCount; i++)
+            clients[i]->loop();
+    }
+};
+
+/**--------------------------------------------------------------------------------------
+ * Firebase App
+ *
+ * Signing in with UserAuth is one request on the client, the app is ready once it is
+ * answered without an error. An IDToken is taken as it is and the app is ready at once.
+ *-------------------------------------------------------------------------------------*/
+
+struct user_auth_data
+{
+    String idToken; // empty to sign in
+    String refreshToken;
+};
+
+class UserAuth
+{
+public:
+    user_auth_data data;
+    UserAuth(const String &, const String &, const String &, size_t = 3600) {}
+};
+
+class IDToken
+{
+public:
+    user_auth_data data;
+    IDToken(const String &, const String &token, size_t, const String &refresh = "") : data{token, refresh} {}
+};
+
+template <typename T>
+user_auth_data &getAuth(T &auth) { return auth.data; }
+
+class FirebaseApp
+{
+private:
+    AsyncClientClass *aClient = nullptr;
+    uint32_t dueMillis = 0;
+    bool signingIn = false;
+    bool signedIn = false;
+    bool failed = false;
+    uint32_t signIns = 0;
+    String token;
+    String refreshToken;
+
+public:
+    void begin(AsyncClientClass &aClient, const user_auth_data &auth, AsyncResultCallback callback, const String &uid)
+    {
+        this->aClient = &aClient;
+        signedIn = !auth.idToken.isEmpty();
+        signingIn = !signedIn;
+        token = auth.idToken;
+        refreshToken = auth.refreshToken;
+        if (!signingIn)
+            return;
+        aClient.submit("POST", "accounts:signInWithPassword", "", callback, uid);
+        dueMillis = aClient.last().dueMillis;
+        failed = aClient.last().error || aClient.last().lost;
+    }
+
+    void loop()
+    {
+        if (aClient)
+            aClient->loop();
+        if (!signingIn || (int32_t)(millis() - dueMillis) < 0)
+            return;
+        signingIn = false;
+        signedIn = !failed;
+        if (!signedIn)
+            return;
+        signIns++;
+        token = String("id-token-") + String(signIns);
+        refreshToken = String("refresh-token-") + String(signIns);
+    }
+
+    bool ready() { return signedIn; }
+    String getToken() { return token; }
+    String getRefreshToken() { return refreshToken; }
+    // Sign-in requests answered without an error
+    uint32_t getSignIns() { return signIns; }
+
+    template <typename T>
+    void getApp(T &) {}
+};
+
+inline void initializeApp(AsyncClientClass &aClient, FirebaseApp &app, const user_auth_data &auth, AsyncResultCallback callback, const String &uid = "")
+{
+    app.begin(aClient, auth, callback, uid);
+}
+
+/**--------------------------------------------------------------------------------------
+ * Realtime Database
+ *-------------------------------------------------------------------------------------*/
+
+class object_t
+{
+private:
+    String text;
+
+public:
+    object_t(const String &text) : text(text) {}
+    const char *c_str() const { return text.c_str(); }
+};
+
+class RealtimeDatabase : public MockService
+{
+public:
+    void url(const String &) {}
+
+    template <typename T>
+    void update(AsyncClientClass &aClient, const String &path, const T &value, AsyncResultCallback callback, const String &uid = "")
+    {
+        track(aClient);
+        aClient.submit("PATCH", path, value.c_str(), callback, uid);
+    }
+
+    template <typename T>
+    void set(AsyncClientClass &aClient, const String &path, const T &value, AsyncResultCallback callback, const String &uid = "")
+    {
+        track(aClient);
+        aClient.submit("PUT", path, value.c_str(), callback, uid);
+    }
+
+    void remove(AsyncClientClass &aClient, const String &path, AsyncResultCallback callback, const String &uid = "")
+    {
+        track(aClient);
+        aClient.submit("DELETE", path, "", callback, uid);
+    }
+
+    void get(AsyncClientClass &aClient, const String &path, AsyncResultCallback callback, bool sse = false, const String &uid = "")
+    {
+        track(aClient);
+        if (sse)
+            aClient.openStream(path, callback, uid);
+        else
+            aClient.submit("GET", path, "", callback, uid);
+    }
+};
+
+/**--------------------------------------------------------------------------------------
+ * Firestore
+ *
+ * Values, documents and writes render the JSON of the REST API, so tests can inspect
+ * the commit body.
+ *-------------------------------------------------------------------------------------*/
+
+class number_t
+{
+private:
+    String text;
+
+public:
+    number_t(double value, int decimals) : text(value, (unsigned char)decimals) {}
+    const char *c_str() const { return text.c_str(); }
+};
+
+namespace Values
+{
+    inline String quote(const char *text)
+    {
+        String quoted("\"");
+        for (; *text; text++)
+        {
+            if (*text == '"' || *text == '\\')
+                quoted += '\\';
+            quoted += *text;
+        }
+        return quoted + "\"";
+    }
+
+    // Every value renders as {"<type>Value": ...}
+    class TypedValue
+    {
+    protected:
+        String json;
+        TypedValue(const char *type, const String &value) : json(String("{\"") + type + "\":" + value + "}") {}
+
+    public:
+        const char *c_str() const { return json.c_str(); }
+    };
+
+    struct NullValue : TypedValue
+    {
+        NullValue() : TypedValue("nullValue", "null") {}
+    };
+    struct StringValue : TypedValue
+    {
+        StringValue(const String &value) : TypedValue("stringValue", quote(value.c_str())) {}
+    };
+    struct BooleanValue : TypedValue
+    {
+        BooleanValue(bool value) : TypedValue("booleanValue", value ? "true" : "false") {}
+    };
+    struct IntegerValue : TypedValue
+    {
+        IntegerValue(int64_t value) : TypedValue("integerValue", quote(String((long long)value).c_str())) {}
+    };
+    struct DoubleValue : TypedValue
+    {
+        DoubleValue(const number_t &value) : TypedValue("doubleValue", value.c_str()) {}
+    };
+    struct TimestampValue : TypedValue
+    {
+        TimestampValue(const String &value) : TypedValue("timestampValue", quote(value.c_str())) {}
+    };
+    struct BytesValue : TypedValue
+    {
+        BytesValue(const String &value) : TypedValue("bytesValue", quote(value.c_str())) {}
+    };
+
+    class Value
+    {
+    private:
+        String json;
+
+    public:
+        template <typename T>
+        Value(const T &value) : json(value.c_str()) {}
+        const char *c_str() const { return json.c_str(); }
+    };
+
+    class MapValue
+    {
+    private:
+        String fields;
+
+    public:
+        MapValue(const String &key, const Value &value) { add(key, value); }
+
+        MapValue &add(const String &key, const Value &value)
+        {
+            if (!fields.isEmpty())
+                fields += ',';
+            fields += quote(key.c_str()) + ":" + value.c_str();
+            return *this;
+        }
+
+        String c_str() const { return String("{\"mapValue\":{\"fields\":{") + fields + "}}}"; }
+    };
+}
+
+class Document
+{
+private:
+    String name;
+    String fields;
+
+public:
+    void setName(const String &name) { this->name = name; }
+
+    Document &add(const String &key, const Values::Value &value)
+    {
+        if (!fields.isEmpty())
+            fields += ',';
+        fields += Values::quote(key.c_str()) + ":" + value.c_str();
+        return *this;
+    }
+
+    String c_str() const
+    {
+        String json("{");
+        if (!name.isEmpty())
+            json += String("\"name\":") + Values::quote(name.c_str()) + ",";
+        return json + "\"fields\":{" + fields + "}}";
+    }
+};
+
+class DocumentMask
+{
+};
+
+class Precondition
+{
+};
+
+class Write
+{
+private:
+    String json;
+
+public:
+    Write(const DocumentMask &, const Document &update, const Precondition &) : json(String("{\"update\":") + update.c_str() + "}") {}
+    const char *c_str() const { return json.c_str(); }
+};
+
+class Writes
+{
+private:
+    String writes;
+
+public:
+    Writes(const Write &write) : writes(write.c_str()) {}
+
+    Writes &add(const Write &write)
+    {
+        writes += ',';
+        writes += write.c_str();
+        return *this;
+    }
+
+    String c_str() const { return String("{\"writes\":[") + writes + "]}"; }
+};
+
+namespace Firestore
+{
+    class Parent
+    {
+    private:
+        String projectId;
+
+    public:
+        Parent(const String &projectId, const String & = "") : projectId(projectId) {}
+        String getProjectId() const { return projectId; }
+    };
+
+    class Documents : public MockService
+    {
+    public:
+        void commit(AsyncClientClass &aClient, const Parent &parent, Writes &writes, AsyncResultCallback callback, const String &uid = "")
+        {
+            track(aClient);
+            aClient.submit("POST", String("projects/") + parent.getProjectId() + "/databases/(default)/documents:commit", writes.c_str(), callback, uid);
+        }
+    };
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <WiFi.h>
+
+#include <WifiLink.h>
+
+/**--------------------------------------------------------------------------------------
+ * ESP Radio Class
+ *
+ * WifiLink driver for the ESP32 station interface. Auto reconnect and the credential
+ * copy in NVS are turned off, the link owns reconnection and its own cache.
+ *-------------------------------------------------------------------------------------*/
+
+class EspRadio
+{
+public:
+    void begin(const char *ssid, const char *password, int32_t channel, const uint8_t *bssid)
+    {
+        WiFi.persistent(false);
+        WiFi.setAutoReconnect(false);
+        WiFi.begin(ssid, password, channel, bssid);
+    }
+
+    // IPAddress(0) is INADDR_NONE, which turns DHCP back on
+    void config(uint32_t ip, uint32_t gateway, uint32_t subnet, uint32_t dns)
+    {
+        WiFi.config(IPAddress(ip), IPAddress(gateway), IPAddress(subnet), IPAddress(dns));
+    }
+
+    void disconnect() { WiFi.disconnect(); }
+
+    RadioStatus status()
+    {
+        switch (WiFi.status())
+        {
+        case WL_CONNECTED:
+            return RADIO_CONNECTED;
+        case WL_NO_SSID_AVAIL:
+        case WL_CONNECT_FAILED:
+            return RADIO_FAILED;
+        case WL_NO_SHIELD:
+            return RADIO_IDLE;
+        default:
+            return RADIO_CONNECTING;
+        }
+    }
+
+    void getLink(WifiLinkRecord &record)
+    {
+        memcpy(record.bssid, WiFi.BSSID(), sizeof(record.bssid));
+        record.channel = WiFi.channel();
+        record.ip = WiFi.localIP();
+        record.gateway = WiFi.gatewayIP();
+        record.subnet = WiFi.subnetMask();
+        record.dns = WiFi.dnsIP();
+    }
+};
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <WifiLink.h>
+
+/**--------------------------------------------------------------------------------------
+ * Fake Radio Class
+ *
+ * Scripted WifiLink driver for host tests, timed by millis() so it pairs with a frozen
+ * FakeClock. The access point answers a direct connect after directDelay and a scan
+ * after scanDelay, a direct connect to another BSSID or channel fails after failDelay.
+ * drop() takes the link down, setAvailable(false) makes every attempt fail.
+ *-------------------------------------------------------------------------------------*/
+
+class FakeRadio
+{
+private:
+    bool started = false;
+    bool direct = false;
+    bool reachable = false;
+    bool linkUp = false;
+    bool available = true;
+    uint32_t startMillis = 0;
+    uint32_t configuredIp = 0;
+
+public:
+    // The access point
+    uint8_t bssid[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+    int32_t channel = 6;
+    uint32_t leaseIp = 0x6401A8C0; // 192.168.1.100
+    uint32_t gateway = 0x0101A8C0;
+    uint32_t subnet = 0x00FFFFFF;
+    uint32_t dns = 0x0101A8C0;
+
+    uint32_t directDelay = 300;
+    uint32_t scanDelay = 2500;
+    uint32_t failDelay = 1500;
+
+    uint32_t beginCount = 0;
+    uint32_t scanCount = 0;
+
+    void begin(const char *, const char *, int32_t channel, const uint8_t *bssid)
+    {
+        started = true;
+        linkUp = false;
+        startMillis = millis();
+        direct = channel && bssid;
+        reachable = available && (!direct || (channel == this->channel && memcmp(bssid, this->bssid, sizeof(this->bssid)) == 0));
+        beginCount++;
+        if (!direct)
+            scanCount++;
+    }
+
+    void config(uint32_t ip, uint32_t, uint32_t, uint32_t) { configuredIp = ip; }
+
+    void disconnect()
+    {
+        started = false;
+        linkUp = false;
+    }
+
+    RadioStatus status()
+    {
+        if (!started)
+            return RADIO_IDLE;
+        uint32_t elapsed = millis() - startMillis;
+        if (!reachable)
+            return elapsed >= failDelay ? RADIO_FAILED : RADIO_CONNECTING;
+        if (!linkUp && elapsed >= (direct ? directDelay : scanDelay))
+            linkUp = true;
+        return linkUp ? RADIO_CONNECTED : RADIO_CONNECTING;
+    }
+
+    void getLink(WifiLinkRecord &record)
+    {
+        memcpy(record.bssid, bssid, sizeof(record.bssid));
+        record.channel = channel;
+        record.ip = configuredIp ? configuredIp : leaseIp;
+        record.gateway = gateway;
+        record.subnet = subnet;
+        record.dns = dns;
+    }
+
+    // Link lost, e.g. the access point rebooted
+    void drop() { started = false; }
+    void setAvailable(bool available) { this->available = available; }
+};
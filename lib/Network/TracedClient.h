@@ -0,0 +1,66 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <BenchmarkStats.h>
+
+/**--------------------------------------------------------------------------------------
+ * Traced Client Class
+ *
+ * Wraps a Client (e.g. WiFiClientSecure) and measures every connect(), which is the TCP
+ * and TLS handshake for a secure client. Requests that reuse a kept-alive connection
+ * don't connect, so handshakes against tasks sent shows how well connections are reused.
+ *
+ * Every connect() is a full handshake. TLS session resumption (session tickets or IDs
+ * kept across reconnects and reboots) is out of scope: WiFiClientSecure runs the mbedtls
+ * setup and handshake in one call with no hook to set a saved session.
+ *-------------------------------------------------------------------------------------*/
+
+template <typename Base>
+class TracedClient : public Base
+{
+private:
+    uint32_t handshakes = 0;
+    uint32_t failures = 0;
+    BenchmarkStats handshakeTime;
+
+    int trace(uint32_t start, int result)
+    {
+        if (result)
+        {
+            handshakes++;
+            handshakeTime.add(millis() - start);
+        }
+        else
+            failures++;
+        return result;
+    }
+
+public:
+    using Base::Base;
+    using Base::connect;
+
+    int connect(IPAddress ip, uint16_t port) override
+    {
+        uint32_t start = millis();
+        return trace(start, Base::connect(ip, port));
+    }
+
+    int connect(const char *host, uint16_t port) override
+    {
+        uint32_t start = millis();
+        return trace(start, Base::connect(host, port));
+    }
+
+    uint32_t getHandshakes() { return handshakes; }
+    uint32_t getFailures() { return failures; }
+    uint32_t getHandshakeMean() { return handshakeTime.mean(); }
+
+    template <typename Print>
+    void print(Print &out, const char *name)
+    {
+        out.printf("%s: handshakes=%lu failures=%lu mean=%lu p95=%lu max=%lu ms\n", name,
+                   (unsigned long)handshakes, (unsigned long)failures, (unsigned long)handshakeTime.mean(),
+                   (unsigned long)handshakeTime.percentile(95), (unsigned long)(handshakeTime.count ? handshakeTime.max : 0));
+    }
+};
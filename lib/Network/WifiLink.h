@@ -0,0 +1,296 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FS.h>
+#include <stddef.h>
+
+#include <BenchmarkStats.h>
+#include <Crc32.h>
+
+#define WIFI_LINK_FILE "/link.bin"
+#define WIFI_LINK_MAGIC 0x4B4E494C // "LINK"
+#define WIFI_LINK_VERSION 1
+
+// Longest a direct connect to the cached access point may take before falling back to a scan
+#ifndef WIFI_LINK_FAST_TIMEOUT_MS
+#define WIFI_LINK_FAST_TIMEOUT_MS 3000
+#endif
+
+#ifndef WIFI_LINK_SCAN_TIMEOUT_MS
+#define WIFI_LINK_SCAN_TIMEOUT_MS 15000
+#endif
+
+#ifndef WIFI_LINK_MAX_BACKOFF_MS
+#define WIFI_LINK_MAX_BACKOFF_MS 60000
+#endif
+
+enum RadioStatus : uint8_t
+{
+    RADIO_IDLE,
+    RADIO_CONNECTING,
+    RADIO_CONNECTED,
+    RADIO_FAILED
+};
+
+enum WifiLinkState : uint8_t
+{
+    LINK_IDLE,
+    LINK_FAST_CONNECT, // direct to the cached BSSID and channel
+    LINK_SCAN_CONNECT, // full scan and DHCP
+    LINK_CONNECTED,
+    LINK_BACKOFF
+};
+
+// Access point and IP lease of the last good connection, addresses as the radio reports them
+struct WifiLinkRecord
+{
+    uint32_t magic;
+    uint16_t version;
+    uint8_t bssid[6];
+    int32_t channel;
+    uint32_t ssidHash; // CRC-32 of the ssid the record belongs to
+    uint32_t ip;
+    uint32_t gateway;
+    uint32_t subnet;
+    uint32_t dns;
+    uint32_t crc; // CRC-32 of the fields above
+};
+
+/**--------------------------------------------------------------------------------------
+ * Wi-Fi Link Class
+ *
+ * Non-blocking connection state machine, call loop() from loop(). The BSSID, channel
+ * and IP lease of the last good connection are kept on the file system, so the next
+ * connect goes straight to that access point with the old address instead of scanning
+ * every channel and waiting for DHCP. A failed fast connect falls back to a scan, a
+ * failed scan retries with exponential backoff. Reconnects after a drop the same way.
+ *
+ * Radio is the driver, see EspRadio for the ESP32 and FakeRadio for host tests:
+ *   void begin(const char *ssid, const char *password, int32_t channel, const uint8_t *bssid);
+ *   void config(uint32_t ip, uint32_t gateway, uint32_t subnet, uint32_t dns); // all 0 for DHCP
+ *   void disconnect();
+ *   RadioStatus status();
+ *   void getLink(WifiLinkRecord &record); // bssid, channel and addresses
+ *-------------------------------------------------------------------------------------*/
+
+template <typename Radio>
+class WifiLink
+{
+private:
+    Radio &radio;
+    fs::FS &fileSystem;
+    const char *ssid = nullptr;
+    const char *password = nullptr;
+    WifiLinkRecord record = {};
+    bool cached = false;   // record holds a link for this ssid
+    bool skipFast = false; // the cached link just failed, scan on the next attempt
+    bool reuseAddress = true;
+    WifiLinkState state = LINK_IDLE;
+    uint32_t attemptMillis = 0; // start of the current attempt or backoff
+    uint32_t downMillis = 0;    // start of the outage, connect time is measured from here
+    uint32_t backoff = 0;
+    uint32_t fastTimeout = WIFI_LINK_FAST_TIMEOUT_MS;
+    uint32_t scanTimeout = WIFI_LINK_SCAN_TIMEOUT_MS;
+    uint32_t maxBackoff = WIFI_LINK_MAX_BACKOFF_MS;
+    uint32_t fastConnects = 0;
+    uint32_t scanConnects = 0;
+    uint32_t fastFailures = 0;
+    uint32_t scanFailures = 0;
+    uint32_t disconnects = 0;
+    uint32_t lastConnectTime = 0;
+    BenchmarkStats connectTime;
+
+    uint32_t hashSsid() { return crc32(ssid, strlen(ssid)); }
+
+    static bool sameLink(const WifiLinkRecord &a, const WifiLinkRecord &b)
+    {
+        return memcmp(a.bssid, b.bssid, sizeof(a.bssid)) == 0 && a.channel == b.channel && a.ssidHash == b.ssidHash &&
+               a.ip == b.ip && a.gateway == b.gateway && a.subnet == b.subnet && a.dns == b.dns;
+    }
+
+    bool load()
+    {
+        File file = fileSystem.open(WIFI_LINK_FILE, "r");
+        if (!file)
+            return false;
+        WifiLinkRecord stored;
+        size_t size = file.read((uint8_t *)&stored, sizeof(stored));
+        file.close();
+
+        if (size != sizeof(stored) || stored.magic != WIFI_LINK_MAGIC || stored.version != WIFI_LINK_VERSION ||
+            crc32(&stored, offsetof(WifiLinkRecord, crc)) != stored.crc || stored.ssidHash != hashSsid())
+            return false;
+        record = stored;
+        return true;
+    }
+
+    bool save()
+    {
+        record.magic = WIFI_LINK_MAGIC;
+        record.version = WIFI_LINK_VERSION;
+        record.crc = crc32(&record, offsetof(WifiLinkRecord, crc));
+        File file = fileSystem.open(WIFI_LINK_FILE, "w");
+        if (!file)
+            return false;
+        size_t written = file.write((const uint8_t *)&record, sizeof(record));
+        file.close();
+        return written == sizeof(record);
+    }
+
+    void connect()
+    {
+        attemptMillis = millis();
+        if (cached && !skipFast)
+        {
+            if (reuseAddress)
+                radio.config(record.ip, record.gateway, record.subnet, record.dns);
+            else
+                radio.config(0, 0, 0, 0);
+            radio.begin(ssid, password, record.channel, record.bssid);
+            state = LINK_FAST_CONNECT;
+        }
+        else
+        {
+            radio.config(0, 0, 0, 0);
+            radio.begin(ssid, password, 0, nullptr);
+            state = LINK_SCAN_CONNECT;
+        }
+    }
+
+    void connected()
+    {
+        lastConnectTime = millis() - downMillis;
+        connectTime.add(lastConnectTime);
+        if (state == LINK_FAST_CONNECT)
+            fastConnects++;
+        else
+            scanConnects++;
+        state = LINK_CONNECTED;
+        backoff = 0;
+        skipFast = false;
+
+        // Only written when the access point or lease changed, saves flash wear
+        WifiLinkRecord current = {};
+        radio.getLink(current);
+        current.ssidHash = hashSsid();
+        if (!cached || !sameLink(current, record))
+        {
+            record = current;
+            save();
+        }
+        cached = true;
+    }
+
+    void failed()
+    {
+        radio.disconnect();
+        if (state == LINK_FAST_CONNECT)
+        {
+            // The access point moved or the lease is gone, scan right away
+            fastFailures++;
+            skipFast = true;
+            connect();
+            return;
+        }
+        scanFailures++;
+        skipFast = false; // the access point may be back, try it first after the backoff
+        backoff = backoff ? (backoff * 2 < maxBackoff ? backoff * 2 : maxBackoff) : 1000;
+        attemptMillis = millis();
+        state = LINK_BACKOFF;
+    }
+
+public:
+    WifiLink(Radio &radio, fs::FS &fileSystem) : radio(radio), fileSystem(fileSystem) {};
+
+    // ssid and password must outlive the link
+    void begin(const char *ssid, const char *password)
+    {
+        this->ssid = ssid;
+        this->password = password;
+        cached = load();
+        skipFast = false;
+        backoff = 0;
+        downMillis = millis();
+        connect();
+    }
+
+    WifiLinkState loop()
+    {
+        switch (state)
+        {
+        case LINK_FAST_CONNECT:
+        case LINK_SCAN_CONNECT:
+        {
+            RadioStatus status = radio.status();
+            if (status == RADIO_CONNECTED)
+                connected();
+            else if (status == RADIO_FAILED || millis() - attemptMillis >= (state == LINK_FAST_CONNECT ? fastTimeout : scanTimeout))
+                failed();
+            break;
+        }
+        case LINK_CONNECTED:
+            if (radio.status() != RADIO_CONNECTED)
+            {
+                disconnects++;
+                downMillis = millis();
+                connect();
+            }
+            break;
+        case LINK_BACKOFF:
+            if (millis() - attemptMillis >= backoff)
+                connect();
+            break;
+        case LINK_IDLE:
+            break;
+        }
+        return state;
+    }
+
+    WifiLinkState getState() { return state; }
+    bool isConnected() { return state == LINK_CONNECTED; }
+
+    WifiLink &setTimeouts(uint32_t fastTimeout, uint32_t scanTimeout)
+    {
+        this->fastTimeout = fastTimeout;
+        this->scanTimeout = scanTimeout;
+        return *this;
+    }
+
+    WifiLink &setMaxBackoff(uint32_t maxBackoff)
+    {
+        this->maxBackoff = maxBackoff;
+        return *this;
+    }
+
+    // Reuses the cached IP lease on a fast connect and skips DHCP, turn off if the
+    // DHCP server hands out addresses from a small pool
+    WifiLink &setReuseAddress(bool reuseAddress)
+    {
+        this->reuseAddress = reuseAddress;
+        return *this;
+    }
+
+    // Drops the cached link, the next connect scans
+    void forget()
+    {
+        cached = false;
+        fileSystem.remove(WIFI_LINK_FILE);
+    }
+
+    uint32_t getFastConnects() { return fastConnects; }
+    uint32_t getScanConnects() { return scanConnects; }
+    uint32_t getFastFailures() { return fastFailures; }
+    uint32_t getScanFailures() { return scanFailures; }
+    uint32_t getDisconnects() { return disconnects; }
+    // Milliseconds from begin() or the last drop to connected
+    uint32_t getLastConnectTime() { return lastConnectTime; }
+
+    template <typename Print>
+    void print(Print &out)
+    {
+        out.printf("wifi: fast=%lu scan=%lu fast-failures=%lu failures=%lu drops=%lu connect last=%lu mean=%lu p95=%lu max=%lu ms\n",
+                   (unsigned long)fastConnects, (unsigned long)scanConnects, (unsigned long)fastFailures, (unsigned long)scanFailures,
+                   (unsigned long)disconnects, (unsigned long)lastConnectTime, (unsigned long)connectTime.mean(),
+                   (unsigned long)connectTime.percentile(95), (unsigned long)(connectTime.count ? connectTime.max : 0));
+    }
+};
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <Arduino.h>
+#include <stddef.h>
+
+#include <Crc32.h>
+
+#define DUTY_CYCLE_MAGIC 0x59545544 // "DUTY"
+
+// Everything that has to survive deep sleep, place it in RTC slow memory (RTC_DATA_ATTR).
+// Its content is random after power-on, DutyCycle::begin() detects that with the CRC.
+template <typename T, size_t Capacity>
+struct DutyCycleState
+{
+    uint32_t magic;
+    uint32_t wakes;            // since power-on
+    uint32_t wakesSinceUpload;
+    uint32_t uploads;
+    uint32_t failures;         // upload wakes in a row that did not get through
+    uint32_t uploadedSamples;
+    uint32_t dropped;          // overwritten while the buffer was full
+    uint32_t radioOnMillis;    // total over all upload wakes
+    uint16_t head;             // oldest sample
+    uint16_t count;
+    T samples[Capacity];
+    uint32_t crc; // CRC-32 of the fields above, set by seal()
+};
+
+/**--------------------------------------------------------------------------------------
+ * Duty Cycle Class
+ *
+ * Wake, sample, sleep bookkeeping for deep sleep nodes. Samples collect in a ring kept
+ * in RTC memory, the radio only comes up every uploadEvery wakes or when the ring is
+ * full, and the whole ring goes out in one upload. The state lives outside the class
+ * so host tests can keep it across simulated resets. Radio-on time is added up per
+ * upload wake to estimate the radio cost of a sample.
+ *-------------------------------------------------------------------------------------*/
+
+template <typename T, size_t Capacity>
+class DutyCycle
+{
+    static_assert(Capacity > 0 && Capacity <= UINT16_MAX, "Capacity must fit the 16 bit count");
+
+public:
+    using State = DutyCycleState<T, Capacity>;
+
+private:
+    State &state;
+    uint32_t uploadEvery = 1;
+    bool warm = false;
+
+    uint32_t checksum() { return crc32(&state, offsetof(State, crc)); }
+
+public:
+    DutyCycle(State &state) : state(state) {};
+
+    // Call once per wake, returns false after power-on or a corrupt state, which starts empty
+    bool begin()
+    {
+        warm = state.magic == DUTY_CYCLE_MAGIC && state.crc == checksum() && state.count <= Capacity && state.head < Capacity;
+        if (!warm)
+        {
+            memset(&state, 0, sizeof(state));
+            state.magic = DUTY_CYCLE_MAGIC;
+        }
+        state.wakes++;
+        state.wakesSinceUpload++;
+        return warm;
+    }
+
+    // Call before deep sleep, the next begin() only trusts a sealed state
+    void seal() { state.crc = checksum(); }
+
+    void setUploadEvery(uint32_t uploadEvery) { this->uploadEvery = uploadEvery ? uploadEvery : 1; }
+
+    // Keeps the newest samples, the oldest is overwritten when the ring is full
+    void add(const T &sample)
+    {
+        if (state.count == Capacity)
+        {
+            state.head = (state.head + 1) % Capacity;
+            state.count--;
+            state.dropped++;
+        }
+        state.samples[(state.head + state.count) % Capacity] = sample;
+        state.count++;
+    }
+
+    // Oldest first
+    const T &operator[](size_t index) { return state.samples[(state.head + index) % Capacity]; }
+    size_t size() { return state.count; }
+    size_t capacity() { return Capacity; }
+    bool isFull() { return state.count == Capacity; }
+
+    // A full ring only forces an early upload while the server is reachable, after a failure
+    // the radio waits for the regular cadence and the oldest samples are overwritten
+    bool shouldUpload() { return state.count > 0 && (state.wakesSinceUpload >= uploadEvery || (isFull() && !state.failures)); }
+
+    // The first count samples reached the server
+    void uploaded(size_t count)
+    {
+        if (count > state.count)
+            count = state.count;
+        state.head = (state.head + count) % Capacity;
+        state.count -= count;
+        state.uploadedSamples += count;
+        state.uploads++;
+        state.failures = 0;
+        state.wakesSinceUpload = 0;
+    }
+
+    // The upload did not get through, the samples are kept for the next upload wake
+    void failed()
+    {
+        state.failures++;
+        state.wakesSinceUpload = 0;
+    }
+
+    // Milliseconds the radio was on during this wake, successful upload or not
+    void addRadioTime(uint32_t millis) { state.radioOnMillis += millis; }
+
+    // Microseconds to sleep so wakes stay period milliseconds apart, awake is the time spent this wake
+    static uint64_t sleepTime(uint32_t period, uint32_t awake) { return (uint64_t)(awake < period ? period - awake : 0) * 1000; }
+
+    bool isWarm() { return warm; }
+    uint32_t getWakes() { return state.wakes; }
+    uint32_t getUploads() { return state.uploads; }
+    uint32_t getFailures() { return state.failures; }
+    uint32_t getDropped() { return state.dropped; }
+    uint32_t getRadioOnMillis() { return state.radioOnMillis; }
+    // Estimated radio-on milliseconds per uploaded sample, 0 before the first upload
+    float getRadioTimePerSample() { return state.uploadedSamples ? (float)state.radioOnMillis / state.uploadedSamples : 0; }
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stddef.h>
+#include <tuple>
+
+/**--------------------------------------------------------------------------------------
+ * Sink Fanout Class
+ *
+ * Hands every item to a set of sinks chosen at compile time. The sinks are policies,
+ * any class with add(item) and loop(online) works, called through a fold expression:
+ * no virtual dispatch, and with a single sink the calls inline to that sink alone.
+ * Each sink keeps its own batch, send cadence and failed batches to send again.
+ *-------------------------------------------------------------------------------------*/
+
+template <typename... Sinks>
+class SinkFanout
+{
+    static_assert(sizeof...(Sinks) > 0, "At least one sink is required");
+
+private:
+    std::tuple<Sinks &...> sinks;
+
+public:
+    SinkFanout(Sinks &...sinks) : sinks(sinks...) {}
+
+    template <typename Item>
+    void add(const Item &item)
+    {
+        std::apply([&](auto &...sink)
+                   { (sink.add(item), ...); },
+                   sinks);
+    }
+
+    // Lets every sink send what is due, call from loop()
+    void loop(bool online)
+    {
+        std::apply([&](auto &...sink)
+                   { (sink.loop(online), ...); },
+                   sinks);
+    }
+
+    template <size_t Index>
+    auto &get() { return std::get<Index>(sinks); }
+
+    static constexpr size_t size() { return sizeof...(Sinks); }
+};
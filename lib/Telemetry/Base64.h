@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Encoded length of n bytes without the null terminator
+#define BASE64_ENCODED_LENGTH(n) ((((n) + 2) / 3) * 4)
+
+/**--------------------------------------------------------------------------------------
+ * Base64 (RFC 4648, padded)
+ *
+ * Encode and decode between fixed buffers. Both return the output length, or 0 if the
+ * output buffer is too small or the input is not valid base64.
+ *-------------------------------------------------------------------------------------*/
+
+inline size_t base64Encode(const uint8_t *data, size_t length, char *out, size_t outSize)
+{
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t encodedLength = BASE64_ENCODED_LENGTH(length);
+    if (outSize < encodedLength + 1)
+        return 0;
+
+    char *p = out;
+    for (size_t i = 0; i < length; i += 3)
+    {
+        uint32_t chunk = (uint32_t)data[i] << 16;
+        if (i + 1 < length)
+            chunk |= (uint32_t)data[i + 1] << 8;
+        if (i + 2 < length)
+            chunk |= data[i + 2];
+
+        *p++ = alphabet[(chunk >> 18) & 0x3F];
+        *p++ = alphabet[(chunk >> 12) & 0x3F];
+        *p++ = i + 1 < length ? alphabet[(chunk >> 6) & 0x3F] : '=';
+        *p++ = i + 2 < length ? alphabet[chunk & 0x3F] : '=';
+    }
+    *p = '\0';
+    return encodedLength;
+}
+
+inline size_t base64Decode(const char *text, size_t length, uint8_t *out, size_t outSize)
+{
+    if (length % 4)
+        return 0;
+
+    size_t written = 0;
+    for (size_t i = 0; i < length; i += 4)
+    {
+        uint32_t chunk = 0;
+        uint8_t padding = 0;
+        for (uint8_t j = 0; j < 4; j++)
+        {
+            char c = text[i + j];
+            int8_t value = c >= 'A' && c <= 'Z'   ? c - 'A'
+                           : c >= 'a' && c <= 'z' ? c - 'a' + 26
+                           : c >= '0' && c <= '9' ? c - '0' + 52
+                           : c == '+'             ? 62
+                           : c == '/'             ? 63
+                                                  : -1;
+            if (c == '=' && i + 4 == length && j >= 2)
+            {
+                padding++;
+                value = 0;
+            }
+            else if (value < 0 || padding)
+            {
+                return 0;
+            }
+            chunk = (chunk << 6) | value;
+        }
+
+        uint8_t bytes = 3 - padding;
+        if (written + bytes > outSize)
+            return 0;
+        for (uint8_t j = 0; j < bytes; j++)
+            out[written++] = chunk >> (16 - 8 * j);
+    }
+    return written;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**--------------------------------------------------------------------------------------
+ * Bit Writer Class
+ *
+ * Appends values of 1 to 64 bits, most significant bit first, into a fixed buffer.
+ * Writes past the end are dropped and flagged as overflow.
+ *-------------------------------------------------------------------------------------*/
+
+class BitWriter
+{
+private:
+    uint8_t *buffer;
+    size_t size;
+    size_t bitLength = 0;
+    bool overflow = false;
+
+public:
+    BitWriter(uint8_t *buffer, size_t size) : buffer(buffer), size(size) {};
+
+    void write(uint64_t value, uint8_t bits)
+    {
+        if (bitLength + bits > size * 8)
+        {
+            overflow = true;
+            return;
+        }
+        for (int i = bits - 1; i >= 0; i--)
+        {
+            size_t byte = bitLength / 8;
+            uint8_t mask = 0x80 >> (bitLength % 8);
+            if ((value >> i) & 1)
+                buffer[byte] |= mask;
+            else
+                buffer[byte] &= ~mask;
+            bitLength++;
+        }
+    }
+
+    void writeBit(bool bit) { write(bit, 1); }
+
+    size_t getBitLength() { return bitLength; }
+    size_t getByteLength() { return (bitLength + 7) / 8; }
+    size_t remainingBits() { return size * 8 - bitLength; }
+    bool hasOverflowed() { return overflow; }
+
+    // Moves back to an earlier position, used to undo a partial write
+    void rewind(size_t bitLength)
+    {
+        if (bitLength < this->bitLength)
+            this->bitLength = bitLength;
+        overflow = false;
+    }
+};
+
+/**--------------------------------------------------------------------------------------
+ * Bit Reader Class
+ *-------------------------------------------------------------------------------------*/
+
+class BitReader
+{
+private:
+    const uint8_t *buffer;
+    size_t bitSize;
+    size_t position = 0;
+
+public:
+    BitReader(const uint8_t *buffer, size_t size) : buffer(buffer), bitSize(size * 8) {};
+
+    // Reads past the end return zero bits
+    uint64_t read(uint8_t bits)
+    {
+        uint64_t value = 0;
+        for (uint8_t i = 0; i < bits; i++)
+        {
+            value <<= 1;
+            if (position < bitSize)
+                value |= (buffer[position / 8] >> (7 - position % 8)) & 1;
+            position++;
+        }
+        return value;
+    }
+
+    bool readBit() { return read(1); }
+
+    size_t getPosition() { return position; }
+    bool isExhausted() { return position > bitSize; }
+};
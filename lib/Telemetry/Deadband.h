@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stdint.h>
+#include <math.h>
+
+/**--------------------------------------------------------------------------------------
+ * Deadband Filter Class
+ *
+ * Report-on-change filter for a fixed set of fields. A sample passes when any field
+ * moved at least its threshold away from the last reported value, or when nothing was
+ * reported for the heartbeat interval so the receiver can tell the device is alive.
+ * A threshold of 0 passes any change, the default heartbeat of 0 disables it.
+ *-------------------------------------------------------------------------------------*/
+
+template <uint8_t Fields>
+class DeadbandFilter
+{
+private:
+    float threshold[Fields] = {};
+    float reported[Fields];
+    uint32_t heartbeat = 0;
+    uint32_t reportedMillis = 0;
+    bool hasReported = false;
+    uint32_t passedCount = 0;
+    uint32_t suppressedCount = 0;
+
+    bool changed(const float values[Fields])
+    {
+        for (uint8_t i = 0; i < Fields; i++)
+        {
+            float difference = fabsf(values[i] - reported[i]);
+            if (threshold[i] > 0 ? difference >= threshold[i] : difference > 0)
+                return true;
+        }
+        return false;
+    }
+
+public:
+    DeadbandFilter &setThreshold(uint8_t field, float threshold)
+    {
+        if (field < Fields)
+            this->threshold[field] = threshold;
+        return *this;
+    }
+
+    // Longest time in milliseconds without a report
+    DeadbandFilter &setHeartbeat(uint32_t heartbeat)
+    {
+        this->heartbeat = heartbeat;
+        return *this;
+    }
+
+    // Returns true if the sample should be reported, it then becomes the reference value
+    bool filter(uint32_t timeMillis, const float values[Fields])
+    {
+        bool pass = !hasReported || changed(values) || (heartbeat && timeMillis - reportedMillis >= heartbeat);
+        if (!pass)
+        {
+            suppressedCount++;
+            return false;
+        }
+
+        for (uint8_t i = 0; i < Fields; i++)
+            reported[i] = values[i];
+        reportedMillis = timeMillis;
+        hasReported = true;
+        passedCount++;
+        return true;
+    }
+
+    void reset() { hasReported = false; }
+
+    uint32_t getPassedCount() { return passedCount; }
+    uint32_t getSuppressedCount() { return suppressedCount; }
+};
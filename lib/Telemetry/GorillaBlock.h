@@ -0,0 +1,266 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include <BitStream.h>
+
+// Worst case bits per sample: a 64 bit delta-of-delta plus a full XOR record per field
+#define GORILLA_MAX_SAMPLE_BITS(fields) (4 + 64 + (fields) * (2 + 5 + 5 + 32))
+// Buffer size that always fits the given number of samples, including the count header
+#define GORILLA_BLOCK_SIZE(samples, fields) (2 + ((samples) * GORILLA_MAX_SAMPLE_BITS(fields) + 7) / 8)
+
+/**--------------------------------------------------------------------------------------
+ * Gorilla Encoder Class
+ *
+ * Packs a run of samples into one block as in Facebook's Gorilla time-series store.
+ * Timestamps (milliseconds) are stored as delta-of-delta, so a steady sample period
+ * costs one bit. Each float field is XORed with its previous value, an unchanged value
+ * costs one bit and a small change only its meaningful bits. The block starts with a
+ * 16 bit sample count.
+ *-------------------------------------------------------------------------------------*/
+
+template <uint8_t Fields, size_t Size>
+class GorillaEncoder
+{
+private:
+    uint8_t data[Size];
+    BitWriter writer{data + 2, Size - 2};
+    uint16_t count = 0;
+    uint64_t previousTime = 0;
+    int64_t previousDelta = 0;
+    uint32_t previousValue[Fields];
+    uint8_t previousLeading[Fields];
+    uint8_t previousTrailing[Fields];
+
+    static uint32_t toBits(float value)
+    {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    void writeTime(uint64_t time)
+    {
+        if (count == 0)
+        {
+            writer.write(time, 64);
+            return;
+        }
+
+        int64_t delta = time - previousTime;
+        int64_t deltaOfDelta = delta - previousDelta;
+        previousDelta = delta;
+
+        if (deltaOfDelta == 0)
+        {
+            writer.writeBit(0);
+        }
+        else if (deltaOfDelta >= -63 && deltaOfDelta <= 64)
+        {
+            writer.write(0b10, 2);
+            writer.write(deltaOfDelta + 63, 7);
+        }
+        else if (deltaOfDelta >= -255 && deltaOfDelta <= 256)
+        {
+            writer.write(0b110, 3);
+            writer.write(deltaOfDelta + 255, 9);
+        }
+        else if (deltaOfDelta >= -2047 && deltaOfDelta <= 2048)
+        {
+            writer.write(0b1110, 4);
+            writer.write(deltaOfDelta + 2047, 12);
+        }
+        else
+        {
+            writer.write(0b1111, 4);
+            writer.write(deltaOfDelta, 64);
+        }
+    }
+
+    void writeValue(uint8_t field, float value)
+    {
+        uint32_t bits = toBits(value);
+        if (count == 0)
+        {
+            writer.write(bits, 32);
+            previousValue[field] = bits;
+            previousLeading[field] = 0xFF; // no window yet
+            return;
+        }
+
+        uint32_t xorValue = bits ^ previousValue[field];
+        previousValue[field] = bits;
+        if (xorValue == 0)
+        {
+            writer.writeBit(0);
+            return;
+        }
+
+        uint8_t leading = __builtin_clz(xorValue);
+        uint8_t trailing = __builtin_ctz(xorValue);
+        if (leading > 31)
+            leading = 31;
+
+        // Reuse the previous window when the meaningful bits fit inside it
+        if (previousLeading[field] != 0xFF && leading >= previousLeading[field] && trailing >= previousTrailing[field])
+        {
+            writer.write(0b10, 2);
+            writer.write(xorValue >> previousTrailing[field], 32 - previousLeading[field] - previousTrailing[field]);
+            return;
+        }
+
+        uint8_t meaningful = 32 - leading - trailing;
+        writer.write(0b11, 2);
+        writer.write(leading, 5);
+        writer.write(meaningful - 1, 5);
+        writer.write(xorValue >> trailing, meaningful);
+        previousLeading[field] = leading;
+        previousTrailing[field] = trailing;
+    }
+
+public:
+    // Returns false and leaves the block unchanged when the sample does not fit
+    bool append(uint64_t time, const float values[Fields])
+    {
+        if (count == UINT16_MAX)
+            return false;
+
+        // Encoding state is restored if the write overflows
+        size_t position = writer.getBitLength();
+        int64_t delta = previousDelta;
+        uint32_t value[Fields];
+        uint8_t leading[Fields], trailing[Fields];
+        memcpy(value, previousValue, sizeof(value));
+        memcpy(leading, previousLeading, sizeof(leading));
+        memcpy(trailing, previousTrailing, sizeof(trailing));
+
+        writeTime(time);
+        for (uint8_t i = 0; i < Fields; i++)
+            writeValue(i, values[i]);
+
+        if (writer.hasOverflowed())
+        {
+            writer.rewind(position);
+            previousDelta = delta;
+            memcpy(previousValue, value, sizeof(value));
+            memcpy(previousLeading, leading, sizeof(leading));
+            memcpy(previousTrailing, trailing, sizeof(trailing));
+            return false;
+        }
+
+        previousTime = time;
+        count++;
+        return true;
+    }
+
+    void clear()
+    {
+        writer.rewind(0);
+        count = 0;
+        previousTime = 0;
+        previousDelta = 0;
+    }
+
+    uint16_t size() { return count; }
+    bool isEmpty() { return count == 0; }
+
+    // Encoded block with the count header filled in
+    const uint8_t *bytes()
+    {
+        data[0] = count >> 8;
+        data[1] = count & 0xFF;
+        return data;
+    }
+
+    size_t length() { return 2 + writer.getByteLength(); }
+};
+
+/**--------------------------------------------------------------------------------------
+ * Gorilla Decoder Class
+ *
+ * Reads the samples of a block written by GorillaEncoder in order.
+ *-------------------------------------------------------------------------------------*/
+
+template <uint8_t Fields>
+class GorillaDecoder
+{
+private:
+    BitReader reader;
+    uint16_t count;
+    uint16_t index = 0;
+    uint64_t previousTime = 0;
+    int64_t previousDelta = 0;
+    uint32_t previousValue[Fields] = {};
+    uint8_t previousLeading[Fields] = {};
+    uint8_t previousTrailing[Fields] = {};
+
+
+    uint64_t readTime()
+    {
+        if (index == 0)
+            return reader.read(64);
+
+        int64_t deltaOfDelta;
+        if (!reader.readBit())
+            deltaOfDelta = 0;
+        else if (!reader.readBit())
+            deltaOfDelta = (int64_t)reader.read(7) - 63;
+        else if (!reader.readBit())
+            deltaOfDelta = (int64_t)reader.read(9) - 255;
+        else if (!reader.readBit())
+            deltaOfDelta = (int64_t)reader.read(12) - 2047;
+        else
+            deltaOfDelta = (int64_t)reader.read(64);
+
+        previousDelta += deltaOfDelta;
+        return previousTime + previousDelta;
+    }
+
+    float readValue(uint8_t field)
+    {
+        if (index == 0)
+        {
+            previousValue[field] = reader.read(32);
+        }
+        else if (reader.readBit())
+        {
+            if (reader.readBit())
+            {
+                previousLeading[field] = reader.read(5);
+                uint8_t meaningful = reader.read(5) + 1;
+                previousTrailing[field] = 32 - previousLeading[field] - meaningful;
+            }
+            uint8_t meaningful = 32 - previousLeading[field] - previousTrailing[field];
+            previousValue[field] ^= (uint32_t)reader.read(meaningful) << previousTrailing[field];
+        }
+
+        float value;
+        memcpy(&value, &previousValue[field], sizeof(value));
+        return value;
+    }
+
+public:
+    GorillaDecoder(const uint8_t *data, size_t length)
+        : reader(data + (length < 2 ? length : 2), length < 2 ? 0 : length - 2),
+          count(length < 2 ? 0 : (data[0] << 8) | data[1]) {};
+
+    uint16_t size() { return count; }
+
+    // Reads the next sample, returns false at the end or on a truncated block
+    bool next(uint64_t &time, float values[Fields])
+    {
+        if (index >= count)
+            return false;
+
+        time = readTime();
+        for (uint8_t i = 0; i < Fields; i++)
+            values[i] = readValue(i);
+        if (reader.isExhausted())
+            return false;
+
+        previousTime = time;
+        index++;
+        return true;
+    }
+};
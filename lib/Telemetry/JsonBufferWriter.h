@@ -0,0 +1,141 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+
+/**--------------------------------------------------------------------------------------
+ * Json Buffer Writer Class
+ *
+ * Writes JSON text into a caller provided buffer without heap allocation. Numbers are
+ * formatted by hand since printf float conversion can allocate on newlib. Once the
+ * buffer overflows every further write is dropped and finish() returns 0.
+ *-------------------------------------------------------------------------------------*/
+
+class JsonBufferWriter
+{
+private:
+    char *buffer;
+    size_t size;
+    size_t length = 0;
+    bool overflow = false;
+
+public:
+    JsonBufferWriter(char *buffer, size_t size) : buffer(buffer), size(size) {};
+
+    size_t getLength() { return length; }
+    bool hasOverflowed() { return overflow; }
+
+    void put(char c)
+    {
+        // Keep one byte for the null terminator
+        if (length + 1 >= size)
+        {
+            overflow = true;
+            return;
+        }
+        buffer[length++] = c;
+    }
+
+    void put(const char *text)
+    {
+        while (*text)
+            put(*text++);
+    }
+
+    // Writes a quoted and escaped JSON string
+    void putString(const char *text)
+    {
+        static const char hex[] = "0123456789abcdef";
+        put('"');
+        for (; *text; text++)
+        {
+            uint8_t c = *text;
+            if (c == '"' || c == '\\')
+            {
+                put('\\');
+                put((char)c);
+            }
+            else if (c < 0x20)
+            {
+                put("\\u00");
+                put(hex[c >> 4]);
+                put(hex[c & 0x0F]);
+            }
+            else
+            {
+                put((char)c);
+            }
+        }
+        put('"');
+    }
+
+    void putKey(const char *key)
+    {
+        putString(key);
+        put(':');
+    }
+
+    void putUnsigned(uint64_t value, int minDigits = 1)
+    {
+        char digits[20];
+        int count = 0;
+        do
+        {
+            digits[count++] = '0' + value % 10;
+            value /= 10;
+        } while (value);
+        while (count < minDigits)
+            digits[count++] = '0';
+        while (count)
+            put(digits[--count]);
+    }
+
+    void putSigned(int64_t value)
+    {
+        if (value < 0)
+        {
+            put('-');
+            putUnsigned((uint64_t)(-(value + 1)) + 1);
+        }
+        else
+        {
+            putUnsigned((uint64_t)value);
+        }
+    }
+
+    // Fixed point float, NaN and infinity are written as null
+    void putFloat(double value, uint8_t decimals = 2)
+    {
+        if (isnan(value) || isinf(value))
+        {
+            put("null");
+            return;
+        }
+
+        uint64_t scale = 1;
+        for (uint8_t i = 0; i < decimals; i++)
+            scale *= 10;
+
+        if (value < 0)
+        {
+            put('-');
+            value = -value;
+        }
+        uint64_t scaled = (uint64_t)(value * scale + 0.5);
+        putUnsigned(scaled / scale);
+        if (decimals)
+        {
+            put('.');
+            putUnsigned(scaled % scale, decimals);
+        }
+    }
+
+    // Null terminates the buffer, returns the text length or 0 if it didn't fit
+    size_t finish()
+    {
+        if (size)
+            buffer[length < size ? length : size - 1] = '\0';
+        return overflow ? 0 : length;
+    }
+};
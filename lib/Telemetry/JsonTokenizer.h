@@ -0,0 +1,359 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef JSON_TOKENIZER_MAX_DEPTH
+#define JSON_TOKENIZER_MAX_DEPTH 16
+#endif
+
+enum JsonTokenType : uint8_t
+{
+    JSON_OBJECT_BEGIN,
+    JSON_OBJECT_END,
+    JSON_ARRAY_BEGIN,
+    JSON_ARRAY_END,
+    JSON_KEY,
+    JSON_STRING,
+    JSON_NUMBER,
+    JSON_TRUE,
+    JSON_FALSE,
+    JSON_NULL,
+    JSON_END,        // the root value is complete, trailing input is an error once seen
+    JSON_INCOMPLETE, // feed more input, see JsonTokenizer::consumed()
+    JSON_ERROR,
+};
+
+/**--------------------------------------------------------------------------------------
+ * Json Token Struct
+ *
+ * Points into the tokenizer input, valid until that buffer changes. Strings and keys
+ * are the raw text between the quotes, unescape() decodes them.
+ *-------------------------------------------------------------------------------------*/
+
+struct JsonToken
+{
+    JsonTokenType type;
+    const char *text;
+    size_t length;
+    bool escaped; // string contains escape sequences
+
+    bool isValue() const { return type == JSON_STRING || type == JSON_NUMBER || type == JSON_TRUE || type == JSON_FALSE || type == JSON_NULL; }
+
+    bool equals(const char *value) const { return !escaped && strlen(value) == length && memcmp(text, value, length) == 0; }
+
+    bool toBool() const { return type == JSON_TRUE; }
+
+    // A number written without fraction or exponent
+    bool isInteger() const { return type == JSON_NUMBER && !memchr(text, '.', length) && !memchr(text, 'e', length) && !memchr(text, 'E', length); }
+
+    double toDouble() const
+    {
+        char number[32];
+        if (type != JSON_NUMBER || length >= sizeof(number))
+            return 0;
+        memcpy(number, text, length);
+        number[length] = '\0';
+        return strtod(number, NULL);
+    }
+
+    long toLong() const { return (long)toDouble(); }
+
+    // Decodes the string into out and null terminates it, returns the decoded length or
+    // 0 if out is too small. \u escapes are written as UTF-8.
+    size_t unescape(char *out, size_t size) const
+    {
+        size_t written = 0;
+        for (size_t i = 0; i < length; i++)
+        {
+            char c = text[i];
+            char utf8[3];
+            uint8_t count = 1;
+            utf8[0] = c;
+            if (c == '\\' && i + 1 < length)
+            {
+                c = text[++i];
+                utf8[0] = c == 'b' ? '\b' : c == 'f' ? '\f' : c == 'n' ? '\n' : c == 'r' ? '\r' : c == 't' ? '\t' : c;
+                if (c == 'u' && i + 4 < length)
+                {
+                    char hex[5] = {text[i + 1], text[i + 2], text[i + 3], text[i + 4], '\0'};
+                    uint16_t code = strtoul(hex, NULL, 16);
+                    i += 4;
+                    if (code < 0x80)
+                    {
+                        utf8[0] = code;
+                    }
+                    else if (code < 0x800)
+                    {
+                        utf8[0] = 0xC0 | (code >> 6);
+                        utf8[1] = 0x80 | (code & 0x3F);
+                        count = 2;
+                    }
+                    else
+                    {
+                        utf8[0] = 0xE0 | (code >> 12);
+                        utf8[1] = 0x80 | ((code >> 6) & 0x3F);
+                        utf8[2] = 0x80 | (code & 0x3F);
+                        count = 3;
+                    }
+                }
+            }
+            if (written + count >= size)
+                return 0;
+            memcpy(out + written, utf8, count);
+            written += count;
+        }
+        if (size)
+            out[written] = '\0';
+        return written;
+    }
+};
+
+/**--------------------------------------------------------------------------------------
+ * Json Tokenizer Class
+ *
+ * Pull-style JSON tokenizer over a caller provided buffer, nothing is copied or
+ * allocated. Input can arrive in chunks: when a token runs past the end of a non-final
+ * buffer next() returns JSON_INCOMPLETE, the caller keeps the bytes after consumed(),
+ * appends the next chunk and calls feed() again. Nesting state survives across feeds.
+ *-------------------------------------------------------------------------------------*/
+
+class JsonTokenizer
+{
+private:
+    enum Expect : uint8_t
+    {
+        EXPECT_VALUE,
+        EXPECT_FIRST_VALUE, // after '[', a value or ']'
+        EXPECT_FIRST_KEY,   // after '{', a key or '}'
+        EXPECT_KEY,
+        EXPECT_COLON,
+        EXPECT_COMMA, // ',' or the end of the container
+        EXPECT_DONE,
+    };
+
+    const char *buffer = nullptr;
+    size_t length = 0;
+    size_t position = 0;
+    bool final = true;
+    bool objects[JSON_TOKENIZER_MAX_DEPTH]; // container kind per depth, true for objects
+    uint8_t depth = 0;
+    Expect expect = EXPECT_VALUE;
+    bool failed = false;
+
+    JsonToken token(JsonTokenType type, size_t start, size_t end, bool escaped = false)
+    {
+        position = end;
+        return {type, buffer + start, end - start, escaped};
+    }
+
+    JsonToken fail()
+    {
+        failed = true;
+        return {JSON_ERROR, buffer + position, 0, false};
+    }
+
+    JsonToken incomplete() { return final ? fail() : JsonToken{JSON_INCOMPLETE, buffer + position, 0, false}; }
+
+    void afterValue() { expect = depth ? EXPECT_COMMA : EXPECT_DONE; }
+
+    JsonToken open(bool object)
+    {
+        if (depth >= JSON_TOKENIZER_MAX_DEPTH)
+            return fail();
+        objects[depth++] = object;
+        expect = object ? EXPECT_FIRST_KEY : EXPECT_FIRST_VALUE;
+        return token(object ? JSON_OBJECT_BEGIN : JSON_ARRAY_BEGIN, position, position + 1);
+    }
+
+    JsonToken close()
+    {
+        if (depth == 0)
+            return fail();
+        bool object = objects[--depth];
+        afterValue();
+        return token(object ? JSON_OBJECT_END : JSON_ARRAY_END, position, position + 1);
+    }
+
+    JsonToken string(JsonTokenType type)
+    {
+        bool escaped = false;
+        for (size_t i = position + 1; i < length; i++)
+        {
+            if (buffer[i] == '\\')
+            {
+                escaped = true;
+                i++;
+            }
+            else if (buffer[i] == '"')
+            {
+                JsonToken result = token(type, position + 1, i, escaped);
+                position = i + 1;
+                return result;
+            }
+        }
+        return incomplete();
+    }
+
+    JsonToken literal(const char *text, JsonTokenType type)
+    {
+        size_t size = strlen(text);
+        if (position + size > length)
+            return memcmp(buffer + position, text, length - position) == 0 ? incomplete() : fail();
+        if (memcmp(buffer + position, text, size) != 0)
+            return fail();
+        afterValue();
+        return token(type, position, position + size);
+    }
+
+    static bool isDelimiter(char c) { return c == ',' || c == ']' || c == '}' || c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+    // Skips [0-9]+, false if there is no digit at end
+    bool digits(size_t &end)
+    {
+        size_t start = end;
+        while (end < length && buffer[end] >= '0' && buffer[end] <= '9')
+            end++;
+        return end > start;
+    }
+
+    // -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)? followed by a delimiter or the end
+    JsonToken number()
+    {
+        size_t end = position;
+        if (end < length && buffer[end] == '-')
+            end++;
+        if (end < length && buffer[end] == '0')
+            end++;
+        else if (!digits(end))
+            return end == length ? incomplete() : fail();
+        if (end < length && buffer[end] == '.')
+        {
+            end++;
+            if (!digits(end))
+                return end == length ? incomplete() : fail();
+        }
+        if (end < length && (buffer[end] == 'e' || buffer[end] == 'E'))
+        {
+            end++;
+            if (end < length && (buffer[end] == '+' || buffer[end] == '-'))
+                end++;
+            if (!digits(end))
+                return end == length ? incomplete() : fail();
+        }
+        if (end == length && !final)
+            return incomplete(); // more digits may follow
+        if (end < length && !isDelimiter(buffer[end]))
+            return fail(); // e.g. "01", "1x" or a NUL inside the input
+        afterValue();
+        return token(JSON_NUMBER, position, end);
+    }
+
+    JsonToken value(char c)
+    {
+        switch (c)
+        {
+        case '{':
+            return open(true);
+        case '[':
+            return open(false);
+        case '"':
+        {
+            JsonToken result = string(JSON_STRING);
+            if (result.type == JSON_STRING)
+                afterValue();
+            return result;
+        }
+        case 't':
+            return literal("true", JSON_TRUE);
+        case 'f':
+            return literal("false", JSON_FALSE);
+        case 'n':
+            return literal("null", JSON_NULL);
+        default:
+            return number();
+        }
+    }
+
+public:
+    // Starts a new document
+    void reset()
+    {
+        depth = 0;
+        expect = EXPECT_VALUE;
+        failed = false;
+        position = 0;
+    }
+
+    // Sets the input, final is false when more chunks of the same document will follow
+    void feed(const char *buffer, size_t length, bool final = true)
+    {
+        this->buffer = buffer;
+        this->length = length;
+        this->final = final;
+        position = 0;
+    }
+
+    // Bytes of the current input that are fully tokenized
+    size_t consumed() { return position; }
+    uint8_t getDepth() { return depth; }
+    bool inObject() { return depth && objects[depth - 1]; }
+
+    JsonToken next()
+    {
+        if (failed)
+            return fail();
+
+        while (true)
+        {
+            while (position < length && (buffer[position] == ' ' || buffer[position] == '\t' || buffer[position] == '\r' || buffer[position] == '\n'))
+                position++;
+            if (position >= length)
+                return expect == EXPECT_DONE ? token(JSON_END, position, position) : incomplete();
+
+            char c = buffer[position];
+            switch (expect)
+            {
+            case EXPECT_DONE:
+                return fail(); // trailing characters
+            case EXPECT_COLON:
+                if (c != ':')
+                    return fail();
+                position++;
+                expect = EXPECT_VALUE;
+                continue;
+            case EXPECT_COMMA:
+                if (c == ',')
+                {
+                    position++;
+                    expect = inObject() ? EXPECT_KEY : EXPECT_VALUE;
+                    continue;
+                }
+                if (c == (inObject() ? '}' : ']'))
+                    return close();
+                return fail();
+            case EXPECT_FIRST_KEY:
+                if (c == '}')
+                    return close();
+                // fall through
+            case EXPECT_KEY:
+            {
+                if (c != '"')
+                    return fail();
+                JsonToken result = string(JSON_KEY);
+                if (result.type == JSON_KEY)
+                    expect = EXPECT_COLON;
+                return result;
+            }
+            case EXPECT_FIRST_VALUE:
+                if (c == ']')
+                    return close();
+                // fall through
+            case EXPECT_VALUE:
+                return value(c);
+            }
+        }
+    }
+};
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <stdint.h>
+#include <sys/time.h>
+#include <tuple>
+#include <type_traits>
+
+#include "JsonBufferWriter.h"
+
+/**--------------------------------------------------------------------------------------
+ * Telemetry Record Schema
+ *
+ * A record is a plain struct that declares its fields once with a static schema():
+ *
+ * struct Reading
+ * {
+ *     struct timeval time;
+ *     float temperature;
+ *     TELEMETRY_SCHEMA(telemetryField("timestamp", &Reading::time),
+ *                      telemetryField("temperature", &Reading::temperature, 1))
+ * };
+ *
+ * Supported field types: bool, integers, float, double, char arrays, const char * and
+ * struct timeval (epoch milliseconds in the JSON, the frame time in a TelemetryFrame).
+ *-------------------------------------------------------------------------------------*/
+
+template <typename Owner, typename T>
+struct TelemetryField
+{
+    const char *name;
+    T Owner::*member;
+    uint8_t decimals;
+};
+
+template <typename Owner, typename T>
+constexpr TelemetryField<Owner, T> telemetryField(const char *name, T Owner::*member, uint8_t decimals = 2)
+{
+    return TelemetryField<Owner, T>{name, member, decimals};
+}
+
+#define TELEMETRY_SCHEMA(...) \
+    static constexpr auto schema() { return std::make_tuple(__VA_ARGS__); }
+
+#ifndef TELEMETRY_FRAME_MAX_VALUES
+#define TELEMETRY_FRAME_MAX_VALUES 4
+#endif
+
+#ifndef TELEMETRY_FRAME_JSON_SIZE
+#define TELEMETRY_FRAME_JSON_SIZE 80
+#endif
+
+/**--------------------------------------------------------------------------------------
+ * Telemetry Frame Struct
+ *
+ * A record serialized once for every backend: the fields as a JSON object, the numeric
+ * fields in schema order and the record time. Sinks copy what they need and never
+ * format the record again. key is set by the producer, e.g. a push id.
+ *-------------------------------------------------------------------------------------*/
+
+struct TelemetryFrame
+{
+    char key[21];
+    struct timeval time;
+    float values[TELEMETRY_FRAME_MAX_VALUES];
+    uint8_t valueCount;
+    char json[TELEMETRY_FRAME_JSON_SIZE];
+    uint8_t jsonLength;
+};
+
+/**--------------------------------------------------------------------------------------
+ * Telemetry Serializer Class
+ *
+ * Serializes a record straight into a fixed buffer as Realtime Database JSON, or into
+ * a TelemetryFrame for the sinks, without heap allocation. Firestore documents are built
+ * by FirebaseClient from the frame values.
+ *-------------------------------------------------------------------------------------*/
+
+class TelemetrySerializer
+{
+private:
+    // Realtime Database values
+    static void writeValue(JsonBufferWriter &writer, bool value, uint8_t) { writer.put(value ? "true" : "false"); }
+    static void writeValue(JsonBufferWriter &writer, const char *value, uint8_t) { writer.putString(value); }
+    static void writeValue(JsonBufferWriter &writer, const struct timeval &value, uint8_t)
+    {
+        writer.putUnsigned((uint64_t)value.tv_sec * 1000 + value.tv_usec / 1000);
+    }
+    template <typename T>
+    static void writeValue(JsonBufferWriter &writer, const T &value, uint8_t decimals)
+    {
+        static_assert(std::is_arithmetic<T>::value, "Unsupported telemetry field type");
+        if constexpr (std::is_floating_point<T>::value)
+            writer.putFloat(value, decimals);
+        else if constexpr (std::is_signed<T>::value)
+            writer.putSigned((int64_t)value);
+        else
+            writer.putUnsigned((uint64_t)value);
+    }
+
+    // Frame values, strings and flags only go into the JSON
+    static void frameValue(TelemetryFrame &frame, const struct timeval &value) { frame.time = value; }
+    static void frameValue(TelemetryFrame &, const char *) {}
+    static void frameValue(TelemetryFrame &, bool) {}
+    template <typename T>
+    static void frameValue(TelemetryFrame &frame, const T &value)
+    {
+        if (frame.valueCount < TELEMETRY_FRAME_MAX_VALUES)
+            frame.values[frame.valueCount++] = value;
+    }
+
+    // Char arrays decay to const char *
+    template <typename Owner, typename T>
+    static const auto &fieldValue(const Owner &record, const TelemetryField<Owner, T> &field)
+    {
+        return record.*(field.member);
+    }
+    template <typename Owner, size_t N>
+    static const char *fieldValue(const Owner &record, const TelemetryField<Owner, char[N]> &field)
+    {
+        return record.*(field.member);
+    }
+
+public:
+    // Writes the record fields as a JSON object, for use inside larger payloads
+    template <typename Record>
+    static void writeRealtime(JsonBufferWriter &writer, const Record &record)
+    {
+        bool first = true;
+        writer.put('{');
+        std::apply([&](const auto &...fields)
+                   { ((writer.put(first ? "" : ","), first = false,
+                       writer.putKey(fields.name),
+                       writeValue(writer, fieldValue(record, fields), fields.decimals)),
+                      ...); },
+                   Record::schema());
+        writer.put('}');
+    }
+
+    // Fills frame from the record in one pass, returns false if the JSON didn't fit
+    template <typename Record>
+    static bool toFrame(const Record &record, TelemetryFrame &frame)
+    {
+        frame.time = {0, 0};
+        frame.valueCount = 0;
+        std::apply([&](const auto &...fields)
+                   { (frameValue(frame, fieldValue(record, fields)), ...); },
+                   Record::schema());
+        frame.jsonLength = toRealtimeJson(record, frame.json, sizeof(frame.json));
+        return frame.jsonLength > 0;
+    }
+
+    // Returns the text length, or 0 if the buffer is too small
+    template <typename Record>
+    static size_t toRealtimeJson(const Record &record, char *buffer, size_t size)
+    {
+        JsonBufferWriter writer(buffer, size);
+        writeRealtime(writer, record);
+        return writer.finish();
+    }
+};
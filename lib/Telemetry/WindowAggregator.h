@@ -0,0 +1,211 @@
+#pragma once
+
+#include <stdint.h>
+#include <math.h>
+
+struct FieldSummary
+{
+    float min;
+    float max;
+    float mean;
+    float stddev; // population standard deviation
+    float p50;    // NAN without a percentile sketch
+    float p95;
+};
+
+template <uint8_t Fields>
+struct WindowSummary
+{
+    uint64_t start; // epoch milliseconds, inclusive
+    uint64_t end;   // epoch milliseconds, exclusive
+    uint32_t count;
+    FieldSummary fields[Fields];
+};
+
+/**--------------------------------------------------------------------------------------
+ * Range Sketch Class
+ *
+ * Fixed range histogram for percentile estimates in constant memory. Values outside
+ * the range count in the first or last bucket. Buckets = 0 disables it.
+ *-------------------------------------------------------------------------------------*/
+
+template <uint8_t Buckets>
+class RangeSketch
+{
+private:
+    float low = 0;
+    float high = 100;
+    uint16_t counts[Buckets] = {};
+    uint32_t total = 0;
+
+public:
+    void setRange(float low, float high)
+    {
+        this->low = low;
+        this->high = high > low ? high : low + 1;
+        reset();
+    }
+
+    void add(float value)
+    {
+        int bucket = (value - low) * Buckets / (high - low);
+        bucket = bucket < 0 ? 0 : bucket >= Buckets ? Buckets - 1 : bucket;
+        if (counts[bucket] < UINT16_MAX)
+            counts[bucket]++;
+        total++;
+    }
+
+    // Interpolated within the bucket holding the pct-th value
+    float percentile(float pct)
+    {
+        if (total == 0)
+            return NAN;
+        float width = (high - low) / Buckets;
+        float rank = pct / 100 * total;
+        uint32_t seen = 0;
+        for (uint8_t i = 0; i < Buckets; i++)
+        {
+            if (counts[i] && seen + counts[i] >= rank)
+                return low + width * (i + (rank - seen) / counts[i]);
+            seen += counts[i];
+        }
+        return high;
+    }
+
+    void reset()
+    {
+        for (uint8_t i = 0; i < Buckets; i++)
+            counts[i] = 0;
+        total = 0;
+    }
+};
+
+template <>
+class RangeSketch<0>
+{
+public:
+    void setRange(float, float) {}
+    void add(float) {}
+    float percentile(float) { return NAN; }
+    void reset() {}
+};
+
+/**--------------------------------------------------------------------------------------
+ * Window Aggregator Class
+ *
+ * Summarizes samples per field over tumbling windows aligned to the epoch: count, min,
+ * max, mean and standard deviation (Welford), plus p50/p95 when SketchBuckets is set.
+ * Memory is fixed and an update is a few float operations, so the sampling rate can be
+ * raised without changing how often summaries are uploaded.
+ *-------------------------------------------------------------------------------------*/
+
+template <uint8_t Fields, uint8_t SketchBuckets = 0>
+class WindowAggregator
+{
+private:
+    struct FieldWindow
+    {
+        float min;
+        float max;
+        float mean; // float keeps updates on the FPU of the ESP32
+        float m2;   // sum of squared differences from the mean
+    };
+
+    uint32_t window = 60000;
+    uint64_t windowStart = 0;
+    bool open = false;
+    uint32_t count = 0;
+    FieldWindow stats[Fields];
+    RangeSketch<SketchBuckets> sketches[Fields];
+    WindowSummary<Fields> summary = {};
+    uint32_t windowCount = 0;
+    uint32_t lateCount = 0;
+
+    void close()
+    {
+        summary.start = windowStart;
+        summary.end = windowStart + window;
+        summary.count = count;
+        for (uint8_t i = 0; i < Fields; i++)
+        {
+            FieldSummary &field = summary.fields[i];
+            field.min = stats[i].min;
+            field.max = stats[i].max;
+            field.mean = stats[i].mean;
+            field.stddev = count ? sqrtf(stats[i].m2 / count) : 0;
+            field.p50 = sketches[i].percentile(50);
+            field.p95 = sketches[i].percentile(95);
+            sketches[i].reset();
+        }
+        open = false;
+        count = 0;
+        windowCount++;
+    }
+
+public:
+    // Window length in milliseconds, takes effect with the next window
+    void setWindow(uint32_t window) { this->window = window ? window : 1; }
+    uint32_t getWindow() { return window; }
+
+    // Expected range of a field for its percentile sketch
+    void setRange(uint8_t field, float low, float high)
+    {
+        if (field < Fields)
+            sketches[field].setRange(low, high);
+    }
+
+    // Adds a sample at epoch milliseconds. Returns true when it closed the previous
+    // window, read that summary with getSummary() before the next call.
+    bool add(uint64_t time, const float values[Fields])
+    {
+        uint64_t start = time - time % window;
+        if (open && start < windowStart)
+        {
+            lateCount++; // belongs to a window already sent
+            return false;
+        }
+
+        bool closed = false;
+        if (open && start != windowStart)
+        {
+            close();
+            closed = true;
+        }
+        if (!open)
+        {
+            windowStart = start;
+            open = true;
+            for (uint8_t i = 0; i < Fields; i++)
+                stats[i] = {values[i], values[i], 0, 0};
+        }
+
+        count++;
+        for (uint8_t i = 0; i < Fields; i++)
+        {
+            FieldWindow &field = stats[i];
+            float value = values[i];
+            field.min = value < field.min ? value : field.min;
+            field.max = value > field.max ? value : field.max;
+            float delta = value - field.mean;
+            field.mean += delta / count;
+            field.m2 += delta * (value - field.mean);
+            sketches[i].add(value);
+        }
+        return closed;
+    }
+
+    // Closes the open window once its end has passed, so a summary is sent even when
+    // samples stop. Returns true when a summary is ready.
+    bool poll(uint64_t now)
+    {
+        if (!open || now < windowStart + window)
+            return false;
+        close();
+        return true;
+    }
+
+    const WindowSummary<Fields> &getSummary() { return summary; }
+    uint32_t pending() { return count; }
+    uint32_t getWindowCount() { return windowCount; }
+    uint32_t getLateCount() { return lateCount; }
+};
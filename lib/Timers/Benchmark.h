@@ -10,30 +10,130 @@
 #define DEBUG_BENCHMARK_SERIAL Serial
 #endif
 
+// Maximum number of labels kept by the registry
+#ifndef DEBUG_BENCHMARK_MAX_LABELS
+#define DEBUG_BENCHMARK_MAX_LABELS 16
+#endif
+
 #if DEBUG_BENCHMARK
-// Creates previous time with label, use same label with BENCHMARK_END(label) to print elapsed milliseconds
+#include <Arduino.h>
+#include "BenchmarkStats.h"
+
+// High resolution time source, the CPU cycle counter where available
+#if defined(ESP32) || defined(ESP8266)
+#define BENCHMARK_TICKS() ESP.getCycleCount()
+#define BENCHMARK_TICKS_TO_MICROS(ticks) ((ticks) / ESP.getCpuFreqMHz())
+#else
+#define BENCHMARK_TICKS() micros()
+#define BENCHMARK_TICKS_TO_MICROS(ticks) (ticks)
+#endif
+
+/**--------------------------------------------------------------------------------------
+ * Benchmark Registry Class
+ *
+ * Fixed table of stats by label. Each call site looks up its label once and keeps the
+ * pointer, so recording a sample costs a few additions and no printing.
+ *-------------------------------------------------------------------------------------*/
+
+class BenchmarkRegistry
+{
+private:
+    BenchmarkStats stats[DEBUG_BENCHMARK_MAX_LABELS];
+    BenchmarkStats overflow; // shared by labels that didn't fit, never printed
+    uint8_t size = 0;
+
+public:
+    static BenchmarkRegistry &instance()
+    {
+        static BenchmarkRegistry registry;
+        return registry;
+    }
+
+    BenchmarkStats *get(const char *label)
+    {
+        for (uint8_t i = 0; i < size; i++)
+        {
+            if (stats[i].label == label || strcmp(stats[i].label, label) == 0)
+                return &stats[i];
+        }
+        if (size >= DEBUG_BENCHMARK_MAX_LABELS)
+            return &overflow;
+        stats[size].label = label;
+        return &stats[size++];
+    }
+
+    template <typename Print>
+    void print(Print &out)
+    {
+        for (uint8_t i = 0; i < size; i++)
+        {
+            BenchmarkStats &s = stats[i];
+            if (s.count == 0)
+                continue;
+            out.printf("%s: n=%lu min=%lu mean=%lu max=%lu p50=%lu p95=%lu p99=%lu us\n",
+                       s.label, (unsigned long)s.count, (unsigned long)s.min, (unsigned long)s.mean(), (unsigned long)s.max,
+                       (unsigned long)s.percentile(50), (unsigned long)s.percentile(95), (unsigned long)s.percentile(99));
+        }
+    }
+
+    void reset()
+    {
+        for (uint8_t i = 0; i < size; i++)
+            stats[i].reset();
+    }
+};
+
+// Creates previous time with label, use same label with BENCHMARK_END(label) to record the elapsed time
 // label must be a symbol
 #define BENCHMARK_BEGIN(label) I_BENCHMARK_BEGIN(CONCAT(_prevTime_, label))
 #define I_BENCHMARK_BEGIN(prevTime) \
-    static unsigned long prevTime;  \
-    prevTime = millis();
+    static uint32_t prevTime;       \
+    prevTime = micros();
 
-// Prints elapsed time since BENCHMARK_BEGIN(label) in milliseconds
+// Records elapsed time since BENCHMARK_BEGIN(label), for spans longer than the cycle counter wraps
 // label must be a symbol
-#define BENCHMARK_END(label) I_BENCHMARK_END(CONCAT(_prevTime_, label), #label)
-#define I_BENCHMARK_END(prevTime, label) DEBUG_BENCHMARK_SERIAL.printf("%s: %lu ms\n", label, millis() - prevTime);
+#define BENCHMARK_END(label) I_BENCHMARK_END(CONCAT(_prevTime_, label), CONCAT(_stats_, label), #label)
+#define I_BENCHMARK_END(prevTime, stats, label)                                  \
+    {                                                                            \
+        static BenchmarkStats *stats = BenchmarkRegistry::instance().get(label); \
+        stats->add(micros() - prevTime);                                         \
+    }
 
-// Creates previous time with label, use same label with BENCHMARK_MICROS_END(label) to print elapsed microseconds
+// Creates previous time with label, use same label with BENCHMARK_MICROS_END(label) to record the elapsed time
 // label must be a symbol
-#define BENCHMARK_MICROS_BEGIN(label) I_BENCHMARK_MICROS_BEGIN(CONCAT(_prevTime_, label))
-#define I_BENCHMARK_MICROS_BEGIN(prevTime) \
-    static unsigned long prevTime;         \
-    prevTime = micros();
+#define BENCHMARK_MICROS_BEGIN(label) I_BENCHMARK_MICROS_BEGIN(CONCAT(_prevTicks_, label))
+#define I_BENCHMARK_MICROS_BEGIN(prevTicks) \
+    static uint32_t prevTicks;              \
+    prevTicks = BENCHMARK_TICKS();
 
-// Prints elapsed time since BENCHMARK_MICROS_BEGIN(label) in microseconds
+// Records elapsed time since BENCHMARK_MICROS_BEGIN(label) using the high resolution time source
 // label must be a symbol
-#define BENCHMARK_MICROS_END(label) I_BENCHMARK_MICROS_END(CONCAT(_prevTime_, label), #label)
-#define I_BENCHMARK_MICROS_END(prevTime, label) DEBUG_BENCHMARK_SERIAL.printf("%s: %lu us\n", label, micros() - prevTime);
+#define BENCHMARK_MICROS_END(label) I_BENCHMARK_MICROS_END(CONCAT(_prevTicks_, label), CONCAT(_stats_, label), #label)
+#define I_BENCHMARK_MICROS_END(prevTicks, stats, label)                          \
+    {                                                                            \
+        uint32_t elapsed = BENCHMARK_TICKS() - prevTicks;                        \
+        static BenchmarkStats *stats = BenchmarkRegistry::instance().get(label); \
+        stats->add(BENCHMARK_TICKS_TO_MICROS(elapsed));                          \
+    }
+
+// Prints the summary of every label
+#define BENCHMARK_PRINT() BenchmarkRegistry::instance().print(DEBUG_BENCHMARK_SERIAL);
+
+// Clears every label
+#define BENCHMARK_RESET() BenchmarkRegistry::instance().reset();
+
+// Prints and clears the summary every n milliseconds, call from loop()
+#define BENCHMARK_PRINT_EVERY(n) I_BENCHMARK_PRINT_EVERY(CONCAT(_benchmarkPrint_, __COUNTER__), n)
+#define I_BENCHMARK_PRINT_EVERY(lastPrint, n)      \
+    {                                              \
+        static uint32_t lastPrint = millis();      \
+        if (millis() - lastPrint >= (uint32_t)(n)) \
+        {                                          \
+            lastPrint = millis();                  \
+            BENCHMARK_PRINT()                      \
+            BENCHMARK_RESET()                      \
+        }                                          \
+    }
 
 #ifndef CONCAT
 #define CONCAT(x, y) I_CONCAT(x, y)
@@ -47,4 +147,8 @@
 #define BENCHMARK_MICROS_BEGIN(label)
 #define BENCHMARK_MICROS_END(label)
 
-#endif
\ No newline at end of file
+#define BENCHMARK_PRINT()
+#define BENCHMARK_RESET()
+#define BENCHMARK_PRINT_EVERY(n)
+
+#endif
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <Arduino.h>
+
+/**--------------------------------------------------------------------------------------
+ * Benchmark Stats Class
+ *
+ * Sample count, min/max/mean and a fixed size log histogram (2 buckets per power of
+ * two) used to estimate percentiles. Values are microseconds.
+ *-------------------------------------------------------------------------------------*/
+
+class BenchmarkStats
+{
+private:
+    static const uint8_t BUCKETS = 64;
+    uint32_t histogram[BUCKETS];
+
+    static uint8_t bucketOf(uint32_t value)
+    {
+        if (value < 4)
+            return value;
+        uint8_t msb = 31 - __builtin_clz(value);
+        return msb * 2 + ((value >> (msb - 1)) & 1);
+    }
+
+    static uint32_t bucketLowerBound(uint8_t bucket)
+    {
+        if (bucket < 4)
+            return bucket;
+        uint8_t msb = bucket / 2;
+        return (uint32_t)(2 + bucket % 2) << (msb - 1);
+    }
+
+public:
+    const char *label = nullptr;
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+
+    BenchmarkStats() { reset(); }
+
+    void add(uint32_t value)
+    {
+        count++;
+        sum += value;
+        if (value < min)
+            min = value;
+        if (value > max)
+            max = value;
+        histogram[bucketOf(value)]++;
+    }
+
+    uint32_t mean() { return count ? sum / count : 0; }
+
+    // Estimates the given percentile (0-100), interpolated inside its histogram bucket
+    uint32_t percentile(uint8_t percent)
+    {
+        if (count == 0)
+            return 0;
+        uint32_t rank = ((uint64_t)count * percent + 99) / 100;
+        uint32_t seen = 0;
+        for (uint8_t i = 0; i < BUCKETS; i++)
+        {
+            if (histogram[i] == 0 || seen + histogram[i] < rank)
+            {
+                seen += histogram[i];
+                continue;
+            }
+            uint32_t lower = bucketLowerBound(i);
+            uint32_t upper = i + 1 < BUCKETS ? bucketLowerBound(i + 1) : UINT32_MAX;
+            uint32_t value = lower + (uint64_t)(upper - 1 - lower) * (rank - seen) / histogram[i]; // stays inside the bucket
+            if (value < min)
+                return min;
+            return value < max ? value : max;
+        }
+        return max;
+    }
+
+    void reset()
+    {
+        count = 0;
+        min = UINT32_MAX;
+        max = 0;
+        sum = 0;
+        memset(histogram, 0, sizeof(histogram));
+    }
+};
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <Arduino.h>
+
+typedef void (*SchedulerCallback)();
+typedef unsigned long (*SchedulerClock)();
+
+/**--------------------------------------------------------------------------------------
+ * Scheduler Class
+ *
+ * Cooperative scheduler for periodic and one-shot tasks kept in a fixed size min-heap
+ * ordered by deadline. run() reads the clock once, dispatches every due task and
+ * returns the time until the next deadline so the loop can sleep until then instead
+ * of polling a timer per task. Deadlines are compared with wrap-around safe arithmetic.
+ *-------------------------------------------------------------------------------------*/
+
+template <uint16_t Capacity>
+class Scheduler
+{
+private:
+    static_assert(Capacity > 0, "Scheduler needs at least one slot");
+
+    struct Task
+    {
+        SchedulerCallback callback;
+        uint32_t period; // 0 for one-shot tasks
+        uint8_t generation;
+        bool active;
+    };
+
+    struct Entry
+    {
+        uint32_t deadline;
+        uint16_t slot;
+    };
+
+    Task tasks[Capacity] = {};
+    Entry heap[Capacity];
+    uint16_t heapSize = 0;
+    SchedulerClock clock;
+
+    static bool before(uint32_t a, uint32_t b) { return (int32_t)(a - b) < 0; }
+
+    void swap(size_t a, size_t b)
+    {
+        Entry entry = heap[a];
+        heap[a] = heap[b];
+        heap[b] = entry;
+    }
+
+    void siftUp(size_t index)
+    {
+        while (index > 0)
+        {
+            size_t parent = (index - 1) / 2;
+            if (!before(heap[index].deadline, heap[parent].deadline))
+                break;
+            swap(index, parent);
+            index = parent;
+        }
+    }
+
+    void siftDown(size_t index)
+    {
+        while (true)
+        {
+            size_t smallest = index;
+            size_t left = index * 2 + 1;
+            size_t right = left + 1;
+            if (left < heapSize && before(heap[left].deadline, heap[smallest].deadline))
+                smallest = left;
+            if (right < heapSize && before(heap[right].deadline, heap[smallest].deadline))
+                smallest = right;
+            if (smallest == index)
+                break;
+            swap(index, smallest);
+            index = smallest;
+        }
+    }
+
+    void push(uint32_t deadline, uint16_t slot)
+    {
+        heap[heapSize] = {deadline, slot};
+        siftUp(heapSize++);
+    }
+
+    void remove(size_t index)
+    {
+        heap[index] = heap[--heapSize];
+        if (index < heapSize)
+        {
+            siftDown(index);
+            siftUp(index);
+        }
+    }
+
+    int add(uint32_t delay, uint32_t period, SchedulerCallback callback)
+    {
+        for (uint16_t slot = 0; slot < Capacity; slot++)
+        {
+            if (tasks[slot].active)
+                continue;
+            Task &task = tasks[slot];
+            task.callback = callback;
+            task.period = period;
+            task.active = true;
+            task.generation++;
+            push(clock() + delay, slot);
+            return slot | (task.generation << 16);
+        }
+        return -1;
+    }
+
+public:
+    // clock is injectable for testing, millis() by default
+    Scheduler(SchedulerClock clock = millis) : clock(clock) {}
+
+    // Runs callback every period, first after one period. Returns a task id or -1 if full.
+    int every(uint32_t period, SchedulerCallback callback) { return add(period, period ? period : 1, callback); }
+
+    // Runs callback once after delay. Returns a task id or -1 if full.
+    int after(uint32_t delay, SchedulerCallback callback) { return add(delay, 0, callback); }
+
+    bool cancel(int id)
+    {
+        if (id < 0 || (id & 0xFFFF) >= Capacity)
+            return false;
+        uint16_t slot = id & 0xFFFF;
+        Task &task = tasks[slot];
+        if (!task.active || task.generation != (uint8_t)(id >> 16))
+            return false;
+        task.active = false;
+        for (size_t i = 0; i < heapSize; i++)
+        {
+            if (heap[i].slot == slot)
+            {
+                remove(i);
+                break;
+            }
+        }
+        return true;
+    }
+
+    uint16_t size() { return heapSize; }
+
+    // Time until the next deadline, 0 if a task is due, UINT32_MAX if nothing is scheduled
+    uint32_t nextDeadline()
+    {
+        if (heapSize == 0)
+            return UINT32_MAX;
+        uint32_t now = clock();
+        return before(now, heap[0].deadline) ? heap[0].deadline - now : 0;
+    }
+
+    // Dispatches due tasks, returns the time until the next deadline
+    uint32_t run()
+    {
+        uint32_t now = clock();
+        while (heapSize && !before(now, heap[0].deadline))
+        {
+            Entry entry = heap[0];
+            Task &task = tasks[entry.slot];
+            remove(0);
+
+            if (task.period)
+            {
+                // Keep the cadence without drift, skip missed periods if far behind
+                uint32_t deadline = entry.deadline + task.period;
+                push(before(deadline, now) ? now + task.period : deadline, entry.slot);
+            }
+            else
+            {
+                task.active = false;
+            }
+            task.callback();
+        }
+        return nextDeadline();
+    }
+};
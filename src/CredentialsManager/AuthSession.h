@@ -0,0 +1,116 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FirebaseClient.h>
+#include <FS.h>
+
+#include "Models.h"
+#include "TokenCache.h"
+
+/**--------------------------------------------------------------------------------------
+ * Auth Session Class
+ *
+ * Signs the app in at boot, restoring the cached token when it still has enough time
+ * left. A cached token is only checked once NTP set the clock, auth waits for the sync
+ * instead of signing in. The token is stored after sign-in and every refresh, a cached
+ * token the server rejects is dropped and the next ready() signs in instead.
+ *-------------------------------------------------------------------------------------*/
+
+class AuthSession
+{
+private:
+    AsyncClientClass &aClient;
+    FirebaseApp &app;
+    TokenCache tokenCache;
+    AsyncResultCallback callback;
+    const FirebaseCredential *firebase = nullptr;
+    AuthToken token; // restored at boot, saved whenever the app gets a new one
+    uint32_t startMillis = 0;
+    bool cached = false; // loaded by begin(), restored once the clock is set
+    bool started = false;
+    bool fromCache = false;
+    bool rejected = false;
+
+    // The app refreshes a restored token in the background from app.loop() before it expires
+    void start(bool useCache, time_t now)
+    {
+        fromCache = useCache;
+        if (fromCache)
+        {
+            IDToken idToken(firebase->apiKey, token.idToken, token.remaining(now), token.refreshToken);
+            initializeApp(aClient, app, getAuth(idToken), callback, "authTask");
+        }
+        else
+        {
+            UserAuth userAuth(firebase->apiKey, firebase->userEmail, firebase->userPassword, AUTH_TOKEN_LIFETIME_SEC);
+            initializeApp(aClient, app, getAuth(userAuth), callback, "authTask");
+        }
+    }
+
+public:
+    AuthSession(AsyncClientClass &aClient, FirebaseApp &app, fs::FS &fileSystem, AsyncResultCallback callback)
+        : aClient(aClient), app(app), tokenCache(fileSystem), callback(callback) {};
+
+    // Loads the cached token, call when the auth phase starts. firebase must outlive the session.
+    void begin(const FirebaseCredential &firebase)
+    {
+        this->firebase = &firebase;
+        startMillis = millis();
+        started = false;
+        rejected = false;
+        cached = tokenCache.load(firebase, token);
+    }
+
+    // Call until it returns true. clockSyncing while NTP sync may still set the clock,
+    // a cached token waits for it.
+    bool ready(time_t now, bool clockSyncing)
+    {
+        if (!started)
+        {
+            AuthStart start = authStart(cached, token, now, clockSyncing);
+            if (start == AUTH_WAIT_FOR_CLOCK)
+                return false;
+            started = true;
+            this->start(start == AUTH_RESTORE, now);
+        }
+        if (rejected)
+        {
+            rejected = false;
+            start(false, now); // the cached token was revoked, sign in instead
+        }
+        app.loop();
+        if (!app.ready())
+            return false;
+        save(now);
+        return true;
+    }
+
+    // Stores a new token, call every few seconds so refreshes are kept too
+    void save(time_t now)
+    {
+        if (!firebase || !app.ready() || now < TOKEN_CACHE_MIN_TIME)
+            return; // expiry can't be stamped before NTP sync, retried on the next call
+        String idToken = app.getToken();
+        if (idToken == token.idToken)
+            return;
+        token.idToken = idToken;
+        token.refreshToken = app.getRefreshToken();
+        token.expiresAt = now + AUTH_TOKEN_LIFETIME_SEC; // seen at most one save interval after it was issued
+        tokenCache.save(*firebase, token);
+    }
+
+    // Call with the results of the auth task, drops a cached token the server rejected
+    void onResult(AsyncResult &aResult)
+    {
+        if (aResult.isError() && fromCache)
+        {
+            tokenCache.clear();
+            rejected = true;
+        }
+    }
+
+    // True when the app was started with the cached token instead of signing in
+    bool isFromCache() { return fromCache; }
+    // millis() when begin() was called
+    uint32_t getStartMillis() { return startMillis; }
+};
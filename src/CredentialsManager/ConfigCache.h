@@ -0,0 +1,152 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FS.h>
+
+#include <Crc32.h>
+#include "Models.h"
+
+#define CONFIG_CACHE_FILE "/config.bin"
+#define CONFIG_CACHE_MAGIC 0x43464743 // "CGFC"
+#define CONFIG_CACHE_VERSION 1
+#define CONFIG_CACHE_MAX_SIZE 1024
+
+// Identifies the JSON file a cache was built from
+struct ConfigSourceStamp
+{
+    uint32_t size;
+    uint32_t lastWrite;
+
+    bool operator==(const ConfigSourceStamp &other) const { return size == other.size && lastWrite == other.lastWrite; }
+};
+
+struct ConfigCacheHeader
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t length; // body bytes after the header
+    uint32_t crc;    // CRC-32 of the body
+    ConfigSourceStamp wifiSource;
+    ConfigSourceStamp firebaseSource;
+};
+
+/**--------------------------------------------------------------------------------------
+ * Config Cache Class
+ *
+ * Compiled copy of the JSON credential files: a header with version, CRC and the size
+ * and modification time of each source file, followed by length prefixed strings.
+ * Loading is one file read and no JSON parsing. The cache is rejected when it is
+ * corrupt, from another version or older than its source files.
+ *-------------------------------------------------------------------------------------*/
+
+class ConfigCache
+{
+private:
+    fs::FS &fileSystem;
+
+    static bool putString(uint8_t *buffer, size_t &offset, const String &value)
+    {
+        if (value.length() > 255 || offset + 1 + value.length() > CONFIG_CACHE_MAX_SIZE - sizeof(ConfigCacheHeader))
+            return false;
+        buffer[offset++] = value.length();
+        memcpy(buffer + offset, value.c_str(), value.length());
+        offset += value.length();
+        return true;
+    }
+
+    static bool getString(const uint8_t *buffer, size_t length, size_t &offset, String &value)
+    {
+        if (offset >= length || offset + 1 + buffer[offset] > length)
+            return false;
+        uint8_t size = buffer[offset++];
+        value = String((const char *)buffer + offset, size);
+        offset += size;
+        return true;
+    }
+
+public:
+    ConfigCache(fs::FS &fileSystem) : fileSystem(fileSystem) {};
+
+    // Size and modification time of a source file, zero if it is missing
+    ConfigSourceStamp stamp(const char *path)
+    {
+        ConfigSourceStamp stamp = {0, 0};
+        File file = fileSystem.open(path, "r");
+        if (file)
+        {
+            stamp.size = file.size();
+            stamp.lastWrite = file.getLastWrite();
+            file.close();
+        }
+        return stamp;
+    }
+
+    bool load(const ConfigSourceStamp &wifiSource, const ConfigSourceStamp &firebaseSource,
+              WifiCredential &wifi, FirebaseCredential &firebase)
+    {
+        uint8_t buffer[CONFIG_CACHE_MAX_SIZE];
+        File file = fileSystem.open(CONFIG_CACHE_FILE, "r");
+        if (!file)
+            return false;
+        size_t size = file.read(buffer, sizeof(buffer));
+        file.close();
+
+        ConfigCacheHeader header;
+        if (size < sizeof(header))
+            return false;
+        memcpy(&header, buffer, sizeof(header));
+        const uint8_t *body = buffer + sizeof(header);
+
+        if (header.magic != CONFIG_CACHE_MAGIC || header.version != CONFIG_CACHE_VERSION ||
+            sizeof(header) + header.length != size || crc32(body, header.length) != header.crc)
+            return false;
+        if (!(header.wifiSource == wifiSource) || !(header.firebaseSource == firebaseSource))
+            return false; // stale, the JSON files changed
+
+        size_t offset = 0;
+        WifiCredential wifiCache;
+        FirebaseCredential firebaseCache;
+        bool ok = getString(body, header.length, offset, wifiCache.ssid) &&
+                  getString(body, header.length, offset, wifiCache.password) &&
+                  getString(body, header.length, offset, firebaseCache.apiKey) &&
+                  getString(body, header.length, offset, firebaseCache.projectId) &&
+                  getString(body, header.length, offset, firebaseCache.realtimeDbUrl) &&
+                  getString(body, header.length, offset, firebaseCache.userEmail) &&
+                  getString(body, header.length, offset, firebaseCache.userPassword);
+        if (!ok)
+            return false;
+
+        wifi = wifiCache;
+        firebase = firebaseCache;
+        return true;
+    }
+
+    bool save(const ConfigSourceStamp &wifiSource, const ConfigSourceStamp &firebaseSource,
+              const WifiCredential &wifi, const FirebaseCredential &firebase)
+    {
+        uint8_t buffer[CONFIG_CACHE_MAX_SIZE];
+        uint8_t *body = buffer + sizeof(ConfigCacheHeader);
+        size_t length = 0;
+        bool ok = putString(body, length, wifi.ssid) &&
+                  putString(body, length, wifi.password) &&
+                  putString(body, length, firebase.apiKey) &&
+                  putString(body, length, firebase.projectId) &&
+                  putString(body, length, firebase.realtimeDbUrl) &&
+                  putString(body, length, firebase.userEmail) &&
+                  putString(body, length, firebase.userPassword);
+        if (!ok)
+            return false;
+
+        ConfigCacheHeader header = {CONFIG_CACHE_MAGIC, CONFIG_CACHE_VERSION, (uint16_t)length, crc32(body, length), wifiSource, firebaseSource};
+        memcpy(buffer, &header, sizeof(header));
+
+        File file = fileSystem.open(CONFIG_CACHE_FILE, "w");
+        if (!file)
+            return false;
+        size_t written = file.write(buffer, sizeof(header) + length);
+        file.close();
+        return written == sizeof(header) + length;
+    }
+
+    void clear() { fileSystem.remove(CONFIG_CACHE_FILE); }
+};
@@ -5,6 +5,7 @@
 #include <FS.h>
 
 #include "Models.h"
+#include "ConfigCache.h"
 
 #define FIREBASE_CONFIG_FILE "/firebase_config.json"
 #define WIFI_CONFIG_FILE "/wifi_config.json"
@@ -67,4 +68,28 @@ public:
 
         return FirebaseCredential{apiKey, projectId, realtimeDbUrl, userEmail, userPassword};
     }
+
+    // Reads both credentials from the config cache, falls back to the JSON files and
+    // rebuilds the cache when it is missing or older than the files.
+    bool getCredentials(WifiCredential &wifiCredential, FirebaseCredential &firebaseCredential)
+    {
+        ConfigCache cache(fileSystem);
+        ConfigSourceStamp wifiSource = cache.stamp(WIFI_CONFIG_FILE);
+        ConfigSourceStamp firebaseSource = cache.stamp(FIREBASE_CONFIG_FILE);
+
+        if (cache.load(wifiSource, firebaseSource, wifiCredential, firebaseCredential))
+        {
+            Serial.printf("Read config cache: %s\r\n", CONFIG_CACHE_FILE);
+            return true;
+        }
+
+        wifiCredential = getWifiCredential();
+        firebaseCredential = getFirebaseCredential();
+        if (wifiCredential.isEmpty() || firebaseCredential.isEmpty())
+            return false;
+
+        if (!cache.save(wifiSource, firebaseSource, wifiCredential, firebaseCredential))
+            Serial.println("Failed to write config cache");
+        return true;
+    }
 };
\ No newline at end of file
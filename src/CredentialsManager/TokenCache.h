@@ -0,0 +1,165 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FS.h>
+
+#include <Crc32.h>
+#include "Models.h"
+
+#define TOKEN_CACHE_FILE "/token.bin"
+#define TOKEN_CACHE_MAGIC 0x4E4B4F54 // "TOKN"
+#define TOKEN_CACHE_VERSION 1
+#define TOKEN_CACHE_MAX_SIZE 3072
+
+// Wall clock before this is not set yet (2023-01-01)
+#define TOKEN_CACHE_MIN_TIME 1672531200
+
+// Firebase ID tokens expire an hour after they are issued
+#define AUTH_TOKEN_LIFETIME_SEC 3600
+
+// A cached ID token with less time left is not restored, signing in costs the same round trip as a refresh
+#ifndef AUTH_TOKEN_MIN_TTL_SEC
+#define AUTH_TOKEN_MIN_TTL_SEC 300
+#endif
+
+// ID and refresh token of a signed in user, expiresAt is in seconds since the epoch
+struct AuthToken
+{
+    String idToken = "";
+    String refreshToken = "";
+    uint32_t expiresAt = 0;
+
+    // Seconds the ID token is still valid for, 0 if expired or the clock is not set yet
+    uint32_t remaining(time_t now)
+    {
+        if (now < TOKEN_CACHE_MIN_TIME || (uint32_t)now >= expiresAt)
+            return 0;
+        return expiresAt - now;
+    }
+};
+
+enum AuthStart
+{
+    AUTH_WAIT_FOR_CLOCK,
+    AUTH_RESTORE,
+    AUTH_SIGN_IN
+};
+
+// How boot authenticates with a cached token. Its expiry is wall time, so it can only be
+// checked once NTP set the clock: wait while the sync is still running, sign in if there
+// is no usable token or the sync gave up.
+inline AuthStart authStart(bool cached, AuthToken &token, time_t now, bool clockSyncing)
+{
+    if (!cached)
+        return AUTH_SIGN_IN;
+    if (now < TOKEN_CACHE_MIN_TIME)
+        return clockSyncing ? AUTH_WAIT_FOR_CLOCK : AUTH_SIGN_IN;
+    return token.remaining(now) >= AUTH_TOKEN_MIN_TTL_SEC ? AUTH_RESTORE : AUTH_SIGN_IN;
+}
+
+struct TokenCacheHeader
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t length;  // body bytes after the header
+    uint32_t crc;     // CRC-32 of the body
+    uint32_t account; // CRC-32 of the API key and email the tokens belong to
+    uint32_t expiresAt;
+};
+
+/**--------------------------------------------------------------------------------------
+ * Token Cache Class
+ *
+ * Keeps the auth tokens on the file system so a reboot restores the session instead of
+ * signing in again. The cache is rejected when it is corrupt or belongs to another API
+ * key or user.
+ *-------------------------------------------------------------------------------------*/
+
+class TokenCache
+{
+private:
+    fs::FS &fileSystem;
+
+    static uint32_t account(const FirebaseCredential &firebase)
+    {
+        return crc32(firebase.userEmail.c_str(), firebase.userEmail.length(), crc32(firebase.apiKey.c_str(), firebase.apiKey.length()));
+    }
+
+    static bool putString(uint8_t *buffer, size_t &offset, const String &value)
+    {
+        if (offset + 2 + value.length() > TOKEN_CACHE_MAX_SIZE - sizeof(TokenCacheHeader))
+            return false;
+        buffer[offset++] = value.length() & 0xFF;
+        buffer[offset++] = value.length() >> 8;
+        memcpy(buffer + offset, value.c_str(), value.length());
+        offset += value.length();
+        return true;
+    }
+
+    static bool getString(const uint8_t *buffer, size_t length, size_t &offset, String &value)
+    {
+        if (offset + 2 > length)
+            return false;
+        size_t size = buffer[offset] | buffer[offset + 1] << 8;
+        offset += 2;
+        if (offset + size > length)
+            return false;
+        value = String((const char *)buffer + offset, size);
+        offset += size;
+        return true;
+    }
+
+public:
+    TokenCache(fs::FS &fileSystem) : fileSystem(fileSystem) {};
+
+    bool load(const FirebaseCredential &firebase, AuthToken &token)
+    {
+        uint8_t buffer[TOKEN_CACHE_MAX_SIZE];
+        File file = fileSystem.open(TOKEN_CACHE_FILE, "r");
+        if (!file)
+            return false;
+        size_t size = file.read(buffer, sizeof(buffer));
+        file.close();
+
+        TokenCacheHeader header;
+        if (size < sizeof(header))
+            return false;
+        memcpy(&header, buffer, sizeof(header));
+        const uint8_t *body = buffer + sizeof(header);
+
+        if (header.magic != TOKEN_CACHE_MAGIC || header.version != TOKEN_CACHE_VERSION ||
+            sizeof(header) + header.length != size || crc32(body, header.length) != header.crc)
+            return false;
+        if (header.account != account(firebase))
+            return false; // signed in with other credentials
+
+        size_t offset = 0;
+        AuthToken cached;
+        if (!getString(body, header.length, offset, cached.idToken) || !getString(body, header.length, offset, cached.refreshToken))
+            return false;
+        cached.expiresAt = header.expiresAt;
+        token = cached;
+        return true;
+    }
+
+    bool save(const FirebaseCredential &firebase, const AuthToken &token)
+    {
+        uint8_t buffer[TOKEN_CACHE_MAX_SIZE];
+        uint8_t *body = buffer + sizeof(TokenCacheHeader);
+        size_t length = 0;
+        if (!putString(body, length, token.idToken) || !putString(body, length, token.refreshToken))
+            return false;
+
+        TokenCacheHeader header = {TOKEN_CACHE_MAGIC, TOKEN_CACHE_VERSION, (uint16_t)length, crc32(body, length), account(firebase), token.expiresAt};
+        memcpy(buffer, &header, sizeof(header));
+
+        File file = fileSystem.open(TOKEN_CACHE_FILE, "w");
+        if (!file)
+            return false;
+        size_t written = file.write(buffer, sizeof(header) + length);
+        file.close();
+        return written == sizeof(header) + length;
+    }
+
+    void clear() { fileSystem.remove(TOKEN_CACHE_FILE); }
+};
@@ -0,0 +1,276 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FirebaseClient.h>
+#include <sys/time.h>
+
+#include <Base64.h>
+#include <BatchBuffer.h>
+#include <RetryBatches.h>
+#include <Benchmark.h>
+#include <Deadband.h>
+#include <GorillaBlock.h>
+#include <TaskTracer.h>
+#include <TelemetryRecord.h>
+
+// Firestore accepts at most 500 writes per commit
+#define FIRESTORE_MAX_BATCH 500
+
+#ifndef FIRESTORE_BATCH_CAPACITY
+#define FIRESTORE_BATCH_CAPACITY 20
+#endif
+
+struct FirestoreSample
+{
+    struct timeval time;
+    int temperature = 0;
+    int humidity = 0;
+};
+
+// Fields packed into a compressed block, in order
+#define FIRESTORE_BLOCK_FIELDS 2
+#define FIRESTORE_BLOCK_SIZE GORILLA_BLOCK_SIZE(FIRESTORE_BATCH_CAPACITY, FIRESTORE_BLOCK_FIELDS)
+
+// Commits kept until their result arrives, a failed one is sent again ahead of new samples
+#ifndef FIRESTORE_RETRY_COMMITS
+#define FIRESTORE_RETRY_COMMITS 2
+#endif
+
+// Longest document name formatted on the stack, a longer one is concatenated on the heap
+#ifndef FIRESTORE_NAME_SIZE
+#define FIRESTORE_NAME_SIZE 128
+#endif
+
+// "YYYY-MM-DDTHH:MM:SS.uuuuuuZ" with room for any year gmtime_r() returns
+#define FIRESTORE_TIMESTAMP_SIZE 40
+
+/**--------------------------------------------------------------------------------------
+ * Firestore Batch Writer Class
+ *
+ * Collects samples and writes them as separate documents in one Firestore commit
+ * request instead of one createDocument request per sample. With compression on, the
+ * batch is written as a single document holding a Gorilla block in a bytes field, and
+ * the optional deadband drops samples that did not change enough to report. Names and
+ * timestamps are formatted on the stack and the encoded block in a member buffer, so
+ * the heap only sees the copies FirebaseClient keeps.
+ * Each commit is kept until onResult() reports it, a failed commit is sent again with
+ * the same document names, so a commit that was applied but reported as failed only
+ * writes the same documents again.
+ *-------------------------------------------------------------------------------------*/
+
+class FirestoreBatchWriter
+{
+private:
+    AsyncClientClass &aClient;
+    Firestore::Documents &docs;
+    AsyncResultCallback callback;
+    TaskTracer *tracer = nullptr;
+    BatchBuffer<FirestoreSample, FIRESTORE_BATCH_CAPACITY> buffer;
+    using Commits = RetryBatches<FirestoreSample, FIRESTORE_BATCH_CAPACITY, FIRESTORE_RETRY_COMMITS>;
+    Commits commits;
+    String projectId;
+    String collectionPath;
+    String deviceId;
+    GorillaEncoder<FIRESTORE_BLOCK_FIELDS, FIRESTORE_BLOCK_SIZE> encoder;
+    DeadbandFilter<FIRESTORE_BLOCK_FIELDS> deadband;
+    char block[BASE64_ENCODED_LENGTH(FIRESTORE_BLOCK_SIZE) + 1];
+    bool compression = false;
+    bool deadbandEnabled = false;
+    uint16_t lastRequest = 0;
+    uint32_t flushCount = 0;
+    uint32_t droppedFrames = 0;
+    uint32_t encodedBytes = 0;
+    uint32_t encodedSamples = 0;
+    uint32_t longNames = 0;
+
+    static uint64_t toMillis(const struct timeval &tv) { return (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000; }
+
+    static void formatTimestamp(const struct timeval &tv, char *buf, size_t size)
+    {
+        time_t now = tv.tv_sec;
+        struct tm ts;
+        gmtime_r(&now, &ts);
+        snprintf(buf, size, "%04d-%02d-%02dT%02d:%02d:%02d.%06ldZ",
+                 ts.tm_year + 1900, ts.tm_mon + 1, ts.tm_mday,
+                 ts.tm_hour, ts.tm_min, ts.tm_sec, (long)tv.tv_usec);
+    }
+
+    // Formatted on the stack, concatenated on the heap when the paths are too long for it
+    String documentName(const struct timeval &tv, uint32_t id)
+    {
+        char name[FIRESTORE_NAME_SIZE];
+        int length = snprintf(name, sizeof(name), "%s/%s_%ld_%lu", collectionPath.c_str(), deviceId.c_str(), (long)tv.tv_sec, (unsigned long)id);
+        if (length >= 0 && (size_t)length < sizeof(name))
+            return String(name);
+        longNames++;
+        return collectionPath + "/" + deviceId + "_" + String(tv.tv_sec) + "_" + String(id);
+    }
+
+    Write createWrite(const FirestoreSample &sample, uint32_t id)
+    {
+        char timestamp[FIRESTORE_TIMESTAMP_SIZE];
+        formatTimestamp(sample.time, timestamp, sizeof(timestamp));
+
+        Document doc;
+        doc.setName(documentName(sample.time, id));
+        doc.add("timestamp", Values::Value(Values::TimestampValue(timestamp)));
+        doc.add("deviceId", Values::Value(Values::StringValue(deviceId)));
+        doc.add("temperature", Values::Value(Values::IntegerValue(sample.temperature)));
+        doc.add("humidity", Values::Value(Values::IntegerValue(sample.humidity)));
+
+        return Write(DocumentMask(), doc, Precondition());
+    }
+
+    // One document for the whole batch, the device id and field names are sent once
+    Write createBlockWrite(const Commits::Batch &commit)
+    {
+        char timestamp[FIRESTORE_TIMESTAMP_SIZE];
+        formatTimestamp(commit.items[0].time, timestamp, sizeof(timestamp));
+
+        BENCHMARK_MICROS_BEGIN(Encode);
+        encoder.clear();
+        for (size_t i = 0; i < commit.count; i++)
+        {
+            float values[FIRESTORE_BLOCK_FIELDS] = {(float)commit.items[i].temperature, (float)commit.items[i].humidity};
+            encoder.append(toMillis(commit.items[i].time), values);
+        }
+        base64Encode(encoder.bytes(), encoder.length(), block, sizeof(block));
+        BENCHMARK_MICROS_END(Encode);
+        encodedBytes += encoder.length();
+        encodedSamples += encoder.size();
+
+        Document doc;
+        doc.setName(documentName(commit.items[0].time, commit.firstId));
+        doc.add("timestamp", Values::Value(Values::TimestampValue(timestamp)));
+        doc.add("deviceId", Values::Value(Values::StringValue(deviceId)));
+        doc.add("count", Values::Value(Values::IntegerValue(encoder.size())));
+        doc.add("encoding", Values::Value(Values::StringValue("gorilla")));
+        doc.add("fields", Values::Value(Values::StringValue("temperature,humidity")));
+        doc.add("block", Values::Value(Values::BytesValue(block)));
+
+        return Write(DocumentMask(), doc, Precondition());
+    }
+
+public:
+    FirestoreBatchWriter(AsyncClientClass &aClient, Firestore::Documents &docs, AsyncResultCallback callback)
+        : aClient(aClient), docs(docs), callback(callback) {};
+
+    void begin(const String &projectId, const String &collectionPath, const String &deviceId)
+    {
+        this->projectId = projectId;
+        this->collectionPath = collectionPath;
+        this->deviceId = deviceId;
+    }
+
+    // Commit requests are submitted with a traced uid when set
+    void setTracer(TaskTracer *tracer) { this->tracer = tracer; }
+
+    // Maximum samples per commit request
+    void setMaxBatch(size_t maxBatch) { buffer.setMaxBatch(maxBatch > FIRESTORE_MAX_BATCH ? FIRESTORE_MAX_BATCH : maxBatch); }
+    // Maximum milliseconds a sample may wait before it is sent
+    void setMaxLatency(uint32_t maxLatency) { buffer.setMaxLatency(maxLatency); }
+
+    // Writes each batch as one compressed block document, see GorillaDecoder to read it back
+    void setCompression(bool compression) { this->compression = compression; }
+
+    // Drops samples within the thresholds of the last sent one, but sends at least every heartbeat milliseconds
+    void setDeadband(float temperature, float humidity, uint32_t heartbeat)
+    {
+        deadband.setThreshold(0, temperature).setThreshold(1, humidity).setHeartbeat(heartbeat);
+        deadband.reset();
+        deadbandEnabled = true;
+    }
+
+    // Commit attempts before a batch is given up, at least 1
+    void setMaxAttempts(uint8_t maxAttempts) { commits.setMaxAttempts(maxAttempts); }
+    // Milliseconds after which a commit without a result counts as failed
+    void setRequestTimeout(uint32_t timeout) { commits.setRequestTimeout(timeout); }
+
+    // Queued samples and those of failed commits waiting to be sent again
+    size_t pending() { return buffer.size() + commits.pending(); }
+    // Samples of commits waiting for their result
+    size_t inFlight() { return commits.inFlight(); }
+    size_t space() { return buffer.isFull() ? 0 : buffer.getMaxBatch() - buffer.size(); }
+    // A failed commit is ready to go again after the latency budget, so it backs off
+    // with the caller's interval
+    bool ready() { return buffer.ready() || commits.due(buffer.getMaxLatency()); }
+    uint32_t getFlushCount() { return flushCount; }
+    uint32_t getSampleCount() { return commits.getTaken(); }
+    // Commits sent again after an error or a request timeout
+    uint32_t getRetryCount() { return commits.getRetries(); }
+    // Samples of commits that succeeded
+    uint32_t getDeliveredSamples() { return commits.getDelivered(); }
+    // Samples of commits that ran out of attempts, or gave way to a newer one
+    uint32_t getFailedSamples() { return commits.getFailed(); }
+    // Frames with fewer than FIRESTORE_BLOCK_FIELDS values, see add(const TelemetryFrame &)
+    uint32_t getDroppedFrames() { return droppedFrames; }
+    // Tracer sequence of the last commit, see TaskTracer::sequenceOf()
+    uint16_t getLastRequest() { return lastRequest; }
+    uint32_t getSuppressedCount() { return deadband.getSuppressedCount(); }
+    // Average compressed size of a sample, 0 before the first compressed flush
+    float getBytesPerSample() { return encodedSamples ? (float)encodedBytes / encodedSamples : 0; }
+    // Document names longer than FIRESTORE_NAME_SIZE, each costs a few heap allocations
+    uint32_t getLongNames() { return longNames; }
+
+    // Queues a sample, flushes first if the batch is already full
+    void add(const FirestoreSample &sample)
+    {
+        float values[FIRESTORE_BLOCK_FIELDS] = {(float)sample.temperature, (float)sample.humidity};
+        if (deadbandEnabled && !deadband.filter(toMillis(sample.time), values))
+            return;
+        if (buffer.isFull())
+            flush();
+        buffer.add(sample);
+    }
+
+    // Queues a frame serialized for several sinks, values are temperature and humidity in that order
+    void add(const TelemetryFrame &frame)
+    {
+        if (frame.valueCount < FIRESTORE_BLOCK_FIELDS)
+        {
+            droppedFrames++;
+            return;
+        }
+        FirestoreSample sample;
+        sample.time = frame.time;
+        sample.temperature = lroundf(frame.values[0]);
+        sample.humidity = lroundf(frame.values[1]);
+        add(sample);
+    }
+
+    // Call from loop(), sends the batch once it is full or too old, or a failed commit again
+    void loop()
+    {
+        if (ready())
+            flush();
+    }
+
+    // Sends a failed commit again, or all queued samples in a single commit request
+    bool flush()
+    {
+        Commits::Batch *commit = commits.next(buffer, compression ? 1 : buffer.size());
+        if (!commit)
+            return false;
+
+        Writes writes(compression ? createBlockWrite(*commit) : createWrite(commit->items[0], commit->firstId));
+        for (size_t i = 1; !compression && i < commit->count; i++)
+        {
+            writes.add(createWrite(commit->items[i], commit->firstId + i));
+        }
+
+        String uid = tracer ? tracer->submit("commitTask") : String("commitTask");
+        lastRequest = TaskTracer::sequenceOf(uid.c_str());
+        docs.commit(aClient, Firestore::Parent(projectId), writes, callback, uid);
+        commits.onSubmit(*commit, lastRequest);
+        flushCount++;
+        return true;
+    }
+
+    // Call with the result of each commit, request is TaskTracer::sequenceOf() its uid.
+    // Without a tracer every request is 0 and results are matched oldest first.
+    void onResult(uint16_t request, bool error) { commits.onResult(request, error); }
+
+    // Flushes pending samples, call before restart or deep sleep and wait for the result
+    // while it returns true, the request is only queued on the client
+    bool end() { return flush(); }
+};
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <RateController.h>
+#include <TelemetryRecord.h>
+#include <Storage/SampleLog.h>
+#include "FirestoreBatchWriter.h"
+
+/**--------------------------------------------------------------------------------------
+ * Firestore Sink Class
+ *
+ * SinkFanout policy for Firestore: queues frames in a FirestoreBatchWriter and commits
+ * them at the cadence of its own RateController. While offline, or while the batch is
+ * full and a commit is in flight, samples go to the sample log and are sent from there
+ * once there is room again. A failed commit is sent again by the writer as the backoff
+ * allows. Frames without temperature and humidity, samples the log refuses and those
+ * of commits that ran out of attempts are dropped and counted.
+ *-------------------------------------------------------------------------------------*/
+
+class FirestoreSink
+{
+private:
+    FirestoreBatchWriter &writer;
+    SampleLog &log;
+    RateController rate;
+    bool online = false;
+    uint32_t dropped = 0;
+
+public:
+    FirestoreSink(FirestoreBatchWriter &writer, SampleLog &log) : writer(writer), log(log) {}
+
+    RateController &getRateController() { return rate; }
+    uint32_t getDropped() { return dropped + writer.getFailedSamples(); }
+
+    void add(const TelemetryFrame &frame)
+    {
+        if (frame.valueCount < FIRESTORE_BLOCK_FIELDS)
+        {
+            dropped++;
+            return;
+        }
+        if (online && writer.space() > 0)
+        {
+            writer.add(frame);
+            return;
+        }
+        FirestoreSample sample;
+        sample.time = frame.time;
+        sample.temperature = lroundf(frame.values[0]);
+        sample.humidity = lroundf(frame.values[1]);
+        if (!log.append(sample))
+            dropped++;
+    }
+
+    void loop(bool online)
+    {
+        this->online = online;
+        writer.setMaxBatch(rate.getBatchSize());
+        writer.setMaxLatency(rate.getInterval());
+        if (!online)
+            return;
+
+        // Forward samples stored while offline, oldest first
+        if (!log.isEmpty() && writer.space() > 0)
+        {
+            log.drainAs<FirestoreSample>([this](const FirestoreSample &sample)
+                                         {
+                                             writer.add(sample);
+                                             return true; },
+                                         writer.space());
+        }
+
+        if (writer.ready() && rate.canSend() && writer.flush())
+            rate.onSubmit(writer.getLastRequest());
+    }
+
+    // Call with the result of each commit, request is TaskTracer::sequenceOf() its uid
+    void onResult(uint16_t request, bool error)
+    {
+        rate.onComplete(request, error);
+        writer.onResult(request, error);
+    }
+};
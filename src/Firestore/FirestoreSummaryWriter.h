@@ -0,0 +1,151 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FirebaseClient.h>
+
+#include <BatchBuffer.h>
+#include <TaskTracer.h>
+#include <WindowAggregator.h>
+
+#ifndef FIRESTORE_SUMMARY_CAPACITY
+#define FIRESTORE_SUMMARY_CAPACITY 8
+#endif
+
+// Longest document name formatted on the stack, a longer one is concatenated on the heap
+#ifndef FIRESTORE_SUMMARY_NAME_SIZE
+#define FIRESTORE_SUMMARY_NAME_SIZE 128
+#endif
+
+// "YYYY-MM-DDTHH:MM:SS.mmmZ" with room for any year gmtime_r() returns
+#define FIRESTORE_SUMMARY_TIMESTAMP_SIZE 40
+
+/**--------------------------------------------------------------------------------------
+ * Firestore Summary Writer Class
+ *
+ * Writes one document per aggregation window: the window bounds, sample count and a
+ * map of min/max/mean/stddev (and p50/p95 when sketched) for every field. Summaries
+ * produced while offline or during a commit are queued and sent together.
+ *-------------------------------------------------------------------------------------*/
+
+template <uint8_t Fields>
+class FirestoreSummaryWriter
+{
+private:
+    AsyncClientClass &aClient;
+    Firestore::Documents &docs;
+    AsyncResultCallback callback;
+    TaskTracer *tracer = nullptr;
+    BatchBuffer<WindowSummary<Fields>, FIRESTORE_SUMMARY_CAPACITY> buffer;
+    const char *const *fieldNames;
+    String projectId;
+    String collectionPath;
+    String deviceId;
+    uint16_t lastRequest = 0;
+    uint32_t flushCount = 0;
+    uint32_t droppedCount = 0;
+    uint32_t longNames = 0;
+
+    static String formatTimestamp(uint64_t millis)
+    {
+        time_t seconds = millis / 1000;
+        struct tm ts;
+        gmtime_r(&seconds, &ts);
+        char buf[FIRESTORE_SUMMARY_TIMESTAMP_SIZE];
+        snprintf(buf, sizeof(buf), "%04d-%02d-%02dT%02d:%02d:%02d.%03dZ",
+                 ts.tm_year + 1900, ts.tm_mon + 1, ts.tm_mday,
+                 ts.tm_hour, ts.tm_min, ts.tm_sec, (int)(millis % 1000));
+        return String(buf);
+    }
+
+    // Formatted on the stack, concatenated on the heap when the paths are too long for it
+    String documentName(uint32_t start)
+    {
+        char name[FIRESTORE_SUMMARY_NAME_SIZE];
+        int length = snprintf(name, sizeof(name), "%s/%s_%lu", collectionPath.c_str(), deviceId.c_str(), (unsigned long)start);
+        if (length >= 0 && (size_t)length < sizeof(name))
+            return String(name);
+        longNames++;
+        return collectionPath + "/" + deviceId + "_" + String(start);
+    }
+
+    static Values::Value number(float value) { return Values::Value(Values::DoubleValue(number_t(value, 2))); }
+
+    Write createWrite(const WindowSummary<Fields> &summary)
+    {
+        Document doc;
+        doc.setName(documentName(summary.start / 1000));
+        doc.add("start", Values::Value(Values::TimestampValue(formatTimestamp(summary.start))));
+        doc.add("end", Values::Value(Values::TimestampValue(formatTimestamp(summary.end))));
+        doc.add("deviceId", Values::Value(Values::StringValue(deviceId)));
+        doc.add("count", Values::Value(Values::IntegerValue(summary.count)));
+
+        for (uint8_t i = 0; i < Fields; i++)
+        {
+            const FieldSummary &field = summary.fields[i];
+            Values::MapValue stats("min", number(field.min));
+            stats.add("max", number(field.max));
+            stats.add("mean", number(field.mean));
+            stats.add("stddev", number(field.stddev));
+            if (!isnan(field.p50))
+            {
+                stats.add("p50", number(field.p50));
+                stats.add("p95", number(field.p95));
+            }
+            doc.add(fieldNames[i], Values::Value(stats));
+        }
+
+        return Write(DocumentMask(), doc, Precondition());
+    }
+
+public:
+    FirestoreSummaryWriter(AsyncClientClass &aClient, Firestore::Documents &docs, AsyncResultCallback callback)
+        : aClient(aClient), docs(docs), callback(callback) {};
+
+    // fieldNames holds one name per field and must outlive the writer
+    void begin(const String &projectId, const String &collectionPath, const String &deviceId, const char *const *fieldNames)
+    {
+        this->projectId = projectId;
+        this->collectionPath = collectionPath;
+        this->deviceId = deviceId;
+        this->fieldNames = fieldNames;
+    }
+
+    // Commit requests are submitted with a traced uid when set
+    void setTracer(TaskTracer *tracer) { this->tracer = tracer; }
+
+    size_t pending() { return buffer.size(); }
+    bool ready() { return !buffer.isEmpty(); }
+    uint32_t getFlushCount() { return flushCount; }
+    // Tracer sequence of the last commit, see TaskTracer::sequenceOf()
+    uint16_t getLastRequest() { return lastRequest; }
+    uint32_t getDroppedCount() { return droppedCount; }
+    // Document names longer than FIRESTORE_SUMMARY_NAME_SIZE
+    uint32_t getLongNames() { return longNames; }
+
+    // Queues a summary, the newest is dropped when the queue is full
+    void add(const WindowSummary<Fields> &summary)
+    {
+        if (!buffer.add(summary))
+            droppedCount++;
+    }
+
+    // Sends all queued summaries in a single commit request
+    bool flush()
+    {
+        if (buffer.isEmpty())
+            return false;
+
+        Writes writes(createWrite(buffer[0]));
+        for (size_t i = 1; i < buffer.size(); i++)
+        {
+            writes.add(createWrite(buffer[i]));
+        }
+
+        String uid = tracer ? tracer->submit("summaryTask") : String("summaryTask");
+        lastRequest = TaskTracer::sequenceOf(uid.c_str());
+        docs.commit(aClient, Firestore::Parent(projectId), writes, callback, uid);
+        flushCount++;
+        buffer.clear();
+        return true;
+    }
+};
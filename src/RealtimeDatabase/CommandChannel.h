@@ -0,0 +1,217 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <JsonTokenizer.h>
+
+#ifndef COMMAND_CHANNEL_MAX_HANDLERS
+#define COMMAND_CHANNEL_MAX_HANDLERS 8
+#endif
+
+#ifndef COMMAND_CHANNEL_MAX_PATH
+#define COMMAND_CHANNEL_MAX_PATH 96
+#endif
+
+typedef void (*CommandHandler)(const char *path, const JsonToken &value);
+
+/**--------------------------------------------------------------------------------------
+ * Command Channel Class
+ *
+ * Consumes the put and patch events of a Realtime Database stream and calls a handler
+ * for every value whose path is registered. The event data is walked with the pull
+ * tokenizer in place, so no JsonDocument is built. Paths are relative to the stream
+ * root, e.g. "/config/maxInterval", array elements are addressed by index.
+ *-------------------------------------------------------------------------------------*/
+
+class CommandChannel
+{
+private:
+    struct Route
+    {
+        const char *path;
+        CommandHandler handler;
+    };
+
+    Route routes[COMMAND_CHANNEL_MAX_HANDLERS];
+    uint8_t routeCount = 0;
+    uint32_t eventCount = 0;
+    uint32_t commandCount = 0;
+    uint32_t errorCount = 0;
+
+    void dispatch(const char *path, const JsonToken &value)
+    {
+        for (uint8_t i = 0; i < routeCount; i++)
+        {
+            if (strcmp(routes[i].path, path) == 0)
+            {
+                commandCount++;
+                routes[i].handler(path, value);
+            }
+        }
+    }
+
+    static bool append(char *path, size_t &length, const char *text, size_t size)
+    {
+        if (length + 1 + size >= COMMAND_CHANNEL_MAX_PATH)
+            return false;
+        path[length++] = '/';
+        memcpy(path + length, text, size);
+        length += size;
+        path[length] = '\0';
+        return true;
+    }
+
+    // Walks one value from the current tokenizer position, path holds pathLength
+    // characters of its location. Returns false if the value is not valid JSON.
+    bool walk(JsonTokenizer &tokenizer, char *path, size_t pathLength)
+    {
+        // Path length and next array index of each open container
+        size_t base[JSON_TOKENIZER_MAX_DEPTH + 1];
+        uint16_t index[JSON_TOKENIZER_MAX_DEPTH + 1];
+        uint8_t start = tokenizer.getDepth();
+        base[start] = pathLength;
+
+        while (true)
+        {
+            uint8_t depth = tokenizer.getDepth();
+            bool inArray = depth > start && !tokenizer.inObject();
+            JsonToken token = tokenizer.next();
+
+            // Array elements are named by index like RTDB does
+            if (inArray && (token.isValue() || token.type == JSON_OBJECT_BEGIN || token.type == JSON_ARRAY_BEGIN))
+            {
+                char number[6];
+                pathLength = base[depth];
+                path[pathLength] = '\0';
+                append(path, pathLength, number, snprintf(number, sizeof(number), "%u", index[depth]++));
+            }
+
+            switch (token.type)
+            {
+            case JSON_OBJECT_BEGIN:
+            case JSON_ARRAY_BEGIN:
+                base[depth + 1] = pathLength;
+                index[depth + 1] = 0;
+                break;
+            case JSON_KEY:
+                pathLength = base[depth];
+                if (!append(path, pathLength, token.text, token.length))
+                    return false;
+                break;
+            case JSON_OBJECT_END:
+            case JSON_ARRAY_END:
+                break;
+            case JSON_END:
+            case JSON_INCOMPLETE:
+            case JSON_ERROR:
+                return false;
+            default:
+                dispatch(pathLength ? path : "/", token);
+                break;
+            }
+            if (tokenizer.getDepth() == start && token.type != JSON_KEY)
+                return true;
+        }
+    }
+
+    // Copies a stream path, the root "/" becomes ""
+    static bool setPath(char *path, size_t &pathLength, const char *text, size_t length)
+    {
+        if (length >= COMMAND_CHANNEL_MAX_PATH)
+            return false;
+        memcpy(path, text, length);
+        pathLength = length;
+        if (pathLength && path[pathLength - 1] == '/')
+            pathLength--;
+        path[pathLength] = '\0';
+        return true;
+    }
+
+    bool error()
+    {
+        errorCount++;
+        return false;
+    }
+
+public:
+    // path must outlive the channel, a string literal is expected
+    bool on(const char *path, CommandHandler handler)
+    {
+        if (routeCount >= COMMAND_CHANNEL_MAX_HANDLERS)
+            return false;
+        routes[routeCount++] = {path, handler};
+        return true;
+    }
+
+    // Walks the data of one stream event written at dataPath, returns false if it is not valid JSON
+    bool handle(const char *dataPath, const char *data, size_t length)
+    {
+        eventCount++;
+        char path[COMMAND_CHANNEL_MAX_PATH];
+        size_t pathLength;
+        if (!setPath(path, pathLength, dataPath, strlen(dataPath)))
+            return error();
+
+        JsonTokenizer tokenizer;
+        tokenizer.feed(data, length);
+        if (!walk(tokenizer, path, pathLength) || tokenizer.next().type != JSON_END)
+            return error();
+        return true;
+    }
+
+    // Walks a raw server-sent event as aResult.c_str() holds it, in place:
+    // "event: put\ndata: {"path":...,"data":...}". Only put and patch events carry data,
+    // others are ignored and return true. Handlers run as values are read, an error
+    // later in the event is reported after them.
+    bool handleEvent(const char *payload)
+    {
+        const char *end = payload + strlen(payload);
+        const char *event = strstr(payload, "event: ");
+        const char *line = strstr(payload, "data: ");
+        if (!event || !line)
+            return error();
+        event += 7;
+        if (strncmp(event, "put", 3) != 0 && strncmp(event, "patch", 5) != 0)
+            return true;
+        eventCount++;
+        line += 6;
+        const char *lineEnd = (const char *)memchr(line, '\n', end - line);
+
+        // The envelope is an object with the path first, then the data value
+        char path[COMMAND_CHANNEL_MAX_PATH];
+        size_t pathLength = 0;
+        bool hasPath = false;
+        JsonTokenizer tokenizer;
+        tokenizer.feed(line, (lineEnd ? lineEnd : end) - line);
+        if (tokenizer.next().type != JSON_OBJECT_BEGIN)
+            return error();
+        while (true)
+        {
+            JsonToken token = tokenizer.next();
+            if (token.type == JSON_OBJECT_END)
+                return tokenizer.next().type == JSON_END ? true : error();
+            if (token.type != JSON_KEY)
+                return error();
+            if (token.equals("path"))
+            {
+                JsonToken value = tokenizer.next();
+                if (value.type != JSON_STRING || value.escaped || !setPath(path, pathLength, value.text, value.length))
+                    return error();
+                hasPath = true;
+            }
+            else if (token.equals("data") && hasPath)
+            {
+                if (!walk(tokenizer, path, pathLength))
+                    return error();
+            }
+            else
+            {
+                return error();
+            }
+        }
+    }
+
+    uint32_t getEventCount() { return eventCount; }
+    uint32_t getCommandCount() { return commandCount; }
+    uint32_t getErrorCount() { return errorCount; }
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <Arduino.h>
+#include <sys/time.h>
+
+#define PUSH_ID_LENGTH 20
+
+/**--------------------------------------------------------------------------------------
+ * Push Id Generator Class
+ *
+ * Generates Firebase style push keys on the device. The first 8 characters encode the
+ * timestamp in milliseconds so keys sort chronologically, the last 12 are random and
+ * incremented when several keys are created in the same millisecond.
+ *-------------------------------------------------------------------------------------*/
+
+class PushIdGenerator
+{
+private:
+    static constexpr const char *PUSH_CHARS = "-0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ_abcdefghijklmnopqrstuvwxyz";
+
+    uint64_t lastTime = 0;
+    uint8_t lastRandom[12];
+
+public:
+    // Epoch time in milliseconds, requires the clock to be set by NTP
+    static uint64_t now()
+    {
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        return (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+    }
+
+    // Writes a null terminated key into buf, buf must hold PUSH_ID_LENGTH + 1 chars
+    void generate(char *buf) { generate(buf, now()); }
+
+    void generate(char *buf, uint64_t timeMs)
+    {
+        bool duplicateTime = timeMs == lastTime;
+        lastTime = timeMs;
+
+        for (int i = 7; i >= 0; i--)
+        {
+            buf[i] = PUSH_CHARS[timeMs % 64];
+            timeMs /= 64;
+        }
+
+        if (!duplicateTime)
+        {
+            for (int i = 0; i < 12; i++)
+            {
+                lastRandom[i] = random(64);
+            }
+        }
+        else
+        {
+            // Same millisecond, increment the random part so keys stay ordered
+            int i = 11;
+            for (; i >= 0 && lastRandom[i] == 63; i--)
+            {
+                lastRandom[i] = 0;
+            }
+            if (i >= 0)
+                lastRandom[i]++;
+        }
+
+        for (int i = 0; i < 12; i++)
+        {
+            buf[8 + i] = PUSH_CHARS[lastRandom[i]];
+        }
+        buf[PUSH_ID_LENGTH] = '\0';
+    }
+};
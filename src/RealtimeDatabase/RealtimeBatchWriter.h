@@ -0,0 +1,182 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FirebaseClient.h>
+
+#include <BatchBuffer.h>
+#include <RetryBatches.h>
+#include <TaskTracer.h>
+#include <TelemetryRecord.h>
+#include "PushIdGenerator.h"
+
+#ifndef REALTIME_BATCH_CAPACITY
+#define REALTIME_BATCH_CAPACITY 20
+#endif
+
+// Updates kept until their result arrives, a failed one is sent again ahead of new samples
+#ifndef REALTIME_RETRY_UPDATES
+#define REALTIME_RETRY_UPDATES 2
+#endif
+
+// Serialized size of one sample including its push key
+#define REALTIME_SAMPLE_JSON_SIZE (PUSH_ID_LENGTH + 4 + TELEMETRY_FRAME_JSON_SIZE)
+
+struct RealtimeSample
+{
+    uint32_t timestamp = 0;
+    float temperature = 0;
+    float humidity = 0;
+
+    TELEMETRY_SCHEMA(telemetryField("timestamp", &RealtimeSample::timestamp),
+                     telemetryField("temperature", &RealtimeSample::temperature),
+                     telemetryField("humidity", &RealtimeSample::humidity))
+};
+
+static_assert(sizeof(TelemetryFrame::key) > PUSH_ID_LENGTH, "Frame key must hold a push id");
+
+/**--------------------------------------------------------------------------------------
+ * Realtime Batch Writer Class
+ *
+ * Collects samples under client generated push keys and writes them with one
+ * multi-location update (PATCH) instead of one push request per sample. Samples are
+ * kept as frames, already serialized when they are added. Each update is kept until
+ * onResult() reports it, a failed update is sent again under the same push keys, so an
+ * update that was applied but reported as failed only writes the same children again.
+ *-------------------------------------------------------------------------------------*/
+
+class RealtimeBatchWriter
+{
+private:
+    AsyncClientClass &aClient;
+    RealtimeDatabase &database;
+    AsyncResultCallback callback;
+    TaskTracer *tracer = nullptr;
+    BatchBuffer<TelemetryFrame, REALTIME_BATCH_CAPACITY> buffer;
+    using Updates = RetryBatches<TelemetryFrame, REALTIME_BATCH_CAPACITY, REALTIME_RETRY_UPDATES>;
+    Updates updates;
+    PushIdGenerator pushIds;
+    String path;
+    const char *operation = "updateTask";
+    char payload[REALTIME_BATCH_CAPACITY * REALTIME_SAMPLE_JSON_SIZE + 2];
+    uint16_t lastRequest = 0;
+    uint32_t flushCount = 0;
+    uint32_t droppedFrames = 0;
+
+public:
+    RealtimeBatchWriter(AsyncClientClass &aClient, RealtimeDatabase &database, AsyncResultCallback callback)
+        : aClient(aClient), database(database), callback(callback) {};
+
+    // Parent node the samples are written under
+    void begin(const String &path) { this->path = path; }
+
+    // Task name of the update requests, a second writer on the same client needs its own
+    void setOperation(const char *operation) { this->operation = operation; }
+
+    // Update requests are submitted with a traced uid when set
+    void setTracer(TaskTracer *tracer) { this->tracer = tracer; }
+
+    // Maximum samples per update request
+    void setMaxBatch(size_t maxBatch) { buffer.setMaxBatch(maxBatch); }
+    // Maximum milliseconds a sample may wait before it is sent
+    void setMaxLatency(uint32_t maxLatency) { buffer.setMaxLatency(maxLatency); }
+
+    // Update attempts before a batch is given up, at least 1
+    void setMaxAttempts(uint8_t maxAttempts) { updates.setMaxAttempts(maxAttempts); }
+    // Milliseconds after which an update without a result counts as failed
+    void setRequestTimeout(uint32_t timeout) { updates.setRequestTimeout(timeout); }
+
+    // Queued samples and those of failed updates waiting to be sent again
+    size_t pending() { return buffer.size() + updates.pending(); }
+    // Samples of updates waiting for their result
+    size_t inFlight() { return updates.inFlight(); }
+    size_t space() { return buffer.isFull() ? 0 : buffer.getMaxBatch() - buffer.size(); }
+    // A failed update is ready to go again after the latency budget, so it backs off
+    // with the caller's interval
+    bool ready() { return buffer.ready() || updates.due(buffer.getMaxLatency()); }
+    // Milliseconds the oldest queued sample has waited, 0 when empty
+    uint32_t getAge() { return buffer.getAge(); }
+    uint32_t getFlushCount() { return flushCount; }
+    // Tracer sequence of the last update, see TaskTracer::sequenceOf()
+    uint16_t getLastRequest() { return lastRequest; }
+    uint32_t getSampleCount() { return updates.getTaken(); }
+    // Updates sent again after an error or a request timeout
+    uint32_t getRetryCount() { return updates.getRetries(); }
+    // Samples of updates that succeeded
+    uint32_t getDeliveredSamples() { return updates.getDelivered(); }
+    // Samples of updates that ran out of attempts, gave way to a newer one or didn't fit the payload
+    uint32_t getFailedSamples() { return updates.getFailed(); }
+    // Samples that could not be serialized into a frame
+    uint32_t getDroppedFrames() { return droppedFrames; }
+
+    // Queues a sample under a new time ordered key, flushes first if the batch is full
+    void add(uint32_t timestamp, float temperature, float humidity)
+    {
+        RealtimeSample sample;
+        sample.timestamp = timestamp;
+        sample.temperature = temperature;
+        sample.humidity = humidity;
+
+        TelemetryFrame frame;
+        if (!TelemetrySerializer::toFrame(sample, frame))
+        {
+            droppedFrames++;
+            return;
+        }
+        pushIds.generate(frame.key);
+        add(frame);
+    }
+
+    // Queues a frame serialized elsewhere under its own key, flushes first if the batch is full
+    void add(const TelemetryFrame &frame)
+    {
+        if (buffer.isFull())
+            flush();
+        buffer.add(frame);
+    }
+
+    // Call from loop(), sends the batch once it is full or too old, or a failed update again
+    void loop()
+    {
+        if (ready())
+            flush();
+    }
+
+    // Sends a failed update again, or all queued samples as child paths of a single update request
+    bool flush()
+    {
+        Updates::Batch *update = updates.next(buffer, 1);
+        if (!update)
+            return false;
+
+        JsonBufferWriter writer(payload, sizeof(payload));
+        writer.put('{');
+        for (size_t i = 0; i < update->count; i++)
+        {
+            if (i)
+                writer.put(',');
+            writer.putKey(update->items[i].key);
+            writer.put(update->items[i].json);
+        }
+        writer.put('}');
+        if (!writer.finish())
+        {
+            updates.discard(*update); // can't happen with the sizes above, drop rather than retry forever
+            return false;
+        }
+
+        String uid = tracer ? tracer->submit(operation) : String(operation);
+        lastRequest = TaskTracer::sequenceOf(uid.c_str());
+        database.update<object_t>(aClient, path, object_t(payload), callback, uid);
+        updates.onSubmit(*update, lastRequest);
+        flushCount++;
+        return true;
+    }
+
+    // Call with the result of each update, request is TaskTracer::sequenceOf() its uid.
+    // Without a tracer every request is 0 and results are matched oldest first.
+    void onResult(uint16_t request, bool error) { updates.onResult(request, error); }
+
+    // Flushes pending samples, call before restart or deep sleep and wait for the result
+    // while it returns true, the request is only queued on the client
+    bool end() { return flush(); }
+};
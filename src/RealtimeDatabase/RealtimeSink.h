@@ -0,0 +1,56 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <RateController.h>
+#include <TelemetryRecord.h>
+#include "RealtimeBatchWriter.h"
+
+/**--------------------------------------------------------------------------------------
+ * Realtime Sink Class
+ *
+ * SinkFanout policy for the Realtime Database: queues frames in a RealtimeBatchWriter
+ * and sends them at the cadence of its own RateController. A failed update is sent
+ * again by the writer as the backoff allows. Frames that arrive while the batch is full
+ * and an update is in flight are dropped and counted, like those that can't be sent.
+ *-------------------------------------------------------------------------------------*/
+
+class RealtimeSink
+{
+private:
+    RealtimeBatchWriter &writer;
+    RateController rate;
+    uint32_t dropped = 0;
+
+public:
+    RealtimeSink(RealtimeBatchWriter &writer) : writer(writer) {}
+
+    RateController &getRateController() { return rate; }
+    // Frames refused while the batch was full, and samples whose update ran out of attempts
+    uint32_t getDropped() { return dropped + writer.getFailedSamples(); }
+
+    void add(const TelemetryFrame &frame)
+    {
+        if (writer.space() == 0)
+        {
+            dropped++;
+            return;
+        }
+        writer.add(frame);
+    }
+
+    void loop(bool online)
+    {
+        writer.setMaxBatch(rate.getBatchSize());
+        writer.setMaxLatency(rate.getInterval());
+        if (online && writer.ready() && rate.canSend() && writer.flush())
+            rate.onSubmit(writer.getLastRequest());
+    }
+
+    // Call with the result of each update, request is TaskTracer::sequenceOf() its uid
+    void onResult(uint16_t request, bool error)
+    {
+        rate.onComplete(request, error);
+        writer.onResult(request, error);
+    }
+};
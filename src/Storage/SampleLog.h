@@ -0,0 +1,361 @@
+#pragma once
+
+#include <Arduino.h>
+#include <FS.h>
+
+#include <Crc32.h>
+
+#define SAMPLE_LOG_DIR "/queue"
+#define SAMPLE_LOG_CURSOR SAMPLE_LOG_DIR "/cursor"
+#define SAMPLE_LOG_MAGIC 0x5A4C
+
+#ifndef SAMPLE_LOG_SEGMENT_SIZE
+#define SAMPLE_LOG_SEGMENT_SIZE 16384
+#endif
+
+#ifndef SAMPLE_LOG_MAX_SEGMENTS
+#define SAMPLE_LOG_MAX_SEGMENTS 16
+#endif
+
+#ifndef SAMPLE_LOG_BUFFER_SIZE
+#define SAMPLE_LOG_BUFFER_SIZE 512
+#endif
+
+#ifndef SAMPLE_LOG_MAX_RECORD
+#define SAMPLE_LOG_MAX_RECORD 256
+#endif
+
+struct SampleLogHeader
+{
+    uint16_t magic;
+    uint16_t length;
+    uint32_t crc;
+};
+
+// Drain position in the first segment, kept across reboots
+struct SampleLogCursor
+{
+    uint32_t segment;
+    uint32_t offset;
+    uint32_t crc; // CRC-32 of segment and offset
+};
+
+/**--------------------------------------------------------------------------------------
+ * Sample Log Class
+ *
+ * Append only store-and-forward queue split into fixed size segment files. Records are
+ * buffered in RAM and written in blocks to limit flash wear, each record carries a
+ * CRC so torn writes after a power loss are skipped. When the log is full the oldest
+ * segment is evicted. Segments are deleted once they are fully drained. Every boot
+ * appends to a new segment, so records written after a reboot never follow a torn
+ * tail, and the drain position is saved so drained records are not sent again.
+ *-------------------------------------------------------------------------------------*/
+
+class SampleLog
+{
+private:
+    fs::FS &fileSystem;
+    uint32_t firstSegment = 0;
+    uint32_t lastSegment = 0;
+    uint32_t segmentSize = 0; // bytes in the last segment, including the write buffer
+    uint32_t readOffset = 0;  // bytes already drained from the first segment
+    uint32_t lastSync = 0;
+    uint32_t syncInterval = 5000;
+    File writeFile;
+
+    uint8_t writeBuffer[SAMPLE_LOG_BUFFER_SIZE];
+    size_t writeLength = 0;
+
+    uint32_t recordCount = 0;
+    uint32_t evictedSegments = 0;
+    uint32_t corruptRecords = 0;
+
+    static String segmentPath(uint32_t segment)
+    {
+        char path[32];
+        snprintf(path, sizeof(path), SAMPLE_LOG_DIR "/%08lu.log", (unsigned long)segment);
+        return String(path);
+    }
+
+    static bool isSegment(const String &name) { return name.endsWith(".log"); }
+
+    bool openWriteFile()
+    {
+        writeFile = fileSystem.open(segmentPath(lastSegment), "a");
+        return (bool)writeFile;
+    }
+
+    // Seals the last segment and starts a new one, evicting the oldest if the log is full
+    void rotate()
+    {
+        sync();
+        writeFile.close();
+        lastSegment++;
+        segmentSize = 0;
+
+        if (lastSegment - firstSegment >= SAMPLE_LOG_MAX_SEGMENTS)
+        {
+            fileSystem.remove(segmentPath(firstSegment));
+            firstSegment++;
+            readOffset = 0;
+            evictedSegments++;
+        }
+        openWriteFile();
+    }
+
+    // Removes the drained first segment, or resets the last one when it is the only segment
+    void releaseFirstSegment()
+    {
+        if (firstSegment == lastSegment)
+        {
+            writeFile.close();
+            fileSystem.remove(segmentPath(firstSegment));
+            firstSegment = ++lastSegment;
+            segmentSize = 0;
+            openWriteFile();
+        }
+        else
+        {
+            fileSystem.remove(segmentPath(firstSegment));
+            firstSegment++;
+        }
+        readOffset = 0;
+        fileSystem.remove(SAMPLE_LOG_CURSOR);
+    }
+
+    // Written once per drain call, not per record, to limit flash wear
+    void saveCursor()
+    {
+        SampleLogCursor cursor = {firstSegment, readOffset, 0};
+        cursor.crc = crc32(&cursor, offsetof(SampleLogCursor, crc));
+        File file = fileSystem.open(SAMPLE_LOG_CURSOR, "w");
+        if (file)
+        {
+            file.write((const uint8_t *)&cursor, sizeof(cursor));
+            file.close();
+        }
+    }
+
+    // Drained bytes of the first segment saved before the reboot, 0 if the cursor is for another segment
+    uint32_t loadCursor()
+    {
+        SampleLogCursor cursor;
+        File file = fileSystem.open(SAMPLE_LOG_CURSOR, "r");
+        if (!file)
+            return 0;
+        bool ok = file.read((uint8_t *)&cursor, sizeof(cursor)) == sizeof(cursor);
+        size_t size = 0;
+        file.close();
+        if (!ok || cursor.crc != crc32(&cursor, offsetof(SampleLogCursor, crc)) || cursor.segment != firstSegment)
+            return 0;
+        file = fileSystem.open(segmentPath(firstSegment), "r");
+        if (file)
+        {
+            size = file.size();
+            file.close();
+        }
+        return cursor.offset <= size ? cursor.offset : 0;
+    }
+
+public:
+    SampleLog(fs::FS &fileSystem) : fileSystem(fileSystem) {};
+
+    // Scans existing segments so samples stored before a reboot are kept. Appends go to a
+    // new segment, the last one may end in a record torn by the reset.
+    bool begin()
+    {
+        if (!fileSystem.exists(SAMPLE_LOG_DIR))
+            fileSystem.mkdir(SAMPLE_LOG_DIR);
+
+        bool found = false;
+        File dir = fileSystem.open(SAMPLE_LOG_DIR);
+        if (dir)
+        {
+            File file = dir.openNextFile();
+            while (file)
+            {
+                String name = file.name();
+                if (isSegment(name))
+                {
+                    int slash = name.lastIndexOf('/');
+                    uint32_t segment = strtoul(name.c_str() + slash + 1, NULL, 10);
+                    if (!found || segment < firstSegment)
+                        firstSegment = segment;
+                    if (!found || segment > lastSegment)
+                    {
+                        lastSegment = segment;
+                        segmentSize = file.size();
+                    }
+                    found = true;
+                }
+                file = dir.openNextFile();
+            }
+            dir.close();
+        }
+
+        readOffset = 0;
+        if (!found)
+        {
+            firstSegment = lastSegment = 0;
+            fileSystem.remove(SAMPLE_LOG_CURSOR);
+        }
+        else
+        {
+            readOffset = loadCursor();
+            if (segmentSize)
+                lastSegment++; // an empty last segment can't be torn, keep appending to it
+            while (lastSegment - firstSegment >= SAMPLE_LOG_MAX_SEGMENTS)
+            {
+                fileSystem.remove(segmentPath(firstSegment));
+                firstSegment++;
+                readOffset = 0;
+                evictedSegments++;
+            }
+        }
+        segmentSize = 0;
+        lastSync = millis();
+        return openWriteFile();
+    }
+
+    // Maximum milliseconds buffered records may stay in RAM before they are written to flash
+    void setSyncInterval(uint32_t syncInterval) { this->syncInterval = syncInterval; }
+
+    uint32_t getRecordCount() { return recordCount; }
+    uint32_t getEvictedSegments() { return evictedSegments; }
+    uint32_t getCorruptRecords() { return corruptRecords; }
+    uint32_t getSegmentCount() { return lastSegment - firstSegment + 1; }
+    bool isEmpty() { return firstSegment == lastSegment && segmentSize <= readOffset; }
+
+    bool append(const void *data, uint16_t length)
+    {
+        if (length == 0 || length > SAMPLE_LOG_MAX_RECORD)
+            return false;
+
+        size_t recordSize = sizeof(SampleLogHeader) + length;
+        if (segmentSize + recordSize > SAMPLE_LOG_SEGMENT_SIZE)
+            rotate();
+        if (writeLength + recordSize > SAMPLE_LOG_BUFFER_SIZE)
+            sync();
+
+        SampleLogHeader header = {SAMPLE_LOG_MAGIC, length, crc32(data, length)};
+        memcpy(writeBuffer + writeLength, &header, sizeof(header));
+        memcpy(writeBuffer + writeLength + sizeof(header), data, length);
+        writeLength += recordSize;
+        segmentSize += recordSize;
+        recordCount++;
+
+        if (millis() - lastSync >= syncInterval)
+            sync();
+        return true;
+    }
+
+    template <typename T>
+    bool append(const T &record) { return append(&record, sizeof(T)); }
+
+    // Writes buffered records to flash
+    bool sync()
+    {
+        lastSync = millis();
+        if (writeLength == 0)
+            return true;
+
+        bool ok = writeFile && writeFile.write(writeBuffer, writeLength) == writeLength;
+        writeFile.flush();
+        writeLength = 0;
+        return ok;
+    }
+
+    // Reads the oldest records and passes them to handler(const uint8_t *data, uint16_t length).
+    // The handler returns false to stop, that record stays in the log. Returns records drained.
+    template <typename Handler>
+    size_t drain(Handler handler, size_t maxRecords)
+    {
+        uint8_t record[SAMPLE_LOG_MAX_RECORD];
+        size_t drained = 0;
+        uint32_t startSegment = firstSegment;
+        uint32_t startOffset = readOffset;
+
+        sync();
+        while (drained < maxRecords && !isEmpty())
+        {
+            File file = fileSystem.open(segmentPath(firstSegment), "r");
+            size_t fileSize = file ? file.size() : 0;
+            if (file)
+                file.seek(readOffset);
+
+            bool stopped = false;
+            while (drained < maxRecords && readOffset + sizeof(SampleLogHeader) <= fileSize)
+            {
+                SampleLogHeader header;
+                file.read((uint8_t *)&header, sizeof(header));
+                if (header.magic != SAMPLE_LOG_MAGIC || header.length > SAMPLE_LOG_MAX_RECORD ||
+                    readOffset + sizeof(header) + header.length > fileSize ||
+                    file.read(record, header.length) != header.length ||
+                    crc32(record, header.length) != header.crc)
+                {
+                    // Torn or corrupt record, the rest of the segment can't be trusted
+                    corruptRecords++;
+                    readOffset = fileSize;
+                    break;
+                }
+
+                if (!handler((const uint8_t *)record, header.length))
+                {
+                    stopped = true;
+                    break;
+                }
+                readOffset += sizeof(header) + header.length;
+                drained++;
+            }
+            file.close();
+
+            if (stopped)
+                break;
+            bool consumed = firstSegment != lastSegment ? readOffset + sizeof(SampleLogHeader) > fileSize : readOffset >= segmentSize;
+            if (consumed)
+                releaseFirstSegment();
+            else if (drained < maxRecords)
+                break;
+        }
+
+        if (readOffset && (firstSegment != startSegment || readOffset != startOffset))
+            saveCursor();
+        return drained;
+    }
+
+    template <typename T, typename Handler>
+    size_t drainAs(Handler handler, size_t maxRecords)
+    {
+        return drain([&](const uint8_t *data, uint16_t length)
+                     {
+                         if (length != sizeof(T))
+                             return true; // skip records of another type
+                         T value;
+                         memcpy(&value, data, sizeof(T));
+                         return handler(value); },
+                     maxRecords);
+    }
+
+    // Deletes every stored record
+    void clear()
+    {
+        writeLength = 0;
+        writeFile.close();
+        for (uint32_t segment = firstSegment; segment <= lastSegment; segment++)
+        {
+            fileSystem.remove(segmentPath(segment));
+        }
+        firstSegment = ++lastSegment;
+        segmentSize = 0;
+        readOffset = 0;
+        fileSystem.remove(SAMPLE_LOG_CURSOR);
+        openWriteFile();
+    }
+
+    // Writes buffered records, call before restart or deep sleep
+    void end()
+    {
+        sync();
+        writeFile.close();
+    }
+};
@@ -1,5 +1,7 @@
 #define FIRESTORE 1
 #define REALTIME 2
+#define FANOUT 3 // both from one backend-neutral frame per sample
+#define DUTY_CYCLE 4 // Firestore from deep sleep, battery nodes
 
 #define DB_TYPE FIRESTORE
 
@@ -7,6 +9,10 @@
 #include "main_firestore.h"
 #elif DB_TYPE == REALTIME
 #include "main_realtime.h"
+#elif DB_TYPE == FANOUT
+#include "main_fanout.h"
+#elif DB_TYPE == DUTY_CYCLE
+#include "main_duty_cycle.h"
 #else
 #include <Arduino.h>
 void setup() {}
@@ -0,0 +1,340 @@
+/**
+ * ABOUT:
+ *
+ * The deep sleep (duty cycle) example for battery nodes, writing Firestore documents.
+ *
+ * Every wake takes one sample, appends it to a ring in RTC memory and goes back to deep
+ * sleep with the radio off. Only every DUTY_CYCLE_UPLOAD_EVERY wakes, or when the ring is
+ * full, Wi-Fi and Firebase come up and the whole ring is written in one commit request.
+ * The cached access point and auth token keep those upload wakes short.
+ *
+ * The complete usage guidelines, please read README.md or visit https://github.com/mobizt/FirebaseClient
+ */
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <WiFi.h>
+#include <WiFiClientSecure.h>
+#include <FirebaseClient.h>
+#include <esp_sleep.h>
+#include <sys/time.h>
+
+#include <AsyncDispatcher.h>
+#include <BootSequencer.h>
+#include <DutyCycle.h>
+#include <EspRadio.h>
+#include <TracedClient.h>
+#include <WifiLink.h>
+
+// Wake period, one sample per wake
+#ifndef DUTY_CYCLE_PERIOD_MS
+#define DUTY_CYCLE_PERIOD_MS 10000
+#endif
+
+// Wakes between uploads, the ring holds a few more in case an upload fails
+#ifndef DUTY_CYCLE_UPLOAD_EVERY
+#define DUTY_CYCLE_UPLOAD_EVERY 30
+#endif
+#define DUTY_CYCLE_BUFFER_SIZE 32
+
+// Longest an upload wake keeps the radio on waiting for the commit result
+#define DUTY_CYCLE_UPLOAD_TIMEOUT_MS 30000
+
+// Longest an upload wake waits for Wi-Fi, the samples stay in the ring for the next one
+#ifndef WIFI_BOOT_TIMEOUT_MS
+#define WIFI_BOOT_TIMEOUT_MS 15000
+#endif
+
+// The whole ring goes out in one commit
+#define FIRESTORE_BATCH_CAPACITY DUTY_CYCLE_BUFFER_SIZE
+
+#include <CredentialsManager/CredentialsManager.h>
+#include <CredentialsManager/AuthSession.h>
+#include <Firestore/FirestoreBatchWriter.h>
+
+static const char *WIFI_SSID;
+static const char *WIFI_PASSWORD;
+
+static const char *API_KEY;
+static const char *USER_EMAIL;
+static const char *USER_PASSWORD;
+static const char *FIREBASE_PROJECT_ID;
+
+DefaultNetwork network(false); // reconnection is left to wifiLink
+
+FirebaseApp app;
+TracedClient<WiFiClientSecure> sslClient; // counts TLS handshakes
+EspRadio radio;
+WifiLink<EspRadio> wifiLink(radio, LittleFS); // fast reconnect to the last access point
+
+using AsyncClient = AsyncClientClass;
+
+// Async results are routed by operation, each operation passes its own callback
+enum AsyncOperation : uint8_t
+{
+    OPERATION_AUTH,
+    OPERATION_COMMIT,
+    OPERATION_COUNT
+};
+using Dispatcher = AsyncDispatcher<AsyncResult, OPERATION_COUNT>;
+AsyncClient aClient(sslClient, getNetwork(network));
+Firestore::Documents Docs;
+FirestoreBatchWriter batchWriter(aClient, Docs, Dispatcher::callback<OPERATION_COMMIT>);
+BootSequencer<8> boot;
+uint8_t ntpPhase = 0xFF; // not added when the RTC kept the time
+
+// Kept in RTC slow memory across deep sleep, lost on power-on
+RTC_DATA_ATTR DutyCycleState<FirestoreSample, DUTY_CYCLE_BUFFER_SIZE> dutyState;
+DutyCycle<FirestoreSample, DUTY_CYCLE_BUFFER_SIZE> dutyCycle(dutyState);
+
+FirebaseCredential firebaseCredential;
+WifiCredential wifiCredential;
+AuthSession authSession(aClient, app, LittleFS, Dispatcher::callback<OPERATION_AUTH>);
+
+uint32_t radioStartMillis = 0; // 0 while the radio is off
+size_t uploadCount = 0;        // samples in the commit in flight
+bool uploadDone = false;
+bool uploadOk = false;
+
+void onCommitResult(uint8_t operation, AsyncResult &aResult);
+void onAuthResult(uint8_t operation, AsyncResult &aResult);
+void onOtherResult(uint8_t operation, AsyncResult &aResult);
+void printResult(AsyncResult &aResult);
+void takeSample();
+void upload();
+void goToSleep();
+void saveToken();
+BootStatus mountFileSystem();
+BootStatus loadConfig();
+BootStatus startRadio();
+BootStatus connectWifi();
+BootStatus wifiConnected();
+BootStatus startApp();
+BootStatus appReady();
+BootStatus startTimeSync();
+BootStatus timeSynced();
+
+void setup()
+{
+    Serial.begin(115200);
+
+    dutyCycle.begin();
+    dutyCycle.setUploadEvery(DUTY_CYCLE_UPLOAD_EVERY);
+
+    // The RTC keeps the time during deep sleep, only the first wake after power-on
+    // has to go online for NTP before the sample can be stamped
+    bool clockSet = time(nullptr) >= FIREBASE_DEFAULT_TS;
+    if (clockSet)
+    {
+        takeSample();
+        if (!dutyCycle.shouldUpload())
+            goToSleep();
+    }
+
+    uint8_t fileSystemPhase = boot.add("littlefs", mountFileSystem);
+    uint8_t radioPhase = boot.add("radio", startRadio);
+    uint8_t configPhase = boot.add("config", loadConfig, nullptr, BOOT_AFTER(fileSystemPhase));
+    uint8_t wifiPhase = boot.add("wifi", connectWifi, wifiConnected, BOOT_AFTER(radioPhase) | BOOT_AFTER(configPhase), WIFI_BOOT_TIMEOUT_MS);
+    if (!clockSet)
+        ntpPhase = boot.add("ntp", startTimeSync, timeSynced, BOOT_AFTER(wifiPhase), 10000);
+    boot.add("auth", startApp, appReady, BOOT_AFTER(wifiPhase), 15000);
+    boot.run();
+
+    if (!clockSet && time(nullptr) >= FIREBASE_DEFAULT_TS)
+        takeSample();
+    upload();
+}
+
+// Only upload wakes get here, the radio stays on until the commit result or the timeout
+void loop()
+{
+    app.loop();
+    Docs.loop();
+
+    if (uploadDone || millis() - radioStartMillis >= DUTY_CYCLE_UPLOAD_TIMEOUT_MS)
+        goToSleep();
+}
+
+void takeSample()
+{
+    FirestoreSample sample;
+    gettimeofday(&sample.time, NULL);
+    sample.temperature = random(100);
+    sample.humidity = random(100);
+    dutyCycle.add(sample);
+}
+
+// Sends the whole ring in one commit request
+void upload()
+{
+    if (!app.ready() || dutyCycle.size() == 0)
+    {
+        uploadDone = true; // offline, the samples wait for the next upload wake
+        return;
+    }
+    uploadCount = dutyCycle.size();
+    for (size_t i = 0; i < uploadCount; i++)
+        batchWriter.add(dutyCycle[i]);
+    Serial.printf("Committing %u samples... \n", (unsigned)uploadCount);
+    if (!batchWriter.end())
+        uploadDone = true; // nothing went out, counted as a failed upload
+}
+
+void goToSleep()
+{
+    if (radioStartMillis)
+    {
+        if (uploadOk)
+            dutyCycle.uploaded(uploadCount);
+        else
+            dutyCycle.failed();
+        saveToken();
+        WiFi.disconnect(true);
+        WiFi.mode(WIFI_OFF);
+        uint32_t radioOn = millis() - radioStartMillis;
+        dutyCycle.addRadioTime(radioOn);
+
+        Serial.printf("duty: wakes=%lu uploads=%lu failures=%lu dropped=%lu radio-on=%lu ms per-sample=%.1f ms\n",
+                      (unsigned long)dutyCycle.getWakes(), (unsigned long)dutyCycle.getUploads(), (unsigned long)dutyCycle.getFailures(),
+                      (unsigned long)dutyCycle.getDropped(), (unsigned long)radioOn, dutyCycle.getRadioTimePerSample());
+        sslClient.print(Serial, "tls");
+        wifiLink.print(Serial);
+        Serial.flush();
+    }
+
+    dutyCycle.seal();
+    esp_sleep_enable_timer_wakeup(DutyCycle<FirestoreSample, DUTY_CYCLE_BUFFER_SIZE>::sleepTime(DUTY_CYCLE_PERIOD_MS, millis()));
+    esp_deep_sleep_start();
+}
+
+BootStatus mountFileSystem()
+{
+    if (!LittleFS.begin())
+    {
+        Serial.println("An Error has occurred while mounting LittleFS");
+        return BOOT_FAILED;
+    }
+    return BOOT_DONE;
+}
+
+BootStatus loadConfig()
+{
+    CredentialsManager credentialsManager(LittleFS);
+    credentialsManager.getCredentials(wifiCredential, firebaseCredential);
+
+    if (wifiCredential.isEmpty())
+    {
+        Serial.println("Failed to read configuration file");
+        return BOOT_FAILED;
+    }
+    WIFI_SSID = wifiCredential.ssid.c_str();
+    WIFI_PASSWORD = wifiCredential.password.c_str();
+
+    if (firebaseCredential.isEmpty())
+    {
+        Serial.println("Firebase configuration is empty");
+        return BOOT_FAILED;
+    }
+
+    API_KEY = firebaseCredential.apiKey.c_str();
+    USER_EMAIL = firebaseCredential.userEmail.c_str();
+    USER_PASSWORD = firebaseCredential.userPassword.c_str();
+    FIREBASE_PROJECT_ID = firebaseCredential.projectId.c_str();
+    return BOOT_DONE;
+}
+
+BootStatus startRadio()
+{
+    radioStartMillis = millis();
+    WiFi.mode(WIFI_STA); // explicitly set mode, esp defaults to STA+AP
+    return BOOT_DONE;
+}
+
+BootStatus connectWifi()
+{
+    wifiLink.begin(WIFI_SSID, WIFI_PASSWORD);
+    return BOOT_PENDING;
+}
+
+BootStatus wifiConnected() { return wifiLink.loop() == LINK_CONNECTED ? BOOT_DONE : BOOT_PENDING; }
+
+BootStatus startApp()
+{
+    sslClient.setInsecure();
+    authSession.begin(firebaseCredential);
+    app.getApp<Firestore::Documents>(Docs);
+
+    // In the console, you can create the ancestor document "example_collection/doc_1" before running this example
+    // to avoid non-existent ancestor documents case.
+    batchWriter.begin(FIREBASE_PROJECT_ID, "example_collection/doc_1/data_1", WiFi.macAddress());
+    batchWriter.setCompression(true);
+
+    Dispatcher::instance().on(OPERATION_AUTH, onAuthResult).on(OPERATION_COMMIT, onCommitResult).otherwise(onOtherResult);
+    return BOOT_PENDING;
+}
+
+BootStatus appReady()
+{
+    // NTP sync runs alongside, a cached token waits for it instead of signing in
+    BootPhaseState ntp = boot.getState(ntpPhase);
+    if (!authSession.ready(time(nullptr), ntp == BOOT_PHASE_WAITING || ntp == BOOT_PHASE_RUNNING))
+        return BOOT_PENDING;
+    Serial.printf("App ready in %lu ms (%s)\n", (unsigned long)(millis() - authSession.getStartMillis()), authSession.isFromCache() ? "cached token" : "sign-in");
+    return BOOT_DONE;
+}
+
+// Stores the token after a refresh during this wake, the next upload wake restores it
+void saveToken() { authSession.save(time(nullptr)); }
+
+// Set time using NTP server
+BootStatus startTimeSync()
+{
+    configTzTime("UTC0", "0.pool.ntp.org", "1.pool.ntp.org", "2.pool.ntp.org");
+    return BOOT_PENDING;
+}
+
+BootStatus timeSynced() { return time(nullptr) >= FIREBASE_DEFAULT_TS ? BOOT_DONE : BOOT_PENDING; }
+
+// Only the final result of the commit ends the upload wake
+void onCommitResult(uint8_t, AsyncResult &aResult)
+{
+    if (!aResult.isError() && !aResult.available())
+        return; // events and debug output of the request
+
+    uploadOk = !aResult.isError();
+    uploadDone = true;
+    if (aResult.isError())
+        printResult(aResult);
+}
+
+// Drops a cached token the server rejected, appReady() signs in again
+void onAuthResult(uint8_t, AsyncResult &aResult)
+{
+    authSession.onResult(aResult);
+    printResult(aResult);
+}
+
+void onOtherResult(uint8_t, AsyncResult &aResult) { printResult(aResult); }
+
+void printResult(AsyncResult &aResult)
+{
+    if (aResult.isEvent())
+    {
+        Firebase.printf("Event task: %s, msg: %s, code: %d\n", aResult.uid().c_str(), aResult.appEvent().message().c_str(), aResult.appEvent().code());
+    }
+
+    if (aResult.isDebug())
+    {
+        Firebase.printf("Debug task: %s, msg: %s\n", aResult.uid().c_str(), aResult.debug().c_str());
+    }
+
+    if (aResult.isError())
+    {
+        Firebase.printf("Error task: %s, msg: %s, code: %d\n", aResult.uid().c_str(), aResult.error().message().c_str(), aResult.error().code());
+    }
+
+    if (aResult.available())
+    {
+        Firebase.printf("task: %s, payload: %s\n", aResult.uid().c_str(), aResult.c_str());
+    }
+}
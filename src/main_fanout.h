@@ -0,0 +1,473 @@
+/**
+ * ABOUT:
+ *
+ * The non-blocking (async) example to write every sample to both the Realtime Database
+ * (live dashboards) and Firestore (history).
+ *
+ * Each sample is converted once into a backend-neutral TelemetryFrame and handed to both
+ * sinks through SinkFanout. Each sink builds its own request body from the frame and
+ * has its own batch and send cadence. Its writer keeps each request until the result and
+ * sends a failed one again, samples are only dropped once they ran out of attempts.
+ *
+ * The complete usage guidelines, please read README.md or visit https://github.com/mobizt/FirebaseClient
+ */
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <WiFi.h>
+#include <WiFiClientSecure.h>
+#include <FirebaseClient.h>
+#include <sys/time.h>
+
+#include <AsyncDispatcher.h>
+#include <Benchmark.h>
+#include <BootSequencer.h>
+#include <EspRadio.h>
+#include <HeapTracker.h>
+#include <Scheduler.h>
+#include <SinkFanout.h>
+#include <SpscRing.h>
+#include <TaskTracer.h>
+#include <TelemetryRecord.h>
+#include <TracedClient.h>
+#include <WifiLink.h>
+
+#include <CredentialsManager/CredentialsManager.h>
+#include <CredentialsManager/AuthSession.h>
+#include <Firestore/FirestoreSink.h>
+#include <RealtimeDatabase/PushIdGenerator.h>
+#include <RealtimeDatabase/RealtimeSink.h>
+#include <Storage/SampleLog.h>
+
+static const char *WIFI_SSID;
+static const char *WIFI_PASSWORD;
+
+static const char *API_KEY;
+static const char *USER_EMAIL;
+static const char *USER_PASSWORD;
+static const char *DATABASE_URL;
+static const char *FIREBASE_PROJECT_ID;
+
+DefaultNetwork network(false); // reconnection is left to wifiLink
+FirebaseApp app;
+TracedClient<WiFiClientSecure> sslClient; // counts TLS handshakes
+TracedClient<WiFiClientSecure> firestoreSslClient;
+EspRadio radio;
+WifiLink<EspRadio> wifiLink(radio, LittleFS); // fast reconnect to the last access point
+using AsyncClient = AsyncClientClass;
+
+// Async results are routed by operation, each operation passes its own callback
+enum AsyncOperation : uint8_t
+{
+    OPERATION_AUTH,
+    OPERATION_UPDATE,
+    OPERATION_COMMIT,
+    OPERATION_COUNT
+};
+using Dispatcher = AsyncDispatcher<AsyncResult, OPERATION_COUNT>;
+
+// One client per host, alternating RTDB and Firestore tasks on a shared client would
+// close the kept-alive connection and handshake again for every task
+AsyncClient aClient(sslClient, getNetwork(network));
+AsyncClient firestoreClient(firestoreSslClient, getNetwork(network));
+RealtimeDatabase Database;
+Firestore::Documents Docs;
+RealtimeBatchWriter realtimeWriter(aClient, Database, Dispatcher::callback<OPERATION_UPDATE>);
+FirestoreBatchWriter firestoreWriter(firestoreClient, Docs, Dispatcher::callback<OPERATION_COMMIT>);
+SampleLog sampleLog(LittleFS); // stores Firestore samples while offline
+RealtimeSink realtimeSink(realtimeWriter);
+FirestoreSink firestoreSink(firestoreWriter, sampleLog);
+SinkFanout<RealtimeSink, FirestoreSink> sinks(realtimeSink, firestoreSink);
+PushIdGenerator pushIds;
+Scheduler<4> scheduler;
+BootSequencer<8> boot;
+uint8_t ntpPhase;
+uint8_t wifiPhase;
+TaskTracer tracer; // latency of each async task from submit to result
+
+// Longest the loop may idle, the async client still has to be serviced
+#define LOOP_MAX_IDLE_MS 10
+
+// Seconds an idle connection is kept alive for the next task, longer than the longest
+// upload interval so consecutive uploads skip the TLS handshake
+#ifndef TLS_SESSION_TIMEOUT_SEC
+#define TLS_SESSION_TIMEOUT_SEC 180
+#endif
+
+// Sampling runs in its own task on the other core, so a slow TLS handshake in loop()
+// can't stall it. Samples reach loop() through a lock-free ring.
+#ifndef SAMPLING_CORE
+#define SAMPLING_CORE 0
+#endif
+#define SAMPLE_PERIOD_MS 1000
+#define SAMPLE_RING_SIZE 64
+
+struct SensorReading
+{
+    struct timeval time;
+    float temperature;
+    float humidity;
+
+    TELEMETRY_SCHEMA(telemetryField("timestamp", &SensorReading::time),
+                     telemetryField("temperature", &SensorReading::temperature),
+                     telemetryField("humidity", &SensorReading::humidity))
+};
+SpscRing<SensorReading, SAMPLE_RING_SIZE> sampleRing;
+
+// Sampling starts before the network, samples taken before NTP sync carry the time since
+// boot. They wait in the ring until the clock is set and are moved onto UTC with the
+// offset below, a boot that stays offline longer than the ring keeps the first ones.
+int64_t bootEpochMicros = 0;
+
+// Longest boot waits for Wi-Fi. The link keeps reconnecting in loop() and the phases
+// that need the network run once it is up.
+#ifndef WIFI_BOOT_TIMEOUT_MS
+#define WIFI_BOOT_TIMEOUT_MS 20000
+#endif
+
+// Longest setup waits for the serial monitor, runs alongside the other boot phases
+#ifndef SERIAL_WAIT_MS
+#define SERIAL_WAIT_MS 3000
+#endif
+
+FirebaseCredential firebaseCredential;
+WifiCredential wifiCredential;
+AuthSession authSession(aClient, app, LittleFS, Dispatcher::callback<OPERATION_AUTH>);
+
+void onUpdateResult(uint8_t operation, AsyncResult &aResult);
+void onCommitResult(uint8_t operation, AsyncResult &aResult);
+void onOtherResult(uint8_t operation, AsyncResult &aResult);
+void printResult(AsyncResult &aResult);
+void samplingTask(void *);
+bool clockSet();
+void toUtc(struct timeval &time);
+void printTaskStats();
+void saveToken();
+void onAuthResult(uint8_t operation, AsyncResult &aResult);
+BootStatus serialReady();
+BootStatus mountFileSystem();
+BootStatus loadConfig();
+BootStatus startRadio();
+BootStatus connectWifi();
+BootStatus wifiConnected();
+BootStatus startSampling();
+BootStatus startApp();
+BootStatus appReady();
+BootStatus startTimeSync();
+BootStatus timeSynced();
+
+void setup()
+{
+    Serial.begin(115200);
+
+    // Phases start as soon as their dependencies are done, so sampling starts first, the
+    // radio comes up while the config is read and NTP sync overlaps Firebase auth
+    boot.add("sampling", startSampling);
+    uint8_t fileSystemPhase = boot.add("littlefs", mountFileSystem);
+    uint8_t radioPhase = boot.add("radio", startRadio);
+    uint8_t configPhase = boot.add("config", loadConfig, nullptr, BOOT_AFTER(fileSystemPhase));
+    wifiPhase = boot.add("wifi", connectWifi, wifiConnected, BOOT_AFTER(radioPhase) | BOOT_AFTER(configPhase), WIFI_BOOT_TIMEOUT_MS);
+    ntpPhase = boot.add("ntp", startTimeSync, timeSynced, BOOT_AFTER(wifiPhase), 10000);
+    boot.add("auth", startApp, appReady, BOOT_AFTER(wifiPhase), 30000);
+    boot.add("serial", nullptr, serialReady); // wait for the serial monitor to connect
+
+    Serial.println("Starting...");
+    boot.run();
+    boot.printTimeline(Serial);
+}
+
+void loop()
+{
+    app.loop();
+    wifiLink.loop();
+    Database.loop();
+    Docs.loop();
+
+    // Boot gave up waiting for Wi-Fi, resume the skipped phases once the link is up
+    if (wifiLink.isConnected() && boot.retry(wifiPhase))
+        Serial.println("Wi-Fi connected, resuming boot");
+    if (!boot.succeeded())
+        boot.loop();
+
+    bool online = wifiLink.isConnected() && app.ready();
+
+    // One frame per sample, each sink renders it into its own request format
+    if (clockSet())
+        sampleRing.drain([](const SensorReading &taken)
+                         {
+                             SensorReading reading = taken;
+                             toUtc(reading.time);
+                             TelemetryFrame frame;
+                             BENCHMARK_MICROS_BEGIN(Serialize);
+                             bool ok = TelemetrySerializer::toFrame(reading, frame);
+                             BENCHMARK_MICROS_END(Serialize);
+                             if (!ok)
+                                 return;
+                             pushIds.generate(frame.key);
+                             sinks.add(frame); });
+
+    // Each sink sends once its batch is full or its latency budget expires
+    {
+        HEAP_SCOPE(Send);
+        sinks.loop(online);
+    }
+
+    BENCHMARK_PRINT_EVERY(60000);
+    HEAP_PRINT_EVERY(60000);
+
+    // Sleep until the next task is due instead of spinning
+    uint32_t idle = scheduler.run();
+    delay(idle < LOOP_MAX_IDLE_MS ? idle : LOOP_MAX_IDLE_MS);
+}
+
+BootStatus serialReady() { return Serial || millis() >= SERIAL_WAIT_MS ? BOOT_DONE : BOOT_PENDING; }
+
+BootStatus mountFileSystem()
+{
+    if (!LittleFS.begin())
+    {
+        Serial.println("An Error has occurred while mounting LittleFS");
+        return BOOT_FAILED;
+    }
+    sampleLog.begin();
+    return BOOT_DONE;
+}
+
+BootStatus loadConfig()
+{
+    HEAP_SCOPE(Credentials);
+    CredentialsManager credentialsManager(LittleFS);
+    BENCHMARK_MICROS_BEGIN(ConfigLoad);
+    credentialsManager.getCredentials(wifiCredential, firebaseCredential);
+    BENCHMARK_MICROS_END(ConfigLoad);
+
+    if (wifiCredential.isEmpty())
+    {
+        Serial.println("Failed to read configuration file");
+        return BOOT_FAILED;
+    }
+    WIFI_SSID = wifiCredential.ssid.c_str();
+    WIFI_PASSWORD = wifiCredential.password.c_str();
+
+    if (firebaseCredential.isEmpty())
+    {
+        Serial.println("Firebase configuration is empty");
+        return BOOT_FAILED;
+    }
+    API_KEY = firebaseCredential.apiKey.c_str();
+    USER_EMAIL = firebaseCredential.userEmail.c_str();
+    USER_PASSWORD = firebaseCredential.userPassword.c_str();
+    DATABASE_URL = firebaseCredential.realtimeDbUrl.c_str();
+    FIREBASE_PROJECT_ID = firebaseCredential.projectId.c_str();
+    return BOOT_DONE;
+}
+
+BootStatus startRadio()
+{
+    WiFi.mode(WIFI_STA); // explicitly set mode, esp defaults to STA+AP
+    return BOOT_DONE;
+}
+
+BootStatus connectWifi()
+{
+    if (wifiLink.getState() != LINK_IDLE)
+        return BOOT_PENDING; // retried after the boot timeout, the link is already connecting
+    Serial.println("Connecting to Wi-Fi...");
+    wifiLink.begin(WIFI_SSID, WIFI_PASSWORD);
+    return BOOT_PENDING;
+}
+
+BootStatus wifiConnected()
+{
+    if (wifiLink.loop() != LINK_CONNECTED)
+        return BOOT_PENDING;
+    Serial.printf("Connected in %lu ms with IP: ", (unsigned long)wifiLink.getLastConnectTime());
+    Serial.println(WiFi.localIP());
+    return BOOT_DONE;
+}
+
+BootStatus startApp()
+{
+    Firebase.printf("Firebase Client v%s\n", FIREBASE_CLIENT_VERSION);
+    sslClient.setInsecure();
+    firestoreSslClient.setInsecure();
+    aClient.setSessionTimeout(TLS_SESSION_TIMEOUT_SEC);
+    firestoreClient.setSessionTimeout(TLS_SESSION_TIMEOUT_SEC);
+
+    Serial.println("Initializing the app...");
+    authSession.begin(firebaseCredential);
+    app.getApp<RealtimeDatabase>(Database);
+    app.getApp<Firestore::Documents>(Docs);
+    Database.url(DATABASE_URL);
+    Serial.println("Initialized the app");
+
+    Dispatcher::instance().on(OPERATION_AUTH, onAuthResult).on(OPERATION_UPDATE, onUpdateResult).on(OPERATION_COMMIT, onCommitResult).otherwise(onOtherResult);
+
+    // Live values every few seconds, history in larger compressed commits
+    realtimeWriter.begin("/test/json");
+    realtimeWriter.setTracer(&tracer);
+    realtimeSink.getRateController()
+        .setInterval(2000, 30000, 1000)
+        .setBatch(1, REALTIME_BATCH_CAPACITY, SAMPLE_PERIOD_MS)
+        .setTargetLatency(3000);
+
+    firestoreWriter.begin(FIREBASE_PROJECT_ID, "example_collection/doc_1/data_1", WiFi.macAddress());
+    firestoreWriter.setCompression(true);
+    firestoreWriter.setTracer(&tracer);
+    firestoreSink.getRateController()
+        .setInterval(10000, 60000, 5000)
+        .setBatch(1, FIRESTORE_BATCH_CAPACITY, SAMPLE_PERIOD_MS)
+        .setTargetLatency(5000);
+
+    scheduler.every(60000, printTaskStats);
+    scheduler.every(10000, saveToken);
+    return BOOT_PENDING;
+}
+
+BootStatus appReady()
+{
+    // NTP sync runs alongside, a cached token waits for it instead of signing in
+    BootPhaseState ntp = boot.getState(ntpPhase);
+    if (!authSession.ready(time(nullptr), ntp == BOOT_PHASE_WAITING || ntp == BOOT_PHASE_RUNNING))
+        return BOOT_PENDING;
+    Serial.printf("App ready in %lu ms (%s)\n", (unsigned long)(millis() - authSession.getStartMillis()), authSession.isFromCache() ? "cached token" : "sign-in");
+    return BOOT_DONE;
+}
+
+// Stores the token after every refresh, the next boot restores it
+void saveToken() { authSession.save(time(nullptr)); }
+
+// Set time using NTP server
+BootStatus startTimeSync()
+{
+    configTzTime("UTC0", "0.pool.ntp.org", "1.pool.ntp.org", "2.pool.ntp.org");
+    return BOOT_PENDING;
+}
+
+BootStatus timeSynced()
+{
+    if (time(nullptr) < FIREBASE_DEFAULT_TS)
+        return BOOT_PENDING;
+    tm timeinfo;
+    getLocalTime(&timeinfo, 0);
+    Serial.println(&timeinfo, "%A, %B %d %Y %H:%M:%S");
+    return BOOT_DONE;
+}
+
+BootStatus startSampling()
+{
+    xTaskCreatePinnedToCore(samplingTask, "sampling", 4096, NULL, 1, NULL, SAMPLING_CORE);
+    return BOOT_DONE;
+}
+
+// True once NTP set the clock, takes the offset of the time since boot to UTC then
+bool clockSet()
+{
+    if (!bootEpochMicros && time(nullptr) >= FIREBASE_DEFAULT_TS)
+    {
+        struct timeval now;
+        gettimeofday(&now, NULL);
+        bootEpochMicros = (int64_t)now.tv_sec * 1000000 + now.tv_usec - esp_timer_get_time();
+    }
+    return bootEpochMicros != 0;
+}
+
+// Moves a time taken before NTP sync, the time since boot, onto UTC
+void toUtc(struct timeval &time)
+{
+    if (time.tv_sec >= FIREBASE_DEFAULT_TS)
+        return;
+    int64_t micros = (int64_t)time.tv_sec * 1000000 + time.tv_usec + bootEpochMicros;
+    time.tv_sec = micros / 1000000;
+    time.tv_usec = micros % 1000000;
+}
+
+void samplingTask(void *)
+{
+    TickType_t wake = xTaskGetTickCount();
+    for (;;)
+    {
+        SensorReading reading;
+        gettimeofday(&reading.time, NULL);
+        reading.temperature = random(0, 1000) / 11.0;
+        reading.humidity = random(0, 1000) / 11.0;
+        sampleRing.push(reading); // counted as dropped if loop() falls behind
+
+        vTaskDelayUntil(&wake, pdMS_TO_TICKS(SAMPLE_PERIOD_MS));
+    }
+}
+
+void printTaskStats()
+{
+    tracer.expire(60000); // results older than this are not coming
+    tracer.print(Serial);
+    sslClient.print(Serial, "tls realtime");
+    firestoreSslClient.print(Serial, "tls firestore");
+    wifiLink.print(Serial);
+    Serial.printf("realtime: interval=%lu ms retries=%lu dropped=%lu\n", (unsigned long)realtimeSink.getRateController().getInterval(),
+                  (unsigned long)realtimeWriter.getRetryCount(), (unsigned long)(realtimeSink.getDropped() + realtimeWriter.getDroppedFrames()));
+    Serial.printf("firestore: interval=%lu ms logged=%lu retries=%lu dropped=%lu\n", (unsigned long)firestoreSink.getRateController().getInterval(),
+                  (unsigned long)sampleLog.getRecordCount(), (unsigned long)firestoreWriter.getRetryCount(),
+                  (unsigned long)(firestoreSink.getDropped() + firestoreWriter.getDroppedFrames()));
+    Serial.printf("samples: taken=%lu dropped=%lu\n", (unsigned long)sampleRing.getPushed(), (unsigned long)sampleRing.getDropped());
+}
+
+// Runs for every update result, only a final result reads the uid and only an error is printed
+void onUpdateResult(uint8_t, AsyncResult &aResult)
+{
+    if (!aResult.isError() && !aResult.available())
+        return; // events and debug output of the request
+
+    String uid = aResult.uid();
+    tracer.complete(uid.c_str(), aResult.isError());
+    realtimeSink.onResult(TaskTracer::sequenceOf(uid.c_str()), aResult.isError());
+    if (aResult.isError())
+        printResult(aResult);
+}
+
+// Runs for every commit result, only a final result reads the uid and only an error is printed
+void onCommitResult(uint8_t, AsyncResult &aResult)
+{
+    if (!aResult.isError() && !aResult.available())
+        return; // events and debug output of the request
+
+    String uid = aResult.uid();
+    tracer.complete(uid.c_str(), aResult.isError());
+    firestoreSink.onResult(TaskTracer::sequenceOf(uid.c_str()), aResult.isError());
+    if (aResult.isError())
+        printResult(aResult);
+}
+
+// Drops a cached token the server rejected, appReady() signs in again
+void onAuthResult(uint8_t operation, AsyncResult &aResult)
+{
+    authSession.onResult(aResult);
+    onOtherResult(operation, aResult);
+}
+
+// Auth and anything else that is rare enough to print in full
+void onOtherResult(uint8_t, AsyncResult &aResult) { printResult(aResult); }
+
+void printResult(AsyncResult &aResult)
+{
+    HEAP_SCOPE(PrintResult);
+    if (aResult.isEvent())
+    {
+        Firebase.printf("Event task: %s, msg: %s, code: %d\n", aResult.uid().c_str(), aResult.appEvent().message().c_str(), aResult.appEvent().code());
+    }
+
+    if (aResult.isDebug())
+    {
+        Firebase.printf("Debug task: %s, msg: %s\n", aResult.uid().c_str(), aResult.debug().c_str());
+    }
+
+    if (aResult.isError())
+    {
+        Firebase.printf("Error task: %s, msg: %s, code: %d\n", aResult.uid().c_str(), aResult.error().message().c_str(), aResult.error().code());
+    }
+
+    if (aResult.available())
+    {
+        Firebase.printf("task: %s, payload: %s\n", aResult.uid().c_str(), aResult.c_str());
+    }
+}
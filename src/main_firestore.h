@@ -36,10 +36,24 @@
 #include <WiFiClientSecure.h>
 #include <sys/time.h>
 
+#include <AsyncDispatcher.h>
 #include <Benchmark.h>
-#include <SimpleTimer.h>
+#include <BootSequencer.h>
+#include <EspRadio.h>
+#include <HeapTracker.h>
+#include <RateController.h>
+#include <Scheduler.h>
+#include <SpscRing.h>
+#include <TaskTracer.h>
+#include <TracedClient.h>
+#include <WifiLink.h>
+#include <WindowAggregator.h>
 
 #include <CredentialsManager/CredentialsManager.h>
+#include <CredentialsManager/AuthSession.h>
+#include <Firestore/FirestoreBatchWriter.h>
+#include <Firestore/FirestoreSummaryWriter.h>
+#include <Storage/SampleLog.h>
 
 static const char *WIFI_SSID;
 static const char *WIFI_PASSWORD;
@@ -49,43 +63,234 @@ static const char *USER_EMAIL;
 static const char *USER_PASSWORD;
 static const char *FIREBASE_PROJECT_ID;
 
-DefaultNetwork network; // initialize with boolean parameter to enable/disable network reconnection
+DefaultNetwork network(false); // reconnection is left to wifiLink
 
 FirebaseApp app;
-WiFiClientSecure sslClient;
+TracedClient<WiFiClientSecure> sslClient; // counts TLS handshakes
+EspRadio radio;
+WifiLink<EspRadio> wifiLink(radio, LittleFS); // fast reconnect to the last access point
 
 using AsyncClient = AsyncClientClass;
+
+// Async results are routed by operation, each operation passes its own callback
+enum AsyncOperation : uint8_t
+{
+    OPERATION_AUTH,
+    OPERATION_COMMIT,
+    OPERATION_SUMMARY,
+    OPERATION_COUNT
+};
+using Dispatcher = AsyncDispatcher<AsyncResult, OPERATION_COUNT>;
 AsyncClient aClient(sslClient, getNetwork(network));
 Firestore::Documents Docs;
+FirestoreBatchWriter batchWriter(aClient, Docs, Dispatcher::callback<OPERATION_COMMIT>);
+SampleLog sampleLog(LittleFS); // stores samples while offline
+
+// Opt-in: summarize samples per window of this many milliseconds and upload only the
+// summaries. Raw samples then bypass the batch writer and the sample log, so nothing is
+// kept while offline. 0 uploads every sample.
+#ifndef AGGREGATE_WINDOW_MS
+#define AGGREGATE_WINDOW_MS 0
+#endif
+
+static const char *const SUMMARY_FIELDS[] = {"temperature", "humidity"};
+WindowAggregator<2, 32> aggregator; // 32 bucket sketch for p50/p95
+FirestoreSummaryWriter<2> summaryWriter(aClient, Docs, Dispatcher::callback<OPERATION_SUMMARY>);
+Scheduler<4> scheduler;
+BootSequencer<8> boot;
+uint8_t ntpPhase;
+uint8_t wifiPhase;
+TaskTracer tracer; // latency of each async task from submit to result
+RateController rateController; // upload cadence from the observed round-trip time
+
+// Longest the loop may idle, the async client still has to be serviced
+#define LOOP_MAX_IDLE_MS 10
+
+// Seconds an idle connection is kept alive for the next task, longer than the longest
+// upload interval so consecutive uploads skip the TLS handshake
+#ifndef TLS_SESSION_TIMEOUT_SEC
+#define TLS_SESSION_TIMEOUT_SEC 180
+#endif
+
+// Sampling runs in its own task on the other core, so a slow TLS handshake in loop()
+// can't stall it. Samples reach loop() through a lock-free ring.
+#ifndef SAMPLING_CORE
+#define SAMPLING_CORE 0
+#endif
+#define SAMPLE_PERIOD_MS 1000
+#define SAMPLE_RING_SIZE 64
+
+SpscRing<FirestoreSample, SAMPLE_RING_SIZE> sampleRing;
+
+// Sampling starts before the network, samples taken before NTP sync carry the time since
+// boot. They wait in the ring until the clock is set and are moved onto UTC with the
+// offset below, a boot that stays offline longer than the ring keeps the first ones.
+int64_t bootEpochMicros = 0;
+
+// Longest boot waits for Wi-Fi. The link keeps reconnecting in loop() and the phases
+// that need the network run once it is up.
+#ifndef WIFI_BOOT_TIMEOUT_MS
+#define WIFI_BOOT_TIMEOUT_MS 20000
+#endif
+
+// Longest setup waits for the serial monitor, runs alongside the other boot phases
+#ifndef SERIAL_WAIT_MS
+#define SERIAL_WAIT_MS 3000
+#endif
 
 FirebaseCredential firebaseCredential;
 WifiCredential wifiCredential;
+AuthSession authSession(aClient, app, LittleFS, Dispatcher::callback<OPERATION_AUTH>);
 
-void asyncCB(AsyncResult &aResult);
+void onCommitResult(uint8_t operation, AsyncResult &aResult);
+void onOtherResult(uint8_t operation, AsyncResult &aResult);
 void printResult(AsyncResult &aResult);
-String getTimestampString();
+void samplingTask(void *);
+bool clockSet();
+void toUtc(struct timeval &time);
+void aggregateSample(const FirestoreSample &sample);
+void printTaskStats();
+void saveToken();
+void onAuthResult(uint8_t operation, AsyncResult &aResult);
+BootStatus serialReady();
+BootStatus mountFileSystem();
+BootStatus loadConfig();
+BootStatus startRadio();
+BootStatus connectWifi();
+BootStatus wifiConnected();
+BootStatus startSampling();
+BootStatus startApp();
+BootStatus appReady();
+BootStatus startTimeSync();
+BootStatus timeSynced();
 
 void setup()
 {
     Serial.begin(115200);
-    delay(3000); // wait for the serial monitor to connect
+
+    // Phases start as soon as their dependencies are done, so sampling starts first, the
+    // radio comes up while the config is read and NTP sync overlaps Firebase auth
+    boot.add("sampling", startSampling);
+    uint8_t fileSystemPhase = boot.add("littlefs", mountFileSystem);
+    uint8_t radioPhase = boot.add("radio", startRadio);
+    uint8_t configPhase = boot.add("config", loadConfig, nullptr, BOOT_AFTER(fileSystemPhase));
+    wifiPhase = boot.add("wifi", connectWifi, wifiConnected, BOOT_AFTER(radioPhase) | BOOT_AFTER(configPhase), WIFI_BOOT_TIMEOUT_MS);
+    ntpPhase = boot.add("ntp", startTimeSync, timeSynced, BOOT_AFTER(wifiPhase), 10000);
+    boot.add("auth", startApp, appReady, BOOT_AFTER(wifiPhase), 30000);
+    boot.add("serial", nullptr, serialReady); // wait for the serial monitor to connect
+
     Serial.println("Starting...");
+    boot.run();
+    boot.printTimeline(Serial);
+}
+
+void loop()
+{
+    // The async task handler should run inside the main loop
+    // without blocking delay or bypassing with millis code blocks.
+    app.loop();
+    wifiLink.loop();
+    Docs.loop();
+
+    // Boot gave up waiting for Wi-Fi, resume the skipped phases once the link is up
+    if (wifiLink.isConnected() && boot.retry(wifiPhase))
+        Serial.println("Wi-Fi connected, resuming boot");
+    if (!boot.succeeded())
+        boot.loop();
+
+    bool online = wifiLink.isConnected() && app.ready();
+
+    // Batch size and cadence follow the round-trip time of the previous commits
+    batchWriter.setMaxBatch(rateController.getBatchSize());
+    batchWriter.setMaxLatency(rateController.getInterval());
+
+    // Take the samples from the sampling task, keep them in the log while offline or
+    // while the batch is full and waiting for a commit to finish
+    if (clockSet())
+        sampleRing.drain([online](const FirestoreSample &taken)
+                         {
+                             FirestoreSample sample = taken;
+                             toUtc(sample.time);
+                             if (AGGREGATE_WINDOW_MS)
+                                 aggregateSample(sample);
+                             else if (online && batchWriter.space() > 0)
+                                 batchWriter.add(sample);
+                             else
+                                 sampleLog.append(sample); });
+
+    // Close the current window on time even when no sample arrives, only after NTP sync
+    if (AGGREGATE_WINDOW_MS && time(nullptr) >= FIREBASE_DEFAULT_TS)
+    {
+        struct timeval now;
+        gettimeofday(&now, NULL);
+        if (aggregator.poll((uint64_t)now.tv_sec * 1000 + now.tv_usec / 1000))
+            summaryWriter.add(aggregator.getSummary());
+    }
+
+    // Forward samples stored while offline, oldest first. They leave the log here, the
+    // writer keeps them until their commit succeeded or ran out of attempts.
+    if (online && !sampleLog.isEmpty() && batchWriter.space() > 0)
+    {
+        sampleLog.drainAs<FirestoreSample>([](const FirestoreSample &sample)
+                                           {
+                                               batchWriter.add(sample);
+                                               return true; },
+                                           batchWriter.space());
+    }
+
+    // Samples are sent as one commit request once the batch is full or the latency budget expires
+    if (online && batchWriter.ready() && rateController.canSend())
+    {
+        Serial.printf("Committing %u documents... \n", (unsigned)batchWriter.pending());
+        HEAP_SCOPE(Commit);
+        BENCHMARK_MICROS_BEGIN(Committed);
+        if (batchWriter.flush())
+            rateController.onSubmit(batchWriter.getLastRequest());
+        BENCHMARK_MICROS_END(Committed);
+    }
+
+    // Summaries queued while offline go out together in one commit
+    if (online && summaryWriter.ready() && rateController.canSend())
+    {
+        Serial.printf("Committing %u summaries... \n", (unsigned)summaryWriter.pending());
+        HEAP_SCOPE(Commit);
+        if (summaryWriter.flush())
+            rateController.onSubmit(summaryWriter.getLastRequest());
+    }
+
+    BENCHMARK_PRINT_EVERY(60000);
+    HEAP_PRINT_EVERY(60000);
+
+    // Sleep until the next task is due instead of spinning
+    uint32_t idle = scheduler.run();
+    delay(idle < LOOP_MAX_IDLE_MS ? idle : LOOP_MAX_IDLE_MS);
+}
+
+BootStatus serialReady() { return Serial || millis() >= SERIAL_WAIT_MS ? BOOT_DONE : BOOT_PENDING; }
 
-    // Read configuration files
+BootStatus mountFileSystem()
+{
     if (!LittleFS.begin())
     {
         Serial.println("An Error has occurred while mounting LittleFS");
-        return;
+        return BOOT_FAILED;
     }
+    sampleLog.begin();
+    return BOOT_DONE;
+}
 
+BootStatus loadConfig()
+{
+    HEAP_SCOPE(Credentials);
     CredentialsManager credentialsManager(LittleFS);
-    firebaseCredential = credentialsManager.getFirebaseCredential();
-    wifiCredential = credentialsManager.getWifiCredential();
+    BENCHMARK_MICROS_BEGIN(ConfigLoad);
+    credentialsManager.getCredentials(wifiCredential, firebaseCredential);
+    BENCHMARK_MICROS_END(ConfigLoad);
 
     if (wifiCredential.isEmpty())
     {
         Serial.println("Failed to read configuration file");
-        return;
+        return BOOT_FAILED;
     }
     WIFI_SSID = wifiCredential.ssid.c_str();
     WIFI_PASSWORD = wifiCredential.password.c_str();
@@ -93,83 +298,207 @@ void setup()
     if (firebaseCredential.isEmpty())
     {
         Serial.println("Firebase configuration is empty");
-        return;
+        return BOOT_FAILED;
     }
 
-    // API_KEY = firebaseCredential.apiKey.c_str();
-    // USER_EMAIL = firebaseCredential.userEmail.c_str();
-    // USER_PASSWORD = firebaseCredential.userPassword.c_str();
+    API_KEY = firebaseCredential.apiKey.c_str();
+    USER_EMAIL = firebaseCredential.userEmail.c_str();
+    USER_PASSWORD = firebaseCredential.userPassword.c_str();
     FIREBASE_PROJECT_ID = firebaseCredential.projectId.c_str();
+    return BOOT_DONE;
+}
 
-    // Connect to Wi-Fi
+BootStatus startRadio()
+{
     WiFi.mode(WIFI_STA); // explicitly set mode, esp defaults to STA+AP
-    WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
-    Serial.print("Connecting to Wi-Fi");
-    while (WiFi.status() != WL_CONNECTED)
-    {
-        Serial.print(".");
-        delay(300);
-    }
-    Serial.println();
-    Serial.print("Connected with IP: ");
+    return BOOT_DONE;
+}
+
+BootStatus connectWifi()
+{
+    if (wifiLink.getState() != LINK_IDLE)
+        return BOOT_PENDING; // retried after the boot timeout, the link is already connecting
+    Serial.println("Connecting to Wi-Fi...");
+    wifiLink.begin(WIFI_SSID, WIFI_PASSWORD);
+    return BOOT_PENDING;
+}
+
+BootStatus wifiConnected()
+{
+    if (wifiLink.loop() != LINK_CONNECTED)
+        return BOOT_PENDING;
+    Serial.printf("Connected in %lu ms with IP: ", (unsigned long)wifiLink.getLastConnectTime());
     Serial.println(WiFi.localIP());
+    return BOOT_DONE;
+}
 
-    // Setup Firebase
+BootStatus startApp()
+{
     Firebase.printf("Firebase Client v%s\n", FIREBASE_CLIENT_VERSION);
     sslClient.setInsecure();
+    aClient.setSessionTimeout(TLS_SESSION_TIMEOUT_SEC);
 
     Serial.println("Initializing the app...");
-    // UserAuth userAuth(API_KEY, USER_EMAIL, USER_PASSWORD);
-    NoAuth userAuth;
-    initializeApp(aClient, app, getAuth(userAuth), asyncCB, "authTask");
+    authSession.begin(firebaseCredential);
     app.getApp<Firestore::Documents>(Docs);
     Serial.println("Initialized the app");
 
-    // Set time using NTP server
-    tm timeinfo;
+    // In the console, you can create the ancestor document "example_collection/doc_1" before running this example
+    // to avoid non-existent ancestor documents case.
+    batchWriter.begin(FIREBASE_PROJECT_ID, "example_collection/doc_1/data_1", WiFi.macAddress());
+    batchWriter.setCompression(true);
+    batchWriter.setDeadband(1, 2, 60000); // report changes of 1 degree or 2 %, or once a minute
+
+    summaryWriter.begin(FIREBASE_PROJECT_ID, "example_collection/doc_1/summaries", WiFi.macAddress(), SUMMARY_FIELDS);
+
+    Dispatcher::instance().on(OPERATION_AUTH, onAuthResult).on(OPERATION_COMMIT, onCommitResult).on(OPERATION_SUMMARY, onCommitResult).otherwise(onOtherResult);
+    batchWriter.setTracer(&tracer);
+    summaryWriter.setTracer(&tracer);
+    rateController.setInterval(2000, 60000, 1000) // send every 2 to 60 seconds
+        .setBatch(1, FIRESTORE_BATCH_CAPACITY, SAMPLE_PERIOD_MS)
+        .setTargetLatency(3000)
+        .setRequestTimeout(30000);
+
+    scheduler.every(60000, printTaskStats);
+    scheduler.every(10000, saveToken);
+    return BOOT_PENDING;
+}
+
+BootStatus appReady()
+{
+    // NTP sync runs alongside, a cached token waits for it instead of signing in
+    BootPhaseState ntp = boot.getState(ntpPhase);
+    if (!authSession.ready(time(nullptr), ntp == BOOT_PHASE_WAITING || ntp == BOOT_PHASE_RUNNING))
+        return BOOT_PENDING;
+    Serial.printf("App ready in %lu ms (%s)\n", (unsigned long)(millis() - authSession.getStartMillis()), authSession.isFromCache() ? "cached token" : "sign-in");
+    return BOOT_DONE;
+}
+
+// Stores the token after every refresh, the next boot restores it
+void saveToken() { authSession.save(time(nullptr)); }
+
+// Set time using NTP server
+BootStatus startTimeSync()
+{
     configTzTime("UTC0", "0.pool.ntp.org", "1.pool.ntp.org", "2.pool.ntp.org");
-    getLocalTime(&timeinfo);
+    return BOOT_PENDING;
+}
+
+BootStatus timeSynced()
+{
+    if (time(nullptr) < FIREBASE_DEFAULT_TS)
+        return BOOT_PENDING;
+    tm timeinfo;
+    getLocalTime(&timeinfo, 0);
     Serial.println(&timeinfo, "%A, %B %d %Y %H:%M:%S");
+    return BOOT_DONE;
 }
 
-void loop()
+BootStatus startSampling()
 {
-    // The async task handler should run inside the main loop
-    // without blocking delay or bypassing with millis code blocks.
-    app.loop();
-    Docs.loop();
+    aggregator.setWindow(AGGREGATE_WINDOW_MS);
+    aggregator.setRange(0, 0, 100); // temperature
+    aggregator.setRange(1, 0, 100); // humidity
+    xTaskCreatePinnedToCore(samplingTask, "sampling", 4096, NULL, 1, NULL, SAMPLING_CORE);
+    return BOOT_DONE;
+}
+
+// True once NTP set the clock, takes the offset of the time since boot to UTC then
+bool clockSet()
+{
+    if (!bootEpochMicros && time(nullptr) >= FIREBASE_DEFAULT_TS)
+    {
+        struct timeval now;
+        gettimeofday(&now, NULL);
+        bootEpochMicros = (int64_t)now.tv_sec * 1000000 + now.tv_usec - esp_timer_get_time();
+    }
+    return bootEpochMicros != 0;
+}
+
+// Moves a time taken before NTP sync, the time since boot, onto UTC
+void toUtc(struct timeval &time)
+{
+    if (time.tv_sec >= FIREBASE_DEFAULT_TS)
+        return;
+    int64_t micros = (int64_t)time.tv_sec * 1000000 + time.tv_usec + bootEpochMicros;
+    time.tv_sec = micros / 1000000;
+    time.tv_usec = micros % 1000000;
+}
 
-    static unsigned long dataMillis = 0;
-    if (app.ready() && (millis() - dataMillis > 10000 || dataMillis == 0))
+void samplingTask(void *)
+{
+    TickType_t wake = xTaskGetTickCount();
+    for (;;)
     {
-        dataMillis = millis();
-        // In the console, you can create the ancestor document "example_collection/doc_1" before running this example
-        // to avoid non-existent ancestor documents case.
-        String documentPath = "example_collection/doc_1/data_1";
-
-        Values::TimestampValue timestamp(getTimestampString());
-        Values::StringValue deviceId(WiFi.macAddress());
-        Values::IntegerValue temperature(random(100));
-        Values::IntegerValue humidity(random(100));
-
-        Document doc;
-        doc.add("timestamp", Values::Value(timestamp));
-        doc.add("deviceId", Values::Value(deviceId));
-        doc.add("temperature", Values::Value(temperature));
-        doc.add("humidity", Values::Value(humidity));
-
-        // The value of Values::xxxValue, Values::Value and Document can be printed on Serial.
-        Serial.println("Creating a document... ");
-        BENCHMARK_MICROS_BEGIN(Created);
-        Docs.createDocument(aClient, Firestore::Parent(FIREBASE_PROJECT_ID), documentPath, DocumentMask(), doc, asyncCB, "createDocumentTask");
-        BENCHMARK_MICROS_END(Created);
+        FirestoreSample sample;
+        gettimeofday(&sample.time, NULL);
+        sample.temperature = random(100);
+        sample.humidity = random(100);
+        sampleRing.push(sample); // counted as dropped if loop() falls behind
+
+        vTaskDelayUntil(&wake, pdMS_TO_TICKS(SAMPLE_PERIOD_MS));
     }
 }
 
-void asyncCB(AsyncResult &aResult) { printResult(aResult); }
+// Adds a sample to the current window, a closed window is queued for upload
+void aggregateSample(const FirestoreSample &sample)
+{
+    if (sample.time.tv_sec < FIREBASE_DEFAULT_TS)
+        return; // taken before NTP sync, would open a window in 1970
+    float values[2] = {(float)sample.temperature, (float)sample.humidity};
+    uint64_t time = (uint64_t)sample.time.tv_sec * 1000 + sample.time.tv_usec / 1000;
+    if (aggregator.add(time, values))
+        summaryWriter.add(aggregator.getSummary());
+}
+
+void printTaskStats()
+{
+    tracer.expire(60000); // results older than this are not coming
+    tracer.print(Serial);
+    sslClient.print(Serial, "tls");
+    wifiLink.print(Serial);
+    Serial.printf("rate: interval=%lu ms batch=%u in-flight=%u increases=%lu decreases=%lu timeouts=%lu late=%lu\n",
+                  (unsigned long)rateController.getInterval(), (unsigned)rateController.getBatchSize(), rateController.getInFlight(),
+                  (unsigned long)rateController.getIncreases(), (unsigned long)rateController.getDecreases(), (unsigned long)rateController.getTimeouts(),
+                  (unsigned long)rateController.getLate());
+    Serial.printf("samples: taken=%lu dropped=%lu suppressed=%lu failed=%lu retries=%lu long-names=%lu bytes/sample=%.2f\n",
+                  (unsigned long)sampleRing.getPushed(), (unsigned long)sampleRing.getDropped(), (unsigned long)batchWriter.getSuppressedCount(),
+                  (unsigned long)batchWriter.getFailedSamples(), (unsigned long)batchWriter.getRetryCount(), (unsigned long)batchWriter.getLongNames(),
+                  batchWriter.getBytesPerSample());
+    Serial.printf("windows: closed=%lu late=%lu pending=%u dropped=%lu\n", (unsigned long)aggregator.getWindowCount(),
+                  (unsigned long)aggregator.getLateCount(), (unsigned)summaryWriter.pending(), (unsigned long)summaryWriter.getDroppedCount());
+}
+
+// Runs for every commit and summary result, only a final result reads the uid and only an error is printed.
+// The batch writer keeps each commit until here, a failed one goes out again once the backoff allows.
+void onCommitResult(uint8_t operation, AsyncResult &aResult)
+{
+    if (!aResult.isError() && !aResult.available())
+        return; // events and debug output of the request
+
+    String uid = aResult.uid();
+    uint16_t request = TaskTracer::sequenceOf(uid.c_str());
+    tracer.complete(uid.c_str(), aResult.isError());
+    rateController.onComplete(request, aResult.isError());
+    if (operation == OPERATION_COMMIT)
+        batchWriter.onResult(request, aResult.isError());
+    if (aResult.isError())
+        printResult(aResult);
+}
+
+// Drops a cached token the server rejected, appReady() signs in again
+void onAuthResult(uint8_t operation, AsyncResult &aResult)
+{
+    authSession.onResult(aResult);
+    onOtherResult(operation, aResult);
+}
+
+// Auth and anything else that is rare enough to print in full
+void onOtherResult(uint8_t, AsyncResult &aResult) { printResult(aResult); }
 
 void printResult(AsyncResult &aResult)
 {
+    HEAP_SCOPE(PrintResult);
     if (aResult.isEvent())
     {
         Firebase.printf("Event task: %s, msg: %s, code: %d\n", aResult.uid().c_str(), aResult.appEvent().message().c_str(), aResult.appEvent().code());
@@ -189,17 +518,4 @@ void printResult(AsyncResult &aResult)
     {
         Firebase.printf("task: %s, payload: %s\n", aResult.uid().c_str(), aResult.c_str());
     }
-}
-
-String getTimestampString()
-{
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    time_t now = tv.tv_sec;
-    struct tm ts = *localtime(&now);
-    char buf[100];
-    sprintf(buf, "%04d-%02d-%02dT%02d:%02d:%02d.%06ldZ",
-            ts.tm_year + 1900, ts.tm_mon + 1, ts.tm_mday,
-            ts.tm_hour, ts.tm_min, ts.tm_sec, tv.tv_usec);
-    return String(buf);
 }
\ No newline at end of file
@@ -30,57 +30,315 @@
 #include <WiFiClientSecure.h>
 #include <FirebaseClient.h>
 
+#include <AsyncDispatcher.h>
 #include <Benchmark.h>
-#include <SimpleTimer.h>
+#include <BootSequencer.h>
+#include <EspRadio.h>
+#include <HeapTracker.h>
+#include <LaneArbiter.h>
+#include <RateController.h>
+#include <Scheduler.h>
+#include <SpscRing.h>
+#include <TaskTracer.h>
+#include <TracedClient.h>
+#include <WifiLink.h>
 
 #include <CredentialsManager/CredentialsManager.h>
+#include <CredentialsManager/AuthSession.h>
+#include <RealtimeDatabase/CommandChannel.h>
+#include <RealtimeDatabase/RealtimeBatchWriter.h>
 
 static const char *WIFI_SSID;
 static const char *WIFI_PASSWORD;
 
-// static const char *API_KEY;
-// static const char *USER_EMAIL;
-// static const char *USER_PASSWORD;
+static const char *API_KEY;
+static const char *USER_EMAIL;
+static const char *USER_PASSWORD;
 static const char *DATABASE_URL;
 
-DefaultNetwork network; // initialize with boolean parameter to enable/disable network reconnection
+DefaultNetwork network(false); // reconnection is left to wifiLink
 FirebaseApp app;
-WiFiClientSecure sslClient;
+TracedClient<WiFiClientSecure> sslClient; // counts TLS handshakes
+EspRadio radio;
+WifiLink<EspRadio> wifiLink(radio, LittleFS); // fast reconnect to the last access point
+TracedClient<WiFiClientSecure> streamSslClient; // the stream keeps its connection open
+
+// Alarms get their own connection and send slot, so an alarm never queues behind a
+// telemetry update in flight. 0 shares the telemetry client and saves one TLS session.
+#ifndef ALARM_OWN_CLIENT
+#define ALARM_OWN_CLIENT 1
+#endif
+#if ALARM_OWN_CLIENT
+TracedClient<WiFiClientSecure> alarmSslClient;
+#endif
 using AsyncClient = AsyncClientClass;
 
+// Async results are routed by operation, each operation passes its own callback
+enum AsyncOperation : uint8_t
+{
+    OPERATION_AUTH,
+    OPERATION_UPDATE,
+    OPERATION_ALARM,
+    OPERATION_STREAM,
+    OPERATION_COMMAND,
+    OPERATION_COUNT
+};
+using Dispatcher = AsyncDispatcher<AsyncResult, OPERATION_COUNT>;
+
 AsyncClient aClient(sslClient, getNetwork(network));
+AsyncClient streamClient(streamSslClient, getNetwork(network));
+#if ALARM_OWN_CLIENT
+AsyncClient alarmClient(alarmSslClient, getNetwork(network));
+#else
+AsyncClient &alarmClient = aClient;
+#endif
 RealtimeDatabase Database;
+RealtimeBatchWriter batchWriter(aClient, Database, Dispatcher::callback<OPERATION_UPDATE>);
+RealtimeBatchWriter alarmWriter(alarmClient, Database, Dispatcher::callback<OPERATION_ALARM>); // alarms skip the telemetry batch
+CommandChannel commandChannel; // config and commands pushed down from the database
+Scheduler<4> scheduler;
+BootSequencer<8> boot;
+uint8_t ntpPhase;
+uint8_t wifiPhase;
+TaskTracer tracer; // latency of each async task from submit to result
+RateController rateController; // upload cadence from the observed round-trip time
+#if ALARM_OWN_CLIENT
+RateController alarmRate; // the in-flight slot of the alarm client
+#else
+RateController &alarmRate = rateController;
+#endif
+
+// Longest the loop may idle, the async client still has to be serviced
+#define LOOP_MAX_IDLE_MS 10
+
+// Seconds an idle connection is kept alive for the next task, longer than the longest
+// upload interval so consecutive uploads skip the TLS handshake
+#ifndef TLS_SESSION_TIMEOUT_SEC
+#define TLS_SESSION_TIMEOUT_SEC 180
+#endif
+
+// Sampling runs in its own task on the other core, so a slow TLS handshake in loop()
+// can't stall it. Samples reach loop() through a lock-free ring.
+#ifndef SAMPLING_CORE
+#define SAMPLING_CORE 0
+#endif
+#define SAMPLE_PERIOD_MS 1000
+#define SAMPLE_RING_SIZE 64
+
+struct SensorReading
+{
+    uint32_t timestamp;
+    float temperature;
+    float humidity;
+};
+SpscRing<SensorReading, SAMPLE_RING_SIZE> sampleRing;
+
+// Longest boot waits for Wi-Fi. The link keeps reconnecting in loop() and the phases
+// that need the network run once it is up.
+#ifndef WIFI_BOOT_TIMEOUT_MS
+#define WIFI_BOOT_TIMEOUT_MS 20000
+#endif
+
+// Readings at or above this are sent as alarms as well, ahead of the telemetry backlog
+#ifndef ALARM_TEMPERATURE
+#define ALARM_TEMPERATURE 90
+#endif
+#define ALARM_RING_SIZE 8
+SpscRing<SensorReading, ALARM_RING_SIZE> alarmRing;
+
+// The arbiter picks which lane with a free send slot goes next. Strict mode always sends
+// alarms first, weighted mode shares the sends by lane weight. Either way a lane waiting
+// past its max wait goes next, so alarms stay within their bound and telemetry can't
+// starve behind a burst of alarms. With ALARM_OWN_CLIENT both lanes can send at once.
+enum UploadLane : uint8_t
+{
+    LANE_CRITICAL,
+    LANE_BULK,
+    LANE_COUNT
+};
+const char *const LANE_NAMES[LANE_COUNT] = {"critical", "bulk"};
+#ifndef UPLOAD_LANE_MODE
+#define UPLOAD_LANE_MODE LANE_STRICT
+#endif
+#define ALARM_MAX_WAIT_MS 2000
+#define BULK_MAX_WAIT_MS 120000 // twice the longest upload interval
+LaneArbiter<LANE_COUNT> lanes;
+
+// Range of /config/maxInterval pushed through the command stream, whole milliseconds.
+// Lower values are ignored, higher ones clamped, so a bad write can't stop the uploads.
+#define REMOTE_MIN_INTERVAL_MS 2000
+#define REMOTE_MAX_INTERVAL_MS 300000
+
+// The stream replays /test/commands on every connect, so a command is removed from the
+// database first and only runs once the remove succeeded. It can't run twice, also not
+// after the restart it asked for.
+enum RemoteCommand : uint8_t
+{
+    COMMAND_NONE,
+    COMMAND_FLUSH,
+    COMMAND_STATS,
+    COMMAND_RESTART
+};
+RemoteCommand takenCommand = COMMAND_NONE; // waiting for its remove result
+bool flushRequested = false;               // send the telemetry batch even if it isn't ready
+bool restartRequested = false;             // restart once the writers are sent and answered
+uint32_t restartMillis = 0;
+
+// Longest a restart command waits for the results of the last updates
+#define RESTART_TIMEOUT_MS 10000
+
+// Longest setup waits for the serial monitor, runs alongside the other boot phases
+#ifndef SERIAL_WAIT_MS
+#define SERIAL_WAIT_MS 3000
+#endif
 
 FirebaseCredential firebaseCredential;
 WifiCredential wifiCredential;
-
-bool taskCompleted = false;
-
-void asyncCB(AsyncResult &aResult);
+AuthSession authSession(aClient, app, LittleFS, Dispatcher::callback<OPERATION_AUTH>);
+
+void onUpdateResult(uint8_t operation, AsyncResult &aResult);
+void onOtherResult(uint8_t operation, AsyncResult &aResult);
+void onStreamResult(uint8_t operation, AsyncResult &aResult);
+void onMaxInterval(const char *path, const JsonToken &value);
+void onCommand(const char *path, const JsonToken &value);
+void onCommandResult(uint8_t operation, AsyncResult &aResult);
+void restartWhenSent();
 void printResult(AsyncResult &aResult);
 void printError(int code, const String &msg);
 void timeStatusCB(uint32_t &ts);
+bool clockSet();
+void samplingTask(void *);
+void printTaskStats();
+void saveToken();
+void onAuthResult(uint8_t operation, AsyncResult &aResult);
+BootStatus serialReady();
+BootStatus mountFileSystem();
+BootStatus loadConfig();
+BootStatus startRadio();
+BootStatus connectWifi();
+BootStatus wifiConnected();
+BootStatus startSampling();
+BootStatus startApp();
+BootStatus appReady();
+BootStatus startTimeSync();
+BootStatus timeSynced();
 
 void setup()
 {
     Serial.begin(115200);
-    delay(3000); // wait for the serial monitor to connect
 
-    // Read configuration files
+    // Phases start as soon as their dependencies are done, so sampling starts first, the
+    // radio comes up while the config is read and NTP sync overlaps Firebase auth
+    boot.add("sampling", startSampling);
+    uint8_t fileSystemPhase = boot.add("littlefs", mountFileSystem);
+    uint8_t radioPhase = boot.add("radio", startRadio);
+    uint8_t configPhase = boot.add("config", loadConfig, nullptr, BOOT_AFTER(fileSystemPhase));
+    wifiPhase = boot.add("wifi", connectWifi, wifiConnected, BOOT_AFTER(radioPhase) | BOOT_AFTER(configPhase), WIFI_BOOT_TIMEOUT_MS);
+    ntpPhase = boot.add("ntp", startTimeSync, timeSynced, BOOT_AFTER(wifiPhase), 10000);
+    boot.add("auth", startApp, appReady, BOOT_AFTER(wifiPhase), 30000);
+    boot.add("serial", nullptr, serialReady); // wait for the serial monitor to connect
+
+    Serial.println("Starting...");
+    boot.run();
+    boot.printTimeline(Serial);
+}
+
+void loop()
+{
+    app.loop();
+    wifiLink.loop();
+    Database.loop();
+
+    // Boot gave up waiting for Wi-Fi, resume the skipped phases once the link is up
+    if (wifiLink.isConnected() && boot.retry(wifiPhase))
+        Serial.println("Wi-Fi connected, resuming boot");
+    if (!boot.succeeded())
+        boot.loop();
+
+    // Batch size and cadence follow the round-trip time of the previous updates
+    batchWriter.setMaxBatch(rateController.getBatchSize());
+    batchWriter.setMaxLatency(rateController.getInterval());
+
+    // Take the samples from the sampling task, they wait in the ring while the batch is
+    // full and an update is still in flight. Push keys encode the clock, so nothing is
+    // taken before NTP sets it, also not when the sync phase timed out and SNTP is still trying
+    if (clockSet() && !restartRequested)
+    {
+        sampleRing.drain([](const SensorReading &reading)
+                         { batchWriter.add(reading.timestamp, reading.temperature, reading.humidity); },
+                         batchWriter.space());
+        alarmRing.drain([](const SensorReading &reading)
+                        { alarmWriter.add(reading.timestamp, reading.temperature, reading.humidity); },
+                        alarmWriter.space());
+    }
+
+    // Alarms are sent as soon as their slot is free, samples as one multi-location update
+    // once the batch is full or the latency budget expires
+    for (uint8_t send = 0; send < LANE_COUNT && wifiLink.isConnected() && app.ready(); send++)
+    {
+        if (alarmWriter.pending() && alarmRate.canSend())
+            lanes.offer(LANE_CRITICAL, alarmWriter.getAge());
+        if ((batchWriter.ready() || (flushRequested && batchWriter.pending())) && rateController.canSend())
+            lanes.offer(LANE_BULK, batchWriter.getAge());
+
+        int8_t lane = lanes.next();
+        if (lane == LANE_CRITICAL)
+        {
+            Serial.printf("Sending %u alarms... \n", (unsigned)alarmWriter.pending());
+            if (alarmWriter.flush())
+                alarmRate.onSubmit(alarmWriter.getLastRequest());
+        }
+        else if (lane == LANE_BULK)
+        {
+            Serial.printf("Updating %u JSON objects... \n", (unsigned)batchWriter.pending());
+            HEAP_SCOPE(Update);
+            BENCHMARK_MICROS_BEGIN(UPDATE)
+            if (batchWriter.flush())
+                rateController.onSubmit(batchWriter.getLastRequest());
+            flushRequested = false;
+            BENCHMARK_MICROS_END(UPDATE)
+        }
+        else
+            break;
+    }
+    if (!batchWriter.pending())
+        flushRequested = false; // nothing was waiting for the flush command
+
+    if (restartRequested)
+        restartWhenSent();
+
+    BENCHMARK_PRINT_EVERY(60000);
+    HEAP_PRINT_EVERY(60000);
+
+    // Sleep until the next task is due instead of spinning
+    uint32_t idle = scheduler.run();
+    delay(idle < LOOP_MAX_IDLE_MS ? idle : LOOP_MAX_IDLE_MS);
+}
+
+BootStatus serialReady() { return Serial || millis() >= SERIAL_WAIT_MS ? BOOT_DONE : BOOT_PENDING; }
+
+BootStatus mountFileSystem()
+{
     if (!LittleFS.begin())
     {
         Serial.println("An Error has occurred while mounting LittleFS");
-        return;
+        return BOOT_FAILED;
     }
+    return BOOT_DONE;
+}
 
+BootStatus loadConfig()
+{
+    HEAP_SCOPE(Credentials);
     CredentialsManager credentialsManager(LittleFS);
-    firebaseCredential = credentialsManager.getFirebaseCredential();
-    wifiCredential = credentialsManager.getWifiCredential();
+    BENCHMARK_MICROS_BEGIN(ConfigLoad);
+    credentialsManager.getCredentials(wifiCredential, firebaseCredential);
+    BENCHMARK_MICROS_END(ConfigLoad);
 
     if (wifiCredential.isEmpty())
     {
         Serial.println("Failed to read configuration file");
-        return;
+        return BOOT_FAILED;
     }
     WIFI_SSID = wifiCredential.ssid.c_str();
     WIFI_PASSWORD = wifiCredential.password.c_str();
@@ -88,85 +346,275 @@ void setup()
     if (firebaseCredential.isEmpty())
     {
         Serial.println("Firebase configuration is empty");
-        return;
+        return BOOT_FAILED;
     }
-    // API_KEY = firebaseCredential.apiKey.c_str();
-    // USER_EMAIL = firebaseCredential.userEmail.c_str();
-    // USER_PASSWORD = firebaseCredential.userPassword.c_str();
+    API_KEY = firebaseCredential.apiKey.c_str();
+    USER_EMAIL = firebaseCredential.userEmail.c_str();
+    USER_PASSWORD = firebaseCredential.userPassword.c_str();
     DATABASE_URL = firebaseCredential.realtimeDbUrl.c_str();
+    return BOOT_DONE;
+}
 
-    // Connect to Wi-Fi
+BootStatus startRadio()
+{
     WiFi.mode(WIFI_STA); // explicitly set mode, esp defaults to STA+AP
-    WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
+    return BOOT_DONE;
+}
 
-    Serial.print("Connecting to Wi-Fi");
-    while (WiFi.status() != WL_CONNECTED)
-    {
-        Serial.print(".");
-        delay(300);
-    }
-    Serial.println();
-    Serial.print("Connected with IP: ");
+BootStatus connectWifi()
+{
+    if (wifiLink.getState() != LINK_IDLE)
+        return BOOT_PENDING; // retried after the boot timeout, the link is already connecting
+    Serial.println("Connecting to Wi-Fi...");
+    wifiLink.begin(WIFI_SSID, WIFI_PASSWORD);
+    return BOOT_PENDING;
+}
+
+BootStatus wifiConnected()
+{
+    if (wifiLink.loop() != LINK_CONNECTED)
+        return BOOT_PENDING;
+    Serial.printf("Connected in %lu ms with IP: ", (unsigned long)wifiLink.getLastConnectTime());
     Serial.println(WiFi.localIP());
+    return BOOT_DONE;
+}
 
-    // Setup Firebase
+BootStatus startApp()
+{
     Firebase.printf("Firebase Client v%s\n", FIREBASE_CLIENT_VERSION);
     sslClient.setInsecure();
+    aClient.setSessionTimeout(TLS_SESSION_TIMEOUT_SEC);
+    streamSslClient.setInsecure();
+#if ALARM_OWN_CLIENT
+    alarmSslClient.setInsecure();
+    alarmClient.setSessionTimeout(TLS_SESSION_TIMEOUT_SEC);
+    alarmRate.setRequestTimeout(10000);
+#endif
 
     Serial.println("Initializing the app...");
-    // UserAuth userAuth(API_KEY, USER_EMAIL, USER_PASSWORD);
-    NoAuth userAuth;
-    initializeApp(aClient, app, getAuth(userAuth), asyncCB, "authTask");
+    authSession.begin(firebaseCredential);
     app.getApp<RealtimeDatabase>(Database);
     Database.url(DATABASE_URL);
     Serial.println("Initialized the app");
 
-    // Set time using NTP server
-    tm timeinfo;
+    batchWriter.begin("/test/json");
+    alarmWriter.begin("/test/alarms");
+    alarmWriter.setOperation("alarmTask");
+
+    Dispatcher::instance().on(OPERATION_AUTH, onAuthResult).on(OPERATION_UPDATE, onUpdateResult).on(OPERATION_ALARM, onUpdateResult).on(OPERATION_STREAM, onStreamResult).on(OPERATION_COMMAND, onCommandResult).otherwise(onOtherResult);
+    batchWriter.setTracer(&tracer);
+    alarmWriter.setTracer(&tracer);
+    lanes.setMode(UPLOAD_LANE_MODE)
+        .setWeight(LANE_CRITICAL, 3)
+        .setWeight(LANE_BULK, 1)
+        .setMaxWait(LANE_CRITICAL, ALARM_MAX_WAIT_MS)
+        .setMaxWait(LANE_BULK, BULK_MAX_WAIT_MS);
+    rateController.setInterval(REMOTE_MIN_INTERVAL_MS, 60000, 1000) // send every 2 to 60 seconds
+        .setBatch(1, REALTIME_BATCH_CAPACITY, SAMPLE_PERIOD_MS)
+        .setTargetLatency(3000)
+        .setRequestTimeout(30000);
+
+    // Listen for commands next to the samples, keep-alive events are filtered out by the client
+    commandChannel.on("/config/maxInterval", onMaxInterval);
+    commandChannel.on("/command", onCommand);
+    streamClient.setSSEFilters("put,patch,cancel,auth_revoked");
+    Database.get(streamClient, "/test/commands", Dispatcher::callback<OPERATION_STREAM>, true /* SSE mode */, "streamTask");
+
+    scheduler.every(60000, printTaskStats);
+    scheduler.every(10000, saveToken);
+    return BOOT_PENDING;
+}
+
+BootStatus appReady()
+{
+    // NTP sync runs alongside, a cached token waits for it instead of signing in
+    BootPhaseState ntp = boot.getState(ntpPhase);
+    if (!authSession.ready(time(nullptr), ntp == BOOT_PHASE_WAITING || ntp == BOOT_PHASE_RUNNING))
+        return BOOT_PENDING;
+    Serial.printf("App ready in %lu ms (%s)\n", (unsigned long)(millis() - authSession.getStartMillis()), authSession.isFromCache() ? "cached token" : "sign-in");
+    return BOOT_DONE;
+}
+
+// Stores the token after every refresh, the next boot restores it
+void saveToken() { authSession.save(time(nullptr)); }
+
+// Set time using NTP server
+BootStatus startTimeSync()
+{
     configTzTime("UTC0", "0.pool.ntp.org", "1.pool.ntp.org", "2.pool.ntp.org");
-    getLocalTime(&timeinfo);
+    return BOOT_PENDING;
+}
+
+BootStatus timeSynced()
+{
+    if (time(nullptr) < FIREBASE_DEFAULT_TS)
+        return BOOT_PENDING;
+    tm timeinfo;
+    getLocalTime(&timeinfo, 0);
     Serial.println(&timeinfo, "%A, %B %d %Y %H:%M:%S");
+    return BOOT_DONE;
 }
 
-void loop()
+// True once NTP set the clock the push keys are built from
+bool clockSet() { return time(nullptr) >= FIREBASE_DEFAULT_TS; }
+
+// Readings carry millis(), they need no clock and are taken from the first phase on
+BootStatus startSampling()
 {
-    app.loop();
-    Database.loop();
+    xTaskCreatePinnedToCore(samplingTask, "sampling", 4096, NULL, 1, NULL, SAMPLING_CORE);
+    return BOOT_DONE;
+}
+
+void samplingTask(void *)
+{
+    TickType_t wake = xTaskGetTickCount();
+    for (;;)
+    {
+        SensorReading reading;
+        reading.timestamp = millis();
+        reading.temperature = random(0, 1000) / 11.0;
+        reading.humidity = random(0, 1000) / 11.0;
+        sampleRing.push(reading); // counted as dropped if loop() falls behind
+        if (reading.temperature >= ALARM_TEMPERATURE)
+            alarmRing.push(reading);
+
+        vTaskDelayUntil(&wake, pdMS_TO_TICKS(SAMPLE_PERIOD_MS));
+    }
+}
+
+void printTaskStats()
+{
+    tracer.expire(60000); // results older than this are not coming
+    tracer.print(Serial);
+    sslClient.print(Serial, "tls");
+    streamSslClient.print(Serial, "tls stream");
+#if ALARM_OWN_CLIENT
+    alarmSslClient.print(Serial, "tls alarm");
+#endif
+    wifiLink.print(Serial);
+    Serial.printf("rate: interval=%lu ms batch=%u in-flight=%u increases=%lu decreases=%lu timeouts=%lu late=%lu\n",
+                  (unsigned long)rateController.getInterval(), (unsigned)rateController.getBatchSize(), rateController.getInFlight(),
+                  (unsigned long)rateController.getIncreases(), (unsigned long)rateController.getDecreases(), (unsigned long)rateController.getTimeouts(),
+                  (unsigned long)rateController.getLate());
+    Serial.printf("samples: taken=%lu dropped=%lu failed=%lu retries=%lu\n", (unsigned long)sampleRing.getPushed(), (unsigned long)sampleRing.getDropped(),
+                  (unsigned long)batchWriter.getFailedSamples(), (unsigned long)batchWriter.getRetryCount());
+    Serial.printf("alarms: raised=%lu dropped=%lu sent=%lu failed=%lu\n", (unsigned long)alarmRing.getPushed(), (unsigned long)alarmRing.getDropped(),
+                  (unsigned long)alarmWriter.getSampleCount(), (unsigned long)alarmWriter.getFailedSamples());
+    lanes.print(Serial, LANE_NAMES);
+    Serial.printf("commands: events=%lu handled=%lu errors=%lu\n", (unsigned long)commandChannel.getEventCount(),
+                  (unsigned long)commandChannel.getCommandCount(), (unsigned long)commandChannel.getErrorCount());
+}
+
+// Runs for every update result, only a final result reads the uid and only an error is printed
+void onUpdateResult(uint8_t operation, AsyncResult &aResult)
+{
+    if (!aResult.isError() && !aResult.available())
+        return; // events and debug output of the request
+
+    String uid = aResult.uid();
+    tracer.complete(uid.c_str(), aResult.isError());
+    uint16_t request = TaskTracer::sequenceOf(uid.c_str());
+    RateController &rate = operation == OPERATION_ALARM ? alarmRate : rateController; // frees the slot of its lane
+    rate.onComplete(request, aResult.isError());
+    RealtimeBatchWriter &writer = operation == OPERATION_ALARM ? alarmWriter : batchWriter; // sends a failed update again
+    writer.onResult(request, aResult.isError());
+    if (aResult.isError())
+        printResult(aResult);
+}
 
-    if (app.ready() && !taskCompleted)
+// Stream events carry the changed path and its new value, the event is tokenized in place
+void onStreamResult(uint8_t, AsyncResult &aResult)
+{
+    if (aResult.isError())
+    {
+        printResult(aResult);
+        return;
+    }
+    if (!aResult.available())
+        return;
+
+    HEAP_SCOPE(Stream);
+    // The raw event text, event(), dataPath() and data() would each copy it into a String
+    if (!commandChannel.handleEvent(aResult.c_str()))
+        Firebase.printf("Invalid command event\n");
+}
+
+void onMaxInterval(const char *, const JsonToken &value)
+{
+    if (!value.isInteger() || value.toDouble() < REMOTE_MIN_INTERVAL_MS)
+        return; // fractions, exponents, other types and too short intervals
+    double maxInterval = value.toDouble();
+    rateController.setInterval(REMOTE_MIN_INTERVAL_MS, maxInterval > REMOTE_MAX_INTERVAL_MS ? REMOTE_MAX_INTERVAL_MS : (uint32_t)maxInterval, 1000);
+}
+
+// Takes the command off the database, it runs from onCommandResult()
+void onCommand(const char *, const JsonToken &value)
+{
+    if (value.type != JSON_STRING || takenCommand != COMMAND_NONE)
+        return; // the null of our own remove, or the next command before the last one is taken
+
+    if (value.equals("flush"))
+        takenCommand = COMMAND_FLUSH;
+    else if (value.equals("stats"))
+        takenCommand = COMMAND_STATS;
+    else if (value.equals("restart"))
+        takenCommand = COMMAND_RESTART;
+    else
+        return;
+    Database.remove(aClient, "/test/commands/command", Dispatcher::callback<OPERATION_COMMAND>, "commandTask");
+}
+
+void onCommandResult(uint8_t, AsyncResult &aResult)
+{
+    if (!aResult.isError() && !aResult.available())
+        return;
+    RemoteCommand command = takenCommand;
+    takenCommand = COMMAND_NONE;
+    if (aResult.isError())
     {
-        taskCompleted = true;
-
-        Serial.print("Pushing the JSON object... ");
-        uint32_t ms = millis();
-        float temperature = random(0, 1000) / 11.0;
-        float humidity = random(0, 1000) / 11.0;
-        String json = "{\"timestamp\": " + String(ms) + ", \"temperature\": " + String(temperature) + ", \"humidity\": " + String(humidity) + "}";
-        object_t obj = object_t(json);
-        BENCHMARK_MICROS_BEGIN(PUSH)
-        Database.push<object_t>(aClient, "/test/json", object_t("{\"data\":123}"), asyncCB, "pushJsonTask1");
-        BENCHMARK_MICROS_END(PUSH)
-
-        // object_t json, obj1, obj2, obj3, obj4;
-        // JsonWriter writer;
-        // writer.create(obj1, "int/value", 9999);
-        // writer.create(obj2, "string/value", string_t("hello"));
-        // writer.create(obj3, "float/value", number_t(123.456, 2));
-        // writer.join(obj4, 3 /* no. of object_t (s) to join */, obj1, obj2, obj3);
-        // writer.create(json, "node/list", obj4);
-        // Database.push<object_t>(aClient, "/test/json", json, asyncCB, "pushJsonTask2");
+        printResult(aResult); // still in the database, the stream delivers it again on the next connect
+        return;
     }
 
-    EVERY_N_MILLIS(10000)
+    if (command == COMMAND_FLUSH)
+        flushRequested = true; // sent through the bulk lane and its slot
+    else if (command == COMMAND_STATS)
+        printTaskStats();
+    else if (command == COMMAND_RESTART)
     {
-        taskCompleted = false;
+        Serial.println("Restarting once the pending samples are sent...");
+        restartRequested = true;
+        restartMillis = millis();
     }
 }
 
-void asyncCB(AsyncResult &aResult) { printResult(aResult); }
+// Ends both writers as their slots free up, restarts once nothing is queued or in flight
+// anymore, or after RESTART_TIMEOUT_MS. Readings still in the rings are lost.
+void restartWhenSent()
+{
+    if (rateController.canSend() && batchWriter.end())
+        rateController.onSubmit(batchWriter.getLastRequest());
+    if (alarmRate.canSend() && alarmWriter.end())
+        alarmRate.onSubmit(alarmWriter.getLastRequest());
+
+    bool sent = !batchWriter.pending() && !alarmWriter.pending() && !rateController.getInFlight() && !alarmRate.getInFlight();
+    if (sent || millis() - restartMillis >= RESTART_TIMEOUT_MS)
+        ESP.restart();
+}
+
+// Drops a cached token the server rejected, appReady() signs in again
+void onAuthResult(uint8_t operation, AsyncResult &aResult)
+{
+    authSession.onResult(aResult);
+    onOtherResult(operation, aResult);
+}
+
+// Auth and anything else that is rare enough to print in full
+void onOtherResult(uint8_t, AsyncResult &aResult) { printResult(aResult); }
 
 void printResult(AsyncResult &aResult)
 {
+    HEAP_SCOPE(PrintResult);
     if (aResult.isEvent())
     {
         Firebase.printf("Event task: %s, msg: %s, code: %d\n", aResult.uid().c_str(), aResult.appEvent().message().c_str(), aResult.appEvent().code());
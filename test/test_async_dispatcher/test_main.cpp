@@ -0,0 +1,183 @@
+#include <unity.h>
+
+#include <Arduino.h>
+#include <FirebaseClient.h>
+
+#include <AsyncDispatcher.h>
+
+// Per-operation result routing on the mock endpoint, and the callbacks per second of the
+// dispatch table against routing by uid
+
+#define OPERATION_AUTH 0
+#define OPERATION_UPDATE 1
+#define OPERATION_STREAM 2
+#define OPERATION_COUNT 3
+
+#define BENCHMARK_CALLS 1000000
+
+using Dispatcher = AsyncDispatcher<AsyncResult, OPERATION_COUNT>;
+
+// Stand-in result for the table alone, any type with isError() works
+struct FakeResult
+{
+    bool error;
+    bool isError() { return error; }
+};
+
+using FakeDispatcher = AsyncDispatcher<FakeResult, 2>;
+
+AsyncClientClass aClient;
+RealtimeDatabase Database;
+uint32_t calls[OPERATION_COUNT];
+uint32_t fallbackCalls;
+uint8_t lastOperation;
+AsyncResult lastResult;
+
+void onResult(uint8_t operation, AsyncResult &aResult)
+{
+    calls[operation]++;
+    lastOperation = operation;
+    lastResult = aResult;
+}
+
+void onOtherResult(uint8_t operation, AsyncResult &aResult)
+{
+    fallbackCalls++;
+    lastOperation = operation;
+}
+
+// Touches nothing of the result, the cost of the routing alone
+void onCount(uint8_t operation, AsyncResult &aResult) { calls[operation]++; }
+
+void onFakeResult(uint8_t operation, FakeResult &result) { calls[operation]++; }
+
+// The routing the sketches did before the table: build the uid and compare it
+void routeByUid(AsyncResult &aResult)
+{
+    String uid = aResult.uid();
+    if (uid == "authTask")
+        calls[OPERATION_AUTH]++;
+    else if (uid.startsWith("updateTask"))
+        calls[OPERATION_UPDATE]++;
+    else if (uid == "streamTask")
+        calls[OPERATION_STREAM]++;
+}
+
+static void runFor(uint32_t millis)
+{
+    for (uint32_t end = ::millis() + millis; ::millis() < end;)
+    {
+        FakeClock::instance().advanceMillis(10);
+        Database.loop();
+    }
+}
+
+void setUp(void)
+{
+    FakeClock::instance().set(0);
+    aClient = AsyncClientClass();
+    memset(calls, 0, sizeof(calls));
+    fallbackCalls = 0;
+    lastOperation = 0xFF;
+    Dispatcher::instance().on(OPERATION_AUTH, nullptr).on(OPERATION_UPDATE, nullptr).on(OPERATION_STREAM, nullptr).otherwise(nullptr);
+}
+
+void tearDown(void) {}
+
+void test_results_reach_the_handler_of_their_operation(void)
+{
+    Dispatcher::instance().on(OPERATION_UPDATE, onResult);
+    Database.update(aClient, "/test/a", object_t("{\"v\":1}"), Dispatcher::callback<OPERATION_UPDATE>, "updateTask#1");
+    Database.update(aClient, "/test/b", object_t("{\"v\":2}"), Dispatcher::callback<OPERATION_UPDATE>, "updateTask#2");
+    runFor(500);
+
+    TEST_ASSERT_EQUAL(2, calls[OPERATION_UPDATE]);
+    TEST_ASSERT_EQUAL(OPERATION_UPDATE, lastOperation);
+    String uid = lastResult.uid();
+    TEST_ASSERT_EQUAL_STRING("updateTask#2", uid.c_str());
+    TEST_ASSERT_EQUAL(2, Dispatcher::instance().getResults(OPERATION_UPDATE));
+    TEST_ASSERT_EQUAL(0, Dispatcher::instance().getResults(OPERATION_AUTH));
+}
+
+void test_errors_are_counted_per_operation(void)
+{
+    Dispatcher::instance().on(OPERATION_AUTH, onResult);
+    uint32_t before = Dispatcher::instance().getErrors(OPERATION_AUTH);
+    aClient.setErrorRate(100);
+    Database.get(aClient, "/auth", Dispatcher::callback<OPERATION_AUTH>, false, "authTask");
+    runFor(500);
+
+    TEST_ASSERT_EQUAL(1, calls[OPERATION_AUTH]);
+    TEST_ASSERT_TRUE(lastResult.isError());
+    TEST_ASSERT_EQUAL(before + 1, Dispatcher::instance().getErrors(OPERATION_AUTH));
+}
+
+void test_operations_without_a_handler_use_the_fallback(void)
+{
+    Dispatcher::instance().on(OPERATION_UPDATE, onResult).otherwise(onOtherResult);
+    Database.get(aClient, "/config", Dispatcher::callback<OPERATION_STREAM>, false, "streamTask");
+    runFor(500);
+
+    TEST_ASSERT_EQUAL(1, fallbackCalls);
+    TEST_ASSERT_EQUAL(OPERATION_STREAM, lastOperation);
+    TEST_ASSERT_EQUAL(0, calls[OPERATION_UPDATE]);
+}
+
+void test_unrouted_and_out_of_range_results_are_dropped(void)
+{
+    FakeResult result = {true};
+    FakeDispatcher::instance().dispatch(0, result); // no handler, no fallback
+    FakeDispatcher::instance().dispatch(2, result);
+    FakeDispatcher::instance().on(5, onFakeResult);
+    TEST_ASSERT_EQUAL(1, FakeDispatcher::instance().getResults(0));
+    TEST_ASSERT_EQUAL(1, FakeDispatcher::instance().getErrors(0));
+    TEST_ASSERT_EQUAL(0, FakeDispatcher::instance().getResults(2));
+
+    FakeDispatcher::instance().on(1, onFakeResult);
+    FakeResult ok = {false};
+    FakeDispatcher::callback<1>(ok);
+    TEST_ASSERT_EQUAL(1, calls[1]);
+    TEST_ASSERT_EQUAL(0, FakeDispatcher::instance().getErrors(1));
+}
+
+static uint64_t nowNanos()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void test_benchmark_callbacks_per_second(void)
+{
+    Dispatcher::instance().on(OPERATION_STREAM, onResult);
+    Database.get(aClient, "/config", Dispatcher::callback<OPERATION_STREAM>, false, "streamTask");
+    runFor(500);
+    AsyncResult result = lastResult;
+
+    Dispatcher::instance().on(OPERATION_STREAM, onCount);
+    memset(calls, 0, sizeof(calls));
+    uint64_t start = nowNanos();
+    for (uint32_t i = 0; i < BENCHMARK_CALLS; i++)
+        Dispatcher::callback<OPERATION_STREAM>(result);
+    uint64_t tableNanos = nowNanos() - start;
+    TEST_ASSERT_EQUAL(BENCHMARK_CALLS, calls[OPERATION_STREAM]);
+
+    memset(calls, 0, sizeof(calls));
+    start = nowNanos();
+    for (uint32_t i = 0; i < BENCHMARK_CALLS; i++)
+        routeByUid(result);
+    uint64_t uidNanos = nowNanos() - start;
+    TEST_ASSERT_EQUAL(BENCHMARK_CALLS, calls[OPERATION_STREAM]);
+
+    Serial.printf("dispatch table: %.1f M callbacks/s, uid compare: %.1f M callbacks/s\n",
+                  BENCHMARK_CALLS * 1e3 / tableNanos, BENCHMARK_CALLS * 1e3 / uidNanos);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_results_reach_the_handler_of_their_operation);
+    RUN_TEST(test_errors_are_counted_per_operation);
+    RUN_TEST(test_operations_without_a_handler_use_the_fallback);
+    RUN_TEST(test_unrouted_and_out_of_range_results_are_dropped);
+    RUN_TEST(test_benchmark_callbacks_per_second);
+    return UNITY_END();
+}
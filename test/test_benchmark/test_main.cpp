@@ -0,0 +1,161 @@
+#include <unity.h>
+
+#include <Arduino.h>
+
+#define DEBUG_BENCHMARK 1
+#define DEBUG_BENCHMARK_MAX_LABELS 8
+#include <Benchmark.h>
+
+// Benchmark stats and registry, timed with the frozen FakeClock
+
+// Collects printed summaries
+struct CapturePrint
+{
+    String text;
+
+    size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)))
+    {
+        char line[256];
+        va_list args;
+        va_start(args, format);
+        int written = vsnprintf(line, sizeof(line), format, args);
+        va_end(args);
+        text += line;
+        return written;
+    }
+};
+
+void setUp(void)
+{
+    FakeClock::instance().set(0);
+    BenchmarkRegistry::instance().reset();
+}
+
+void tearDown(void) {}
+
+void test_stats_summary(void)
+{
+    BenchmarkStats stats;
+    TEST_ASSERT_EQUAL(0, stats.mean());
+    TEST_ASSERT_EQUAL(0, stats.percentile(50));
+
+    for (uint32_t value = 1; value <= 1000; value++)
+        stats.add(value);
+    TEST_ASSERT_EQUAL(1000, stats.count);
+    TEST_ASSERT_EQUAL(1, stats.min);
+    TEST_ASSERT_EQUAL(1000, stats.max);
+    TEST_ASSERT_EQUAL(500, stats.mean());
+}
+
+// Buckets are a quarter of a power of two wide, so estimates are within 12.5 %
+void test_percentiles_within_bucket_error(void)
+{
+    BenchmarkStats stats;
+    for (uint32_t value = 1; value <= 10000; value++)
+        stats.add(value);
+    TEST_ASSERT_UINT32_WITHIN(5000 / 8, 5000, stats.percentile(50));
+    TEST_ASSERT_UINT32_WITHIN(9500 / 8, 9500, stats.percentile(95));
+    TEST_ASSERT_UINT32_WITHIN(9900 / 8, 9900, stats.percentile(99));
+    TEST_ASSERT_EQUAL(10000, stats.percentile(100));
+
+    BenchmarkStats single;
+    single.add(777);
+    TEST_ASSERT_EQUAL(777, single.percentile(50));
+    TEST_ASSERT_EQUAL(777, single.percentile(99));
+}
+
+void test_small_values_are_exact(void)
+{
+    BenchmarkStats stats;
+    stats.add(0);
+    stats.add(1);
+    stats.add(2);
+    stats.add(3);
+    TEST_ASSERT_EQUAL(0, stats.percentile(25));
+    TEST_ASSERT_EQUAL(1, stats.percentile(50));
+    TEST_ASSERT_EQUAL(3, stats.percentile(100));
+}
+
+void test_registry_resolves_labels_once(void)
+{
+    BenchmarkRegistry &registry = BenchmarkRegistry::instance();
+    char label[] = "Update";
+    BenchmarkStats *stats = registry.get("Update");
+    TEST_ASSERT_TRUE(stats == registry.get(label)); // equal text, another pointer
+    TEST_ASSERT_TRUE(stats != registry.get("Commit"));
+}
+
+void test_labels_past_the_table_are_not_printed(void)
+{
+    BenchmarkRegistry &registry = BenchmarkRegistry::instance();
+    const char *labels[] = {"L0", "L1", "L2", "L3", "L4", "L5", "L6", "L7", "L8", "L9"};
+    for (const char *label : labels)
+        registry.get(label)->add(10);
+
+    CapturePrint out;
+    registry.print(out);
+    TEST_ASSERT_TRUE(out.text.indexOf("Update: n=") < 0); // reset labels with no samples are skipped
+    TEST_ASSERT_TRUE(out.text.indexOf("L3: n=1 min=10 mean=10 max=10 p50=10 p95=10 p99=10 us") >= 0);
+    TEST_ASSERT_TRUE(out.text.indexOf("L9") < 0);
+    TEST_ASSERT_TRUE(registry.get("L8") == registry.get("L9")); // both share the overflow stats
+}
+
+void test_macros_record_elapsed_time(void)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        BENCHMARK_BEGIN(Span);
+        FakeClock::instance().advance(1500 + i * 500);
+        BENCHMARK_END(Span);
+
+        BENCHMARK_MICROS_BEGIN(Tight);
+        FakeClock::instance().advance(20);
+        BENCHMARK_MICROS_END(Tight);
+    }
+
+    BenchmarkStats *span = BenchmarkRegistry::instance().get("Span");
+    TEST_ASSERT_EQUAL(3, span->count);
+    TEST_ASSERT_EQUAL(1500, span->min);
+    TEST_ASSERT_EQUAL(2500, span->max);
+    TEST_ASSERT_EQUAL(20, BenchmarkRegistry::instance().get("Tight")->mean());
+}
+
+void test_print_every_resets_after_printing(void)
+{
+    BenchmarkStats *stats = BenchmarkRegistry::instance().get("Update");
+    for (int second = 0; second < 4; second++)
+    {
+        stats->add(100);
+        FakeClock::instance().advanceMillis(1000);
+        BENCHMARK_PRINT_EVERY(2000); // the period starts with the first call
+    }
+    TEST_ASSERT_EQUAL(1, stats->count); // printed and cleared at 3 s, one sample since
+}
+
+// Recording is a few additions, cheap enough to leave in hot paths
+void test_benchmark_recording_cost(void)
+{
+    FakeClock::instance().unfreeze();
+    BenchmarkStats stats;
+    const uint32_t samples = 1000000;
+    uint32_t start = micros();
+    for (uint32_t i = 0; i < samples; i++)
+        stats.add(i & 0xFFFF);
+    uint32_t elapsed = micros() - start;
+    TEST_ASSERT_EQUAL(samples, stats.count);
+    Serial.printf("BenchmarkStats::add: %lu ns/sample\n", (unsigned long)(elapsed * 1000ULL / samples));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_stats_summary);
+    RUN_TEST(test_percentiles_within_bucket_error);
+    RUN_TEST(test_small_values_are_exact);
+    RUN_TEST(test_registry_resolves_labels_once);
+    RUN_TEST(test_macros_record_elapsed_time);
+    RUN_TEST(test_print_every_resets_after_printing);
+    RUN_TEST(test_labels_past_the_table_are_not_printed);
+    RUN_TEST(test_benchmark_recording_cost);
+    return UNITY_END();
+}
@@ -0,0 +1,193 @@
+#include <unity.h>
+
+#include <Arduino.h>
+
+#include <BootSequencer.h>
+
+// Boot phases as a dependency graph on the frozen FakeClock. Phases finish at fixed
+// times since boot, e.g. Wi-Fi at 300 ms and the config read at 100 ms.
+
+uint32_t starts;
+
+// Collects the printed timeline
+struct CapturePrint
+{
+    String text;
+
+    size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)))
+    {
+        char line[128];
+        va_list args;
+        va_start(args, format);
+        int written = vsnprintf(line, sizeof(line), format, args);
+        va_end(args);
+        text += line;
+        return written;
+    }
+};
+
+template <uint32_t Millis>
+BootStatus doneAt() { return millis() >= Millis ? BOOT_DONE : BOOT_PENDING; }
+
+BootStatus startPhase()
+{
+    starts++;
+    return BOOT_PENDING;
+}
+
+BootStatus startDone()
+{
+    starts++;
+    return BOOT_DONE;
+}
+
+BootStatus startFailed() { return BOOT_FAILED; }
+BootStatus never() { return BOOT_PENDING; }
+
+void setUp(void)
+{
+    FakeClock::instance().set(0);
+    starts = 0;
+}
+
+void tearDown(void) {}
+
+static void runFor(BootSequencer<8> &boot, uint32_t millis)
+{
+    for (uint32_t ms = 0; ms < millis && !boot.loop(); ms++)
+        delay(1);
+}
+
+void test_independent_phases_overlap(void)
+{
+    BootSequencer<8> boot;
+    uint8_t config = boot.add("config", startPhase, doneAt<100>);
+    uint8_t wifi = boot.add("wifi", startPhase, doneAt<300>, BOOT_AFTER(config));
+    uint8_t ntp = boot.add("ntp", startPhase, doneAt<500>, BOOT_AFTER(wifi));
+    uint8_t auth = boot.add("auth", startPhase, doneAt<450>, BOOT_AFTER(wifi));
+    uint8_t app = boot.add("app", startDone, nullptr, BOOT_AFTER(ntp) | BOOT_AFTER(auth));
+
+    TEST_ASSERT_TRUE(boot.run(10000));
+    TEST_ASSERT_EQUAL(5, starts);
+    TEST_ASSERT_EQUAL(100, boot.getDuration(config));
+    TEST_ASSERT_EQUAL(200, boot.getDuration(wifi));
+    TEST_ASSERT_EQUAL(200, boot.getDuration(ntp)); // ntp and auth both started at 300 ms
+    TEST_ASSERT_EQUAL(150, boot.getDuration(auth));
+    TEST_ASSERT_EQUAL(BOOT_PHASE_DONE, boot.getState(app));
+    TEST_ASSERT_EQUAL(500, boot.getTotal()); // a chain would take 650 ms
+}
+
+// Phases that finish in start() let their dependents start in the same loop()
+void test_immediate_phases_finish_in_one_pass(void)
+{
+    BootSequencer<8> boot;
+    uint8_t first = boot.add("mount", startDone);
+    uint8_t second = boot.add("config", startDone, nullptr, BOOT_AFTER(first));
+    boot.add("sampling", startDone, nullptr, BOOT_AFTER(second));
+    TEST_ASSERT_TRUE(boot.loop());
+    TEST_ASSERT_TRUE(boot.succeeded());
+    TEST_ASSERT_EQUAL(3, starts);
+}
+
+void test_failure_skips_dependents(void)
+{
+    BootSequencer<8> boot;
+    uint8_t mount = boot.add("mount", startFailed);
+    uint8_t config = boot.add("config", startPhase, doneAt<10>, BOOT_AFTER(mount));
+    uint8_t wifi = boot.add("wifi", startPhase, doneAt<20>, BOOT_AFTER(config));
+    uint8_t clock = boot.add("clock", startPhase, doneAt<30>);
+
+    TEST_ASSERT_FALSE(boot.run(1000));
+    TEST_ASSERT_EQUAL(BOOT_PHASE_FAILED, boot.getState(mount));
+    TEST_ASSERT_EQUAL(BOOT_PHASE_SKIPPED, boot.getState(config));
+    TEST_ASSERT_EQUAL(BOOT_PHASE_SKIPPED, boot.getState(wifi));
+    TEST_ASSERT_EQUAL(BOOT_PHASE_DONE, boot.getState(clock));
+    TEST_ASSERT_EQUAL(1, starts); // only the independent phase ran
+}
+
+void test_timeout_fails_a_phase(void)
+{
+    BootSequencer<8> boot;
+    uint8_t wifi = boot.add("wifi", startPhase, never, 0, 250);
+    uint8_t app = boot.add("app", startDone, nullptr, BOOT_AFTER(wifi));
+
+    runFor(boot, 1000);
+    TEST_ASSERT_EQUAL(BOOT_PHASE_FAILED, boot.getState(wifi));
+    TEST_ASSERT_EQUAL(BOOT_PHASE_SKIPPED, boot.getState(app));
+    TEST_ASSERT_EQUAL(250, boot.getDuration(wifi));
+    TEST_ASSERT_FALSE(boot.succeeded());
+}
+
+// A timed out Wi-Fi phase is retried later, the phases it skipped run after it
+void test_retry_restarts_a_failed_phase_and_its_dependents(void)
+{
+    BootSequencer<8> boot;
+    uint8_t sampling = boot.add("sampling", startDone);
+    uint8_t wifi = boot.add("wifi", startPhase, doneAt<1500>, 0, 1000);
+    uint8_t ntp = boot.add("ntp", startPhase, doneAt<1600>, BOOT_AFTER(wifi));
+    uint8_t auth = boot.add("auth", startPhase, doneAt<1700>, BOOT_AFTER(ntp));
+
+    TEST_ASSERT_FALSE(boot.run(5000));
+    TEST_ASSERT_EQUAL(1000, millis()); // gave up at the phase timeout
+    TEST_ASSERT_EQUAL(BOOT_PHASE_DONE, boot.getState(sampling));
+    TEST_ASSERT_EQUAL(BOOT_PHASE_SKIPPED, boot.getState(auth));
+    TEST_ASSERT_FALSE(boot.retry(sampling));
+    TEST_ASSERT_FALSE(boot.retry(ntp));
+
+    TEST_ASSERT_TRUE(boot.retry(wifi));
+    TEST_ASSERT_EQUAL(BOOT_PHASE_WAITING, boot.getState(auth));
+    TEST_ASSERT_TRUE(boot.run(5000));
+    TEST_ASSERT_EQUAL(1700, millis());
+    TEST_ASSERT_EQUAL(500, boot.getDuration(wifi));
+    TEST_ASSERT_EQUAL(5, starts); // wifi twice, sampling only once
+}
+
+void test_run_gives_up_after_its_timeout(void)
+{
+    BootSequencer<8> boot;
+    uint8_t wifi = boot.add("wifi", startPhase, never);
+    TEST_ASSERT_FALSE(boot.run(400));
+    TEST_ASSERT_EQUAL(BOOT_PHASE_RUNNING, boot.getState(wifi));
+    TEST_ASSERT_EQUAL(400, millis());
+}
+
+void test_capacity_is_enforced(void)
+{
+    BootSequencer<2> boot;
+    TEST_ASSERT_EQUAL(0, boot.add("a", startDone));
+    TEST_ASSERT_EQUAL(1, boot.add("b", startDone));
+    TEST_ASSERT_EQUAL(0xFF, boot.add("c", startDone));
+    TEST_ASSERT_EQUAL(BOOT_PHASE_SKIPPED, boot.getState(2));
+}
+
+void test_timeline_lists_every_phase(void)
+{
+    BootSequencer<8> boot;
+    uint8_t config = boot.add("config", startPhase, doneAt<100>);
+    uint8_t wifi = boot.add("wifi", startFailed, nullptr, BOOT_AFTER(config));
+    uint8_t ntp = boot.add("ntp", startPhase, doneAt<40>);
+    boot.add("app", startDone, nullptr, BOOT_AFTER(ntp) | BOOT_AFTER(wifi));
+    boot.run(1000);
+
+    CapturePrint out;
+    boot.printTimeline(out);
+    TEST_ASSERT_TRUE(out.text.indexOf("Boot timeline (100 ms):") == 0);
+    TEST_ASSERT_TRUE(out.text.indexOf("config            0 ->    100 ms (100 ms) done") > 0);
+    TEST_ASSERT_TRUE(out.text.indexOf("wifi            100 ->    100 ms (0 ms) failed") > 0);
+    TEST_ASSERT_TRUE(out.text.indexOf("ntp               0 ->     40 ms (40 ms) done") > 0);
+    TEST_ASSERT_TRUE(out.text.indexOf("app          skipped") > 0);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_independent_phases_overlap);
+    RUN_TEST(test_immediate_phases_finish_in_one_pass);
+    RUN_TEST(test_failure_skips_dependents);
+    RUN_TEST(test_timeout_fails_a_phase);
+    RUN_TEST(test_retry_restarts_a_failed_phase_and_its_dependents);
+    RUN_TEST(test_run_gives_up_after_its_timeout);
+    RUN_TEST(test_capacity_is_enforced);
+    RUN_TEST(test_timeline_lists_every_phase);
+    return UNITY_END();
+}
@@ -0,0 +1,183 @@
+#include <unity.h>
+
+#include <Arduino.h>
+#include <FirebaseClient.h>
+
+#include <JsonTokenizer.h>
+
+#include <RealtimeDatabase/CommandChannel.h>
+
+// JsonTokenizer grammar and chunked input, and CommandChannel on server-sent events
+// from the mock stream standing in for the RTDB SSE connection
+
+AsyncClientClass streamClient;
+RealtimeDatabase Database;
+CommandChannel *channel;
+uint32_t streamErrors;
+String handled; // "path=value;" per handler call
+
+void onValue(const char *path, const JsonToken &value)
+{
+    handled += path;
+    handled += "=";
+    for (size_t i = 0; i < value.length; i++)
+        handled += value.text[i];
+    handled += ";";
+}
+
+// The stream callback of the realtime sketch
+void onStreamResult(AsyncResult &aResult)
+{
+    if (aResult.isError() || !aResult.available())
+        return;
+    if (!channel->handleEvent(aResult.c_str()))
+        streamErrors++;
+}
+
+// Tokenizes a complete document, returns the type of the first token that is not a value
+// or container token, JSON_END for valid input
+static JsonTokenType scan(const char *json)
+{
+    JsonTokenizer tokenizer;
+    tokenizer.feed(json, strlen(json));
+    while (true)
+    {
+        JsonToken token = tokenizer.next();
+        if (token.type == JSON_END || token.type == JSON_ERROR || token.type == JSON_INCOMPLETE)
+            return token.type;
+    }
+}
+
+void setUp(void)
+{
+    FakeClock::instance().set(0);
+    streamClient = AsyncClientClass();
+    streamErrors = 0;
+    handled = "";
+    channel = new CommandChannel();
+}
+
+void tearDown(void) { delete channel; }
+
+void test_numbers_follow_the_json_grammar(void)
+{
+    const char *valid[] = {"0", "-0", "7", "-12", "3.25", "0.5", "1e3", "1E+3", "-2.5e-10", "[1,2]", "{\"a\":10}"};
+    for (const char *json : valid)
+        TEST_ASSERT_EQUAL_MESSAGE(JSON_END, scan(json), json);
+
+    const char *invalid[] = {"01", "-", "+1", ".5", "1.", "1.e3", "1e", "1e+", "--1", "1-2", "0x10", "1x", "[1.2.3]", "{\"a\":1e5e5}"};
+    for (const char *json : invalid)
+        TEST_ASSERT_EQUAL_MESSAGE(JSON_ERROR, scan(json), json);
+}
+
+void test_nul_inside_a_number_is_an_error(void)
+{
+    const char json[] = {'[', '1', '\0', '2', ']'};
+    JsonTokenizer tokenizer;
+    tokenizer.feed(json, sizeof(json));
+    TEST_ASSERT_EQUAL(JSON_ARRAY_BEGIN, tokenizer.next().type);
+    TEST_ASSERT_EQUAL(JSON_ERROR, tokenizer.next().type);
+}
+
+// A number cut at the end of a chunk waits for the rest
+void test_numbers_split_across_chunks(void)
+{
+    const char *chunks[] = {"[-1", "2.", "5e", "-1", ",7]"};
+    char buffer[32];
+    size_t kept = 0;
+    JsonTokenizer tokenizer;
+    String numbers;
+    for (size_t i = 0; i < 5; i++)
+    {
+        size_t length = strlen(chunks[i]);
+        memcpy(buffer + kept, chunks[i], length);
+        tokenizer.feed(buffer, kept + length, i == 4);
+        JsonToken token;
+        while ((token = tokenizer.next()).type != JSON_INCOMPLETE && token.type != JSON_END)
+        {
+            TEST_ASSERT_TRUE(token.type != JSON_ERROR);
+            if (token.type == JSON_NUMBER)
+                numbers += String(token.toDouble(), 2) + ";";
+        }
+        kept = kept + length - tokenizer.consumed();
+        memmove(buffer, buffer + tokenizer.consumed(), kept);
+    }
+    TEST_ASSERT_EQUAL_STRING("-1.25;7.00;", numbers.c_str());
+}
+
+void test_integers_have_no_fraction_or_exponent(void)
+{
+    const char *json = "[30000,-1,0,3e4,2.5,30000.0,1E2,\"7\"]";
+    JsonTokenizer tokenizer;
+    tokenizer.feed(json, strlen(json));
+    String integers;
+    JsonToken token;
+    while ((token = tokenizer.next()).type != JSON_END)
+    {
+        TEST_ASSERT_TRUE(token.type != JSON_ERROR);
+        integers += token.isInteger() ? "1" : token.isValue() ? "0" : "";
+    }
+    TEST_ASSERT_EQUAL_STRING("11100000", integers.c_str());
+}
+
+void test_handle_walks_nested_values(void)
+{
+    channel->on("/config/maxInterval", onValue);
+    channel->on("/command", onValue);
+    channel->on("/list/1", onValue);
+    const char *data = "{\"config\":{\"maxInterval\":30000,\"other\":true},\"command\":\"flush\",\"list\":[1,2]}";
+    TEST_ASSERT_TRUE(channel->handle("/", data, strlen(data)));
+    TEST_ASSERT_EQUAL_STRING("/config/maxInterval=30000;/command=flush;/list/1=2;", handled.c_str());
+    TEST_ASSERT_EQUAL(3, channel->getCommandCount());
+
+    TEST_ASSERT_FALSE(channel->handle("/", "{\"command\":01}", 14));
+    TEST_ASSERT_FALSE(channel->handle("/", "1 2", 3));
+    TEST_ASSERT_EQUAL(2, channel->getErrorCount());
+}
+
+void test_stream_events_are_handled_in_place(void)
+{
+    channel->on("/config/maxInterval", onValue);
+    channel->on("/command", onValue);
+    Database.get(streamClient, "/test/commands", onStreamResult, true, "streamTask");
+
+    streamClient.pushEvent("put", "/", "{\"config\":{\"maxInterval\":20000},\"command\":\"stats\"}");
+    streamClient.pushEvent("patch", "/config", "{\"maxInterval\":45000}");
+    streamClient.pushEvent("put", "/command", "\"flush\"");
+    streamClient.pushEvent("put", "/command", "null");
+    streamClient.pushEvent("cancel", "/", "null");
+    Database.loop();
+
+    TEST_ASSERT_EQUAL(0, streamErrors);
+    TEST_ASSERT_EQUAL(4, channel->getEventCount()); // cancel carries no data
+    TEST_ASSERT_EQUAL_STRING("/config/maxInterval=20000;/command=stats;/config/maxInterval=45000;/command=flush;/command=null;", handled.c_str());
+}
+
+void test_malformed_events_are_counted(void)
+{
+    channel->on("/command", onValue);
+    Database.get(streamClient, "/test/commands", onStreamResult, true, "streamTask");
+
+    streamClient.pushEvent("put", "/command", "1.");
+    streamClient.pushEvent("put", "/command", "\"stats\" 1");
+    streamClient.pushEvent("put", "/command", "{\"a\":");
+    Database.loop();
+    TEST_ASSERT_FALSE(channel->handleEvent("event: put\ndata: {\"data\":1,\"path\":\"/command\"}\n")); // data before path
+
+    TEST_ASSERT_EQUAL(3, streamErrors);
+    TEST_ASSERT_EQUAL(4, channel->getErrorCount());
+    TEST_ASSERT_EQUAL_STRING("/command=stats;", handled.c_str()); // read before the error after it
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_numbers_follow_the_json_grammar);
+    RUN_TEST(test_nul_inside_a_number_is_an_error);
+    RUN_TEST(test_numbers_split_across_chunks);
+    RUN_TEST(test_integers_have_no_fraction_or_exponent);
+    RUN_TEST(test_handle_walks_nested_values);
+    RUN_TEST(test_stream_events_are_handled_in_place);
+    RUN_TEST(test_malformed_events_are_counted);
+    return UNITY_END();
+}
@@ -0,0 +1,241 @@
+#include <unity.h>
+
+#include <Arduino.h>
+#include <FirebaseClient.h>
+
+#include <HeapTracker.h>
+
+#include <Firestore/FirestoreBatchWriter.h>
+
+// Weeks of Firestore commit cycles against the mock endpoint with heap accounting on:
+// the allocations of every commit are counted and compared with the same commit built
+// from String concatenations, the count stays the same from commit to commit and the
+// live heap returns to its warm-up level. Run with pio test -e native_heap.
+
+#if !DEBUG_HEAP || !DEBUG_HEAP_WRAP_MALLOC
+#error "Build with the [heap_debug] flags, e.g. pio test -e native_heap"
+#endif
+
+#define SAMPLES_PER_COMMIT 10
+#define WARMUP_COMMITS 100
+#define SOAK_COMMITS 20000 // a commit every 2 minutes for four weeks
+#define CHECK_EVERY 1000
+
+#define COLLECTION_PATH "example_collection/doc_1/data_1"
+#define DEVICE_ID "24:6F:28:AA:BB:CC"
+
+AsyncClientClass aClient;
+Firestore::Documents Docs;
+FirestoreBatchWriter *batchWriter;
+HeapTagStats *writerTag;
+HeapTagStats *referenceTag;
+uint32_t results;
+uint32_t errors;
+long sampleTime;
+
+// Collects the printed report in a fixed buffer, so printing allocates nothing
+struct CapturePrint
+{
+    char text[1024];
+    size_t used = 0;
+
+    size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)))
+    {
+        va_list args;
+        va_start(args, format);
+        int written = vsnprintf(text + used, sizeof(text) - used, format, args);
+        va_end(args);
+        used += written;
+        return written;
+    }
+};
+
+static long liveBytes()
+{
+    CapturePrint out;
+    HeapTracker::instance().print(out);
+    long live = -1;
+    sscanf(out.text, "heap: live=%ld", &live);
+    return live;
+}
+
+void onCommitResult(AsyncResult &aResult)
+{
+    if (!aResult.isError() && !aResult.available())
+        return;
+    results++;
+    if (aResult.isError())
+        errors++;
+    batchWriter->onResult(0, aResult.isError());
+}
+
+static FirestoreSample sampleAt(int i)
+{
+    FirestoreSample sample;
+    sample.time.tv_sec = sampleTime++;
+    sample.time.tv_usec = 250000;
+    sample.temperature = 20 + i % 5;
+    sample.humidity = 40 + i % 7;
+    return sample;
+}
+
+// Allocations made under tag while the commit is built and submitted
+template <typename Submit>
+static uint32_t countAllocations(HeapTagStats *tag, Submit submit)
+{
+    uint32_t before = tag->allocations.load();
+    {
+        HeapScope scope(tag);
+        submit();
+    }
+    return tag->allocations.load() - before;
+}
+
+// One upload cycle of the sketch: a batch of samples, one commit, the result. Returns the
+// allocations of the commit.
+static uint32_t commitCycle()
+{
+    for (int i = 0; i < SAMPLES_PER_COMMIT; i++)
+        batchWriter->add(sampleAt(i));
+    uint32_t allocations = countAllocations(writerTag, []() { TEST_ASSERT_TRUE(batchWriter->flush()); });
+    FakeClock::instance().advanceMillis(500);
+    Docs.loop();
+    return allocations;
+}
+
+// The same document commit built the way the sketch did before the batch writer:
+// names concatenated from Strings and a String per timestamp
+static String timestampString(const struct timeval &tv)
+{
+    time_t now = tv.tv_sec;
+    struct tm ts;
+    gmtime_r(&now, &ts);
+    char buf[100];
+    sprintf(buf, "%04d-%02d-%02dT%02d:%02d:%02d.%06ldZ",
+            ts.tm_year + 1900, ts.tm_mon + 1, ts.tm_mday,
+            ts.tm_hour, ts.tm_min, ts.tm_sec, (long)tv.tv_usec);
+    return String(buf);
+}
+
+static Write referenceWrite(const FirestoreSample &sample, uint32_t id)
+{
+    String collectionPath = COLLECTION_PATH;
+    String deviceId = DEVICE_ID;
+    Document doc;
+    doc.setName(collectionPath + "/" + deviceId + "_" + String(sample.time.tv_sec) + "_" + String(id));
+    doc.add("timestamp", Values::Value(Values::TimestampValue(timestampString(sample.time))));
+    doc.add("deviceId", Values::Value(Values::StringValue(deviceId)));
+    doc.add("temperature", Values::Value(Values::IntegerValue(sample.temperature)));
+    doc.add("humidity", Values::Value(Values::IntegerValue(sample.humidity)));
+    return Write(DocumentMask(), doc, Precondition());
+}
+
+static uint32_t referenceCommit()
+{
+    FirestoreSample samples[SAMPLES_PER_COMMIT];
+    for (int i = 0; i < SAMPLES_PER_COMMIT; i++)
+        samples[i] = sampleAt(i);
+    uint32_t allocations = countAllocations(referenceTag, [&samples]()
+                                            {
+        Writes writes(referenceWrite(samples[0], 0));
+        for (int i = 1; i < SAMPLES_PER_COMMIT; i++)
+            writes.add(referenceWrite(samples[i], i));
+        Docs.commit(aClient, Firestore::Parent("test-project"), writes, onCommitResult, "referenceTask"); });
+    FakeClock::instance().advanceMillis(500);
+    Docs.loop();
+    return allocations;
+}
+
+// Allocations per commit over the soak. The mock client's request queue takes a block
+// now and then, so a commit may allocate one more or less than the last.
+struct CommitAllocations
+{
+    uint32_t min = UINT32_MAX;
+    uint32_t max = 0;
+
+    void add(uint32_t allocations)
+    {
+        min = allocations < min ? allocations : min;
+        max = allocations > max ? allocations : max;
+    }
+};
+
+// Runs the soak. The commits after the first check stay within the range of allocations
+// per commit seen up to it, drift is set to the live heap change from the warm-up level.
+static CommitAllocations soak(bool compression, long &drift)
+{
+    batchWriter->setCompression(compression);
+    for (int i = 0; i < WARMUP_COMMITS; i++)
+        commitCycle();
+    long baseline = liveBytes();
+
+    CommitAllocations first;
+    drift = 0;
+    for (int i = 1; i <= SOAK_COMMITS; i++)
+    {
+        uint32_t allocations = commitCycle();
+        if (i <= CHECK_EVERY)
+            first.add(allocations);
+        else
+        {
+            TEST_ASSERT_GREATER_OR_EQUAL(first.min, allocations);
+            TEST_ASSERT_LESS_OR_EQUAL(first.max, allocations);
+        }
+        if (i % CHECK_EVERY == 0)
+        {
+            long delta = liveBytes() - baseline;
+            drift = labs(delta) > labs(drift) ? delta : drift;
+        }
+    }
+
+    TEST_ASSERT_EQUAL(WARMUP_COMMITS + SOAK_COMMITS, results);
+    TEST_ASSERT_EQUAL(0, errors);
+    TEST_ASSERT_EQUAL((WARMUP_COMMITS + SOAK_COMMITS) * SAMPLES_PER_COMMIT, batchWriter->getDeliveredSamples());
+    TEST_ASSERT_LESS_OR_EQUAL(1, first.max - first.min);
+    return first;
+}
+
+void setUp(void)
+{
+    FakeClock::instance().set(0);
+    aClient = AsyncClientClass();
+    aClient.setLatency(300, 300);
+    results = errors = 0;
+    sampleTime = 1700000000;
+    writerTag = HeapTracker::instance().get("writer");
+    referenceTag = HeapTracker::instance().get("reference");
+    batchWriter = new FirestoreBatchWriter(aClient, Docs, onCommitResult);
+    batchWriter->begin("test-project", COLLECTION_PATH, DEVICE_ID);
+    batchWriter->setMaxBatch(SAMPLES_PER_COMMIT);
+}
+
+void tearDown(void) { delete batchWriter; }
+
+void test_document_commits_allocate_less_than_string_concatenation(void)
+{
+    uint32_t reference = referenceCommit();
+    results = 0;
+    long drift;
+    CommitAllocations commit = soak(false, drift);
+    Serial.printf("%d document commits: %lu-%lu allocations per commit, %lu built from Strings, live heap drift %ld bytes\n",
+                  SOAK_COMMITS, (unsigned long)commit.min, (unsigned long)commit.max, (unsigned long)reference, drift);
+    TEST_ASSERT_LESS_THAN(reference, commit.max);
+    TEST_ASSERT_EQUAL(0, drift);
+}
+
+void test_block_commits_keep_the_heap_flat(void)
+{
+    long drift;
+    CommitAllocations commit = soak(true, drift);
+    Serial.printf("%d block commits: %lu-%lu allocations per commit, live heap drift %ld bytes\n",
+                  SOAK_COMMITS, (unsigned long)commit.min, (unsigned long)commit.max, drift);
+    TEST_ASSERT_EQUAL(0, drift);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_document_commits_allocate_less_than_string_concatenation);
+    RUN_TEST(test_block_commits_keep_the_heap_flat);
+    return UNITY_END();
+}
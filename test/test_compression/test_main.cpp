@@ -0,0 +1,242 @@
+#include <unity.h>
+
+#include <Arduino.h>
+
+#include <Base64.h>
+#include <Deadband.h>
+#include <GorillaBlock.h>
+
+// Deadband filter and Gorilla blocks: lossless round trips, overflow and truncation,
+// and the size and encoding cost for a typical 1 Hz climate series
+
+#define FIELDS 2
+#define SAMPLES 120
+#define BLOCK_SIZE GORILLA_BLOCK_SIZE(SAMPLES, FIELDS)
+#define BENCHMARK_ROUNDS 2000
+
+typedef GorillaEncoder<FIELDS, BLOCK_SIZE> Encoder;
+
+uint64_t times[SAMPLES];
+float values[SAMPLES][FIELDS];
+
+// 1 Hz with a few milliseconds of jitter, slowly drifting temperature and humidity
+static void climateSeries()
+{
+    for (int i = 0; i < SAMPLES; i++)
+    {
+        times[i] = 1700000000000ULL + i * 1000ULL + (i % 7 == 3 ? 4 : 0);
+        values[i][0] = 21.5f + (i / 20) * 0.25f;
+        values[i][1] = 40.0f + (i % 30 < 15 ? 0.5f : 0.0f);
+    }
+}
+
+static void assertRoundTrip(Encoder &encoder, int count)
+{
+    GorillaDecoder<FIELDS> decoder(encoder.bytes(), encoder.length());
+    TEST_ASSERT_EQUAL(count, decoder.size());
+    uint64_t time;
+    float decoded[FIELDS];
+    for (int i = 0; i < count; i++)
+    {
+        TEST_ASSERT_TRUE(decoder.next(time, decoded));
+        TEST_ASSERT_TRUE(time == times[i]);
+        TEST_ASSERT_EQUAL_MEMORY(values[i], decoded, sizeof(decoded)); // bit exact
+    }
+    TEST_ASSERT_FALSE(decoder.next(time, decoded));
+}
+
+void setUp(void) { FakeClock::instance().unfreeze(); }
+
+void tearDown(void) {}
+
+void test_climate_series_round_trip(void)
+{
+    climateSeries();
+    static Encoder encoder;
+    for (int i = 0; i < SAMPLES; i++)
+        TEST_ASSERT_TRUE(encoder.append(times[i], values[i]));
+    assertRoundTrip(encoder, SAMPLES);
+
+    size_t raw = SAMPLES * (sizeof(uint64_t) + FIELDS * sizeof(float));
+    TEST_ASSERT_LESS_THAN(raw / 8, encoder.length());
+    Serial.printf("%d samples: %u bytes raw, %u bytes encoded\n", SAMPLES, (unsigned)raw, (unsigned)encoder.length());
+}
+
+// Every timestamp bucket, negative and special floats and sign flips
+void test_irregular_series_round_trip(void)
+{
+    const int64_t gaps[] = {1000, 1000, 1060, 990, 1250, 700, 3000, 100, 1000000, 5, 0, 86400000};
+    const float special[] = {0.0f, -0.0f, 1e-30f, -1e30f, INFINITY, -INFINITY, NAN, 3.4e38f, -1.0f, 1.0f, 0.1f, 0.2f};
+    uint64_t time = 1000;
+    for (int i = 0; i < 12; i++)
+    {
+        time += gaps[i];
+        times[i] = time;
+        values[i][0] = special[i];
+        values[i][1] = special[11 - i];
+    }
+    static Encoder encoder;
+    for (int i = 0; i < 12; i++)
+        TEST_ASSERT_TRUE(encoder.append(times[i], values[i]));
+    assertRoundTrip(encoder, 12);
+}
+
+void test_full_block_refuses_samples_unchanged(void)
+{
+    GorillaEncoder<FIELDS, GORILLA_BLOCK_SIZE(2, FIELDS)> small;
+    const float first[FIELDS] = {1.0f, 2.0f};
+    const float second[FIELDS] = {-123.456f, 9e9f};
+    int appended = 0;
+    while (small.append(appended * 977777ULL, appended % 2 ? first : second))
+        appended++;
+    TEST_ASSERT_GREATER_OR_EQUAL(2, appended); // the worst case size always fits
+    size_t length = small.length();
+    TEST_ASSERT_FALSE(small.append(1, first));
+    TEST_ASSERT_EQUAL(length, small.length());
+    TEST_ASSERT_EQUAL(appended, small.size());
+
+    small.clear();
+    TEST_ASSERT_TRUE(small.isEmpty());
+    TEST_ASSERT_EQUAL(2, small.length());
+}
+
+void test_truncated_block_stops_decoding(void)
+{
+    climateSeries();
+    static Encoder encoder;
+    for (int i = 0; i < 10; i++)
+        encoder.append(times[i], values[i]);
+
+    GorillaDecoder<FIELDS> decoder(encoder.bytes(), encoder.length() - 3);
+    uint64_t time;
+    float decoded[FIELDS];
+    int read = 0;
+    while (decoder.next(time, decoded))
+        read++;
+    TEST_ASSERT_LESS_THAN(10, read);
+
+    GorillaDecoder<FIELDS> empty(encoder.bytes(), 1);
+    TEST_ASSERT_FALSE(empty.next(time, decoded));
+}
+
+// Blocks travel as a base64 bytes field
+void test_base64_round_trip(void)
+{
+    climateSeries();
+    static Encoder encoder;
+    for (int i = 0; i < 30; i++)
+        encoder.append(times[i], values[i]);
+
+    char text[BASE64_ENCODED_LENGTH(BLOCK_SIZE) + 1];
+    size_t length = base64Encode(encoder.bytes(), encoder.length(), text, sizeof(text));
+    TEST_ASSERT_EQUAL(strlen(text), length);
+    uint8_t decoded[BLOCK_SIZE];
+    TEST_ASSERT_EQUAL(encoder.length(), base64Decode(text, length, decoded, sizeof(decoded)));
+    TEST_ASSERT_EQUAL_MEMORY(encoder.bytes(), decoded, encoder.length());
+
+    TEST_ASSERT_EQUAL(0, base64Decode("QUJ", 3, decoded, sizeof(decoded)));
+    TEST_ASSERT_EQUAL(0, base64Decode("QU!D", 4, decoded, sizeof(decoded)));
+    TEST_ASSERT_EQUAL(0, base64Encode(decoded, 3, text, 4)); // no room for the terminator
+}
+
+void test_deadband_passes_steps_of_a_threshold(void)
+{
+    DeadbandFilter<FIELDS> deadband;
+    deadband.setThreshold(0, 0.5f).setThreshold(1, 2.0f).setHeartbeat(60000);
+
+    const float start[FIELDS] = {21.0f, 40.0f};
+    const float small[FIELDS] = {21.4f, 41.9f};
+    const float warmer[FIELDS] = {21.5f, 40.0f};
+    TEST_ASSERT_TRUE(deadband.filter(0, start)); // the first sample always passes
+    TEST_ASSERT_FALSE(deadband.filter(1000, small));
+    TEST_ASSERT_TRUE(deadband.filter(2000, warmer));
+    TEST_ASSERT_TRUE(deadband.filter(3000, start)); // a step of exactly the threshold passes
+    TEST_ASSERT_EQUAL(3, deadband.getPassedCount());
+    TEST_ASSERT_EQUAL(1, deadband.getSuppressedCount());
+}
+
+void test_deadband_measures_from_the_last_report(void)
+{
+    DeadbandFilter<1> deadband;
+    deadband.setThreshold(0, 1.0f);
+    float value[1] = {10.0f};
+    deadband.filter(0, value);
+    for (int i = 1; i <= 9; i++) // creeps by 0.9 in total, never a full step from 10
+    {
+        value[0] = 10.0f + i * 0.1f;
+        TEST_ASSERT_FALSE(deadband.filter(i * 1000, value));
+    }
+    value[0] = 11.0f;
+    TEST_ASSERT_TRUE(deadband.filter(10000, value));
+    TEST_ASSERT_EQUAL(2, deadband.getPassedCount());
+    TEST_ASSERT_EQUAL(9, deadband.getSuppressedCount());
+}
+
+void test_deadband_heartbeat_and_reset(void)
+{
+    DeadbandFilter<1> deadband;
+    deadband.setThreshold(0, 1.0f).setHeartbeat(60000);
+    float value[1] = {10.0f};
+    TEST_ASSERT_TRUE(deadband.filter(0, value));
+    TEST_ASSERT_FALSE(deadband.filter(59999, value));
+    TEST_ASSERT_TRUE(deadband.filter(60000, value));
+
+    deadband.reset();
+    TEST_ASSERT_TRUE(deadband.filter(60001, value));
+
+    DeadbandFilter<1> exact; // threshold 0 passes any change
+    TEST_ASSERT_TRUE(exact.filter(0, value));
+    TEST_ASSERT_FALSE(exact.filter(1, value));
+    value[0] = 10.000001f;
+    TEST_ASSERT_TRUE(exact.filter(2, value));
+}
+
+static uint64_t nowNanos()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void test_benchmark_encode_and_decode(void)
+{
+    climateSeries();
+    static Encoder encoder;
+    uint64_t start = nowNanos();
+    for (int round = 0; round < BENCHMARK_ROUNDS; round++)
+    {
+        encoder.clear();
+        for (int i = 0; i < SAMPLES; i++)
+            encoder.append(times[i], values[i]);
+    }
+    uint64_t encodeNanos = nowNanos() - start;
+
+    uint64_t time;
+    float decoded[FIELDS];
+    uint32_t count = 0;
+    start = nowNanos();
+    for (int round = 0; round < BENCHMARK_ROUNDS; round++)
+    {
+        GorillaDecoder<FIELDS> decoder(encoder.bytes(), encoder.length());
+        while (decoder.next(time, decoded))
+            count++;
+    }
+    uint64_t decodeNanos = nowNanos() - start;
+
+    TEST_ASSERT_EQUAL(SAMPLES * BENCHMARK_ROUNDS, count);
+    Serial.printf("gorilla: encode %lu ns/sample, decode %lu ns/sample, %.2f bytes/sample\n",
+                  (unsigned long)(encodeNanos / count), (unsigned long)(decodeNanos / count), (double)encoder.length() / SAMPLES);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_climate_series_round_trip);
+    RUN_TEST(test_irregular_series_round_trip);
+    RUN_TEST(test_full_block_refuses_samples_unchanged);
+    RUN_TEST(test_truncated_block_stops_decoding);
+    RUN_TEST(test_base64_round_trip);
+    RUN_TEST(test_deadband_passes_steps_of_a_threshold);
+    RUN_TEST(test_deadband_measures_from_the_last_report);
+    RUN_TEST(test_deadband_heartbeat_and_reset);
+    RUN_TEST(test_benchmark_encode_and_decode);
+    return UNITY_END();
+}
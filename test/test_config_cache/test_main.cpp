@@ -0,0 +1,192 @@
+#include <unity.h>
+
+#include <Arduino.h>
+#include <FS.h>
+#include <filesystem>
+
+#include <CredentialsManager/CredentialsManager.h>
+
+// ConfigCache on the file-backed FS: round trip, and every way a cache is rejected
+
+#define TEST_FS_ROOT "./.native_fs_config_cache"
+
+fs::FS fileSystem(TEST_FS_ROOT);
+
+static const ConfigSourceStamp wifiSource = {48, 1700000000};
+static const ConfigSourceStamp firebaseSource = {200, 1700000100};
+
+static WifiCredential wifi() { return WifiCredential{"home-net", "wifi-pass"}; }
+
+static FirebaseCredential firebase()
+{
+    return FirebaseCredential{"AIzaSy-key", "demo-project", "https://demo-project.firebaseio.com", "device@example.com", "device-pass"};
+}
+
+static void writeFile(const char *path, const char *text)
+{
+    File file = fileSystem.open(path, "w");
+    file.print(text);
+    file.close();
+}
+
+// Flips one byte of the cache file at offset
+static void corrupt(size_t offset)
+{
+    uint8_t buffer[CONFIG_CACHE_MAX_SIZE];
+    File file = fileSystem.open(CONFIG_CACHE_FILE, "r");
+    size_t size = file.read(buffer, sizeof(buffer));
+    file.close();
+    buffer[offset] ^= 0x01;
+    file = fileSystem.open(CONFIG_CACHE_FILE, "w");
+    file.write(buffer, size);
+    file.close();
+}
+
+static bool load(ConfigCache &cache, WifiCredential &wifiCredential, FirebaseCredential &firebaseCredential)
+{
+    return cache.load(wifiSource, firebaseSource, wifiCredential, firebaseCredential);
+}
+
+void setUp(void)
+{
+    std::filesystem::remove_all(TEST_FS_ROOT);
+    fileSystem.begin();
+}
+
+void tearDown(void) { std::filesystem::remove_all(TEST_FS_ROOT); }
+
+void test_round_trip(void)
+{
+    ConfigCache cache(fileSystem);
+    TEST_ASSERT_TRUE(cache.save(wifiSource, firebaseSource, wifi(), firebase()));
+
+    WifiCredential wifiCredential;
+    FirebaseCredential firebaseCredential;
+    TEST_ASSERT_TRUE(load(cache, wifiCredential, firebaseCredential));
+    TEST_ASSERT_EQUAL_STRING("home-net", wifiCredential.ssid.c_str());
+    TEST_ASSERT_EQUAL_STRING("wifi-pass", wifiCredential.password.c_str());
+    TEST_ASSERT_EQUAL_STRING("AIzaSy-key", firebaseCredential.apiKey.c_str());
+    TEST_ASSERT_EQUAL_STRING("demo-project", firebaseCredential.projectId.c_str());
+    TEST_ASSERT_EQUAL_STRING("https://demo-project.firebaseio.com", firebaseCredential.realtimeDbUrl.c_str());
+    TEST_ASSERT_EQUAL_STRING("device@example.com", firebaseCredential.userEmail.c_str());
+    TEST_ASSERT_EQUAL_STRING("device-pass", firebaseCredential.userPassword.c_str());
+}
+
+void test_missing_cache_is_a_miss(void)
+{
+    ConfigCache cache(fileSystem);
+    WifiCredential wifiCredential;
+    FirebaseCredential firebaseCredential;
+    TEST_ASSERT_FALSE(load(cache, wifiCredential, firebaseCredential));
+    TEST_ASSERT_TRUE(wifiCredential.isEmpty());
+}
+
+void test_changed_source_files_make_it_stale(void)
+{
+    ConfigCache cache(fileSystem);
+    cache.save(wifiSource, firebaseSource, wifi(), firebase());
+    WifiCredential wifiCredential;
+    FirebaseCredential firebaseCredential;
+
+    ConfigSourceStamp edited = {wifiSource.size, wifiSource.lastWrite + 1};
+    TEST_ASSERT_FALSE(cache.load(edited, firebaseSource, wifiCredential, firebaseCredential));
+    ConfigSourceStamp resized = {firebaseSource.size + 1, firebaseSource.lastWrite};
+    TEST_ASSERT_FALSE(cache.load(wifiSource, resized, wifiCredential, firebaseCredential));
+    TEST_ASSERT_TRUE(wifiCredential.isEmpty()); // outputs untouched on a miss
+}
+
+void test_corrupt_body_is_rejected(void)
+{
+    ConfigCache cache(fileSystem);
+    cache.save(wifiSource, firebaseSource, wifi(), firebase());
+    corrupt(sizeof(ConfigCacheHeader) + 3);
+
+    WifiCredential wifiCredential;
+    FirebaseCredential firebaseCredential;
+    TEST_ASSERT_FALSE(load(cache, wifiCredential, firebaseCredential));
+}
+
+void test_other_version_is_rejected(void)
+{
+    ConfigCache cache(fileSystem);
+    cache.save(wifiSource, firebaseSource, wifi(), firebase());
+    corrupt(offsetof(ConfigCacheHeader, version));
+
+    WifiCredential wifiCredential;
+    FirebaseCredential firebaseCredential;
+    TEST_ASSERT_FALSE(load(cache, wifiCredential, firebaseCredential));
+}
+
+void test_truncated_cache_is_rejected(void)
+{
+    ConfigCache cache(fileSystem);
+    cache.save(wifiSource, firebaseSource, wifi(), firebase());
+    File file = fileSystem.open(CONFIG_CACHE_FILE, "r");
+    uint8_t buffer[CONFIG_CACHE_MAX_SIZE];
+    size_t size = file.read(buffer, sizeof(buffer));
+    file.close();
+    file = fileSystem.open(CONFIG_CACHE_FILE, "w");
+    file.write(buffer, size - 1);
+    file.close();
+
+    WifiCredential wifiCredential;
+    FirebaseCredential firebaseCredential;
+    TEST_ASSERT_FALSE(load(cache, wifiCredential, firebaseCredential));
+}
+
+// Strings are length prefixed with one byte
+void test_oversized_field_is_not_cached(void)
+{
+    ConfigCache cache(fileSystem);
+    FirebaseCredential credential = firebase();
+    credential.apiKey = String(std::string(256, 'k'));
+    TEST_ASSERT_FALSE(cache.save(wifiSource, firebaseSource, wifi(), credential));
+    TEST_ASSERT_FALSE(fileSystem.exists(CONFIG_CACHE_FILE));
+}
+
+// The first boot parses the JSON and writes the cache, editing a file rebuilds it
+void test_credentials_manager_rebuilds_stale_cache(void)
+{
+    writeFile(WIFI_CONFIG_FILE, "{\"ssid\":\"home-net\",\"password\":\"wifi-pass\"}");
+    writeFile(FIREBASE_CONFIG_FILE, "{\"apiKey\":\"AIzaSy-key\",\"projectId\":\"demo-project\","
+                                    "\"realtimeDbUrl\":\"https://demo-project.firebaseio.com\","
+                                    "\"userEmail\":\"device@example.com\",\"userPassword\":\"device-pass\"}");
+    CredentialsManager credentials(fileSystem);
+    WifiCredential wifiCredential;
+    FirebaseCredential firebaseCredential;
+    TEST_ASSERT_TRUE(credentials.getCredentials(wifiCredential, firebaseCredential));
+    TEST_ASSERT_TRUE(fileSystem.exists(CONFIG_CACHE_FILE));
+
+    writeFile(WIFI_CONFIG_FILE, "{\"ssid\":\"office-net\",\"password\":\"wifi-pass\"}");
+    TEST_ASSERT_TRUE(credentials.getCredentials(wifiCredential, firebaseCredential));
+    TEST_ASSERT_EQUAL_STRING("office-net", wifiCredential.ssid.c_str());
+
+    ConfigCache cache(fileSystem);
+    WifiCredential cached;
+    TEST_ASSERT_TRUE(cache.load(cache.stamp(WIFI_CONFIG_FILE), cache.stamp(FIREBASE_CONFIG_FILE), cached, firebaseCredential));
+    TEST_ASSERT_EQUAL_STRING("office-net", cached.ssid.c_str());
+}
+
+void test_missing_json_is_not_cached(void)
+{
+    CredentialsManager credentials(fileSystem);
+    WifiCredential wifiCredential;
+    FirebaseCredential firebaseCredential;
+    TEST_ASSERT_FALSE(credentials.getCredentials(wifiCredential, firebaseCredential));
+    TEST_ASSERT_FALSE(fileSystem.exists(CONFIG_CACHE_FILE));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_round_trip);
+    RUN_TEST(test_missing_cache_is_a_miss);
+    RUN_TEST(test_changed_source_files_make_it_stale);
+    RUN_TEST(test_corrupt_body_is_rejected);
+    RUN_TEST(test_other_version_is_rejected);
+    RUN_TEST(test_truncated_cache_is_rejected);
+    RUN_TEST(test_oversized_field_is_not_cached);
+    RUN_TEST(test_credentials_manager_rebuilds_stale_cache);
+    RUN_TEST(test_missing_json_is_not_cached);
+    return UNITY_END();
+}
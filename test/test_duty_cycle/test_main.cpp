@@ -0,0 +1,187 @@
+#include <unity.h>
+
+#include <Arduino.h>
+
+#include <DutyCycle.h>
+
+// DutyCycle across simulated resets: the state stands in for RTC slow memory, kept
+// across deep sleep, random after power-on and left unsealed by a crash
+
+#define CAPACITY 8
+#define UPLOAD_EVERY 5
+#define PERIOD_MS 10000
+
+struct Sample
+{
+    uint32_t time;
+    float value;
+};
+
+typedef DutyCycle<Sample, CAPACITY> Cycle;
+
+Cycle::State rtcMemory; // RTC_DATA_ATTR on the device
+
+// Power-on, RTC memory holds whatever the SRAM came up with
+static void powerOn()
+{
+    uint8_t *bytes = (uint8_t *)&rtcMemory;
+    for (size_t i = 0; i < sizeof(rtcMemory); i++)
+        bytes[i] = rand();
+}
+
+// One wake of the duty-cycle sketch, a fresh object over the retained state like after a
+// deep sleep reset. Returns true on an upload wake.
+static bool wake(bool online = true, uint32_t radioMillis = 2000)
+{
+    Cycle cycle(rtcMemory);
+    cycle.begin();
+    cycle.setUploadEvery(UPLOAD_EVERY);
+    cycle.add({cycle.getWakes(), cycle.getWakes() * 0.5f});
+    bool upload = cycle.shouldUpload();
+    if (upload)
+    {
+        cycle.addRadioTime(radioMillis);
+        if (online)
+            cycle.uploaded(cycle.size());
+        else
+            cycle.failed();
+    }
+    cycle.seal();
+    return upload;
+}
+
+void setUp(void)
+{
+    FakeClock::instance().set(0);
+    powerOn();
+}
+
+void tearDown(void) {}
+
+void test_power_on_starts_empty(void)
+{
+    Cycle cycle(rtcMemory);
+    TEST_ASSERT_FALSE(cycle.begin());
+    TEST_ASSERT_EQUAL(0, cycle.size());
+    TEST_ASSERT_EQUAL(1, cycle.getWakes());
+    TEST_ASSERT_EQUAL(0, cycle.getUploads());
+}
+
+// Samples and counters survive the resets between wakes
+void test_state_is_retained_across_resets(void)
+{
+    for (int i = 0; i < 3; i++)
+        TEST_ASSERT_FALSE(wake());
+
+    Cycle cycle(rtcMemory);
+    TEST_ASSERT_TRUE(cycle.begin());
+    TEST_ASSERT_TRUE(cycle.isWarm());
+    TEST_ASSERT_EQUAL(4, cycle.getWakes());
+    TEST_ASSERT_EQUAL(3, cycle.size());
+    for (size_t i = 0; i < 3; i++)
+    {
+        TEST_ASSERT_EQUAL(i + 1, cycle[i].time); // oldest first, as taken
+        TEST_ASSERT_EQUAL_FLOAT((i + 1) * 0.5f, cycle[i].value);
+    }
+}
+
+// A crash or brownout leaves the state unsealed, the next wake doesn't trust it
+void test_unsealed_or_corrupt_state_is_dropped(void)
+{
+    wake();
+    wake();
+    {
+        Cycle cycle(rtcMemory);
+        cycle.begin();
+        cycle.add({99, 1.0f}); // reset before seal()
+    }
+    Cycle cycle(rtcMemory);
+    TEST_ASSERT_FALSE(cycle.begin());
+    TEST_ASSERT_EQUAL(0, cycle.size());
+
+    cycle.add({1, 1.0f});
+    cycle.seal();
+    ((uint8_t *)&rtcMemory.samples[0])[0] ^= 0x01; // flipped bit in RTC memory
+    Cycle corrupt(rtcMemory);
+    TEST_ASSERT_FALSE(corrupt.begin());
+    TEST_ASSERT_EQUAL(0, corrupt.size());
+}
+
+// The radio comes up every UPLOAD_EVERY wakes and sends the whole ring at once
+void test_radio_only_on_upload_wakes(void)
+{
+    uint32_t uploads = 0;
+    for (int i = 1; i <= 20; i++)
+    {
+        bool upload = wake();
+        TEST_ASSERT_EQUAL(i % UPLOAD_EVERY == 0, upload);
+        uploads += upload;
+    }
+    Cycle cycle(rtcMemory);
+    cycle.begin();
+    TEST_ASSERT_EQUAL(4, uploads);
+    TEST_ASSERT_EQUAL(4, cycle.getUploads());
+    TEST_ASSERT_EQUAL(0, cycle.size());
+    TEST_ASSERT_EQUAL(8000, cycle.getRadioOnMillis());
+    TEST_ASSERT_EQUAL_FLOAT(400.0f, cycle.getRadioTimePerSample()); // 2 s radio for 5 samples
+}
+
+// Failed uploads keep the samples, a full ring overwrites the oldest until one gets through
+void test_failed_uploads_keep_the_newest_samples(void)
+{
+    for (int i = 1; i <= 15; i++)
+        wake(false);
+
+    Cycle cycle(rtcMemory);
+    cycle.begin();
+    TEST_ASSERT_EQUAL(CAPACITY, cycle.size());
+    TEST_ASSERT_EQUAL(15 - CAPACITY, cycle.getDropped());
+    TEST_ASSERT_EQUAL(3, cycle.getFailures());
+    TEST_ASSERT_EQUAL(15 - CAPACITY + 1, cycle[0].time);
+    cycle.seal();
+
+    // Back online, the next upload wake clears the ring and the failure count
+    uint32_t wakes = 0;
+    while (!wake())
+        wakes++;
+    Cycle after(rtcMemory);
+    after.begin();
+    TEST_ASSERT_EQUAL(0, after.size());
+    TEST_ASSERT_EQUAL(0, after.getFailures());
+    TEST_ASSERT_EQUAL_FLOAT(8000.0f / CAPACITY, after.getRadioTimePerSample()); // failed wakes cost radio time too
+    TEST_ASSERT_LESS_THAN(UPLOAD_EVERY, wakes);
+}
+
+// While the server is reachable a full ring goes out before the regular upload wake
+void test_full_ring_forces_an_early_upload(void)
+{
+    Cycle cycle(rtcMemory);
+    cycle.begin();
+    cycle.setUploadEvery(100);
+    for (int i = 0; i < CAPACITY - 1; i++)
+        cycle.add({(uint32_t)i, 0});
+    TEST_ASSERT_FALSE(cycle.shouldUpload());
+    cycle.add({CAPACITY, 0});
+    TEST_ASSERT_TRUE(cycle.shouldUpload());
+    cycle.failed();
+    TEST_ASSERT_FALSE(cycle.shouldUpload()); // after a failure only on the regular cadence
+}
+
+void test_sleep_time_keeps_the_period(void)
+{
+    TEST_ASSERT_EQUAL(9800000ULL, Cycle::sleepTime(PERIOD_MS, 200));
+    TEST_ASSERT_EQUAL(0ULL, Cycle::sleepTime(PERIOD_MS, 12000)); // a long upload wake
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_power_on_starts_empty);
+    RUN_TEST(test_state_is_retained_across_resets);
+    RUN_TEST(test_unsealed_or_corrupt_state_is_dropped);
+    RUN_TEST(test_radio_only_on_upload_wakes);
+    RUN_TEST(test_failed_uploads_keep_the_newest_samples);
+    RUN_TEST(test_full_ring_forces_an_early_upload);
+    RUN_TEST(test_sleep_time_keeps_the_period);
+    return UNITY_END();
+}
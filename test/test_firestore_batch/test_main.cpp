@@ -0,0 +1,318 @@
+#include <unity.h>
+
+#include <Arduino.h>
+#include <FirebaseClient.h>
+
+#include <FS.h>
+#include <filesystem>
+
+#include <Firestore/FirestoreBatchWriter.h>
+#include <Firestore/FirestoreSink.h>
+
+// Batches of samples against the mock Firestore endpoint: one commit per batch, sent
+// when the batch is full, too old or the writer is ended.
+
+#define TEST_FS_ROOT "./.native_fs_firestore_batch"
+
+AsyncClientClass aClient;
+Firestore::Documents Docs;
+FirestoreBatchWriter *batchWriter;
+uint32_t results;
+uint32_t errors;
+
+void onCommitResult(AsyncResult &aResult)
+{
+    results++;
+    if (aResult.isError())
+        errors++;
+    batchWriter->onResult(TaskTracer::sequenceOf(aResult.uid().c_str()), aResult.isError());
+}
+
+static size_t count(const String &text, const char *pattern)
+{
+    size_t matches = 0;
+    for (int index = text.indexOf(pattern); index >= 0; index = text.indexOf(pattern, index + 1))
+        matches++;
+    return matches;
+}
+
+static FirestoreSample sample(long seconds, int temperature)
+{
+    FirestoreSample sample;
+    sample.time.tv_sec = seconds;
+    sample.time.tv_usec = 250000;
+    sample.temperature = temperature;
+    sample.humidity = 40;
+    return sample;
+}
+
+void setUp(void)
+{
+    FakeClock::instance().set(0);
+    aClient = AsyncClientClass();
+    aClient.setLatency(300, 300);
+    results = errors = 0;
+    batchWriter = new FirestoreBatchWriter(aClient, Docs, onCommitResult);
+    batchWriter->begin("test-project", "test/samples", "device1");
+    batchWriter->setMaxBatch(10);
+    batchWriter->setMaxLatency(10000);
+}
+
+void tearDown(void) { delete batchWriter; }
+
+void test_full_batch_is_one_commit(void)
+{
+    for (int i = 0; i < 10; i++)
+        batchWriter->add(sample(1700000000 + i, 20 + i));
+    TEST_ASSERT_TRUE(batchWriter->ready());
+    batchWriter->loop();
+
+    TEST_ASSERT_EQUAL(1, aClient.getRequests());
+    TEST_ASSERT_EQUAL_STRING("projects/test-project/databases/(default)/documents:commit", aClient.last().path.c_str());
+    String body = aClient.last().body;
+    TEST_ASSERT_EQUAL(10, count(body, "\"update\":"));
+    TEST_ASSERT_EQUAL(1, count(body, "\"name\":\"test/samples/device1_1700000000_0\""));
+    TEST_ASSERT_EQUAL(1, count(body, "\"name\":\"test/samples/device1_1700000009_9\""));
+    TEST_ASSERT_EQUAL(1, count(body, "\"timestampValue\":\"2023-11-14T22:13:20.250000Z\""));
+    TEST_ASSERT_EQUAL(1, count(body, "\"temperature\":{\"integerValue\":\"29\"}"));
+    TEST_ASSERT_EQUAL(0, batchWriter->pending());
+    TEST_ASSERT_EQUAL(10, batchWriter->getSampleCount());
+
+    // The result comes back through the callback once the round trip is over
+    Docs.loop();
+    TEST_ASSERT_EQUAL(0, results);
+    FakeClock::instance().advanceMillis(300);
+    Docs.loop();
+    TEST_ASSERT_EQUAL(1, results);
+    TEST_ASSERT_EQUAL(0, errors);
+}
+
+// A name longer than FIRESTORE_NAME_SIZE is concatenated in full and counted, never cut off
+void test_long_names_are_sent_whole(void)
+{
+    String path = "test/samples";
+    while (path.length() < FIRESTORE_NAME_SIZE)
+        path += "/nested/docs";
+    batchWriter->begin("test-project", path, "device1");
+    batchWriter->add(sample(1700000000, 20));
+    batchWriter->add(sample(1700000001, 21));
+    TEST_ASSERT_TRUE(batchWriter->flush());
+
+    String body = aClient.last().body;
+    TEST_ASSERT_EQUAL(1, count(body, (String("\"name\":\"") + path + "/device1_1700000000_0\"").c_str()));
+    TEST_ASSERT_EQUAL(1, count(body, (String("\"name\":\"") + path + "/device1_1700000001_1\"").c_str()));
+    TEST_ASSERT_EQUAL(2, batchWriter->getLongNames());
+}
+
+void test_adding_to_full_batch_flushes_first(void)
+{
+    for (int i = 0; i < 25; i++)
+        batchWriter->add(sample(1700000000 + i, 20));
+
+    TEST_ASSERT_EQUAL(2, aClient.getRequests());
+    TEST_ASSERT_EQUAL(5, batchWriter->pending());
+    TEST_ASSERT_EQUAL(2, batchWriter->getFlushCount());
+}
+
+void test_partial_batch_waits_for_latency_budget(void)
+{
+    batchWriter->add(sample(1700000000, 20));
+    batchWriter->add(sample(1700000001, 21));
+    FakeClock::instance().advanceMillis(9999);
+    batchWriter->loop();
+    TEST_ASSERT_EQUAL(0, aClient.getRequests());
+
+    FakeClock::instance().advanceMillis(1);
+    batchWriter->loop();
+    TEST_ASSERT_EQUAL(1, aClient.getRequests());
+    TEST_ASSERT_EQUAL(2, count(aClient.last().body, "\"update\":"));
+}
+
+void test_end_flushes_pending_samples(void)
+{
+    batchWriter->add(sample(1700000000, 20));
+    TEST_ASSERT_TRUE(batchWriter->end()); // queued, the caller waits for the result
+    TEST_ASSERT_EQUAL(1, aClient.getRequests());
+    TEST_ASSERT_EQUAL(0, batchWriter->pending());
+    TEST_ASSERT_EQUAL(0, results);
+    FakeClock::instance().advanceMillis(300);
+    Docs.loop();
+    TEST_ASSERT_EQUAL(1, results);
+
+    TEST_ASSERT_FALSE(batchWriter->end()); // nothing left, no empty commit and nothing to wait for
+    TEST_ASSERT_EQUAL(1, aClient.getRequests());
+}
+
+// A minute of 1 Hz samples takes 6 commits instead of 60 createDocument requests
+void test_requests_per_minute(void)
+{
+    for (int second = 0; second < 60; second++)
+    {
+        batchWriter->add(sample(1700000000 + second, 20));
+        batchWriter->loop();
+        FakeClock::instance().advanceMillis(1000);
+        Docs.loop();
+    }
+    batchWriter->end();
+    Docs.loop();
+
+    Serial.printf("60 samples: %lu commits, %lu bytes\n", (unsigned long)aClient.getRequests(), (unsigned long)aClient.getBytes());
+    TEST_ASSERT_EQUAL(6, aClient.getRequests());
+    TEST_ASSERT_EQUAL(6, results);
+    TEST_ASSERT_EQUAL(60, batchWriter->getSampleCount());
+}
+
+void test_errors_reach_the_callback(void)
+{
+    aClient.setErrorRate(100);
+    batchWriter->add(sample(1700000000, 20));
+    batchWriter->flush();
+    FakeClock::instance().advanceMillis(300);
+    Docs.loop();
+    TEST_ASSERT_EQUAL(1, results);
+    TEST_ASSERT_EQUAL(1, errors);
+}
+
+// A failed commit goes out again after the latency budget, with the same document
+// names and before newer samples
+void test_failed_commit_is_sent_again(void)
+{
+    aClient.setErrorRate(100);
+    batchWriter->add(sample(1700000000, 20));
+    batchWriter->add(sample(1700000001, 21));
+    TEST_ASSERT_TRUE(batchWriter->flush());
+    FakeClock::instance().advanceMillis(300);
+    Docs.loop();
+    TEST_ASSERT_EQUAL(1, errors);
+    TEST_ASSERT_EQUAL(2, batchWriter->pending());
+    TEST_ASSERT_FALSE(batchWriter->ready());
+    FakeClock::instance().advanceMillis(10000);
+    TEST_ASSERT_TRUE(batchWriter->ready());
+
+    aClient.setErrorRate(0);
+    batchWriter->add(sample(1700000002, 22));
+    TEST_ASSERT_TRUE(batchWriter->flush());
+    String body = aClient.last().body;
+    TEST_ASSERT_EQUAL(2, count(body, "\"update\":"));
+    TEST_ASSERT_EQUAL(1, count(body, "\"name\":\"test/samples/device1_1700000000_0\""));
+    TEST_ASSERT_EQUAL(1, count(body, "\"name\":\"test/samples/device1_1700000001_1\""));
+    FakeClock::instance().advanceMillis(300);
+    Docs.loop();
+    TEST_ASSERT_EQUAL(1, batchWriter->pending()); // the newer sample is still queued
+    TEST_ASSERT_FALSE(batchWriter->ready());
+
+    TEST_ASSERT_TRUE(batchWriter->flush());
+    TEST_ASSERT_EQUAL(1, count(aClient.last().body, "\"name\":\"test/samples/device1_1700000002_2\""));
+    FakeClock::instance().advanceMillis(300);
+    Docs.loop();
+    TEST_ASSERT_EQUAL(3, aClient.getRequests());
+    TEST_ASSERT_EQUAL(1, batchWriter->getRetryCount());
+    TEST_ASSERT_EQUAL(0, batchWriter->getFailedSamples());
+    TEST_ASSERT_EQUAL(3, batchWriter->getSampleCount());
+    TEST_ASSERT_EQUAL(3, batchWriter->getDeliveredSamples());
+}
+
+// A commit without a result within the request timeout is sent again
+void test_commit_without_result_is_sent_again(void)
+{
+    aClient.setLossRate(100);
+    batchWriter->setRequestTimeout(5000);
+    batchWriter->add(sample(1700000000, 20));
+    TEST_ASSERT_TRUE(batchWriter->flush());
+    FakeClock::instance().advanceMillis(5000);
+    Docs.loop();
+    TEST_ASSERT_EQUAL(0, results);
+    TEST_ASSERT_FALSE(batchWriter->ready()); // timed out, waits out the latency budget
+    TEST_ASSERT_EQUAL(1, batchWriter->pending());
+
+    aClient.setLossRate(0);
+    FakeClock::instance().advanceMillis(10000);
+    TEST_ASSERT_TRUE(batchWriter->ready());
+    batchWriter->loop();
+    FakeClock::instance().advanceMillis(300);
+    Docs.loop();
+    TEST_ASSERT_EQUAL(1, batchWriter->getDeliveredSamples());
+    TEST_ASSERT_EQUAL(1, batchWriter->getRetryCount());
+}
+
+// A commit that keeps failing is given up after its attempts and counted
+void test_commit_is_dropped_after_max_attempts(void)
+{
+    aClient.setErrorRate(100);
+    batchWriter->setMaxAttempts(3);
+    batchWriter->add(sample(1700000000, 20));
+    while (batchWriter->flush())
+    {
+        FakeClock::instance().advanceMillis(300);
+        Docs.loop();
+    }
+    TEST_ASSERT_EQUAL(3, aClient.getRequests());
+    TEST_ASSERT_EQUAL(1, batchWriter->getFailedSamples());
+    TEST_ASSERT_EQUAL(0, batchWriter->pending());
+}
+
+// Without a free slot the oldest commit waiting for its result gives way
+void test_commit_without_free_slot_replaces_the_oldest(void)
+{
+    for (int i = 0; i <= FIRESTORE_RETRY_COMMITS; i++)
+    {
+        batchWriter->add(sample(1700000000 + i, 20));
+        TEST_ASSERT_TRUE(batchWriter->flush());
+    }
+    TEST_ASSERT_EQUAL(1, batchWriter->getFailedSamples());
+    FakeClock::instance().advanceMillis(300 * (FIRESTORE_RETRY_COMMITS + 1));
+    Docs.loop();
+    TEST_ASSERT_EQUAL(FIRESTORE_RETRY_COMMITS + 1, results);
+    TEST_ASSERT_EQUAL(0, batchWriter->pending());
+    TEST_ASSERT_FALSE(batchWriter->ready());
+}
+
+static TelemetryFrame frame(long seconds, uint8_t valueCount)
+{
+    TelemetryFrame frame = {};
+    frame.time.tv_sec = seconds;
+    frame.values[0] = 21.4f;
+    frame.values[1] = 40.6f;
+    frame.valueCount = valueCount;
+    return frame;
+}
+
+// Frames without both values can't become a sample, they are counted instead of lost silently
+void test_short_frames_are_counted_as_dropped(void)
+{
+    batchWriter->add(frame(1700000000, 2));
+    batchWriter->add(frame(1700000001, 1));
+    TEST_ASSERT_EQUAL(1, batchWriter->pending());
+    TEST_ASSERT_EQUAL(1, batchWriter->getDroppedFrames());
+
+    std::filesystem::remove_all(TEST_FS_ROOT);
+    fs::FS fileSystem(TEST_FS_ROOT);
+    fileSystem.begin();
+    SampleLog log(fileSystem);
+    TEST_ASSERT_TRUE(log.begin());
+    FirestoreSink sink(*batchWriter, log);
+    sink.loop(true);
+    sink.add(frame(1700000002, 0));
+    sink.add(frame(1700000003, 2));
+    TEST_ASSERT_EQUAL(1, sink.getDropped());
+    TEST_ASSERT_EQUAL(2, batchWriter->pending());
+    std::filesystem::remove_all(TEST_FS_ROOT);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_full_batch_is_one_commit);
+    RUN_TEST(test_long_names_are_sent_whole);
+    RUN_TEST(test_adding_to_full_batch_flushes_first);
+    RUN_TEST(test_partial_batch_waits_for_latency_budget);
+    RUN_TEST(test_end_flushes_pending_samples);
+    RUN_TEST(test_requests_per_minute);
+    RUN_TEST(test_errors_reach_the_callback);
+    RUN_TEST(test_failed_commit_is_sent_again);
+    RUN_TEST(test_commit_is_dropped_after_max_attempts);
+    RUN_TEST(test_commit_without_result_is_sent_again);
+    RUN_TEST(test_commit_without_free_slot_replaces_the_oldest);
+    RUN_TEST(test_short_frames_are_counted_as_dropped);
+    return UNITY_END();
+}
@@ -0,0 +1,109 @@
+#include <unity.h>
+
+#include <Arduino.h>
+
+#include <HeapTracker.h>
+
+// Heap accounting with the [heap_debug] flags: malloc, String and new inside a tagged scope
+// are all counted, run with pio test -e native_heap
+
+#if !DEBUG_HEAP || !DEBUG_HEAP_WRAP_MALLOC
+#error "Build with the [heap_debug] flags, e.g. pio test -e native_heap"
+#endif
+
+// Collects the printed report in a fixed buffer, so printing allocates nothing
+struct CapturePrint
+{
+    char text[1024];
+    size_t used = 0;
+
+    size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)))
+    {
+        va_list args;
+        va_start(args, format);
+        int written = vsnprintf(text + used, sizeof(text) - used, format, args);
+        va_end(args);
+        used += written;
+        return written;
+    }
+};
+
+static long liveBytes()
+{
+    CapturePrint out;
+    HeapTracker::instance().print(out);
+    long live = -1;
+    sscanf(out.text, "heap: live=%ld", &live);
+    return live;
+}
+
+static uint32_t allocationsOf(const char *label) { return HeapTracker::instance().get(label)->allocations.load(); }
+
+void setUp(void) { HEAP_RESET() }
+
+void tearDown(void) {}
+
+void test_malloc_in_a_scope_is_tagged(void)
+{
+    void *block;
+    {
+        HEAP_SCOPE(Malloc);
+        block = malloc(100);
+    }
+    free(block);
+    TEST_ASSERT_EQUAL(1, allocationsOf("Malloc"));
+    TEST_ASSERT_EQUAL(100, HeapTracker::instance().get("Malloc")->bytes.load());
+    TEST_ASSERT_EQUAL(100, HeapTracker::instance().get("Malloc")->largest.load());
+}
+
+// String goes through malloc/realloc, not new, so only the wrapper sees it
+void test_string_in_a_scope_is_tagged(void)
+{
+    {
+        HEAP_SCOPE(Strings);
+        String text("a string longer than any small string buffer");
+        for (int i = 0; i < 20; i++)
+            text += " and a bit more";
+    }
+    TEST_ASSERT_GREATER_OR_EQUAL(1, allocationsOf("Strings"));
+}
+
+void test_new_and_nested_scopes(void)
+{
+    int *outer;
+    int *inner;
+    {
+        HEAP_SCOPE(Outer);
+        outer = new int[8];
+        {
+            HEAP_SCOPE(Inner);
+            inner = new int;
+        }
+    }
+    delete[] outer;
+    delete inner;
+    TEST_ASSERT_EQUAL(1, allocationsOf("Outer"));
+    TEST_ASSERT_EQUAL(1, allocationsOf("Inner"));
+}
+
+void test_freed_blocks_leave_no_live_bytes(void)
+{
+    long before = liveBytes();
+    void *blocks[50];
+    for (int i = 0; i < 50; i++)
+        blocks[i] = realloc(calloc(4, 16), 512);
+    TEST_ASSERT_GREATER_OR_EQUAL(before + 50 * 512, liveBytes());
+    for (int i = 0; i < 50; i++)
+        free(blocks[i]);
+    TEST_ASSERT_EQUAL(before, liveBytes());
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_malloc_in_a_scope_is_tagged);
+    RUN_TEST(test_string_in_a_scope_is_tagged);
+    RUN_TEST(test_new_and_nested_scopes);
+    RUN_TEST(test_freed_blocks_leave_no_live_bytes);
+    return UNITY_END();
+}
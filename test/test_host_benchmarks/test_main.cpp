@@ -0,0 +1,340 @@
+#include <unity.h>
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <FirebaseClient.h>
+#include <FS.h>
+#include <filesystem>
+
+#include <Scheduler.h>
+#include <SimpleTimer.h>
+#include <TelemetryRecord.h>
+#include <WindowAggregator.h>
+#include <CredentialsManager/CredentialsManager.h>
+#include <Firestore/FirestoreBatchWriter.h>
+#include <Firestore/FirestoreSummaryWriter.h>
+
+// Host benchmarks of the hot paths the sketches run: config loading, payload
+// serialization, timestamp formatting, timer dispatch and raw or summarized uploads. Each one checks that both
+// sides produce the same result, timings use the steady clock and are printed, not
+// asserted, so CI logs show regressions without failing on a slow runner.
+
+#define TEST_FS_ROOT "./.native_fs_host_benchmarks"
+
+#define CONFIG_ROUNDS 25
+#define SERIALIZE_ROUNDS 20000
+#define TIMESTAMP_ROUNDS 20000
+#define DISPATCH_TASKS 4
+#define DISPATCH_MILLIS 600000
+#define AGGREGATE_SAMPLES 36000 // ten hours at 1 Hz
+#define AGGREGATE_WINDOW_MS 60000
+
+fs::FS fileSystem(TEST_FS_ROOT);
+
+static uint64_t nowNanos()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void writeFile(const char *path, const char *text)
+{
+    File file = fileSystem.open(path, "w");
+    file.print(text);
+    file.close();
+}
+
+void setUp(void)
+{
+    std::filesystem::remove_all(TEST_FS_ROOT);
+    fileSystem.begin();
+    writeFile(WIFI_CONFIG_FILE, "{\"ssid\":\"bench-net\",\"password\":\"secret-pass\"}");
+    writeFile(FIREBASE_CONFIG_FILE, "{\"apiKey\":\"AIzaSyA-bench\",\"projectId\":\"bench-project\","
+                                    "\"realtimeDbUrl\":\"https://bench-project.firebaseio.com\","
+                                    "\"userEmail\":\"device@example.com\",\"userPassword\":\"device-pass\"}");
+    FakeClock::instance().unfreeze();
+}
+
+void tearDown(void) { std::filesystem::remove_all(TEST_FS_ROOT); }
+
+/**--------------------------------------------------------------------------------------
+ * Config Loading
+ *-------------------------------------------------------------------------------------*/
+
+void test_config_cache_matches_json(void)
+{
+    CredentialsManager credentials(fileSystem);
+    WifiCredential wifi;
+    FirebaseCredential firebase;
+    TEST_ASSERT_TRUE(credentials.getCredentials(wifi, firebase)); // parses the JSON, writes the cache
+    TEST_ASSERT_TRUE(fileSystem.exists(CONFIG_CACHE_FILE));
+
+    WifiCredential cachedWifi;
+    FirebaseCredential cachedFirebase;
+    ConfigCache cache(fileSystem);
+    TEST_ASSERT_TRUE(cache.load(cache.stamp(WIFI_CONFIG_FILE), cache.stamp(FIREBASE_CONFIG_FILE), cachedWifi, cachedFirebase));
+    TEST_ASSERT_EQUAL_STRING("bench-net", cachedWifi.ssid.c_str());
+    TEST_ASSERT_EQUAL_STRING(wifi.password.c_str(), cachedWifi.password.c_str());
+    TEST_ASSERT_EQUAL_STRING("https://bench-project.firebaseio.com", cachedFirebase.realtimeDbUrl.c_str());
+    TEST_ASSERT_EQUAL_STRING(firebase.userPassword.c_str(), cachedFirebase.userPassword.c_str());
+}
+
+void test_benchmark_config_load(void)
+{
+    CredentialsManager credentials(fileSystem);
+    WifiCredential wifi;
+    FirebaseCredential firebase;
+    credentials.getCredentials(wifi, firebase);
+
+    uint64_t start = nowNanos();
+    for (int round = 0; round < CONFIG_ROUNDS; round++)
+    {
+        wifi = credentials.getWifiCredential();
+        firebase = credentials.getFirebaseCredential();
+    }
+    uint64_t jsonNanos = nowNanos() - start;
+    TEST_ASSERT_FALSE(wifi.isEmpty() || firebase.isEmpty());
+
+    ConfigCache cache(fileSystem);
+    start = nowNanos();
+    for (int round = 0; round < CONFIG_ROUNDS; round++)
+        TEST_ASSERT_TRUE(cache.load(cache.stamp(WIFI_CONFIG_FILE), cache.stamp(FIREBASE_CONFIG_FILE), wifi, firebase));
+    uint64_t cacheNanos = nowNanos() - start;
+
+    Serial.printf("config load: JSON files %lu us, config cache %lu us\n",
+                  (unsigned long)(jsonNanos / 1000 / CONFIG_ROUNDS), (unsigned long)(cacheNanos / 1000 / CONFIG_ROUNDS));
+}
+
+/**--------------------------------------------------------------------------------------
+ * Payload Serialization
+ *-------------------------------------------------------------------------------------*/
+
+struct Sample
+{
+    uint32_t timestamp;
+    int32_t temperature;
+    int32_t humidity;
+
+    TELEMETRY_SCHEMA(telemetryField("timestamp", &Sample::timestamp),
+                     telemetryField("temperature", &Sample::temperature),
+                     telemetryField("humidity", &Sample::humidity))
+};
+
+void test_benchmark_payload_serialization(void)
+{
+    char json[96];
+    char expected[96];
+    JsonDocument doc;
+
+    uint64_t start = nowNanos();
+    for (uint32_t round = 0; round < SERIALIZE_ROUNDS; round++)
+    {
+        doc.clear();
+        doc["timestamp"] = 1700000000 + round;
+        doc["temperature"] = (int32_t)(round % 40);
+        doc["humidity"] = (int32_t)(round % 100);
+        serializeJson(doc, expected, sizeof(expected));
+    }
+    uint64_t documentNanos = nowNanos() - start;
+
+    start = nowNanos();
+    for (uint32_t round = 0; round < SERIALIZE_ROUNDS; round++)
+    {
+        Sample sample = {1700000000 + round, (int32_t)(round % 40), (int32_t)(round % 100)};
+        TEST_ASSERT_NOT_EQUAL(0, TelemetrySerializer::toRealtimeJson(sample, json, sizeof(json)));
+    }
+    uint64_t serializerNanos = nowNanos() - start;
+
+    TEST_ASSERT_EQUAL_STRING(expected, json);
+    Serial.printf("payload: JsonDocument %lu ns, TelemetrySerializer %lu ns\n",
+                  (unsigned long)(documentNanos / SERIALIZE_ROUNDS), (unsigned long)(serializerNanos / SERIALIZE_ROUNDS));
+}
+
+/**--------------------------------------------------------------------------------------
+ * Timestamp Formatting
+ *-------------------------------------------------------------------------------------*/
+
+// The original sketch helper: local time, sprintf and a String per sample
+static String getTimestampString(const struct timeval &tv)
+{
+    time_t now = tv.tv_sec;
+    struct tm ts = *localtime(&now);
+    char buf[100];
+    sprintf(buf, "%04d-%02d-%02dT%02d:%02d:%02d.%06ldZ",
+            ts.tm_year + 1900, ts.tm_mon + 1, ts.tm_mday,
+            ts.tm_hour, ts.tm_min, ts.tm_sec, (long)tv.tv_usec);
+    return String(buf);
+}
+
+// The batch writers: UTC without the time zone lookup, formatted into a stack buffer
+static void formatTimestamp(const struct timeval &tv, char *buf, size_t size)
+{
+    time_t now = tv.tv_sec;
+    struct tm ts;
+    gmtime_r(&now, &ts);
+    snprintf(buf, size, "%04d-%02d-%02dT%02d:%02d:%02d.%06ldZ",
+             ts.tm_year + 1900, ts.tm_mon + 1, ts.tm_mday,
+             ts.tm_hour, ts.tm_min, ts.tm_sec, (long)tv.tv_usec);
+}
+
+void test_benchmark_timestamp_formatting(void)
+{
+    setenv("TZ", "UTC0", 1); // what configTzTime() sets in the sketches
+    tzset();
+    char buf[FIRESTORE_TIMESTAMP_SIZE];
+    struct timeval tv = {1700000000, 250000};
+    String timestamp = getTimestampString(tv);
+    TEST_ASSERT_EQUAL_STRING("2023-11-14T22:13:20.250000Z", timestamp.c_str());
+    formatTimestamp(tv, buf, sizeof(buf));
+    TEST_ASSERT_EQUAL_STRING("2023-11-14T22:13:20.250000Z", buf);
+
+    size_t length = 0;
+    uint64_t start = nowNanos();
+    for (int round = 0; round < TIMESTAMP_ROUNDS; round++)
+    {
+        tv.tv_sec++;
+        length += getTimestampString(tv).length();
+    }
+    uint64_t stringNanos = nowNanos() - start;
+
+    start = nowNanos();
+    for (int round = 0; round < TIMESTAMP_ROUNDS; round++)
+    {
+        tv.tv_sec++;
+        formatTimestamp(tv, buf, sizeof(buf));
+        length -= strlen(buf);
+    }
+    uint64_t bufferNanos = nowNanos() - start;
+
+    TEST_ASSERT_EQUAL(0, length);
+    Serial.printf("timestamp: localtime + String %lu ns, gmtime_r + buffer %lu ns\n",
+                  (unsigned long)(stringNanos / TIMESTAMP_ROUNDS), (unsigned long)(bufferNanos / TIMESTAMP_ROUNDS));
+}
+
+/**--------------------------------------------------------------------------------------
+ * Timer Dispatch
+ *-------------------------------------------------------------------------------------*/
+
+static const uint32_t periods[DISPATCH_TASKS] = {100, 1000, 10000, 60000};
+static uint32_t dispatched[DISPATCH_TASKS];
+
+template <int Task>
+static void onTimer() { dispatched[Task]++; }
+
+static const SchedulerCallback callbacks[DISPATCH_TASKS] = {onTimer<0>, onTimer<1>, onTimer<2>, onTimer<3>};
+
+// Ten simulated minutes of 1 ms loop iterations on the frozen clock
+void test_benchmark_timer_dispatch(void)
+{
+    FakeClock::instance().set(0);
+    SimpleTimer timers[DISPATCH_TASKS];
+    for (int i = 0; i < DISPATCH_TASKS; i++)
+        timers[i].setPeriod(periods[i]);
+
+    uint64_t start = nowNanos();
+    for (uint32_t ms = 0; ms < DISPATCH_MILLIS; ms++)
+    {
+        FakeClock::instance().advanceMillis(1);
+        for (int i = 0; i < DISPATCH_TASKS; i++)
+            if (timers[i].ready())
+                callbacks[i]();
+    }
+    uint64_t pollNanos = nowNanos() - start;
+    uint32_t polled[DISPATCH_TASKS];
+    memcpy(polled, dispatched, sizeof(polled));
+    memset(dispatched, 0, sizeof(dispatched));
+
+    FakeClock::instance().set(0);
+    Scheduler<DISPATCH_TASKS> scheduler;
+    for (int i = 0; i < DISPATCH_TASKS; i++)
+        scheduler.every(periods[i], callbacks[i]);
+
+    start = nowNanos();
+    for (uint32_t ms = 0; ms < DISPATCH_MILLIS; ms++)
+    {
+        FakeClock::instance().advanceMillis(1);
+        scheduler.run();
+    }
+    uint64_t schedulerNanos = nowNanos() - start;
+
+    for (int i = 0; i < DISPATCH_TASKS; i++)
+    {
+        TEST_ASSERT_EQUAL(DISPATCH_MILLIS / periods[i], polled[i]);
+        TEST_ASSERT_EQUAL(polled[i], dispatched[i]);
+    }
+    Serial.printf("dispatch of %d timers: SimpleTimer polling %lu ns/loop, Scheduler %lu ns/loop\n", DISPATCH_TASKS,
+                  (unsigned long)(pollNanos / DISPATCH_MILLIS), (unsigned long)(schedulerNanos / DISPATCH_MILLIS));
+}
+
+/**--------------------------------------------------------------------------------------
+ * Window Aggregation
+ *-------------------------------------------------------------------------------------*/
+
+void onCommitResult(AsyncResult &) {}
+
+// Per-sample cost of the Firestore sketch with AGGREGATE_WINDOW_MS 0 (every sample in a
+// batch commit) and 60000 (one summary per minute), request bodies included
+void test_benchmark_window_aggregation(void)
+{
+    static const char *const fields[] = {"temperature", "humidity"};
+    Firestore::Documents docs;
+    AsyncClientClass rawClient;
+    AsyncClientClass summaryClient;
+    rawClient.setLatency(0, 0);
+    summaryClient.setLatency(0, 0);
+    FirestoreBatchWriter batchWriter(rawClient, docs, onCommitResult);
+    batchWriter.begin("bench-project", "bench/samples", "device1");
+    batchWriter.setMaxBatch(20);
+    FirestoreSummaryWriter<2> summaryWriter(summaryClient, docs, onCommitResult);
+    summaryWriter.begin("bench-project", "bench/summaries", "device1", fields);
+    WindowAggregator<2, 32> aggregator;
+    aggregator.setWindow(AGGREGATE_WINDOW_MS);
+    aggregator.setRange(0, 0, 100);
+    aggregator.setRange(1, 0, 100);
+
+    FirestoreSample sample;
+    uint64_t start = nowNanos();
+    for (uint32_t i = 0; i < AGGREGATE_SAMPLES; i++)
+    {
+        sample.time = {1700000000 + (time_t)i, 0};
+        sample.temperature = 20 + i % 5;
+        sample.humidity = 40 + i % 7;
+        batchWriter.add(sample);
+        docs.loop();
+    }
+    batchWriter.flush();
+    docs.loop();
+    uint64_t rawNanos = nowNanos() - start;
+
+    start = nowNanos();
+    for (uint32_t i = 0; i < AGGREGATE_SAMPLES; i++)
+    {
+        float values[2] = {(float)(20 + i % 5), (float)(40 + i % 7)};
+        if (aggregator.add((1700000000ULL + i) * 1000, values))
+        {
+            summaryWriter.add(aggregator.getSummary());
+            summaryWriter.flush();
+        }
+        docs.loop();
+    }
+    uint64_t aggregateNanos = nowNanos() - start;
+
+    TEST_ASSERT_EQUAL(AGGREGATE_SAMPLES, batchWriter.getSampleCount());
+    TEST_ASSERT_EQUAL(AGGREGATE_SAMPLES / 20, rawClient.getRequests());
+    TEST_ASSERT_EQUAL(aggregator.getWindowCount(), summaryClient.getRequests()); // one commit per closed window
+    TEST_ASSERT_UINT32_WITHIN(1, AGGREGATE_SAMPLES / 60, aggregator.getWindowCount());
+    Serial.printf("upload per sample: raw batches %lu ns %.1f bytes, 60 s summaries %lu ns %.1f bytes\n",
+                  (unsigned long)(rawNanos / AGGREGATE_SAMPLES), (double)rawClient.getBytes() / AGGREGATE_SAMPLES,
+                  (unsigned long)(aggregateNanos / AGGREGATE_SAMPLES), (double)summaryClient.getBytes() / AGGREGATE_SAMPLES);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_config_cache_matches_json);
+    RUN_TEST(test_benchmark_config_load);
+    RUN_TEST(test_benchmark_payload_serialization);
+    RUN_TEST(test_benchmark_timestamp_formatting);
+    RUN_TEST(test_benchmark_timer_dispatch);
+    RUN_TEST(test_benchmark_window_aggregation);
+    return UNITY_END();
+}
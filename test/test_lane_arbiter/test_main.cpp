@@ -0,0 +1,283 @@
+#include <unity.h>
+
+#include <Arduino.h>
+#include <deque>
+#include <FirebaseClient.h>
+
+#include <LaneArbiter.h>
+#include <RateController.h>
+#include <TaskTracer.h>
+
+#include <RealtimeDatabase/RealtimeBatchWriter.h>
+
+// LaneArbiter picks on the frozen FakeClock, and a mixed-load benchmark of the realtime
+// sketch's send step: alarms sharing the telemetry client and its one in-flight slot,
+// against alarms with a client and slot of their own
+
+#define LANE_CRITICAL 0
+#define LANE_BULK 1
+#define LANE_COUNT 2
+
+#define BENCHMARK_MILLIS (4 * 3600 * 1000UL) // four hours of 1 Hz telemetry
+#define ALARM_EVERY_MS 20000                 // mean gap between alarms
+#define TRACKED_REQUESTS 64
+
+typedef LaneArbiter<LANE_COUNT> Arbiter;
+
+// One upload path: a writer, the client it sends on and the slot that gates it
+struct Lane
+{
+    AsyncClientClass *client;
+    RateController *rate;
+    RealtimeBatchWriter *writer;
+    std::deque<uint32_t> ring;           // millis() of the readings not yet in the writer
+    uint32_t batchOldest;                // millis() of the oldest reading in the writer
+    uint32_t oldestAt[TRACKED_REQUESTS]; // batchOldest of each request in flight
+    BenchmarkStats latency;              // reading to result, milliseconds
+};
+
+AsyncClientClass telemetryClient;
+AsyncClientClass alarmClient;
+RealtimeDatabase Database;
+TaskTracer *tracer;
+Lane lanes[LANE_COUNT];
+
+static void onResult(uint8_t lane, AsyncResult &aResult)
+{
+    if (!aResult.isError() && !aResult.available())
+        return;
+    String uid = aResult.uid();
+    uint16_t request = TaskTracer::sequenceOf(uid.c_str());
+    tracer->complete(uid.c_str(), aResult.isError());
+    lanes[lane].rate->onComplete(request, aResult.isError());
+    lanes[lane].writer->onResult(request, aResult.isError());
+    lanes[lane].latency.add(millis() - lanes[lane].oldestAt[request % TRACKED_REQUESTS]);
+}
+
+void onAlarmResult(AsyncResult &aResult) { onResult(LANE_CRITICAL, aResult); }
+void onTelemetryResult(AsyncResult &aResult) { onResult(LANE_BULK, aResult); }
+
+// Readings arrive in the lane's ring, the sketch moves at most space() of them into the writer
+static void read(Lane &lane) { lane.ring.push_back(millis()); }
+
+static void drain(Lane &lane)
+{
+    for (size_t space = lane.writer->space(); space && !lane.ring.empty(); space--)
+    {
+        if (!lane.writer->pending())
+            lane.batchOldest = lane.ring.front();
+        lane.writer->add(lane.ring.front(), 21.5f, 40.0f);
+        lane.ring.pop_front();
+    }
+}
+
+// The send step of the realtime sketch: every lane with work and a free slot is offered,
+// the arbiter picks, until no lane can send
+static void sendStep(Arbiter &arbiter)
+{
+    Lane &alarm = lanes[LANE_CRITICAL];
+    Lane &bulk = lanes[LANE_BULK];
+    drain(alarm);
+    drain(bulk);
+    for (uint8_t send = 0; send < LANE_COUNT; send++)
+    {
+        if (alarm.writer->pending() && alarm.rate->canSend())
+            arbiter.offer(LANE_CRITICAL, alarm.writer->getAge());
+        if (bulk.writer->ready() && bulk.rate->canSend())
+            arbiter.offer(LANE_BULK, bulk.writer->getAge());
+
+        int8_t pick = arbiter.next();
+        if (pick < 0)
+            break;
+        Lane &lane = lanes[pick];
+        if (lane.writer->flush())
+        {
+            lane.oldestAt[lane.writer->getLastRequest() % TRACKED_REQUESTS] = lane.batchOldest;
+            lane.rate->onSubmit(lane.writer->getLastRequest());
+        }
+    }
+}
+
+// Sets up both lanes, alarms on their own client and slot or on the telemetry ones
+static void setUpLanes(bool ownSlot)
+{
+    static RateController telemetryRate;
+    static RateController alarmRate;
+    telemetryRate = RateController();
+    alarmRate = RateController();
+    telemetryRate.setRequestTimeout(30000);
+    alarmRate.setRequestTimeout(10000);
+
+    lanes[LANE_BULK].client = &telemetryClient;
+    lanes[LANE_BULK].rate = &telemetryRate;
+    lanes[LANE_CRITICAL].client = ownSlot ? &alarmClient : &telemetryClient;
+    lanes[LANE_CRITICAL].rate = ownSlot ? &alarmRate : &telemetryRate;
+
+    lanes[LANE_BULK].writer = new RealtimeBatchWriter(*lanes[LANE_BULK].client, Database, onTelemetryResult);
+    lanes[LANE_BULK].writer->begin("/test/json");
+    lanes[LANE_BULK].writer->setMaxBatch(10);
+    lanes[LANE_BULK].writer->setMaxLatency(10000);
+    lanes[LANE_CRITICAL].writer = new RealtimeBatchWriter(*lanes[LANE_CRITICAL].client, Database, onAlarmResult);
+    lanes[LANE_CRITICAL].writer->begin("/test/alarms");
+    lanes[LANE_CRITICAL].writer->setOperation("alarmTask");
+    for (uint8_t i = 0; i < LANE_COUNT; i++)
+    {
+        lanes[i].writer->setTracer(tracer);
+        lanes[i].ring.clear();
+        lanes[i].latency.reset();
+    }
+}
+
+static void tearDownLanes()
+{
+    for (uint8_t i = 0; i < LANE_COUNT; i++)
+    {
+        delete lanes[i].writer;
+        lanes[i].writer = nullptr;
+    }
+}
+
+// Mixed load: 1 Hz telemetry in batches of 10, an alarm on average every ALARM_EVERY_MS,
+// round trips of 200 ms to 2.5 s on both connections
+static void runMixedLoad(bool ownSlot)
+{
+    FakeClock::instance().set(0);
+    telemetryClient = AsyncClientClass();
+    alarmClient = AsyncClientClass();
+    telemetryClient.setLatency(200, 2500).setSeed(7);
+    alarmClient.setLatency(200, 2500).setSeed(11);
+    setUpLanes(ownSlot);
+    Arbiter arbiter;
+    arbiter.setMaxWait(LANE_CRITICAL, 2000).setMaxWait(LANE_BULK, 120000);
+
+    uint32_t seed = 2024;
+    while (millis() < BENCHMARK_MILLIS)
+    {
+        FakeClock::instance().advanceMillis(10);
+        if (millis() % 1000 == 0)
+            read(lanes[LANE_BULK]);
+        seed ^= seed << 13, seed ^= seed >> 17, seed ^= seed << 5;
+        if (seed % (ALARM_EVERY_MS / 10) == 0)
+            read(lanes[LANE_CRITICAL]);
+        Database.loop();
+        sendStep(arbiter);
+    }
+}
+
+static void printLanes(const char *name)
+{
+    static const char *const names[LANE_COUNT] = {"critical", "bulk"};
+    for (uint8_t i = 0; i < LANE_COUNT; i++)
+    {
+        BenchmarkStats &latency = lanes[i].latency;
+        Serial.printf("%s %-8s: %5lu results, latency p50=%lu p95=%lu p99=%lu max=%lu ms\n", name, names[i], (unsigned long)latency.count,
+                      (unsigned long)latency.percentile(50), (unsigned long)latency.percentile(95), (unsigned long)latency.percentile(99),
+                      (unsigned long)latency.max);
+    }
+}
+
+void setUp(void)
+{
+    FakeClock::instance().set(0);
+    tracer = new TaskTracer();
+}
+
+void tearDown(void)
+{
+    tearDownLanes();
+    delete tracer;
+}
+
+void test_strict_mode_sends_critical_first(void)
+{
+    Arbiter arbiter;
+    arbiter.offer(LANE_BULK, 5000);
+    arbiter.offer(LANE_CRITICAL, 10);
+    TEST_ASSERT_EQUAL(LANE_CRITICAL, arbiter.next());
+    arbiter.offer(LANE_BULK, 5000);
+    TEST_ASSERT_EQUAL(LANE_BULK, arbiter.next());
+    TEST_ASSERT_EQUAL(-1, arbiter.next()); // offers are cleared by next()
+}
+
+void test_weighted_mode_shares_sends_by_weight(void)
+{
+    Arbiter arbiter;
+    arbiter.setMode(LANE_WEIGHTED).setWeight(LANE_CRITICAL, 3).setWeight(LANE_BULK, 1);
+    for (int i = 0; i < 40; i++)
+    {
+        arbiter.offer(LANE_CRITICAL, 0);
+        arbiter.offer(LANE_BULK, 0);
+        arbiter.next();
+    }
+    TEST_ASSERT_EQUAL(30, arbiter.getServed(LANE_CRITICAL));
+    TEST_ASSERT_EQUAL(10, arbiter.getServed(LANE_BULK));
+}
+
+// A steady critical load can't starve bulk past its max wait
+void test_overdue_bulk_goes_next_in_strict_mode(void)
+{
+    Arbiter arbiter;
+    arbiter.setMaxWait(LANE_BULK, 1000);
+    arbiter.offer(LANE_CRITICAL, 0);
+    arbiter.offer(LANE_BULK, 999);
+    TEST_ASSERT_EQUAL(LANE_CRITICAL, arbiter.next());
+    arbiter.offer(LANE_CRITICAL, 0);
+    arbiter.offer(LANE_BULK, 1000);
+    TEST_ASSERT_EQUAL(LANE_BULK, arbiter.next());
+    TEST_ASSERT_EQUAL(0, arbiter.getOverdue(LANE_BULK)); // served at its bound, not past it
+}
+
+// With a shared slot an alarm waits for the telemetry update in flight
+void test_own_slot_sends_alarm_during_telemetry_update(void)
+{
+    telemetryClient.setLatency(2000, 2000);
+    alarmClient.setLatency(300, 300);
+    for (bool ownSlot : {false, true})
+    {
+        FakeClock::instance().set(0);
+        setUpLanes(ownSlot);
+        Arbiter arbiter;
+        lanes[LANE_BULK].writer->setMaxBatch(1);
+        read(lanes[LANE_BULK]);
+        sendStep(arbiter);
+        read(lanes[LANE_CRITICAL]);
+        sendStep(arbiter);
+        for (uint32_t i = 0; i < 500; i++)
+        {
+            FakeClock::instance().advanceMillis(10);
+            Database.loop();
+            sendStep(arbiter);
+        }
+        TEST_ASSERT_EQUAL(1, lanes[LANE_CRITICAL].latency.count);
+        TEST_ASSERT_EQUAL(ownSlot ? 300 : 2000 + 2000, lanes[LANE_CRITICAL].latency.max);
+        tearDownLanes();
+    }
+}
+
+void test_benchmark_mixed_load_shared_and_own_slot(void)
+{
+    runMixedLoad(false);
+    printLanes("shared slot");
+    uint32_t sharedP99 = lanes[LANE_CRITICAL].latency.percentile(99);
+    uint32_t sharedBulk = lanes[LANE_BULK].latency.count;
+    TEST_ASSERT_GREATER_THAN(500, lanes[LANE_CRITICAL].latency.count);
+    tearDownLanes();
+
+    runMixedLoad(true);
+    printLanes("own slot   ");
+    TEST_ASSERT_GREATER_THAN(500, lanes[LANE_CRITICAL].latency.count);
+    TEST_ASSERT_LESS_OR_EQUAL(2 * 2500, lanes[LANE_CRITICAL].latency.max); // behind one alarm at most, never telemetry
+    TEST_ASSERT_LESS_THAN(sharedP99, lanes[LANE_CRITICAL].latency.percentile(99));
+    TEST_ASSERT_GREATER_OR_EQUAL(sharedBulk, lanes[LANE_BULK].latency.count); // bulk loses nothing
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_strict_mode_sends_critical_first);
+    RUN_TEST(test_weighted_mode_shares_sends_by_weight);
+    RUN_TEST(test_overdue_bulk_goes_next_in_strict_mode);
+    RUN_TEST(test_own_slot_sends_alarm_during_telemetry_update);
+    RUN_TEST(test_benchmark_mixed_load_shared_and_own_slot);
+    return UNITY_END();
+}
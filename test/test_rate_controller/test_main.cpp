@@ -0,0 +1,182 @@
+#include <unity.h>
+
+#include <Arduino.h>
+#include <FirebaseClient.h>
+
+#include <RateController.h>
+#include <TaskTracer.h>
+
+#include <RealtimeDatabase/RealtimeBatchWriter.h>
+
+// RateController on the frozen FakeClock: AIMD steps, per-request timeouts, and a late
+// result from the mock endpoint that must not be taken for a newer request's result
+
+AsyncClientClass aClient;
+RealtimeDatabase Database;
+TaskTracer *tracer;
+RateController *rate;
+RealtimeBatchWriter *batchWriter;
+uint32_t results;
+
+// The result handling of the sketches
+void onUpdateResult(AsyncResult &aResult)
+{
+    if (!aResult.isError() && !aResult.available())
+        return;
+    results++;
+    String uid = aResult.uid();
+    tracer->complete(uid.c_str(), aResult.isError());
+    rate->onComplete(TaskTracer::sequenceOf(uid.c_str()), aResult.isError());
+    batchWriter->onResult(TaskTracer::sequenceOf(uid.c_str()), aResult.isError());
+}
+
+// The send step of the sketches, true if an update was submitted
+static bool trySend()
+{
+    Database.loop();
+    if (!batchWriter->ready() || !rate->canSend() || !batchWriter->flush())
+        return false;
+    rate->onSubmit(batchWriter->getLastRequest());
+    return true;
+}
+
+static void runUntil(uint32_t millis)
+{
+    while (::millis() < millis)
+    {
+        FakeClock::instance().advanceMillis(10);
+        trySend();
+    }
+}
+
+void setUp(void)
+{
+    FakeClock::instance().set(0);
+    aClient = AsyncClientClass();
+    results = 0;
+    tracer = new TaskTracer();
+    rate = new RateController();
+    rate->setInterval(1000, 60000, 1000).setTargetLatency(2000).setRequestTimeout(5000).setBatch(1, 20, 1000);
+    batchWriter = new RealtimeBatchWriter(aClient, Database, onUpdateResult);
+    batchWriter->begin("/test/samples");
+    batchWriter->setTracer(tracer);
+    batchWriter->setMaxBatch(1); // every sample is ready on its own
+    batchWriter->setMaxLatency(0);
+}
+
+void tearDown(void)
+{
+    delete batchWriter;
+    delete rate;
+    delete tracer;
+}
+
+void test_fast_results_shrink_the_interval(void)
+{
+    RateController controller;
+    controller.setInterval(2000, 60000, 1000).setBatch(1, 20, 1000);
+    TEST_ASSERT_EQUAL(10000, controller.getInterval());
+    TEST_ASSERT_EQUAL(10, controller.getBatchSize());
+    for (uint16_t request = 1; request <= 5; request++)
+    {
+        TEST_ASSERT_TRUE(controller.canSend());
+        controller.onSubmit(request);
+        TEST_ASSERT_FALSE(controller.canSend());
+        FakeClock::instance().advanceMillis(300);
+        controller.onComplete(request, false);
+    }
+    TEST_ASSERT_EQUAL(5000, controller.getInterval());
+    TEST_ASSERT_EQUAL(5, controller.getBatchSize());
+    TEST_ASSERT_EQUAL(5, controller.getIncreases());
+}
+
+void test_errors_and_slow_results_double_the_interval(void)
+{
+    RateController controller;
+    controller.setInterval(2000, 30000, 1000).setTargetLatency(2000);
+    controller.onSubmit(1);
+    controller.onComplete(1, true);
+    TEST_ASSERT_EQUAL(20000, controller.getInterval());
+    controller.onSubmit(2);
+    FakeClock::instance().advanceMillis(2500);
+    controller.onComplete(2, false);
+    TEST_ASSERT_EQUAL(30000, controller.getInterval()); // capped
+    TEST_ASSERT_EQUAL(2, controller.getDecreases());
+}
+
+// With two in flight each request times out on its own
+void test_requests_time_out_one_by_one(void)
+{
+    RateController controller;
+    controller.setMaxInFlight(2).setRequestTimeout(5000);
+    controller.onSubmit(1);
+    FakeClock::instance().advanceMillis(3000);
+    controller.onSubmit(2);
+    TEST_ASSERT_FALSE(controller.canSend());
+
+    FakeClock::instance().advanceMillis(2000);
+    TEST_ASSERT_TRUE(controller.canSend()); // only request 1 expired
+    TEST_ASSERT_EQUAL(1, controller.getInFlight());
+    TEST_ASSERT_EQUAL(1, controller.getTimeouts());
+
+    controller.onComplete(2, false);
+    TEST_ASSERT_EQUAL(0, controller.getInFlight());
+    TEST_ASSERT_EQUAL(0, controller.getLate());
+}
+
+void test_unknown_results_are_ignored(void)
+{
+    RateController controller;
+    controller.onSubmit(7);
+    controller.onComplete(8, false);
+    TEST_ASSERT_EQUAL(1, controller.getInFlight());
+    TEST_ASSERT_EQUAL(1, controller.getLate());
+    TEST_ASSERT_EQUAL(10000, controller.getInterval());
+}
+
+// The first update takes 8 s, longer than the 5 s timeout. The second is sent when the
+// first times out and queues behind it on the connection. The first result arrives
+// while the second is in flight and must not free its slot or count as its round trip.
+void test_late_result_does_not_complete_a_newer_request(void)
+{
+    aClient.setLatency(8000, 8000);
+    batchWriter->add(1, 20, 40);
+    TEST_ASSERT_TRUE(trySend());
+    uint16_t first = batchWriter->getLastRequest();
+    aClient.setLatency(1000, 1000);
+
+    batchWriter->add(2, 21, 41);
+    runUntil(4990);
+    TEST_ASSERT_EQUAL(1, aClient.getRequests()); // backpressure, the sample waits
+    runUntil(5000);
+    TEST_ASSERT_EQUAL(1, rate->getTimeouts());
+    TEST_ASSERT_EQUAL(20000, rate->getInterval());
+    TEST_ASSERT_EQUAL(2, aClient.getRequests());
+    uint16_t second = batchWriter->getLastRequest();
+    TEST_ASSERT_TRUE(first != second);
+
+    batchWriter->add(3, 22, 42);
+    runUntil(8000); // the first result
+    TEST_ASSERT_EQUAL(1, results);
+    TEST_ASSERT_EQUAL(1, rate->getLate());
+    TEST_ASSERT_EQUAL(1, rate->getInFlight());
+    TEST_ASSERT_EQUAL(20000, rate->getInterval()); // no bogus round trip either way
+    runUntil(8990);
+    TEST_ASSERT_EQUAL(2, aClient.getRequests()); // still waiting for the second
+
+    runUntil(9000); // the second result, 4 s after it was sent
+    TEST_ASSERT_EQUAL(2, results);
+    TEST_ASSERT_EQUAL(20000 * 2, rate->getInterval()); // slower than the 2 s target
+    TEST_ASSERT_EQUAL(3, aClient.getRequests());       // the slot is free again
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_fast_results_shrink_the_interval);
+    RUN_TEST(test_errors_and_slow_results_double_the_interval);
+    RUN_TEST(test_requests_time_out_one_by_one);
+    RUN_TEST(test_unknown_results_are_ignored);
+    RUN_TEST(test_late_result_does_not_complete_a_newer_request);
+    return UNITY_END();
+}
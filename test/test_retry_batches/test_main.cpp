@@ -0,0 +1,178 @@
+#include <unity.h>
+
+#include <Arduino.h>
+#include <FirebaseClient.h>
+
+#include <BatchBuffer.h>
+#include <RetryBatches.h>
+#include <TaskTracer.h>
+
+#include <RealtimeDatabase/RealtimeBatchWriter.h>
+
+// RetryBatches on the frozen FakeClock: failed and timed out batches go again ahead of
+// new items, ids survive the retry, and a realtime update is sent again under its keys
+
+typedef BatchBuffer<int, 4> Buffer;
+typedef RetryBatches<int, 4, 2> Batches;
+
+AsyncClientClass aClient;
+RealtimeDatabase Database;
+TaskTracer *tracer;
+RealtimeBatchWriter *batchWriter;
+
+void onUpdateResult(AsyncResult &aResult)
+{
+    if (!aResult.isError() && !aResult.available())
+        return;
+    String uid = aResult.uid();
+    tracer->complete(uid.c_str(), aResult.isError());
+    batchWriter->onResult(TaskTracer::sequenceOf(uid.c_str()), aResult.isError());
+}
+
+static void fill(Buffer &buffer, int first, int count)
+{
+    for (int i = 0; i < count; i++)
+        buffer.add(first + i);
+}
+
+void setUp(void)
+{
+    FakeClock::instance().set(0);
+    aClient = AsyncClientClass();
+    aClient.setLatency(300, 300);
+    tracer = new TaskTracer();
+    batchWriter = new RealtimeBatchWriter(aClient, Database, onUpdateResult);
+    batchWriter->begin("/test/samples");
+    batchWriter->setTracer(tracer);
+    batchWriter->setMaxLatency(1000);
+}
+
+void tearDown(void)
+{
+    delete batchWriter;
+    delete tracer;
+}
+
+void test_failed_batch_goes_again_with_its_ids(void)
+{
+    Buffer buffer;
+    Batches batches;
+    fill(buffer, 10, 3);
+    Batches::Batch *first = batches.next(buffer, 3);
+    TEST_ASSERT_EQUAL(0, first->firstId);
+    TEST_ASSERT_TRUE(buffer.isEmpty());
+    batches.onSubmit(*first, 1);
+
+    fill(buffer, 20, 2);
+    Batches::Batch *second = batches.next(buffer, 2);
+    TEST_ASSERT_EQUAL(3, second->firstId);
+    batches.onSubmit(*second, 2);
+    TEST_ASSERT_EQUAL(5, batches.inFlight());
+
+    batches.onResult(1, true);
+    TEST_ASSERT_EQUAL(3, batches.pending());
+    TEST_ASSERT_FALSE(batches.due(1000));
+    FakeClock::instance().advanceMillis(1000);
+    TEST_ASSERT_TRUE(batches.due(1000));
+
+    fill(buffer, 30, 1);
+    Batches::Batch *retry = batches.next(buffer, 1);
+    TEST_ASSERT_TRUE(retry == first); // ahead of the new item
+    TEST_ASSERT_EQUAL(0, retry->firstId);
+    TEST_ASSERT_EQUAL(10, retry->items[0]);
+    TEST_ASSERT_EQUAL(1, buffer.size());
+    batches.onSubmit(*retry, 3);
+
+    batches.onResult(2, false);
+    batches.onResult(3, false);
+    TEST_ASSERT_EQUAL(5, batches.getDelivered());
+    TEST_ASSERT_EQUAL(1, batches.getRetries());
+    TEST_ASSERT_EQUAL(0, batches.inFlight() + batches.pending());
+}
+
+// A batch without a result fails at the request timeout, a late result is ignored
+void test_batch_without_result_times_out(void)
+{
+    Buffer buffer;
+    Batches batches;
+    batches.setRequestTimeout(5000);
+    fill(buffer, 1, 2);
+    batches.onSubmit(*batches.next(buffer, 2), 7);
+    FakeClock::instance().advanceMillis(4999);
+    TEST_ASSERT_FALSE(batches.due(0));
+    FakeClock::instance().advanceMillis(1);
+    TEST_ASSERT_TRUE(batches.due(0));
+    batches.onResult(7, false);
+    TEST_ASSERT_EQUAL(0, batches.getDelivered());
+    TEST_ASSERT_EQUAL(2, batches.pending());
+}
+
+void test_batch_is_given_up_after_max_attempts(void)
+{
+    Buffer buffer;
+    Batches batches;
+    batches.setMaxAttempts(2);
+    fill(buffer, 1, 2);
+    for (uint16_t request = 1; request <= 2; request++)
+    {
+        Batches::Batch *batch = batches.next(buffer, 2);
+        TEST_ASSERT_NOT_NULL(batch);
+        batches.onSubmit(*batch, request);
+        batches.onResult(request, true);
+    }
+    TEST_ASSERT_NULL(batches.next(buffer, 2));
+    TEST_ASSERT_EQUAL(2, batches.getFailed());
+}
+
+// Without a free slot the oldest batch waiting gives way to the new one
+void test_oldest_batch_gives_way_without_a_free_slot(void)
+{
+    Buffer buffer;
+    Batches batches;
+    for (uint16_t request = 1; request <= 3; request++)
+    {
+        fill(buffer, request * 10, 1);
+        batches.onSubmit(*batches.next(buffer, 1), request);
+    }
+    TEST_ASSERT_EQUAL(1, batches.getFailed());
+    TEST_ASSERT_EQUAL(2, batches.inFlight());
+    batches.onResult(1, false); // its batch is gone
+    TEST_ASSERT_EQUAL(0, batches.getDelivered());
+}
+
+// The update after an error carries the same push keys and values
+void test_failed_update_is_sent_again_under_its_keys(void)
+{
+    aClient.setErrorRate(100);
+    batchWriter->add(1000, 21.5f, 40.0f);
+    batchWriter->add(2000, 21.6f, 40.1f);
+    TEST_ASSERT_TRUE(batchWriter->flush());
+    String body = aClient.last().body;
+    FakeClock::instance().advanceMillis(300);
+    Database.loop();
+    TEST_ASSERT_EQUAL(2, batchWriter->pending());
+    TEST_ASSERT_FALSE(batchWriter->ready());
+
+    aClient.setErrorRate(0);
+    FakeClock::instance().advanceMillis(1000);
+    TEST_ASSERT_TRUE(batchWriter->ready());
+    batchWriter->loop();
+    TEST_ASSERT_EQUAL_STRING(body.c_str(), aClient.last().body.c_str());
+    FakeClock::instance().advanceMillis(300);
+    Database.loop();
+    TEST_ASSERT_EQUAL(2, aClient.getRequests());
+    TEST_ASSERT_EQUAL(2, batchWriter->getDeliveredSamples());
+    TEST_ASSERT_EQUAL(1, batchWriter->getRetryCount());
+    TEST_ASSERT_EQUAL(0, batchWriter->pending());
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_failed_batch_goes_again_with_its_ids);
+    RUN_TEST(test_batch_without_result_times_out);
+    RUN_TEST(test_batch_is_given_up_after_max_attempts);
+    RUN_TEST(test_oldest_batch_gives_way_without_a_free_slot);
+    RUN_TEST(test_failed_update_is_sent_again_under_its_keys);
+    return UNITY_END();
+}
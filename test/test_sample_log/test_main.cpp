@@ -0,0 +1,198 @@
+#include <unity.h>
+
+#include <Arduino.h>
+#include <FS.h>
+#include <filesystem>
+
+#define SAMPLE_LOG_SEGMENT_SIZE 256
+#define SAMPLE_LOG_MAX_SEGMENTS 4
+#include <Storage/SampleLog.h>
+
+// SampleLog on the file-backed FS, reboots are simulated by a new instance over the same files
+
+#define TEST_FS_ROOT "./.native_fs_sample_log"
+
+struct Record
+{
+    uint32_t id;
+    float value;
+};
+
+fs::FS fileSystem(TEST_FS_ROOT);
+uint32_t received[256];
+size_t receivedCount;
+
+static void append(SampleLog &log, uint32_t first, uint32_t count)
+{
+    for (uint32_t id = first; id < first + count; id++)
+        TEST_ASSERT_TRUE(log.append(Record{id, id * 0.5f}));
+}
+
+static size_t drain(SampleLog &log, size_t maxRecords = 1000)
+{
+    return log.drainAs<Record>([](const Record &record)
+                               {
+                                   received[receivedCount++] = record.id;
+                                   return true; },
+                               maxRecords);
+}
+
+// Appends bytes to a segment file the way a reset in the middle of a write leaves it
+static void tearLastRecord()
+{
+    File dir = fileSystem.open(SAMPLE_LOG_DIR);
+    String last;
+    for (File file = dir.openNextFile(); file; file = dir.openNextFile())
+    {
+        String name = file.path();
+        if (name.endsWith(".log") && (last.isEmpty() || last < name))
+            last = name;
+    }
+    File file = fileSystem.open(last, "a");
+    SampleLogHeader header = {SAMPLE_LOG_MAGIC, sizeof(Record), 0x12345678};
+    file.write((const uint8_t *)&header, sizeof(header));
+    file.write((const uint8_t *)"\x01\x02", 2);
+    file.close();
+}
+
+void setUp(void)
+{
+    std::filesystem::remove_all(TEST_FS_ROOT);
+    fileSystem.begin();
+    receivedCount = 0;
+}
+
+void tearDown(void) { std::filesystem::remove_all(TEST_FS_ROOT); }
+
+void test_records_drain_in_order_across_segments(void)
+{
+    SampleLog log(fileSystem);
+    TEST_ASSERT_TRUE(log.begin());
+    TEST_ASSERT_TRUE(log.isEmpty());
+
+    append(log, 0, 40); // 12 bytes per record, spans several segments
+    TEST_ASSERT_GREATER_THAN(1, log.getSegmentCount());
+    TEST_ASSERT_EQUAL(40, drain(log));
+    for (uint32_t i = 0; i < 40; i++)
+        TEST_ASSERT_EQUAL(i, received[i]);
+    TEST_ASSERT_TRUE(log.isEmpty());
+    TEST_ASSERT_EQUAL(0, log.getCorruptRecords());
+}
+
+void test_records_survive_a_reboot(void)
+{
+    {
+        SampleLog log(fileSystem);
+        log.begin();
+        append(log, 0, 10);
+        log.end();
+    }
+    SampleLog log(fileSystem);
+    log.begin();
+    TEST_ASSERT_FALSE(log.isEmpty());
+    TEST_ASSERT_EQUAL(10, drain(log));
+    TEST_ASSERT_EQUAL(9, received[9]);
+}
+
+// A torn record ends its segment, records written after the reboot are in a new one
+void test_torn_tail_keeps_records_written_after_reboot(void)
+{
+    {
+        SampleLog log(fileSystem);
+        log.begin();
+        append(log, 0, 5);
+        log.end();
+    }
+    tearLastRecord();
+
+    SampleLog log(fileSystem);
+    log.begin();
+    append(log, 100, 5);
+    TEST_ASSERT_EQUAL(10, drain(log));
+    TEST_ASSERT_EQUAL(1, log.getCorruptRecords());
+    TEST_ASSERT_EQUAL(4, received[4]);
+    TEST_ASSERT_EQUAL(100, received[5]);
+    TEST_ASSERT_EQUAL(104, received[9]);
+    TEST_ASSERT_TRUE(log.isEmpty());
+}
+
+// Records drained before a reboot are not sent again
+void test_drain_cursor_survives_a_reboot(void)
+{
+    {
+        SampleLog log(fileSystem);
+        log.begin();
+        append(log, 0, 10);
+        log.sync();
+        TEST_ASSERT_EQUAL(4, drain(log, 4));
+        // no end(), power is cut
+    }
+
+    receivedCount = 0;
+    SampleLog log(fileSystem);
+    log.begin();
+    TEST_ASSERT_EQUAL(6, drain(log));
+    TEST_ASSERT_EQUAL(4, received[0]);
+    TEST_ASSERT_EQUAL(9, received[5]);
+}
+
+void test_records_the_handler_refuses_stay(void)
+{
+    SampleLog log(fileSystem);
+    log.begin();
+    append(log, 0, 3);
+    size_t drained = log.drainAs<Record>([](const Record &record)
+                                         { return record.id < 1; },
+                                         10);
+    TEST_ASSERT_EQUAL(1, drained);
+    TEST_ASSERT_EQUAL(2, drain(log));
+    TEST_ASSERT_EQUAL(1, received[0]);
+}
+
+void test_full_log_evicts_oldest_segment(void)
+{
+    SampleLog log(fileSystem);
+    log.begin();
+    append(log, 0, 200);
+    TEST_ASSERT_GREATER_THAN(0, log.getEvictedSegments());
+    TEST_ASSERT_LESS_OR_EQUAL(SAMPLE_LOG_MAX_SEGMENTS, log.getSegmentCount());
+
+    size_t drained = drain(log);
+    TEST_ASSERT_LESS_THAN(200, drained);
+    TEST_ASSERT_EQUAL(199, received[drained - 1]); // the newest records are kept
+}
+
+// Boots without new samples reuse the empty segment instead of evicting stored ones
+void test_reboots_without_samples_keep_records(void)
+{
+    {
+        SampleLog log(fileSystem);
+        log.begin();
+        append(log, 0, 10);
+        log.end();
+    }
+    for (int boot = 0; boot < SAMPLE_LOG_MAX_SEGMENTS * 2; boot++)
+    {
+        SampleLog log(fileSystem);
+        log.begin();
+        log.end();
+    }
+
+    SampleLog log(fileSystem);
+    log.begin();
+    TEST_ASSERT_EQUAL(0, log.getEvictedSegments());
+    TEST_ASSERT_EQUAL(10, drain(log));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_records_drain_in_order_across_segments);
+    RUN_TEST(test_records_survive_a_reboot);
+    RUN_TEST(test_torn_tail_keeps_records_written_after_reboot);
+    RUN_TEST(test_drain_cursor_survives_a_reboot);
+    RUN_TEST(test_records_the_handler_refuses_stay);
+    RUN_TEST(test_full_log_evicts_oldest_segment);
+    RUN_TEST(test_reboots_without_samples_keep_records);
+    return UNITY_END();
+}
@@ -0,0 +1,163 @@
+#include <unity.h>
+
+#include <Arduino.h>
+
+#include <Scheduler.h>
+#include <SimpleTimer.h>
+
+// Scheduler on the frozen FakeClock, with more tasks than an 8 bit heap index can hold
+
+#define LARGE_CAPACITY 200
+#define BENCHMARK_MILLIS 60000
+
+uint32_t fired;
+uint32_t counts[3];
+
+void onFire() { fired++; }
+
+template <int Task>
+void onCount() { counts[Task]++; }
+
+void setUp(void)
+{
+    FakeClock::instance().set(0);
+    fired = 0;
+    memset(counts, 0, sizeof(counts));
+}
+
+void tearDown(void) {}
+
+// Deadlines 1..200 ms added out of order, one task is due per millisecond
+void test_tasks_run_in_deadline_order(void)
+{
+    static Scheduler<LARGE_CAPACITY> scheduler;
+    for (uint32_t i = 0; i < LARGE_CAPACITY; i++)
+        TEST_ASSERT_TRUE(scheduler.after((i * 7919) % LARGE_CAPACITY + 1, onFire) >= 0);
+    TEST_ASSERT_EQUAL(LARGE_CAPACITY, scheduler.size());
+
+    for (uint32_t ms = 1; ms <= LARGE_CAPACITY; ms++)
+    {
+        FakeClock::instance().advanceMillis(1);
+        scheduler.run();
+        TEST_ASSERT_EQUAL(ms, fired);
+    }
+    TEST_ASSERT_EQUAL(0, scheduler.size());
+    TEST_ASSERT_EQUAL(UINT32_MAX, scheduler.nextDeadline());
+}
+
+void test_full_scheduler_refuses_tasks(void)
+{
+    static Scheduler<LARGE_CAPACITY> scheduler;
+    for (uint32_t i = 0; i < LARGE_CAPACITY; i++)
+        TEST_ASSERT_TRUE(scheduler.every(100, onFire) >= 0);
+    TEST_ASSERT_EQUAL(-1, scheduler.every(100, onFire));
+}
+
+void test_cancel_slots_past_255(void)
+{
+    static Scheduler<300> scheduler;
+    int ids[300];
+    for (int i = 0; i < 300; i++)
+        ids[i] = scheduler.after(1000 + i, onFire);
+    TEST_ASSERT_EQUAL(299, ids[299] & 0xFFFF);
+    TEST_ASSERT_TRUE(ids[256] != ids[0]);
+
+    TEST_ASSERT_TRUE(scheduler.cancel(ids[256]));
+    TEST_ASSERT_TRUE(scheduler.cancel(ids[299]));
+    TEST_ASSERT_FALSE(scheduler.cancel(ids[299]));
+    TEST_ASSERT_EQUAL(298, scheduler.size());
+
+    int reused = scheduler.after(5, onFire);
+    TEST_ASSERT_EQUAL(256, reused & 0xFFFF); // first free slot, new generation
+    TEST_ASSERT_FALSE(scheduler.cancel(ids[256]));
+
+    FakeClock::instance().advanceMillis(1299);
+    scheduler.run();
+    TEST_ASSERT_EQUAL(299, fired);
+}
+
+void test_periodic_tasks_keep_cadence(void)
+{
+    Scheduler<4> scheduler;
+    scheduler.every(10, onCount<0>);
+    scheduler.every(25, onCount<1>);
+    int id = scheduler.every(100, onCount<2>);
+
+    for (int ms = 0; ms < 1000; ms++)
+    {
+        FakeClock::instance().advanceMillis(1);
+        scheduler.run();
+        if (ms == 499)
+            scheduler.cancel(id);
+    }
+    TEST_ASSERT_EQUAL(100, counts[0]);
+    TEST_ASSERT_EQUAL(40, counts[1]);
+    TEST_ASSERT_EQUAL(5, counts[2]);
+    TEST_ASSERT_EQUAL(10, scheduler.nextDeadline());
+}
+
+// A late loop runs a periodic task once and skips the missed periods
+void test_missed_periods_are_skipped(void)
+{
+    Scheduler<2> scheduler;
+    scheduler.every(10, onFire);
+    FakeClock::instance().advanceMillis(95);
+    TEST_ASSERT_EQUAL(10, scheduler.run());
+    TEST_ASSERT_EQUAL(1, fired);
+}
+
+static uint64_t nowNanos()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// A minute of 1 ms loops with 200 periodic tasks, Scheduler against polled SimpleTimers
+void test_benchmark_large_dispatch(void)
+{
+    static Scheduler<LARGE_CAPACITY> scheduler;
+    for (uint32_t i = 0; i < LARGE_CAPACITY; i++)
+        scheduler.every(10 + i, onFire);
+
+    uint64_t start = nowNanos();
+    for (uint32_t ms = 0; ms < BENCHMARK_MILLIS; ms++)
+    {
+        FakeClock::instance().advanceMillis(1);
+        scheduler.run();
+    }
+    uint64_t schedulerNanos = nowNanos() - start;
+    uint32_t scheduled = fired;
+
+    FakeClock::instance().set(0);
+    fired = 0;
+    static SimpleTimer timers[LARGE_CAPACITY];
+    for (uint32_t i = 0; i < LARGE_CAPACITY; i++)
+    {
+        timers[i].setPeriod(10 + i);
+        timers[i].reset();
+    }
+    start = nowNanos();
+    for (uint32_t ms = 0; ms < BENCHMARK_MILLIS; ms++)
+    {
+        FakeClock::instance().advanceMillis(1);
+        for (uint32_t i = 0; i < LARGE_CAPACITY; i++)
+            if (timers[i].ready())
+                onFire();
+    }
+    uint64_t pollNanos = nowNanos() - start;
+
+    TEST_ASSERT_EQUAL(fired, scheduled);
+    Serial.printf("%d tasks: Scheduler %lu ns/loop, SimpleTimer polling %lu ns/loop, %lu dispatches\n", LARGE_CAPACITY,
+                  (unsigned long)(schedulerNanos / BENCHMARK_MILLIS), (unsigned long)(pollNanos / BENCHMARK_MILLIS), (unsigned long)scheduled);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_tasks_run_in_deadline_order);
+    RUN_TEST(test_full_scheduler_refuses_tasks);
+    RUN_TEST(test_cancel_slots_past_255);
+    RUN_TEST(test_periodic_tasks_keep_cadence);
+    RUN_TEST(test_missed_periods_are_skipped);
+    RUN_TEST(test_benchmark_large_dispatch);
+    return UNITY_END();
+}
@@ -0,0 +1,348 @@
+#include <unity.h>
+
+#include <Arduino.h>
+#include <FirebaseClient.h>
+
+#include <AsyncDispatcher.h>
+#include <RateController.h>
+#include <SpscRing.h>
+#include <TaskTracer.h>
+
+#include <Firestore/FirestoreBatchWriter.h>
+#include <RealtimeDatabase/RealtimeBatchWriter.h>
+
+/**
+ * Virtual-device soak harness.
+ *
+ * Runs a fleet of simulated devices against the mock RTDB and Firestore endpoints on
+ * the FakeClock. Each device samples at 1 Hz into its ring and uploads under its rate
+ * controller the way the sketches' loop() does, so hours of traffic run in seconds.
+ * Every sample is accounted for as delivered, failed, lost, in flight, waiting or
+ * dropped, and each device's round-trip percentiles are printed per scenario. The
+ * writers send failed requests again themselves, their counts say where each sample is.
+ */
+
+#define SOAK_DEVICES 8
+#define SAMPLE_PERIOD_MS 1000
+#define LOOP_PERIOD_MS 20
+#define RING_SIZE 64
+#define FIRESTORE_EPOCH 1700000000 // wall clock of the virtual devices at millis() 0
+
+using Dispatcher = AsyncDispatcher<AsyncResult, SOAK_DEVICES>;
+
+struct SensorReading
+{
+    uint32_t timestamp;
+    float temperature;
+    float humidity;
+};
+
+struct SoakReport
+{
+    uint32_t sampled;
+    uint32_t dropped;   // ring full
+    uint32_t waiting;   // in the ring or the batch
+    uint32_t delivered; // in a request that succeeded
+    uint32_t failed;    // given up after its attempts
+    uint32_t open;      // in a request without a result yet, lost or in flight
+    uint32_t requests;
+    uint32_t retries;   // requests sent again after an error or a lost result
+    uint32_t timeouts;
+    uint32_t late; // results after their request timed out
+    uint32_t backOffs;
+};
+
+/**--------------------------------------------------------------------------------------
+ * Virtual Device Class
+ *
+ * One device: a sampling source, its ring, a batch writer on its own mock connection,
+ * a tracer and a rate controller. Samples are tracked by the writer.
+ *-------------------------------------------------------------------------------------*/
+
+class VirtualDevice
+{
+protected:
+    AsyncClientClass client;
+    TaskTracer tracer;
+    RateController rate;
+    SpscRing<SensorReading, RING_SIZE> ring;
+    uint32_t nextSample;
+    float temperature;
+    uint32_t requests = 0;
+
+    virtual void add(const SensorReading &reading) = 0;
+    virtual size_t space() = 0;
+    virtual size_t pending() = 0;
+    virtual bool ready() = 0;
+    virtual size_t inFlight() = 0;
+    virtual uint32_t delivered() = 0;
+    virtual uint32_t failed() = 0;
+    virtual uint32_t retries() = 0;
+    virtual bool flush() = 0;
+    virtual void service() = 0;
+    virtual void setBatch(size_t maxBatch, uint32_t maxLatency) = 0;
+    virtual void onWriterResult(uint16_t request, bool error) = 0;
+
+public:
+    VirtualDevice(uint8_t id) : nextSample(id * 97), temperature(20 + id)
+    {
+        client.setSeed(17 + id);
+        rate.setInterval(2000, 60000, 1000)
+            .setBatch(1, 20, SAMPLE_PERIOD_MS)
+            .setTargetLatency(3000)
+            .setRequestTimeout(30000);
+    }
+    virtual ~VirtualDevice() {}
+
+    AsyncClientClass &endpoint() { return client; }
+    RateController &getRate() { return rate; }
+    TaskTracer &getTracer() { return tracer; }
+
+    // Sampling task: one reading per period, a random walk around the start value
+    void sample(uint32_t now)
+    {
+        while ((int32_t)(now - nextSample) >= 0)
+        {
+            temperature += random(-10, 11) / 10.0f;
+            ring.push({nextSample, temperature, 50 + random(0, 100) / 10.0f});
+            nextSample += SAMPLE_PERIOD_MS;
+        }
+    }
+
+    // Upload loop, the same steps as loop() in the sketches
+    void loop()
+    {
+        service();
+        setBatch(rate.getBatchSize(), rate.getInterval());
+        ring.drain([this](const SensorReading &reading)
+                   { add(reading); },
+                   space());
+
+        if (ready() && rate.canSend() && flush())
+        {
+            rate.onSubmit(TaskTracer::sequenceOf(client.last().uid.c_str()));
+            requests++;
+        }
+    }
+
+    void onResult(AsyncResult &aResult)
+    {
+        if (!aResult.isError() && !aResult.available())
+            return;
+        String uid = aResult.uid();
+        tracer.complete(uid.c_str(), aResult.isError());
+        rate.onComplete(TaskTracer::sequenceOf(uid.c_str()), aResult.isError());
+        onWriterResult(TaskTracer::sequenceOf(uid.c_str()), aResult.isError());
+    }
+
+    void report(SoakReport &report)
+    {
+        report.sampled += ring.getPushed() + ring.getDropped();
+        report.dropped += ring.getDropped();
+        report.waiting += ring.size() + pending();
+        report.delivered += delivered();
+        report.failed += failed();
+        report.open += inFlight();
+        report.requests += requests;
+        report.retries += retries();
+        report.timeouts += rate.getTimeouts();
+        report.late += rate.getLate();
+        report.backOffs += rate.getDecreases();
+    }
+};
+
+class RealtimeDevice : public VirtualDevice
+{
+private:
+    RealtimeDatabase database;
+    RealtimeBatchWriter writer;
+
+protected:
+    void add(const SensorReading &reading) override { writer.add(reading.timestamp, reading.temperature, reading.humidity); }
+    size_t space() override { return writer.space(); }
+    size_t pending() override { return writer.pending(); }
+    bool ready() override { return writer.ready(); }
+    size_t inFlight() override { return writer.inFlight(); }
+    uint32_t delivered() override { return writer.getDeliveredSamples(); }
+    uint32_t failed() override { return writer.getFailedSamples(); }
+    uint32_t retries() override { return writer.getRetryCount(); }
+    bool flush() override { return writer.flush(); }
+    void service() override { database.loop(); }
+    void setBatch(size_t maxBatch, uint32_t maxLatency) override
+    {
+        writer.setMaxBatch(maxBatch);
+        writer.setMaxLatency(maxLatency);
+    }
+    void onWriterResult(uint16_t request, bool error) override { writer.onResult(request, error); }
+
+public:
+    RealtimeDevice(uint8_t id, AsyncResultCallback callback) : VirtualDevice(id), writer(client, database, callback)
+    {
+        writer.begin(String("/soak/device") + String((int)id));
+        writer.setTracer(&tracer);
+    }
+};
+
+class FirestoreDevice : public VirtualDevice
+{
+private:
+    Firestore::Documents docs;
+    FirestoreBatchWriter writer;
+
+protected:
+    void add(const SensorReading &reading) override
+    {
+        FirestoreSample sample;
+        sample.time.tv_sec = FIRESTORE_EPOCH + reading.timestamp / 1000;
+        sample.time.tv_usec = (reading.timestamp % 1000) * 1000;
+        sample.temperature = lroundf(reading.temperature);
+        sample.humidity = lroundf(reading.humidity);
+        writer.add(sample);
+    }
+    size_t space() override { return writer.space(); }
+    size_t pending() override { return writer.pending(); }
+    bool ready() override { return writer.ready(); }
+    size_t inFlight() override { return writer.inFlight(); }
+    uint32_t delivered() override { return writer.getDeliveredSamples(); }
+    uint32_t failed() override { return writer.getFailedSamples(); }
+    uint32_t retries() override { return writer.getRetryCount(); }
+    bool flush() override { return writer.flush(); }
+    void service() override { docs.loop(); }
+    void setBatch(size_t maxBatch, uint32_t maxLatency) override
+    {
+        writer.setMaxBatch(maxBatch);
+        writer.setMaxLatency(maxLatency);
+    }
+    void onWriterResult(uint16_t request, bool error) override { writer.onResult(request, error); }
+
+public:
+    FirestoreDevice(uint8_t id, AsyncResultCallback callback) : VirtualDevice(id), writer(client, docs, callback)
+    {
+        writer.begin("soak-project", "soak", String("device") + String((int)id));
+        writer.setTracer(&tracer);
+    }
+};
+
+VirtualDevice *fleet[SOAK_DEVICES];
+
+void onDeviceResult(uint8_t device, AsyncResult &aResult) { fleet[device]->onResult(aResult); }
+
+template <size_t... Ids>
+void createFleet(std::index_sequence<Ids...>)
+{
+    // Each device gets the dispatcher callback of its own id, even ids write to RTDB
+    ((fleet[Ids] = Ids % 2 ? (VirtualDevice *)new FirestoreDevice(Ids, Dispatcher::callback<Ids>)
+                           : (VirtualDevice *)new RealtimeDevice(Ids, Dispatcher::callback<Ids>)),
+     ...);
+}
+
+// Load generator: steps the fleet through simulated time, calls outage(now) to change the endpoints
+template <typename Faults>
+void run(uint32_t durationMillis, Faults faults)
+{
+    for (uint32_t now = millis(), end = now + durationMillis; (int32_t)(end - now) > 0; now = millis())
+    {
+        for (VirtualDevice *device : fleet)
+        {
+            faults(now, device->endpoint());
+            device->sample(now);
+            device->loop();
+            TEST_ASSERT_LESS_OR_EQUAL(1, device->getRate().getInFlight());
+        }
+        FakeClock::instance().advanceMillis(LOOP_PERIOD_MS);
+    }
+}
+
+SoakReport collect(const char *scenario)
+{
+    SoakReport report = {};
+    for (VirtualDevice *device : fleet)
+        device->report(report);
+
+    // Samples never vanish: each one is dropped, waiting or in exactly one request
+    TEST_ASSERT_EQUAL(report.sampled, report.dropped + report.waiting + report.delivered + report.failed + report.open);
+
+    Serial.printf("%s: sampled=%lu delivered=%lu failed=%lu open=%lu waiting=%lu dropped=%lu requests=%lu retries=%lu timeouts=%lu late=%lu back-offs=%lu\n",
+                  scenario, (unsigned long)report.sampled, (unsigned long)report.delivered, (unsigned long)report.failed,
+                  (unsigned long)report.open, (unsigned long)report.waiting, (unsigned long)report.dropped,
+                  (unsigned long)report.requests, (unsigned long)report.retries, (unsigned long)report.timeouts, (unsigned long)report.late, (unsigned long)report.backOffs);
+    for (VirtualDevice *device : fleet)
+        device->getTracer().print(Serial);
+    return report;
+}
+
+void setUp(void)
+{
+    FakeClock::instance().set(0);
+    randomSeed(17);
+    createFleet(std::make_index_sequence<SOAK_DEVICES>());
+    for (uint8_t i = 0; i < SOAK_DEVICES; i++)
+        Dispatcher::instance().on(i, onDeviceResult);
+}
+
+void tearDown(void)
+{
+    for (VirtualDevice *&device : fleet)
+    {
+        delete device;
+        device = nullptr;
+    }
+}
+
+// An hour of healthy traffic: everything but the last batches arrives, nothing is dropped
+// and the 1% errors are sent again
+void test_soak_steady(void)
+{
+    run(3600000, [](uint32_t, AsyncClientClass &endpoint)
+        { endpoint.setLatency(200, 800).setErrorRate(1); });
+
+    SoakReport report = collect("steady");
+    TEST_ASSERT_EQUAL(0, report.dropped);
+    TEST_ASSERT_EQUAL(0, report.failed);
+    TEST_ASSERT_GREATER_THAN(0, report.retries);
+    TEST_ASSERT_EQUAL(0, report.timeouts);
+    TEST_ASSERT_GREATER_OR_EQUAL(report.sampled * 95 / 100, report.delivered);
+    for (VirtualDevice *device : fleet)
+        TEST_ASSERT_EQUAL(2000, device->getRate().getInterval()); // fast round trips reach the minimum interval
+}
+
+// Slow round trips push the interval out, batches grow so the ring still keeps up
+void test_soak_slow_endpoint(void)
+{
+    run(3600000, [](uint32_t, AsyncClientClass &endpoint)
+        { endpoint.setLatency(4000, 8000); });
+
+    SoakReport report = collect("slow");
+    TEST_ASSERT_EQUAL(0, report.dropped);
+    TEST_ASSERT_EQUAL(0, report.failed);
+    for (VirtualDevice *device : fleet)
+        TEST_ASSERT_GREATER_THAN(10000, device->getRate().getInterval());
+}
+
+// Errors, lost responses and a ten minute outage: lost requests time out, the devices
+// back off and uploads resume once the endpoint is back
+void test_soak_faults(void)
+{
+    auto faults = [](uint32_t now, AsyncClientClass &endpoint)
+    {
+        bool outage = now >= 1800000 && now < 2400000;
+        endpoint.setLatency(500, 4000).setErrorRate(5).setLossRate(2).setOnline(!outage);
+    };
+    run(2400000, faults);
+    SoakReport during = collect("faults, end of outage");
+
+    run(1200000, faults);
+    SoakReport after = collect("faults, recovered");
+    TEST_ASSERT_GREATER_THAN(0, after.timeouts);
+    TEST_ASSERT_GREATER_THAN(during.failed, after.failed);
+    TEST_ASSERT_GREATER_THAN(during.delivered + (1200000 / SAMPLE_PERIOD_MS) * SOAK_DEVICES / 2, after.delivered);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_soak_steady);
+    RUN_TEST(test_soak_slow_endpoint);
+    RUN_TEST(test_soak_faults);
+    return UNITY_END();
+}
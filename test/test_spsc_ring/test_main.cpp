@@ -0,0 +1,156 @@
+#include <unity.h>
+
+#include <Arduino.h>
+#include <thread>
+
+#include <SpscRing.h>
+
+// SpscRing single threaded, then with a producer and a consumer thread standing in for
+// the sampling task and the upload loop on the two cores
+
+#define STRESS_ITEMS 2000000
+
+struct Sample
+{
+    uint32_t sequence;
+    uint32_t check; // derived from sequence, a torn copy does not match
+};
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void test_items_come_out_in_order(void)
+{
+    SpscRing<uint32_t, 8> ring;
+    TEST_ASSERT_TRUE(ring.isEmpty());
+    for (uint32_t i = 0; i < 5; i++)
+        TEST_ASSERT_TRUE(ring.push(i));
+    TEST_ASSERT_EQUAL(5, ring.size());
+
+    uint32_t item;
+    for (uint32_t i = 0; i < 5; i++)
+    {
+        TEST_ASSERT_TRUE(ring.pop(item));
+        TEST_ASSERT_EQUAL(i, item);
+    }
+    TEST_ASSERT_FALSE(ring.pop(item));
+}
+
+void test_full_ring_drops_new_items(void)
+{
+    SpscRing<uint32_t, 4> ring;
+    for (uint32_t i = 0; i < 6; i++)
+        ring.push(i);
+    TEST_ASSERT_EQUAL(4, ring.size());
+    TEST_ASSERT_EQUAL(4, ring.getPushed());
+    TEST_ASSERT_EQUAL(2, ring.getDropped());
+
+    uint32_t item;
+    ring.pop(item);
+    TEST_ASSERT_EQUAL(0, item); // the oldest items were kept
+    TEST_ASSERT_TRUE(ring.push(10));
+}
+
+void test_drain_releases_a_bounded_run(void)
+{
+    SpscRing<uint32_t, 8> ring;
+    uint32_t item;
+    for (uint32_t i = 0; i < 6; i++) // wrap the indices around the end
+    {
+        ring.push(i);
+        ring.pop(item);
+    }
+    for (uint32_t i = 0; i < 7; i++)
+        ring.push(100 + i);
+
+    uint32_t sum = 0;
+    TEST_ASSERT_EQUAL(5, ring.drain([&](const uint32_t &value)
+                                    { sum += value; },
+                                    5));
+    TEST_ASSERT_EQUAL(100 + 101 + 102 + 103 + 104, sum);
+    TEST_ASSERT_EQUAL(2, ring.size());
+    TEST_ASSERT_EQUAL(2, ring.drain([](const uint32_t &) {}));
+    TEST_ASSERT_TRUE(ring.isEmpty());
+}
+
+static uint64_t nowNanos()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// The producer retries when full so every item must arrive once, in order and intact
+void test_two_threads_keep_order(void)
+{
+    static SpscRing<Sample, 64> ring;
+    uint64_t start = nowNanos();
+    std::thread producer([]()
+                         {
+                             for (uint32_t i = 0; i < STRESS_ITEMS; i++)
+                             {
+                                 while (!ring.push(Sample{i, ~i * 2654435761u}))
+                                     std::this_thread::yield();
+                             } });
+
+    uint32_t expected = 0;
+    uint32_t errors = 0;
+    while (expected < STRESS_ITEMS)
+    {
+        size_t drained = ring.drain([&](const Sample &sample)
+                                    {
+                                        if (sample.sequence != expected || sample.check != ~expected * 2654435761u)
+                                            errors++;
+                                        expected++; },
+                                    16);
+        if (!drained)
+            std::this_thread::yield();
+    }
+    producer.join();
+    uint64_t elapsed = nowNanos() - start;
+
+    TEST_ASSERT_EQUAL(0, errors);
+    TEST_ASSERT_TRUE(ring.isEmpty());
+    TEST_ASSERT_EQUAL(STRESS_ITEMS, ring.getPushed());
+    Serial.printf("two threads: %lu ns/item, %lu full-ring retries\n",
+                  (unsigned long)(elapsed / STRESS_ITEMS), (unsigned long)ring.getDropped());
+}
+
+// A producer that never retries loses items but the consumer still sees them in order
+void test_two_threads_with_drops(void)
+{
+    static SpscRing<uint32_t, 16> ring;
+    std::atomic<bool> done{false};
+    std::thread producer([&]()
+                         {
+                             for (uint32_t i = 1; i <= STRESS_ITEMS / 4; i++)
+                                 ring.push(i);
+                             done = true; });
+
+    uint32_t last = 0;
+    uint32_t received = 0;
+    bool ordered = true;
+    uint32_t value;
+    while (!done || !ring.isEmpty())
+    {
+        if (!ring.pop(value))
+            continue;
+        ordered = ordered && value > last;
+        last = value;
+        received++;
+    }
+    producer.join();
+
+    TEST_ASSERT_TRUE(ordered);
+    TEST_ASSERT_EQUAL(STRESS_ITEMS / 4, received + ring.getDropped());
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_items_come_out_in_order);
+    RUN_TEST(test_full_ring_drops_new_items);
+    RUN_TEST(test_drain_releases_a_bounded_run);
+    RUN_TEST(test_two_threads_keep_order);
+    RUN_TEST(test_two_threads_with_drops);
+    return UNITY_END();
+}
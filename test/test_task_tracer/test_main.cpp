@@ -0,0 +1,158 @@
+#include <unity.h>
+
+#include <Arduino.h>
+
+#define TASK_TRACER_MAX_OPERATIONS 3
+#define TASK_TRACER_MAX_IN_FLIGHT 4
+#include <TaskTracer.h>
+
+// Task latency tracing on the frozen FakeClock
+
+void setUp(void) { FakeClock::instance().set(0); }
+
+void tearDown(void) {}
+
+void test_uid_names_operation_and_sequence(void)
+{
+    TaskTracer tracer;
+    TEST_ASSERT_EQUAL_STRING("commitTask#1", tracer.submit("commitTask").c_str());
+    TEST_ASSERT_EQUAL_STRING("pushTask#2", tracer.submit("pushTask").c_str());
+    TEST_ASSERT_EQUAL(2, tracer.size());
+    TEST_ASSERT_EQUAL(2, tracer.inFlight());
+}
+
+void test_completion_records_latency(void)
+{
+    TaskTracer tracer;
+    String first = tracer.submit("commitTask");
+    FakeClock::instance().advanceMillis(100);
+    String second = tracer.submit("commitTask");
+    FakeClock::instance().advanceMillis(250);
+
+    uint32_t latency = 0;
+    TEST_ASSERT_TRUE(tracer.complete(second.c_str(), false, &latency));
+    TEST_ASSERT_EQUAL(250, latency);
+    TEST_ASSERT_TRUE(tracer.complete(first.c_str(), true, &latency)); // out of order
+    TEST_ASSERT_EQUAL(350, latency);
+    TEST_ASSERT_FALSE(tracer.complete(first.c_str(), false)); // only once
+
+    TaskStatsSnapshot stats;
+    TEST_ASSERT_TRUE(tracer.snapshot("commitTask", stats));
+    TEST_ASSERT_EQUAL(2, stats.submitted);
+    TEST_ASSERT_EQUAL(2, stats.completed);
+    TEST_ASSERT_EQUAL(1, stats.errors);
+    TEST_ASSERT_EQUAL(0, stats.inFlight);
+    TEST_ASSERT_EQUAL(300, stats.mean);
+    TEST_ASSERT_EQUAL(350, stats.max);
+}
+
+void test_foreign_uids_are_ignored(void)
+{
+    TaskTracer tracer;
+    tracer.submit("commitTask");
+    TEST_ASSERT_FALSE(tracer.complete("authTask", false));      // no separator
+    TEST_ASSERT_FALSE(tracer.complete("streamTask#1", false));  // unknown operation
+    TEST_ASSERT_FALSE(tracer.complete("commitTask#99", false)); // unknown sequence
+    TEST_ASSERT_FALSE(tracer.complete("commit#1", false));      // operation prefix only
+    TEST_ASSERT_EQUAL(1, tracer.inFlight());
+}
+
+void test_expired_tasks_are_counted_and_late_results_ignored(void)
+{
+    TaskTracer tracer;
+    String old = tracer.submit("commitTask");
+    FakeClock::instance().advanceMillis(5000);
+    String recent = tracer.submit("commitTask");
+    FakeClock::instance().advanceMillis(1000);
+
+    tracer.expire(3000);
+    TEST_ASSERT_EQUAL(1, tracer.inFlight());
+    TEST_ASSERT_FALSE(tracer.complete(old.c_str(), false));
+    TEST_ASSERT_TRUE(tracer.complete(recent.c_str(), false));
+
+    TaskStatsSnapshot stats;
+    tracer.snapshot("commitTask", stats);
+    TEST_ASSERT_EQUAL(1, stats.expired);
+    TEST_ASSERT_EQUAL(1, stats.completed);
+}
+
+// With every slot in flight the oldest task is dropped to trace the new one
+void test_full_table_drops_the_oldest_task(void)
+{
+    TaskTracer tracer;
+    String uids[TASK_TRACER_MAX_IN_FLIGHT + 1];
+    for (int i = 0; i <= TASK_TRACER_MAX_IN_FLIGHT; i++)
+    {
+        uids[i] = tracer.submit("commitTask");
+        FakeClock::instance().advanceMillis(10);
+    }
+    TEST_ASSERT_EQUAL(TASK_TRACER_MAX_IN_FLIGHT, tracer.inFlight());
+    TEST_ASSERT_FALSE(tracer.complete(uids[0].c_str(), false));
+    for (int i = 1; i <= TASK_TRACER_MAX_IN_FLIGHT; i++)
+        TEST_ASSERT_TRUE(tracer.complete(uids[i].c_str(), false));
+
+    TaskStatsSnapshot stats;
+    tracer.snapshot("commitTask", stats);
+    TEST_ASSERT_EQUAL(1, stats.expired);
+}
+
+void test_full_operation_table_leaves_tasks_untraced(void)
+{
+    TaskTracer tracer;
+    tracer.submit("a");
+    tracer.submit("b");
+    tracer.submit("c");
+    TEST_ASSERT_EQUAL_STRING("d", tracer.submit("d").c_str());
+    TEST_ASSERT_EQUAL(3, tracer.size());
+    TEST_ASSERT_EQUAL(3, tracer.inFlight());
+}
+
+// Collects the printed stats
+struct CapturePrint
+{
+    String text;
+
+    size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)))
+    {
+        char line[256];
+        va_list args;
+        va_start(args, format);
+        int written = vsnprintf(line, sizeof(line), format, args);
+        va_end(args);
+        text += line;
+        return written;
+    }
+};
+
+void test_print_reports_percentiles(void)
+{
+    TaskTracer tracer;
+    for (uint32_t latency = 1; latency <= 100; latency++)
+    {
+        String uid = tracer.submit("pushTask");
+        FakeClock::instance().advanceMillis(latency);
+        tracer.complete(uid.c_str(), latency == 100);
+    }
+    CapturePrint out;
+    tracer.print(out);
+    TEST_ASSERT_TRUE(out.text.indexOf("pushTask: sent=100 done=100 errors=1 expired=0 in-flight=0 mean=50 ") == 0);
+    TEST_ASSERT_TRUE(out.text.indexOf(" max=100 ms") > 0);
+
+    TaskStatsSnapshot stats;
+    tracer.snapshot("pushTask", stats);
+    TEST_ASSERT_UINT32_WITHIN(50 / 8, 50, stats.p50);
+    TEST_ASSERT_UINT32_WITHIN(95 / 8, 95, stats.p95);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_uid_names_operation_and_sequence);
+    RUN_TEST(test_completion_records_latency);
+    RUN_TEST(test_foreign_uids_are_ignored);
+    RUN_TEST(test_expired_tasks_are_counted_and_late_results_ignored);
+    RUN_TEST(test_full_table_drops_the_oldest_task);
+    RUN_TEST(test_full_operation_table_leaves_tasks_untraced);
+    RUN_TEST(test_print_reports_percentiles);
+    return UNITY_END();
+}
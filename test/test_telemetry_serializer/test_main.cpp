@@ -0,0 +1,204 @@
+#include <unity.h>
+
+#include <Arduino.h>
+
+#include <TelemetryRecord.h>
+
+// Output of the schema serializer and microbenchmarks against the snprintf + String
+// building it replaced. Timings use the real clock and are printed, not asserted.
+
+#define BENCHMARK_RECORDS 20
+#define BENCHMARK_ROUNDS 2000
+
+struct Reading
+{
+    char key[21];
+    struct timeval time;
+    uint32_t sequence;
+    int16_t offset;
+    float temperature;
+    double humidity;
+    bool alarm;
+    const char *unit;
+
+    TELEMETRY_SCHEMA(telemetryField("timestamp", &Reading::time),
+                     telemetryField("key", &Reading::key),
+                     telemetryField("sequence", &Reading::sequence),
+                     telemetryField("offset", &Reading::offset),
+                     telemetryField("temperature", &Reading::temperature, 1),
+                     telemetryField("humidity", &Reading::humidity),
+                     telemetryField("alarm", &Reading::alarm),
+                     telemetryField("unit", &Reading::unit))
+};
+
+struct Sample
+{
+    uint32_t timestamp;
+    float temperature;
+    float humidity;
+
+    TELEMETRY_SCHEMA(telemetryField("timestamp", &Sample::timestamp),
+                     telemetryField("temperature", &Sample::temperature),
+                     telemetryField("humidity", &Sample::humidity))
+};
+
+struct Climate
+{
+    struct timeval time;
+    float temperature;
+    float humidity;
+    bool alarm;
+
+    TELEMETRY_SCHEMA(telemetryField("timestamp", &Climate::time),
+                     telemetryField("temperature", &Climate::temperature),
+                     telemetryField("humidity", &Climate::humidity),
+                     telemetryField("alarm", &Climate::alarm))
+};
+
+static Reading reading()
+{
+    Reading reading = {"-NxA0", {1700000000, 123456}, 42, -7, 21.46f, 55.555, true, "C \"dry\""};
+    return reading;
+}
+
+void setUp(void) { FakeClock::instance().unfreeze(); }
+
+void tearDown(void) {}
+
+void test_realtime_json_of_every_field_type(void)
+{
+    char json[256];
+    size_t length = TelemetrySerializer::toRealtimeJson(reading(), json, sizeof(json));
+    TEST_ASSERT_EQUAL_STRING("{\"timestamp\":1700000000123,\"key\":\"-NxA0\",\"sequence\":42,\"offset\":-7,"
+                             "\"temperature\":21.5,\"humidity\":55.56,\"alarm\":true,\"unit\":\"C \\\"dry\\\"\"}",
+                             json);
+    TEST_ASSERT_EQUAL(strlen(json), length);
+}
+
+void test_numbers_are_formatted_by_hand(void)
+{
+    char json[64];
+    JsonBufferWriter writer(json, sizeof(json));
+    writer.putFloat(-0.004, 2);
+    writer.put(',');
+    writer.putFloat(NAN);
+    writer.put(',');
+    writer.putSigned(INT64_MIN);
+    writer.put(',');
+    writer.putFloat(9.999, 2);
+    writer.finish();
+    TEST_ASSERT_EQUAL_STRING("-0.00,null,-9223372036854775808,10.00", json);
+}
+
+void test_control_characters_are_escaped(void)
+{
+    char json[32];
+    JsonBufferWriter writer(json, sizeof(json));
+    writer.putString("a\nb\\");
+    writer.finish();
+    TEST_ASSERT_EQUAL_STRING("\"a\\u000ab\\\\\"", json);
+}
+
+void test_overflow_returns_zero(void)
+{
+    char json[16];
+    TEST_ASSERT_EQUAL(0, TelemetrySerializer::toRealtimeJson(reading(), json, sizeof(json)));
+    TEST_ASSERT_EQUAL(15, strlen(json)); // still terminated
+}
+
+void test_frame_holds_json_values_and_time(void)
+{
+    Climate climate = {{1700000000, 123456}, 21.46f, 55.5f, false};
+    TelemetryFrame frame;
+    TEST_ASSERT_TRUE(TelemetrySerializer::toFrame(climate, frame));
+    TEST_ASSERT_EQUAL(1700000000, frame.time.tv_sec);
+    TEST_ASSERT_EQUAL(123456, frame.time.tv_usec);
+    TEST_ASSERT_EQUAL(2, frame.valueCount); // flags and the time are not values
+    TEST_ASSERT_EQUAL_FLOAT(21.46f, frame.values[0]);
+    TEST_ASSERT_EQUAL_FLOAT(55.5f, frame.values[1]);
+    TEST_ASSERT_EQUAL_STRING("{\"timestamp\":1700000000123,\"temperature\":21.46,\"humidity\":55.50,\"alarm\":false}", frame.json);
+    TEST_ASSERT_EQUAL(strlen(frame.json), frame.jsonLength);
+
+    TEST_ASSERT_FALSE(TelemetrySerializer::toFrame(reading(), frame)); // longer than TELEMETRY_FRAME_JSON_SIZE
+}
+
+// One batch of samples as a multi-path update body, the way RealtimeBatchWriter builds it
+void test_benchmark_batch_payload(void)
+{
+    Sample samples[BENCHMARK_RECORDS];
+    for (int i = 0; i < BENCHMARK_RECORDS; i++)
+        samples[i] = {(uint32_t)(1000 * i), 20 + i / 7.0f, 50 - i / 3.0f};
+    static char payload[BENCHMARK_RECORDS * 96 + 2];
+    char key[8];
+
+    uint32_t start = micros();
+    size_t serializerLength = 0;
+    for (int round = 0; round < BENCHMARK_ROUNDS; round++)
+    {
+        JsonBufferWriter writer(payload, sizeof(payload));
+        writer.put('{');
+        for (int i = 0; i < BENCHMARK_RECORDS; i++)
+        {
+            if (i)
+                writer.put(',');
+            snprintf(key, sizeof(key), "k%d", i);
+            writer.putKey(key);
+            TelemetrySerializer::writeRealtime(writer, samples[i]);
+        }
+        writer.put('}');
+        serializerLength = writer.finish();
+    }
+    uint32_t serializerMicros = micros() - start;
+    String serialized(payload);
+
+    start = micros();
+    String concatenated;
+    for (int round = 0; round < BENCHMARK_ROUNDS; round++)
+    {
+        char entry[96];
+        concatenated = "";
+        concatenated += "{";
+        for (int i = 0; i < BENCHMARK_RECORDS; i++)
+        {
+            snprintf(entry, sizeof(entry), "%s\"k%d\":{\"timestamp\":%lu,\"temperature\":%.2f,\"humidity\":%.2f}",
+                     i ? "," : "", i, (unsigned long)samples[i].timestamp, samples[i].temperature, samples[i].humidity);
+            concatenated += entry;
+        }
+        concatenated += "}";
+    }
+    uint32_t snprintfMicros = micros() - start;
+
+    TEST_ASSERT_EQUAL_STRING(concatenated.c_str(), serialized.c_str());
+    TEST_ASSERT_EQUAL(concatenated.length(), serializerLength);
+
+    unsigned long records = (unsigned long)BENCHMARK_RECORDS * BENCHMARK_ROUNDS;
+    Serial.printf("batch of %d: serializer %lu ns/record, snprintf + String %lu ns/record\n", BENCHMARK_RECORDS,
+                  (unsigned long)(serializerMicros * 1000ULL / records), (unsigned long)(snprintfMicros * 1000ULL / records));
+}
+
+void test_benchmark_frame(void)
+{
+    Climate climate = {{1700000000, 0}, 21.46f, 55.5f, false};
+    TelemetryFrame frame;
+    uint32_t start = micros();
+    for (int round = 0; round < BENCHMARK_ROUNDS * BENCHMARK_RECORDS; round++)
+    {
+        climate.time.tv_usec = round % 1000000;
+        TEST_ASSERT_TRUE(TelemetrySerializer::toFrame(climate, frame));
+    }
+    uint32_t elapsed = micros() - start;
+    Serial.printf("toFrame: %lu ns/record\n", (unsigned long)(elapsed * 1000ULL / (BENCHMARK_ROUNDS * BENCHMARK_RECORDS)));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_realtime_json_of_every_field_type);
+    RUN_TEST(test_numbers_are_formatted_by_hand);
+    RUN_TEST(test_control_characters_are_escaped);
+    RUN_TEST(test_overflow_returns_zero);
+    RUN_TEST(test_frame_holds_json_values_and_time);
+    RUN_TEST(test_benchmark_batch_payload);
+    RUN_TEST(test_benchmark_frame);
+    return UNITY_END();
+}
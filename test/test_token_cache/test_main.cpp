@@ -0,0 +1,232 @@
+#include <unity.h>
+
+#include <Arduino.h>
+#include <FS.h>
+#include <filesystem>
+
+#include <BootSequencer.h>
+#include <FirebaseClient.h>
+
+#include <CredentialsManager/AuthSession.h>
+
+// TokenCache on the file-backed FS, and AuthSession on a cold boot on the frozen
+// FakeClock: NTP sync and auth start together after Wi-Fi, a cached token waits for the
+// clock instead of signing in
+
+#define TEST_FS_ROOT "./.native_fs_token_cache"
+
+#define WIFI_DONE_MS 300
+#define NTP_SYNC_MS 400 // from Wi-Fi up to the clock set
+#define NTP_TIMEOUT_MS 10000
+#define SIGN_IN_MS 1200 // sign-in round trip, a restored token needs none
+#define ISSUED_AT 1700000000
+
+fs::FS fileSystem(TEST_FS_ROOT);
+TokenCache tokenCache(fileSystem);
+AsyncClientClass aClient;
+FirebaseApp app;
+FirebaseCredential credential;
+AuthSession *authSession;
+
+// Boot state of the sketch, the wall clock is 0 until the ntp phase sets it
+BootSequencer<8> *boot;
+uint8_t ntpPhase;
+bool ntpAnswers;
+time_t wallTime;
+uint32_t syncMillis;
+bool waitForClock; // false checks the token when auth starts, the boot before the fix
+
+static FirebaseCredential firebase()
+{
+    return FirebaseCredential{"AIzaSy-key", "demo-project", "https://demo-project.firebaseio.com", "device@example.com", "device-pass"};
+}
+
+static time_t now() { return wallTime ? wallTime + (millis() - syncMillis) / 1000 : 0; }
+
+void onAuthResult(AsyncResult &aResult) { authSession->onResult(aResult); }
+
+BootStatus wifiConnected() { return millis() >= WIFI_DONE_MS ? BOOT_DONE : BOOT_PENDING; }
+
+BootStatus timeSynced()
+{
+    if (!ntpAnswers || millis() < WIFI_DONE_MS + NTP_SYNC_MS)
+        return BOOT_PENDING;
+    wallTime = ISSUED_AT + 600; // ten minutes after the token was issued
+    syncMillis = millis();
+    return BOOT_DONE;
+}
+
+BootStatus startApp()
+{
+    authSession->begin(credential);
+    return BOOT_PENDING;
+}
+
+// appReady() of the sketches
+BootStatus appReady()
+{
+    BootPhaseState ntp = boot->getState(ntpPhase);
+    return authSession->ready(now(), waitForClock && (ntp == BOOT_PHASE_WAITING || ntp == BOOT_PHASE_RUNNING)) ? BOOT_DONE : BOOT_PENDING;
+}
+
+// Boots and returns the milliseconds from Wi-Fi up to the app ready
+static uint32_t timeToReady()
+{
+    BootSequencer<8> sequencer;
+    boot = &sequencer;
+    wallTime = 0;
+    uint8_t wifi = sequencer.add("wifi", nullptr, wifiConnected);
+    ntpPhase = sequencer.add("ntp", nullptr, timeSynced, BOOT_AFTER(wifi), NTP_TIMEOUT_MS);
+    uint8_t auth = sequencer.add("auth", startApp, appReady, BOOT_AFTER(wifi), 30000);
+    sequencer.run(60000);
+    TEST_ASSERT_EQUAL(BOOT_PHASE_DONE, sequencer.getState(auth));
+    return millis() - WIFI_DONE_MS;
+}
+
+// A token issued at ISSUED_AT, as the app saved it on an earlier boot
+static void saveToken()
+{
+    AuthToken token;
+    token.idToken = "id-token";
+    token.refreshToken = "refresh-token";
+    token.expiresAt = ISSUED_AT + AUTH_TOKEN_LIFETIME_SEC;
+    TEST_ASSERT_TRUE(tokenCache.save(firebase(), token));
+}
+
+void setUp(void)
+{
+    std::filesystem::remove_all(TEST_FS_ROOT);
+    fileSystem.begin();
+    FakeClock::instance().set(0);
+    aClient = AsyncClientClass();
+    aClient.setLatency(SIGN_IN_MS, SIGN_IN_MS);
+    app = FirebaseApp();
+    credential = firebase();
+    authSession = new AuthSession(aClient, app, fileSystem, onAuthResult);
+    ntpAnswers = true;
+    waitForClock = true;
+}
+
+void tearDown(void)
+{
+    delete authSession;
+    std::filesystem::remove_all(TEST_FS_ROOT);
+}
+
+void test_round_trip_and_other_account(void)
+{
+    saveToken();
+    AuthToken token;
+    TEST_ASSERT_TRUE(tokenCache.load(firebase(), token));
+    TEST_ASSERT_EQUAL_STRING("id-token", token.idToken.c_str());
+    TEST_ASSERT_EQUAL_STRING("refresh-token", token.refreshToken.c_str());
+    TEST_ASSERT_EQUAL(ISSUED_AT + AUTH_TOKEN_LIFETIME_SEC, token.expiresAt);
+
+    FirebaseCredential other = firebase();
+    other.userEmail = "other@example.com";
+    TEST_ASSERT_FALSE(tokenCache.load(other, token));
+}
+
+void test_auth_start_waits_only_for_a_cached_token(void)
+{
+    AuthToken token;
+    token.expiresAt = ISSUED_AT + AUTH_TOKEN_LIFETIME_SEC;
+    TEST_ASSERT_EQUAL(AUTH_SIGN_IN, authStart(false, token, 0, true));
+    TEST_ASSERT_EQUAL(AUTH_WAIT_FOR_CLOCK, authStart(true, token, 0, true));
+    TEST_ASSERT_EQUAL(AUTH_SIGN_IN, authStart(true, token, 0, false)); // the sync gave up
+    TEST_ASSERT_EQUAL(AUTH_RESTORE, authStart(true, token, ISSUED_AT, false));
+    TEST_ASSERT_EQUAL(AUTH_SIGN_IN, authStart(true, token, token.expiresAt - AUTH_TOKEN_MIN_TTL_SEC + 1, false));
+}
+
+// Checking the token when auth starts, before NTP, always signed in on a cold boot
+void test_cached_token_is_restored_on_cold_boot(void)
+{
+    saveToken();
+    waitForClock = false;
+    uint32_t before = timeToReady();
+    TEST_ASSERT_FALSE(authSession->isFromCache());
+
+    FakeClock::instance().set(0);
+    saveToken(); // the sign-in replaced it
+    app = FirebaseApp();
+    waitForClock = true;
+    uint32_t after = timeToReady();
+    TEST_ASSERT_TRUE(authSession->isFromCache());
+    TEST_ASSERT_EQUAL(0, app.getSignIns()); // the app took the cached token as it is
+    TEST_ASSERT_EQUAL_STRING("id-token", app.getToken().c_str());
+
+    TEST_ASSERT_EQUAL(SIGN_IN_MS, before);
+    TEST_ASSERT_EQUAL(NTP_SYNC_MS, after);
+    Serial.printf("time to ready after Wi-Fi: %lu ms signing in, %lu ms restoring the cached token\n",
+                  (unsigned long)before, (unsigned long)after);
+}
+
+void test_sign_in_when_ntp_gives_up(void)
+{
+    saveToken();
+    ntpAnswers = false;
+    TEST_ASSERT_EQUAL(NTP_TIMEOUT_MS + SIGN_IN_MS, timeToReady());
+    TEST_ASSERT_FALSE(authSession->isFromCache());
+}
+
+// Without a cached token auth doesn't wait for NTP at all
+void test_sign_in_without_cache_overlaps_ntp(void)
+{
+    TEST_ASSERT_EQUAL(SIGN_IN_MS, timeToReady());
+    TEST_ASSERT_FALSE(authSession->isFromCache());
+}
+
+// The token of a sign-in is stored once the clock is set, the next boot restores it
+void test_signed_in_token_is_restored_on_next_boot(void)
+{
+    timeToReady();
+    AuthToken token;
+    TEST_ASSERT_TRUE(tokenCache.load(firebase(), token));
+    TEST_ASSERT_EQUAL_STRING("id-token-1", token.idToken.c_str());
+    TEST_ASSERT_EQUAL_STRING("refresh-token-1", token.refreshToken.c_str());
+
+    FakeClock::instance().set(0);
+    app = FirebaseApp();
+    TEST_ASSERT_EQUAL(NTP_SYNC_MS, timeToReady());
+    TEST_ASSERT_TRUE(authSession->isFromCache());
+    TEST_ASSERT_EQUAL_STRING("id-token-1", app.getToken().c_str());
+}
+
+// An error on the auth task after a restore drops the cache, ready() signs in again
+void test_rejected_cached_token_signs_in_again(void)
+{
+    saveToken();
+    wallTime = ISSUED_AT;
+    syncMillis = 0;
+    authSession->begin(credential);
+    TEST_ASSERT_TRUE(authSession->ready(now(), false));
+    TEST_ASSERT_TRUE(authSession->isFromCache());
+
+    aClient.setErrorRate(100);
+    aClient.submit("POST", "accounts:lookup", "", onAuthResult, "authTask"); // the server revoked the token
+    FakeClock::instance().advanceMillis(SIGN_IN_MS);
+    aClient.loop();
+    AuthToken token;
+    TEST_ASSERT_FALSE(tokenCache.load(firebase(), token));
+
+    aClient.setErrorRate(0);
+    TEST_ASSERT_FALSE(authSession->ready(now(), false));
+    FakeClock::instance().advanceMillis(SIGN_IN_MS);
+    TEST_ASSERT_TRUE(authSession->ready(now(), false));
+    TEST_ASSERT_FALSE(authSession->isFromCache());
+    TEST_ASSERT_TRUE(tokenCache.load(firebase(), token));
+    TEST_ASSERT_EQUAL_STRING("id-token-1", token.idToken.c_str());
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_round_trip_and_other_account);
+    RUN_TEST(test_auth_start_waits_only_for_a_cached_token);
+    RUN_TEST(test_cached_token_is_restored_on_cold_boot);
+    RUN_TEST(test_sign_in_when_ntp_gives_up);
+    RUN_TEST(test_sign_in_without_cache_overlaps_ntp);
+    RUN_TEST(test_signed_in_token_is_restored_on_next_boot);
+    RUN_TEST(test_rejected_cached_token_signs_in_again);
+    return UNITY_END();
+}
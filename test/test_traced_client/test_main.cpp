@@ -0,0 +1,124 @@
+#include <unity.h>
+
+#include <Arduino.h>
+
+#include <TracedClient.h>
+
+// Handshake counts of TracedClient against a stand-in TLS server on the frozen FakeClock.
+// Every connect is a full handshake, there is no session resumption to count.
+
+#define HANDSHAKE_MS 800
+#define IDLE_TIMEOUT_MS 180000 // TLS_SESSION_TIMEOUT_SEC of the sketches
+
+// Stand-in server: a handshake takes HANDSHAKE_MS, idle connections are closed after
+// IDLE_TIMEOUT_MS and hosts other than the known ones refuse the connection
+class StandInTlsClient : public Client
+{
+private:
+    bool open = false;
+    uint32_t lastUse = 0;
+
+public:
+    String host;
+
+    int connect(IPAddress ip, uint16_t port) override { return StandInTlsClient::connect("192.168.1.10", port); }
+
+    int connect(const char *host, uint16_t port) override
+    {
+        delay(HANDSHAKE_MS);
+        if (port != 443 || (strcmp(host, "rtdb.example") != 0 && strcmp(host, "firestore.example") != 0 && strcmp(host, "192.168.1.10") != 0))
+            return 0;
+        this->host = host;
+        open = true;
+        lastUse = millis();
+        return 1;
+    }
+
+    uint8_t connected() override
+    {
+        if (open && millis() - lastUse >= IDLE_TIMEOUT_MS)
+            open = false; // closed by the server while idle
+        return open;
+    }
+
+    void stop() override { open = false; }
+
+    void use() { lastUse = millis(); }
+};
+
+typedef TracedClient<StandInTlsClient> Traced;
+
+// What the async client does per task: keep the connection if it is open to the same
+// host, otherwise reconnect
+static bool request(Traced &client, const char *host)
+{
+    if (!client.connected() || client.host != host)
+    {
+        client.stop();
+        if (!client.connect(host, 443))
+            return false;
+    }
+    delay(50); // request and response
+    client.use();
+    return true;
+}
+
+void setUp(void) { FakeClock::instance().set(0); }
+
+void tearDown(void) {}
+
+// Uploads closer together than the idle timeout share one handshake
+void test_kept_alive_connection_is_reused(void)
+{
+    Traced client;
+    for (int i = 0; i < 10; i++)
+    {
+        TEST_ASSERT_TRUE(request(client, "rtdb.example"));
+        delay(60000); // the slowest upload interval
+    }
+    TEST_ASSERT_EQUAL(1, client.getHandshakes());
+    TEST_ASSERT_EQUAL(HANDSHAKE_MS, client.getHandshakeMean());
+
+    delay(IDLE_TIMEOUT_MS);
+    TEST_ASSERT_TRUE(request(client, "rtdb.example"));
+    TEST_ASSERT_EQUAL(2, client.getHandshakes()); // closed while idle, no resumption
+}
+
+// Alternating hosts on one client reconnect every task, a client per host doesn't
+void test_client_per_host_avoids_handshakes(void)
+{
+    Traced shared;
+    Traced rtdb;
+    Traced firestore;
+    for (int i = 0; i < 10; i++)
+    {
+        TEST_ASSERT_TRUE(request(shared, i % 2 ? "firestore.example" : "rtdb.example"));
+        TEST_ASSERT_TRUE(request(i % 2 ? firestore : rtdb, i % 2 ? "firestore.example" : "rtdb.example"));
+        delay(5000);
+    }
+    TEST_ASSERT_EQUAL(10, shared.getHandshakes());
+    TEST_ASSERT_EQUAL(1, rtdb.getHandshakes());
+    TEST_ASSERT_EQUAL(1, firestore.getHandshakes());
+    Serial.printf("10 alternating tasks: %lu handshakes on one client, %lu on a client per host\n",
+                  (unsigned long)shared.getHandshakes(), (unsigned long)(rtdb.getHandshakes() + firestore.getHandshakes()));
+}
+
+void test_failed_connects_are_counted_apart(void)
+{
+    Traced client;
+    TEST_ASSERT_FALSE(request(client, "unknown.example"));
+    TEST_ASSERT_EQUAL(0, client.getHandshakes());
+    TEST_ASSERT_EQUAL(1, client.getFailures());
+
+    TEST_ASSERT_EQUAL(1, client.connect(IPAddress(192, 168, 1, 10), 443));
+    TEST_ASSERT_EQUAL(1, client.getHandshakes());
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_kept_alive_connection_is_reused);
+    RUN_TEST(test_client_per_host_avoids_handshakes);
+    RUN_TEST(test_failed_connects_are_counted_apart);
+    return UNITY_END();
+}